@@ -96,6 +96,7 @@ void VoxelTool::set_voxel(Vector3i pos, uint64_t v) {
 		PRINT_VERBOSE("Area not editable");
 		return;
 	}
+	_pre_edit(box);
 	_set_voxel(pos, v);
 	_post_edit(box);
 }
@@ -106,6 +107,7 @@ void VoxelTool::set_voxel_f(Vector3i pos, float v) {
 		PRINT_VERBOSE("Area not editable");
 		return;
 	}
+	_pre_edit(box);
 	_set_voxel_f(pos, v);
 	_post_edit(box);
 }
@@ -115,6 +117,7 @@ void VoxelTool::do_point(Vector3i pos) {
 	if (!is_area_editable(box)) {
 		return;
 	}
+	_pre_edit(box);
 	if (_channel == VoxelBuffer::CHANNEL_SDF) {
 		_set_voxel_f(pos, _mode == MODE_REMOVE ? 1.0 : -1.0);
 	} else {
@@ -187,6 +190,7 @@ void VoxelTool::do_sphere(Vector3 center, float radius) {
 		PRINT_VERBOSE("Area not editable");
 		return;
 	}
+	_pre_edit(box);
 
 	if (_channel == VoxelBuffer::CHANNEL_SDF) {
 		box.for_each_cell([this, center, radius](Vector3i pos) {
@@ -218,6 +222,7 @@ void VoxelTool::sdf_stamp_erase(Ref<VoxelBuffer> stamp, Vector3i pos) {
 		PRINT_VERBOSE("Area not editable");
 		return;
 	}
+	_pre_edit(box);
 
 	box.for_each_cell_zxy([this, stamp, pos](Vector3i pos_in_volume) {
 		const Vector3i pos_in_stamp = pos_in_volume - pos;
@@ -240,6 +245,7 @@ void VoxelTool::do_box(Vector3i begin, Vector3i end) {
 		PRINT_VERBOSE("Area not editable");
 		return;
 	}
+	_pre_edit(box);
 
 	if (_channel == VoxelBuffer::CHANNEL_SDF) {
 		// TODO Better quality
@@ -272,6 +278,10 @@ bool VoxelTool::is_area_editable(const Box3i &box) const {
 	return false;
 }
 
+void VoxelTool::_pre_edit(const Box3i &box) {
+	// Can be implemented in subclasses
+}
+
 void VoxelTool::_post_edit(const Box3i &box) {
 	ERR_PRINT("Not implemented");
 }
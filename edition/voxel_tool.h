@@ -85,6 +85,8 @@ protected:
 	virtual float _get_voxel_f(Vector3i pos) const;
 	virtual void _set_voxel(Vector3i pos, uint64_t v);
 	virtual void _set_voxel_f(Vector3i pos, float v);
+	// Called before an edit, once the area was found editable
+	virtual void _pre_edit(const Box3i &box);
 	virtual void _post_edit(const Box3i &box);
 
 private:
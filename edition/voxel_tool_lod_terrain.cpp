@@ -22,7 +22,14 @@ VoxelToolLodTerrain::VoxelToolLodTerrain(VoxelLodTerrain *terrain, VoxelDataMap
 bool VoxelToolLodTerrain::is_area_editable(const Box3i &box) const {
 	ERR_FAIL_COND_V(_terrain == nullptr, false);
 	// TODO Take volume bounds into account
-	return _map->is_area_fully_loaded(box);
+	if (!_terrain->get_implicit_uniform_blocks()) {
+		return _map->is_area_fully_loaded(box);
+	}
+	// Blocks implied by lower LODs are not in the map until they get edited
+	const Box3i block_box = box.downscaled(_map->get_block_size());
+	return block_box.all_cells_match([this](Vector3i block_pos) {
+		return _map->has_block(block_pos) || _terrain->get_implicit_block_source(block_pos, 0) != nullptr;
+	});
 }
 
 template <typename Volume_F>
@@ -94,11 +101,11 @@ Ref<VoxelRaycastResult> VoxelToolLodTerrain::raycast(
 	// TODO Implement reverse raycast? (going from inside ground to air, could be useful for undigging)
 
 	struct RaycastPredicate {
-		const VoxelDataMap &map;
+		const VoxelToolLodTerrain &tool;
 
 		bool operator()(Vector3i pos) {
 			// This is not particularly optimized, but runs fast enough for player raycasts
-			const float sdf = map.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF);
+			const float sdf = tool.get_voxel_f_with_implicit_blocks(pos, VoxelBuffer::CHANNEL_SDF);
 			return sdf < 0;
 		}
 	};
@@ -106,7 +113,7 @@ Ref<VoxelRaycastResult> VoxelToolLodTerrain::raycast(
 	Ref<VoxelRaycastResult> res;
 
 	// We use grid-raycast as a middle-phase to roughly detect where the hit will be
-	RaycastPredicate predicate = { *_map };
+	RaycastPredicate predicate = { *this };
 	Vector3i hit_pos;
 	Vector3i prev_pos;
 	float hit_distance;
@@ -135,14 +142,14 @@ Ref<VoxelRaycastResult> VoxelToolLodTerrain::raycast(
 		if (_raycast_binary_search_iterations > 0) {
 			// This is not particularly optimized, but runs fast enough for player raycasts
 			struct VolumeSampler {
-				const VoxelDataMap &map;
+				const VoxelToolLodTerrain &tool;
 
 				inline float operator()(const Vector3i &pos) const {
-					return map.get_voxel_f(pos, VoxelBuffer::CHANNEL_SDF);
+					return tool.get_voxel_f_with_implicit_blocks(pos, VoxelBuffer::CHANNEL_SDF);
 				}
 			};
 
-			VolumeSampler sampler{ *_map };
+			VolumeSampler sampler{ *this };
 			d = hit_distance_prev + approximate_distance_to_isosurface_binary_search(sampler,
 											pos + dir * hit_distance_prev,
 											dir, hit_distance - hit_distance_prev,
@@ -174,6 +181,7 @@ void VoxelToolLodTerrain::do_sphere(Vector3 center, float radius) {
 		PRINT_VERBOSE("Area not editable");
 		return;
 	}
+	_pre_edit(box);
 
 	_map->write_box_2(box, VoxelBuffer::CHANNEL_INDICES, VoxelBuffer::CHANNEL_WEIGHTS,
 			TextureBlendSphereOp{ center, radius, _texture_params });
@@ -188,27 +196,73 @@ void VoxelToolLodTerrain::copy(Vector3i pos, Ref<VoxelBuffer> dst, uint8_t chann
 		channels_mask = (1 << _channel);
 	}
 	_map->copy(pos, **dst, channels_mask);
+
+	if (!_terrain->get_implicit_uniform_blocks()) {
+		return;
+	}
+	// The map filled blocks it doesn't have with defaults, implicit ones take the value of their source instead
+	const Box3i voxel_box(pos, dst->get_size());
+	const Box3i block_box = voxel_box.downscaled(_map->get_block_size());
+	block_box.for_each_cell([this, pos, dst, channels_mask](Vector3i block_pos) {
+		if (_map->has_block(block_pos)) {
+			return;
+		}
+		const VoxelDataBlock *source = _terrain->get_implicit_block_source(block_pos, 0);
+		if (source == nullptr) {
+			return;
+		}
+		const Vector3i block_origin = _map->block_to_voxel(block_pos);
+		const Vector3i block_size(_map->get_block_size());
+		for (unsigned int channel = 0; channel < VoxelBuffer::MAX_CHANNELS; ++channel) {
+			if (((1 << channel) & channels_mask) == 0) {
+				continue;
+			}
+			dst->set_channel_depth(channel, source->voxels->get_channel_depth(channel));
+			// Uniform, any position gives the same value
+			dst->fill_area(source->voxels->get_voxel(0, 0, 0, channel),
+					block_origin - pos, block_origin - pos + block_size, channel);
+		}
+	});
 }
 
 float VoxelToolLodTerrain::get_voxel_f_interpolated(Vector3 position) const {
 	ERR_FAIL_COND_V(_terrain == nullptr, 0);
-	const VoxelDataMap *map = _map;
 	const int channel = get_channel();
 	// TODO Optimization: is it worth a making a fast-path for this?
-	return get_sdf_interpolated([map, channel](Vector3i ipos) {
-		return map->get_voxel_f(ipos, channel);
+	return get_sdf_interpolated([this, channel](Vector3i ipos) {
+		return get_voxel_f_with_implicit_blocks(ipos, channel);
 	},
 			position);
 }
 
+float VoxelToolLodTerrain::get_voxel_f_with_implicit_blocks(Vector3i pos, unsigned int channel) const {
+	const Vector3i block_pos = _map->voxel_to_block(pos);
+	if (!_map->has_block(block_pos)) {
+		const VoxelDataBlock *source = _terrain->get_implicit_block_source(block_pos, 0);
+		if (source != nullptr) {
+			// Uniform, any position gives the same value
+			return source->voxels->get_voxel_f(0, 0, 0, channel);
+		}
+	}
+	return _map->get_voxel_f(pos, channel);
+}
+
 uint64_t VoxelToolLodTerrain::_get_voxel(Vector3i pos) const {
 	ERR_FAIL_COND_V(_terrain == nullptr, 0);
+	const Vector3i block_pos = _map->voxel_to_block(pos);
+	if (!_map->has_block(block_pos)) {
+		const VoxelDataBlock *source = _terrain->get_implicit_block_source(block_pos, 0);
+		if (source != nullptr) {
+			// Uniform, any position gives the same value
+			return source->voxels->get_voxel(0, 0, 0, _channel);
+		}
+	}
 	return _map->get_voxel(pos, _channel);
 }
 
 float VoxelToolLodTerrain::_get_voxel_f(Vector3i pos) const {
 	ERR_FAIL_COND_V(_terrain == nullptr, 0);
-	return _map->get_voxel_f(pos, _channel);
+	return get_voxel_f_with_implicit_blocks(pos, _channel);
 }
 
 void VoxelToolLodTerrain::_set_voxel(Vector3i pos, uint64_t v) {
@@ -221,6 +275,12 @@ void VoxelToolLodTerrain::_set_voxel_f(Vector3i pos, float v) {
 	_map->set_voxel_f(v, pos, _channel);
 }
 
+void VoxelToolLodTerrain::_pre_edit(const Box3i &box) {
+	ERR_FAIL_COND(_terrain == nullptr);
+	// Neighbors are included because they get remeshed after the edit
+	_terrain->materialize_implicit_blocks(box.padded(1));
+}
+
 void VoxelToolLodTerrain::_post_edit(const Box3i &box) {
 	ERR_FAIL_COND(_terrain == nullptr);
 	_terrain->post_edit_area(box);
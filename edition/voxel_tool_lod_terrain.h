@@ -35,11 +35,15 @@ protected:
 	float _get_voxel_f(Vector3i pos) const override;
 	void _set_voxel(Vector3i pos, uint64_t v) override;
 	void _set_voxel_f(Vector3i pos, float v) override;
+	void _pre_edit(const Box3i &box) override;
 	void _post_edit(const Box3i &box) override;
 
 private:
 	static void _bind_methods();
 
+	// Blocks implied by a uniform block of a lower LOD are not in the map until they get edited
+	float get_voxel_f_with_implicit_blocks(Vector3i pos, unsigned int channel) const;
+
 	VoxelLodTerrain *_terrain = nullptr;
 	VoxelDataMap *_map = nullptr;
 	int _raycast_binary_search_iterations = 0;
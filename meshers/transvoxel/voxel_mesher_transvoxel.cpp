@@ -140,12 +140,24 @@ void VoxelMesherTransvoxel::build(VoxelMesher::Output &output, const VoxelMesher
 	// Once capacity is big enough, no more memory should be allocated
 	s_mesh_arrays.clear();
 
-	const VoxelBuffer &voxels = input.voxels;
-	if (voxels.is_uniform(sdf_channel)) {
+	if (input.voxels.is_uniform(sdf_channel)) {
 		// There won't be anything to polygonize since the SDF has no variations, so it can't cross the isolevel
 		return;
 	}
 
+	// Polygonization reads channels as dense arrays
+	Ref<VoxelBuffer> dense_voxels;
+	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		const VoxelBuffer::Compression compression = input.voxels.get_channel_compression(channel_index);
+		if (compression == VoxelBuffer::COMPRESSION_SPARSE || compression == VoxelBuffer::COMPRESSION_SDF_8_BITS) {
+			if (dense_voxels.is_null()) {
+				dense_voxels = input.voxels.duplicate(false);
+			}
+			dense_voxels->decompress_channel(channel_index);
+		}
+	}
+	const VoxelBuffer &voxels = dense_voxels.is_valid() ? **dense_voxels : input.voxels;
+
 	// const uint64_t time_before = OS::get_singleton()->get_ticks_usec();
 
 	Transvoxel::DefaultTextureIndicesData default_texture_indices_data = Transvoxel::build_regular_mesh(
@@ -24,6 +24,7 @@
 #include "meshers/transvoxel/voxel_mesher_transvoxel.h"
 #include "storage/voxel_buffer.h"
 #include "storage/voxel_memory_pool.h"
+#include "streams/log/voxel_stream_log.h"
 #include "streams/region/voxel_stream_region_files.h"
 #include "streams/sqlite/voxel_stream_sqlite.h"
 #include "streams/vox_loader.h"
@@ -90,6 +91,7 @@ void register_voxel_types() {
 	ClassDB::register_class<VoxelStreamRegionFiles>();
 	ClassDB::register_class<VoxelStreamScript>();
 	ClassDB::register_class<VoxelStreamSQLite>();
+	ClassDB::register_class<VoxelStreamLog>();
 
 	// Generators
 	ClassDB::register_virtual_class<VoxelGenerator>();
@@ -149,6 +151,9 @@ void register_voxel_types() {
 
 #ifdef VOXEL_RUN_TESTS
 	run_voxel_tests();
+#ifdef VOXEL_RUN_BENCHMARKS
+	run_voxel_benchmarks();
+#endif
 #endif
 }
 
@@ -5,12 +5,21 @@
 #include "../util/macros.h"
 #include "../util/profiling.h"
 #include <core/os/memory.h>
+#include <core/os/os.h>
 #include <scene/main/viewport.h>
+#include <algorithm>
+#include <limits>
 #include <thread>
 
 namespace {
 VoxelServer *g_voxel_server = nullptr;
-}
+
+// Above priorities of all load requests, prefetches included
+const int SAVE_TASK_PRIORITY = (VoxelConstants::MAX_LOD + 1) * 10000 * 4;
+// Beyond these, saving goes before loads, so saves can't be held back forever by a stream of loads
+const uint32_t SAVE_TASK_MAX_DELAY_MSEC = 2000;
+const unsigned int SAVE_QUEUE_MAX_PENDING_BLOCKS = 512;
+} // namespace
 
 template <typename Dst_T>
 inline Dst_T *must_be_cast(IVoxelTask *src) {
@@ -113,6 +122,17 @@ void VoxelServer::wait_and_clear_all_tasks(bool warn) {
 	});
 }
 
+// Tells if any viewer is moving towards the given position
+static bool is_any_viewer_heading_to(const std::vector<Vector3> &viewer_positions,
+		const std::vector<Vector3> &viewer_velocities, Vector3 position) {
+	for (size_t i = 0; i < viewer_positions.size() && i < viewer_velocities.size(); ++i) {
+		if (viewer_velocities[i].dot(position - viewer_positions[i]) > 0.f) {
+			return true;
+		}
+	}
+	return false;
+}
+
 int VoxelServer::get_priority(const PriorityDependency &dep, uint8_t lod_index, float *out_closest_distance_sq) {
 	const std::vector<Vector3> &viewer_positions = dep.shared->viewers;
 	const Vector3 block_position = dep.world_position;
@@ -131,7 +151,14 @@ int VoxelServer::get_priority(const PriorityDependency &dep, uint8_t lod_index,
 	}
 
 	if (out_closest_distance_sq != nullptr) {
-		*out_closest_distance_sq = closest_distance_sq;
+		if (dep.prefetch &&
+				!is_any_viewer_heading_to(viewer_positions, dep.shared->viewer_velocities, block_position)) {
+			// The viewer turned around or stopped, the block is no longer worth loading in advance.
+			// Reported as infinitely far away so the request gets cancelled.
+			*out_closest_distance_sq = std::numeric_limits<float>::max();
+		} else {
+			*out_closest_distance_sq = closest_distance_sq;
+		}
 	}
 
 	// TODO Any way to optimize out the sqrt?
@@ -146,6 +173,11 @@ int VoxelServer::get_priority(const PriorityDependency &dep, uint8_t lod_index,
 	// Then comes distance, which is modified by how much in view the block is
 	priority += (VoxelConstants::MAX_LOD - lod_index) * 10000;
 
+	if (dep.prefetch) {
+		// After all other requests
+		priority += (VoxelConstants::MAX_LOD + 1) * 10000;
+	}
+
 	return priority;
 }
 
@@ -230,6 +262,7 @@ void VoxelServer::init_priority_dependency(
 	const float block_radius = (block_size << lod) / 2;
 	dep.shared = _world.shared_priority_dependency;
 	dep.world_position = volume.transform.xform(voxel_pos.to_vec3());
+	dep.prefetch = false;
 	const float transformed_block_radius =
 			volume.transform.basis.xform(Vector3(block_radius, block_radius, block_radius)).length();
 
@@ -262,8 +295,16 @@ void VoxelServer::request_block_mesh(uint32_t volume_id, const BlockMeshInput &i
 
 	BlockMeshRequest *r = memnew(BlockMeshRequest);
 	r->volume_id = volume_id;
-	r->blocks = input.data_blocks;
 	r->blocks_count = input.data_blocks_count;
+	// Meshing works on snapshots of the blocks, so the main thread can keep editing them meanwhile.
+	// Channels are copy-on-write, so this doesn't actually copy voxel data.
+	for (unsigned int i = 0; i < input.data_blocks_count; ++i) {
+		const Ref<VoxelBuffer> &src = input.data_blocks[i];
+		if (src.is_valid()) {
+			RWLockRead lock(src->get_lock());
+			r->blocks[i] = src->duplicate(false);
+		}
+	}
 	r->position = input.render_block_position;
 	r->lod = input.lod;
 	r->meshing_dependency = volume.meshing_dependency;
@@ -275,7 +316,8 @@ void VoxelServer::request_block_mesh(uint32_t volume_id, const BlockMeshInput &i
 	_meshing_thread_pool.enqueue(r);
 }
 
-void VoxelServer::request_block_load(uint32_t volume_id, Vector3i block_pos, int lod, bool request_instances) {
+void VoxelServer::request_block_load(
+		uint32_t volume_id, Vector3i block_pos, int lod, bool request_instances, bool prefetch) {
 	const Volume &volume = _world.volumes.get(volume_id);
 	ERR_FAIL_COND(volume.stream_dependency == nullptr);
 
@@ -290,6 +332,7 @@ void VoxelServer::request_block_load(uint32_t volume_id, Vector3i block_pos, int
 		r->request_instances = request_instances;
 
 		init_priority_dependency(r->priority_dependency, block_pos, lod, volume, volume.data_block_size);
+		r->priority_dependency.prefetch = prefetch;
 
 		_streaming_thread_pool.enqueue(r);
 
@@ -305,6 +348,7 @@ void VoxelServer::request_block_load(uint32_t volume_id, Vector3i block_pos, int
 		r.stream_dependency = volume.stream_dependency;
 
 		init_priority_dependency(r.priority_dependency, block_pos, lod, volume, volume.data_block_size);
+		r.priority_dependency.prefetch = prefetch;
 
 		BlockGenerateRequest *rp = memnew(BlockGenerateRequest(r));
 		_generation_thread_pool.enqueue(rp);
@@ -316,20 +360,18 @@ void VoxelServer::request_voxel_block_save(uint32_t volume_id, Ref<VoxelBuffer>
 	ERR_FAIL_COND(volume.stream.is_null());
 	CRASH_COND(volume.stream_dependency == nullptr);
 
-	BlockDataRequest *r = memnew(BlockDataRequest);
-	r->voxels = voxels;
-	r->volume_id = volume_id;
-	r->position = block_pos;
-	r->lod = lod;
-	r->type = BlockDataRequest::TYPE_SAVE;
-	r->block_size = volume.data_block_size;
-	r->stream_dependency = volume.stream_dependency;
-	r->request_instances = false;
-	r->request_voxels = true;
-
-	// No priority data, saving doesnt need sorting
+	// Channels are copy-on-write, so this snapshot is cheap, and the volume can keep editing the block
+	Ref<VoxelBuffer> voxels_copy;
+	if (voxels.is_valid()) {
+		RWLockRead lock(voxels->get_lock());
+		voxels_copy = voxels->duplicate(true);
+	}
 
-	_streaming_thread_pool.enqueue(r);
+	MutexLock lock(_save_queue.mutex);
+	PendingSave &save = get_or_create_pending_save(volume.stream_dependency, block_pos, lod, volume.data_block_size);
+	save.voxels = voxels_copy;
+	save.has_voxels = true;
+	schedule_save_task();
 }
 
 void VoxelServer::request_instance_block_save(uint32_t volume_id, std::unique_ptr<VoxelInstanceBlockData> instances,
@@ -338,20 +380,11 @@ void VoxelServer::request_instance_block_save(uint32_t volume_id, std::unique_pt
 	ERR_FAIL_COND(volume.stream.is_null());
 	CRASH_COND(volume.stream_dependency == nullptr);
 
-	BlockDataRequest *r = memnew(BlockDataRequest);
-	r->instances = std::move(instances);
-	r->volume_id = volume_id;
-	r->position = block_pos;
-	r->lod = lod;
-	r->type = BlockDataRequest::TYPE_SAVE;
-	r->block_size = volume.data_block_size;
-	r->stream_dependency = volume.stream_dependency;
-	r->request_instances = true;
-	r->request_voxels = false;
-
-	// No priority data, saving doesnt need sorting
-
-	_streaming_thread_pool.enqueue(r);
+	MutexLock lock(_save_queue.mutex);
+	PendingSave &save = get_or_create_pending_save(volume.stream_dependency, block_pos, lod, volume.data_block_size);
+	save.instances = std::move(instances);
+	save.has_instances = true;
+	schedule_save_task();
 }
 
 void VoxelServer::request_block_generate_from_data_request(BlockDataRequest *src) {
@@ -378,21 +411,177 @@ void VoxelServer::request_block_save_from_generate_request(BlockGenerateRequest
 
 	ERR_FAIL_COND(src->voxels.is_null());
 
-	BlockDataRequest *r = memnew(BlockDataRequest());
-	r->voxels = src->voxels->duplicate(true);
-	r->volume_id = src->volume_id;
-	r->position = src->position;
-	r->lod = src->lod;
-	r->type = BlockDataRequest::TYPE_SAVE;
-	r->block_size = src->block_size;
-	r->stream_dependency = src->stream_dependency;
-
 	// No instances, generators are not designed to produce them at this stage yet.
-	// No priority data, saving doesnt need sorting
+	MutexLock lock(_save_queue.mutex);
+	PendingSave &save = get_or_create_pending_save(src->stream_dependency, src->position, src->lod, src->block_size);
+	save.voxels = src->voxels->duplicate(true);
+	save.has_voxels = true;
+	schedule_save_task();
+}
+
+// Must be called with the save queue mutex locked
+VoxelServer::PendingSave &VoxelServer::get_or_create_pending_save(
+		const std::shared_ptr<StreamingDependency> &stream_dependency, Vector3i block_pos, uint8_t lod,
+		uint8_t block_size) {
+	const SaveKey key{ stream_dependency.get(), block_pos, lod };
+	auto it = _save_queue.pending.find(key);
+	if (it == _save_queue.pending.end()) {
+		PendingSave save;
+		save.stream_dependency = stream_dependency;
+		save.position = block_pos;
+		save.lod = lod;
+		save.block_size = block_size;
+		it = _save_queue.pending.insert(std::make_pair(key, std::move(save))).first;
+		_save_queue.pending_count = _save_queue.pending.size();
+	}
+	// Else, the block was saved already and is still waiting to be written, so the new data replaces the old one
+	return it->second;
+}
 
+// Must be called with the save queue mutex locked
+void VoxelServer::schedule_save_task() {
+	// Only one task writes the queue at a time, so saves of the same block are written in order
+	if (_save_queue.task_scheduled) {
+		return;
+	}
+	_save_queue.task_scheduled = true;
+	BlockDataRequest *r = memnew(BlockDataRequest);
+	r->type = BlockDataRequest::TYPE_SAVE;
+	r->scheduled_time_msec = OS::get_singleton()->get_ticks_msec();
 	_streaming_thread_pool.enqueue(r);
 }
 
+void VoxelServer::run_save_queue() {
+	VOXEL_PROFILE_SCOPE();
+
+	{
+		MutexLock lock(_save_queue.mutex);
+		CRASH_COND(_save_queue.saving.size() != 0);
+		_save_queue.saving.swap(_save_queue.pending);
+		_save_queue.pending_count = 0;
+	}
+
+	// Saves being written are only modified with the lock, so they can be read without it.
+	// Group them by stream, so each stream receives them in one batch.
+	std::vector<const PendingSave *> saves;
+	saves.reserve(_save_queue.saving.size());
+	for (auto it = _save_queue.saving.begin(); it != _save_queue.saving.end(); ++it) {
+		saves.push_back(&it->second);
+	}
+	std::sort(saves.begin(), saves.end(), [](const PendingSave *a, const PendingSave *b) {
+		return std::less<const StreamingDependency *>()(a->stream_dependency.get(), b->stream_dependency.get());
+	});
+
+	Vector<VoxelBlockRequest> voxel_requests;
+	std::vector<VoxelStreamInstanceDataRequest> instance_requests;
+
+	size_t begin = 0;
+	while (begin < saves.size()) {
+		const StreamingDependency *stream_dependency = saves[begin]->stream_dependency.get();
+		size_t end = begin + 1;
+		while (end < saves.size() && saves[end]->stream_dependency.get() == stream_dependency) {
+			++end;
+		}
+
+		Ref<VoxelStream> stream = stream_dependency->stream;
+		CRASH_COND(stream.is_null());
+		const bool supports_instances = stream->supports_instance_blocks();
+
+		voxel_requests.clear();
+		instance_requests.clear();
+
+		for (size_t i = begin; i < end; ++i) {
+			const PendingSave &save = *saves[i];
+
+			if (save.has_voxels) {
+				VoxelBlockRequest r;
+				r.voxel_buffer = save.voxels;
+				r.origin_in_voxels = (save.position << save.lod) * save.block_size;
+				r.lod = save.lod;
+				voxel_requests.push_back(r);
+			}
+
+			if (save.has_instances && supports_instances) {
+				// If the provided data is null, it means this instance block was never modified.
+				// Since we are in a save request, the saved data will revert to unmodified.
+				// On the other hand, if we want to represent the fact that "everything was deleted here",
+				// this should not be null.
+				VoxelStreamInstanceDataRequest r;
+				r.lod = save.lod;
+				r.position = save.position;
+				// Copied, because loads can still read the queued data while it's being written
+				if (save.instances != nullptr) {
+					r.data = std::make_unique<VoxelInstanceBlockData>();
+					save.instances->copy_to(*r.data);
+				}
+				instance_requests.push_back(std::move(r));
+			}
+		}
+
+		PRINT_VERBOSE(String("Saving {0} voxel blocks and {1} instance blocks")
+							  .format(varray(voxel_requests.size(), (int)instance_requests.size())));
+
+		if (voxel_requests.size() > 0) {
+			stream->immerge_blocks(voxel_requests);
+		}
+		if (instance_requests.size() > 0) {
+			stream->save_instance_blocks(to_span(instance_requests));
+		}
+
+		begin = end;
+	}
+
+	MutexLock lock(_save_queue.mutex);
+	_save_queue.saving.clear();
+	// Blocks saved meanwhile get written by a new task, after loads that came in since then
+	_save_queue.task_scheduled = false;
+	if (_save_queue.pending.size() > 0) {
+		schedule_save_task();
+	}
+}
+
+void VoxelServer::load_from_save_queue(BlockDataRequest &r, bool &out_voxels_found, bool &out_instances_found) {
+	out_voxels_found = false;
+	out_instances_found = false;
+
+	MutexLock lock(_save_queue.mutex);
+
+	if (_save_queue.pending.size() == 0 && _save_queue.saving.size() == 0) {
+		return;
+	}
+
+	const SaveKey key{ r.stream_dependency.get(), r.position, r.lod };
+	// Pending saves are more recent than those being written
+	const std::unordered_map<SaveKey, PendingSave, SaveKeyHasher> *maps[2] = {
+		&_save_queue.pending, &_save_queue.saving
+	};
+
+	for (unsigned int i = 0; i < 2; ++i) {
+		auto it = maps[i]->find(key);
+		if (it == maps[i]->end()) {
+			continue;
+		}
+		const PendingSave &save = it->second;
+
+		if (!out_voxels_found && save.has_voxels) {
+			// Null voxels mean the block was erased. Like instances, it counts as found without data,
+			// so the stream isn't asked for a version it might still have from before.
+			if (save.voxels.is_valid()) {
+				r.voxels = save.voxels->duplicate(true);
+			}
+			out_voxels_found = true;
+		}
+
+		if (!out_instances_found && save.has_instances && r.request_instances) {
+			if (save.instances != nullptr) {
+				r.instances = std::make_unique<VoxelInstanceBlockData>();
+				save.instances->copy_to(*r.instances);
+			}
+			out_instances_found = true;
+		}
+	}
+}
+
 void VoxelServer::remove_volume(uint32_t volume_id) {
 	{
 		Volume &volume = _world.volumes.get(volume_id);
@@ -427,6 +616,16 @@ void VoxelServer::set_viewer_position(uint32_t viewer_id, Vector3 position) {
 	viewer.world_position = position;
 }
 
+void VoxelServer::set_viewer_velocity(uint32_t viewer_id, Vector3 velocity) {
+	Viewer &viewer = _world.viewers.get(viewer_id);
+	viewer.velocity = velocity;
+}
+
+void VoxelServer::set_viewer_prefetch_time(uint32_t viewer_id, float seconds) {
+	Viewer &viewer = _world.viewers.get(viewer_id);
+	viewer.prefetch_time = seconds;
+}
+
 void VoxelServer::set_viewer_distance(uint32_t viewer_id, unsigned int distance) {
 	Viewer &viewer = _world.viewers.get(viewer_id);
 	viewer.view_distance = distance;
@@ -470,6 +669,13 @@ void VoxelServer::process() {
 	// Receive data updates
 	_streaming_thread_pool.dequeue_completed_tasks([this](IVoxelTask *task) {
 		BlockDataRequest *r = must_be_cast<BlockDataRequest>(task);
+
+		if (r->type == BlockDataRequest::TYPE_SAVE) {
+			// Saves are not tied to a specific volume and have no output
+			memdelete(r);
+			return;
+		}
+
 		Volume *volume = _world.volumes.try_get(r->volume_id);
 
 		if (volume != nullptr) {
@@ -484,19 +690,10 @@ void VoxelServer::process() {
 				o.position = r->position;
 				o.lod = r->lod;
 				o.dropped = !r->has_run;
+				o.prefetch = r->priority_dependency.prefetch;
 
-				switch (r->type) {
-					case BlockDataRequest::TYPE_SAVE:
-						o.type = BlockDataOutput::TYPE_SAVE;
-						break;
-
-					case BlockDataRequest::TYPE_LOAD:
-						o.type = BlockDataOutput::TYPE_LOAD;
-						break;
-
-					default:
-						CRASH_NOW_MSG("Unexpected data request response type");
-				}
+				CRASH_COND_MSG(r->type != BlockDataRequest::TYPE_LOAD, "Unexpected data request response type");
+				o.type = BlockDataOutput::TYPE_LOAD;
 
 				volume->reception_buffers->data_output.push_back(std::move(o));
 			}
@@ -524,6 +721,7 @@ void VoxelServer::process() {
 				o.position = r->position;
 				o.lod = r->lod;
 				o.dropped = !r->has_run;
+				o.prefetch = r->priority_dependency.prefetch;
 				o.type = BlockDataOutput::TYPE_LOAD;
 				volume->reception_buffers->data_output.push_back(std::move(o));
 			}
@@ -577,11 +775,13 @@ void VoxelServer::process() {
 			// TODO We can avoid the invalidation by using an atomic size or memory barrier?
 			_world.shared_priority_dependency = gd_make_shared<PriorityDependencyShared>();
 			_world.shared_priority_dependency->viewers.resize(viewer_count);
+			_world.shared_priority_dependency->viewer_velocities.resize(viewer_count);
 		}
 		size_t i = 0;
 		unsigned int max_distance = 0;
 		_world.viewers.for_each([&i, &max_distance, this](Viewer &viewer) {
 			_world.shared_priority_dependency->viewers[i] = viewer.world_position;
+			_world.shared_priority_dependency->viewer_velocities[i] = viewer.velocity;
 			if (viewer.view_distance > max_distance) {
 				max_distance = viewer.view_distance;
 			}
@@ -618,6 +818,10 @@ VoxelServer::Stats VoxelServer::get_stats() const {
 	s.streaming = debug_get_pool_stats(_streaming_thread_pool);
 	s.generation = debug_get_pool_stats(_generation_thread_pool);
 	s.meshing = debug_get_pool_stats(_meshing_thread_pool);
+	{
+		MutexLock lock(_save_queue.mutex);
+		s.pending_saves = _save_queue.pending.size() + _save_queue.saving.size();
+	}
 	return s;
 }
 
@@ -634,6 +838,12 @@ void VoxelServer::_bind_methods() {
 void VoxelServer::BlockDataRequest::run(VoxelTaskContext ctx) {
 	VOXEL_PROFILE_SCOPE();
 
+	if (type == TYPE_SAVE) {
+		VoxelServer::get_singleton()->run_save_queue();
+		has_run = true;
+		return;
+	}
+
 	CRASH_COND(stream_dependency == nullptr);
 	Ref<VoxelStream> stream = stream_dependency->stream;
 	CRASH_COND(stream.is_null());
@@ -642,32 +852,45 @@ void VoxelServer::BlockDataRequest::run(VoxelTaskContext ctx) {
 
 	switch (type) {
 		case TYPE_LOAD: {
-			voxels.instance();
-			voxels->create(block_size, block_size, block_size);
-
-			// TODO We should consider batching this again, but it needs to be done carefully.
-			// Each task is one block, and priority depends on distance to closest viewer.
-			// If we batch blocks, we have to do it by distance too.
-
-			const VoxelStream::Result voxel_result = stream->emerge_block(voxels, origin_in_voxels, lod);
-
-			if (voxel_result == VoxelStream::RESULT_ERROR) {
-				ERR_PRINT("Error loading voxel block");
-
-			} else if (voxel_result == VoxelStream::RESULT_BLOCK_NOT_FOUND) {
-				Ref<VoxelGenerator> generator = stream_dependency->generator;
-				if (generator.is_valid()) {
-					VoxelServer::get_singleton()->request_block_generate_from_data_request(this);
-					type = TYPE_FALLBACK_ON_GENERATOR;
-				} else {
-					// If there is no generator... what do we do? What defines the format of that empty block?
-					// If the user leaves the defaults it's fine, but otherwise blocks of inconsistent format can
-					// end up in the volume and that can cause errors.
-					// TODO Define format on volume?
+			// Saves are written after loads, so the latest data of the block might still be in the save queue
+			bool voxels_found = false;
+			bool instances_found = false;
+			VoxelServer::get_singleton()->load_from_save_queue(*this, voxels_found, instances_found);
+
+			// In mostly generated worlds, the stream often knows the block was never saved without having to look
+			const bool may_have_block = stream->may_have_block(origin_in_voxels, lod);
+
+			if (voxels.is_null()) {
+				voxels.instance();
+				voxels->create(block_size, block_size, block_size);
+
+				// TODO We should consider batching this again, but it needs to be done carefully.
+				// Each task is one block, and priority depends on distance to closest viewer.
+				// If we batch blocks, we have to do it by distance too.
+
+				// A block erased in the save queue falls back on the generator like a block that was never saved
+				const VoxelStream::Result voxel_result = may_have_block && !voxels_found ?
+						stream->emerge_block(voxels, origin_in_voxels, lod) :
+						VoxelStream::RESULT_BLOCK_NOT_FOUND;
+
+				if (voxel_result == VoxelStream::RESULT_ERROR) {
+					ERR_PRINT("Error loading voxel block");
+
+				} else if (voxel_result == VoxelStream::RESULT_BLOCK_NOT_FOUND) {
+					Ref<VoxelGenerator> generator = stream_dependency->generator;
+					if (generator.is_valid()) {
+						VoxelServer::get_singleton()->request_block_generate_from_data_request(this);
+						type = TYPE_FALLBACK_ON_GENERATOR;
+					} else {
+						// If there is no generator... what do we do? What defines the format of that empty block?
+						// If the user leaves the defaults it's fine, but otherwise blocks of inconsistent format can
+						// end up in the volume and that can cause errors.
+						// TODO Define format on volume?
+					}
 				}
 			}
 
-			if (request_instances && stream->supports_instance_blocks()) {
+			if (request_instances && !instances_found && may_have_block && stream->supports_instance_blocks()) {
 				ERR_FAIL_COND(instances != nullptr);
 
 				VoxelStreamInstanceDataRequest instance_data_request;
@@ -681,7 +904,7 @@ void VoxelServer::BlockDataRequest::run(VoxelTaskContext ctx) {
 				if (instances_result == VoxelStream::RESULT_ERROR) {
 					ERR_PRINT("Error loading instance block");
 
-				} else if (voxel_result == VoxelStream::RESULT_BLOCK_FOUND) {
+				} else if (instances_result == VoxelStream::RESULT_BLOCK_FOUND) {
 					instances = std::move(instance_data_request.data);
 				}
 				// If not found, instances will return null,
@@ -689,35 +912,6 @@ void VoxelServer::BlockDataRequest::run(VoxelTaskContext ctx) {
 			}
 		} break;
 
-		case TYPE_SAVE: {
-			if (request_voxels) {
-				Ref<VoxelBuffer> voxels_copy;
-				// TODO Is that copy necessary? It's possible it was already done while issuing the request
-				if (voxels.is_valid()) {
-					RWLockRead lock(voxels->get_lock());
-					voxels_copy = voxels->duplicate(true);
-				}
-				voxels.unref();
-				stream->immerge_block(voxels_copy, origin_in_voxels, lod);
-			}
-
-			if (request_instances && stream->supports_instance_blocks()) {
-				// If the provided data is null, it means this instance block was never modified.
-				// Since we are in a save request, the saved data will revert to unmodified.
-				// On the other hand, if we want to represent the fact that "everything was deleted here",
-				// this should not be null.
-
-				PRINT_VERBOSE(String("Saving instance block {0} lod {1} with data {2}")
-									  .format(varray(position.to_vec3(), lod, ptr2s(instances.get()))));
-
-				VoxelStreamInstanceDataRequest instance_data_request;
-				instance_data_request.lod = lod;
-				instance_data_request.position = position;
-				instance_data_request.data = std::move(instances);
-				stream->save_instance_blocks(Span<VoxelStreamInstanceDataRequest>(&instance_data_request, 1));
-			}
-		} break;
-
 		default:
 			CRASH_NOW_MSG("Invalid type");
 	}
@@ -727,7 +921,13 @@ void VoxelServer::BlockDataRequest::run(VoxelTaskContext ctx) {
 
 int VoxelServer::BlockDataRequest::get_priority() {
 	if (type == TYPE_SAVE) {
-		return 0;
+		const uint32_t now = OS::get_singleton()->get_ticks_msec();
+		if (now - scheduled_time_msec >= SAVE_TASK_MAX_DELAY_MSEC ||
+				VoxelServer::get_singleton()->_save_queue.pending_count >= SAVE_QUEUE_MAX_PENDING_BLOCKS) {
+			return 0;
+		}
+		// Loads go first
+		return SAVE_TASK_PRIORITY;
 	}
 	float closest_viewer_distance_sq;
 	const int p = VoxelServer::get_priority(priority_dependency, lod, &closest_viewer_distance_sq);
@@ -849,11 +1049,9 @@ static void copy_block_and_neighbors(Span<Ref<VoxelBuffer>> blocks, VoxelBuffer
 				const Vector3i src_min = min_pos - offset;
 				const Vector3i src_max = max_pos - offset;
 
-				{
-					RWLockRead read(src->get_lock());
-					for (unsigned int ci = 0; ci < channels_count; ++ci) {
-						dst.copy_from(**src, src_min, src_max, Vector3(), channels[ci]);
-					}
+				// No lock needed, blocks are snapshots owned by the request
+				for (unsigned int ci = 0; ci < channels_count; ++ci) {
+					dst.copy_from(**src, src_min, src_max, Vector3(), channels[ci]);
 				}
 			}
 		}
@@ -9,7 +9,9 @@
 #include "voxel_thread_pool.h"
 #include <scene/main/node.h>
 
+#include <atomic>
 #include <memory>
+#include <unordered_map>
 
 // TODO Don't inherit Object. Instead have a Godot wrapper, there is very little use for Object stuff
 
@@ -42,6 +44,8 @@ public:
 		Vector3i position;
 		uint8_t lod;
 		bool dropped;
+		// The block was requested in advance for a moving viewer
+		bool prefetch = false;
 	};
 
 	struct BlockMeshInput {
@@ -65,7 +69,11 @@ public:
 		// 	FLAGS_COUNT = 3
 		// };
 		Vector3 world_position;
+		// World space units per second
+		Vector3 velocity;
 		unsigned int view_distance = 128;
+		// How many seconds of motion ahead of the viewer should be loaded in advance
+		float prefetch_time = 0.f;
 		bool require_collisions = false;
 		bool require_visuals = true;
 	};
@@ -93,7 +101,8 @@ public:
 	void set_volume_octree_lod_distance(uint32_t volume_id, float lod_distance);
 	void invalidate_volume_mesh_requests(uint32_t volume_id);
 	void request_block_mesh(uint32_t volume_id, const BlockMeshInput &input);
-	void request_block_load(uint32_t volume_id, Vector3i block_pos, int lod, bool request_instances);
+	// Prefetch loads run after other loads, and get cancelled if no viewer is heading towards them anymore
+	void request_block_load(uint32_t volume_id, Vector3i block_pos, int lod, bool request_instances, bool prefetch);
 	void request_voxel_block_save(uint32_t volume_id, Ref<VoxelBuffer> voxels, Vector3i block_pos, int lod);
 	void request_instance_block_save(uint32_t volume_id, std::unique_ptr<VoxelInstanceBlockData> instances,
 			Vector3i block_pos, int lod);
@@ -103,6 +112,8 @@ public:
 	uint32_t add_viewer();
 	void remove_viewer(uint32_t viewer_id);
 	void set_viewer_position(uint32_t viewer_id, Vector3 position);
+	void set_viewer_velocity(uint32_t viewer_id, Vector3 velocity);
+	void set_viewer_prefetch_time(uint32_t viewer_id, float seconds);
 	void set_viewer_distance(uint32_t viewer_id, unsigned int distance);
 	unsigned int get_viewer_distance(uint32_t viewer_id) const;
 	void set_viewer_requires_visuals(uint32_t viewer_id, bool enabled);
@@ -153,10 +164,12 @@ public:
 		ThreadPoolStats streaming;
 		ThreadPoolStats generation;
 		ThreadPoolStats meshing;
+		unsigned int pending_saves;
 
 		Dictionary to_dict() {
 			Dictionary d;
 			d["streaming"] = streaming.to_dict();
+			d["pending_saves"] = pending_saves;
 			d["generation"] = generation.to_dict();
 			d["meshing"] = meshing.to_dict();
 			return d;
@@ -169,9 +182,18 @@ private:
 	class BlockDataRequest;
 	class BlockGenerateRequest;
 
+	struct StreamingDependency;
+	struct PendingSave;
+
 	void request_block_generate_from_data_request(BlockDataRequest *src);
 	void request_block_save_from_generate_request(BlockGenerateRequest *src);
 
+	PendingSave &get_or_create_pending_save(const std::shared_ptr<StreamingDependency> &stream_dependency,
+			Vector3i block_pos, uint8_t lod, uint8_t block_size);
+	void schedule_save_task();
+	void run_save_queue();
+	void load_from_save_queue(BlockDataRequest &r, bool &out_voxels_found, bool &out_instances_found);
+
 	Dictionary _b_get_stats();
 
 	static void _bind_methods();
@@ -219,6 +241,7 @@ private:
 		// It's only used to adjust task priority so using a lock isn't worth it. In worst case scenario,
 		// a task will run much sooner or later than expected, but it will run in any case.
 		std::vector<Vector3> viewers;
+		std::vector<Vector3> viewer_velocities;
 		float highest_view_distance = 999999;
 	};
 
@@ -235,16 +258,65 @@ private:
 		Vector3 world_position; // TODO Won't update while in queue. Can it be bad?
 		// If the closest viewer is further away than this distance, the request can be cancelled as not worth it
 		float drop_distance_squared;
+		// Requested ahead of a moving viewer. Goes after other requests, and is dropped once no viewer heads to it.
+		bool prefetch = false;
 	};
 
 	void init_priority_dependency(PriorityDependency &dep, Vector3i block_position, uint8_t lod, const Volume &volume,
 			int block_size);
 	static int get_priority(const PriorityDependency &dep, uint8_t lod_index, float *out_closest_distance_sq);
 
+	// Key of a block in the save queue
+	struct SaveKey {
+		const StreamingDependency *stream_dependency;
+		Vector3i position;
+		uint8_t lod;
+
+		inline bool operator==(const SaveKey &other) const {
+			return stream_dependency == other.stream_dependency && position == other.position && lod == other.lod;
+		}
+	};
+
+	struct SaveKeyHasher {
+		inline size_t operator()(const SaveKey &k) const {
+			return hash_djb2_one_32(k.lod, Vector3iHasher::hash(k.position)) ^
+				   std::hash<const StreamingDependency *>()(k.stream_dependency);
+		}
+	};
+
+	// Latest data saved for a block, which has not been written to the stream yet
+	struct PendingSave {
+		std::shared_ptr<StreamingDependency> stream_dependency;
+		Ref<VoxelBuffer> voxels;
+		std::unique_ptr<VoxelInstanceBlockData> instances;
+		Vector3i position;
+		uint8_t lod;
+		uint8_t block_size;
+		// Same meaning as in `VoxelStreamCache::Block`
+		bool has_voxels = false;
+		bool has_instances = false;
+	};
+
+	// Saves don't need sorting, and they can wait for loads to be done. So instead of going through the streaming
+	// pool one by one, they are queued here, where repeated saves of the same block are merged.
+	// A single task of the streaming pool writes them in batches, with a priority that puts it after loads.
+	// If saves wait too long or pile up, the task goes before loads instead.
+	struct SaveQueue {
+		std::unordered_map<SaveKey, PendingSave, SaveKeyHasher> pending;
+		// Size of `pending`, readable without locking when computing the priority of the task
+		std::atomic<unsigned int> pending_count{ 0 };
+		// Saves being written by the current task. They are not modified until the task is done,
+		// and loads can still get data from them meanwhile.
+		std::unordered_map<SaveKey, PendingSave, SaveKeyHasher> saving;
+		bool task_scheduled = false;
+		Mutex mutex;
+	};
+
 	class BlockDataRequest : public IVoxelTask {
 	public:
 		enum Type {
 			TYPE_LOAD = 0,
+			// Writes all blocks of the save queue
 			TYPE_SAVE,
 			TYPE_FALLBACK_ON_GENERATOR
 		};
@@ -263,10 +335,10 @@ private:
 		bool has_run = false;
 		bool too_far = false;
 		bool request_instances = false;
-		bool request_voxels = false;
+		// For saves, time at which the task was scheduled
+		uint32_t scheduled_time_msec = 0;
 		PriorityDependency priority_dependency;
 		std::shared_ptr<StreamingDependency> stream_dependency;
-		// TODO Find a way to separate save, it doesnt need sorting
 	};
 
 	class BlockGenerateRequest : public IVoxelTask {
@@ -311,6 +383,8 @@ private:
 	VoxelThreadPool _generation_thread_pool;
 	VoxelThreadPool _meshing_thread_pool;
 
+	SaveQueue _save_queue;
+
 	VoxelFileLocker _file_locker;
 };
 
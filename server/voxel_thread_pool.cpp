@@ -4,6 +4,7 @@
 #include <core/os/os.h>
 #include <core/os/semaphore.h>
 #include <core/os/thread.h>
+#include <limits>
 
 // template <typename T>
 // static bool contains(const std::vector<T> vec, T v) {
@@ -145,7 +146,7 @@ void VoxelThreadPool::thread_func(ThreadData &data) {
 			// Pick best tasks
 			for (uint32_t bi = 0; bi < _batch_count && _tasks.size() != 0; ++bi) {
 				size_t best_index = 0; // Take first by default, this is a valid index
-				int best_priority = 999999;
+				int best_priority = std::numeric_limits<int>::max();
 
 				// TODO This takes a lot of time when there are many queued tasks. Use a better container?
 				for (size_t i = 0; i < _tasks.size(); ++i) {
@@ -34,11 +34,17 @@ void copy_3d_region_zxy(
 		// essentially doing y+1
 		const unsigned int src_row_offset = src_size.y * item_size;
 		const unsigned int dst_row_offset = dst_size.y * item_size;
+		// If rows span the whole height of both buffers, they are contiguous and can be copied as whole slices
+		const bool contiguous_rows = area_size.y == src_size.y && area_size.y == dst_size.y;
 		Vector3i pos;
 		for (pos.z = 0; pos.z < area_size.z; ++pos.z) {
 			pos.x = 0;
 			unsigned int src_ri = Vector3i(src_min + pos).get_zxy_index(src_size) * item_size;
 			unsigned int dst_ri = Vector3i(dst_min + pos).get_zxy_index(dst_size) * item_size;
+			if (contiguous_rows) {
+				memcpy(&dst[dst_ri], &src[src_ri], area_size.x * area_size.y * item_size);
+				continue;
+			}
 			for (; pos.x < area_size.x; ++pos.x) {
 				// TODO Cast src and dst to `restrict` so the optimizer can assume adresses don't overlap,
 				//      which might allow to write as a for loop (which may compile as a `memcpy`)?
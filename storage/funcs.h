@@ -3,6 +3,7 @@
 
 #include "../constants/voxel_constants.h"
 #include "../util/math/vector3i.h"
+#include "../util/simd.h"
 #include "../util/span.h"
 #include <stdint.h>
 
@@ -74,20 +75,20 @@ void fill_3d_region_zxy(Span<T> dst, Vector3i dst_size, Vector3i dst_min, Vector
 #endif
 
 	if (area_size == dst_size) {
-		for (unsigned int i = 0; i < dst.size(); ++i) {
-			dst[i] = value;
-		}
+		simd::fill(dst.data(), dst.size(), value);
 
 	} else {
 		const unsigned int dst_row_offset = dst_size.y;
 		Vector3i pos;
 		for (pos.z = 0; pos.z < area_size.z; ++pos.z) {
 			unsigned int dst_ri = Vector3i(dst_min + pos).get_zxy_index(dst_size);
+			if (area_size.y == dst_size.y) {
+				// Rows are contiguous, fill the whole slice at once
+				simd::fill(&dst[dst_ri], area_size.x * area_size.y, value);
+				continue;
+			}
 			for (pos.x = 0; pos.x < area_size.x; ++pos.x) {
-				// Fill row
-				for (pos.y = 0; pos.y < area_size.y; ++pos.y) {
-					dst[dst_ri + pos.y] = value;
-				}
+				simd::fill(&dst[dst_ri], area_size.y, value);
 				dst_ri += dst_row_offset;
 			}
 		}
@@ -6,6 +6,7 @@
 
 #include "../edition/voxel_tool_buffer.h"
 #include "../util/funcs.h"
+#include "../util/math/morton.h"
 #include "../util/profiling.h"
 #include "voxel_buffer.h"
 
@@ -13,26 +14,62 @@
 #include <core/image.h>
 #include <core/io/marshalls.h>
 #include <core/math/math_funcs.h>
+#include <core/safe_refcount.h>
 #include <string.h>
 
 namespace {
 
+// Channel memory is prefixed with a reference count, so it can be shared between buffers and copied on write.
+// The header is padded so voxel data keeps the alignment of the allocation.
+struct ChannelDataHeader {
+	SafeRefCount refcount;
+};
+
+const uint32_t CHANNEL_DATA_HEADER_SIZE = 16;
+static_assert(sizeof(ChannelDataHeader) <= CHANNEL_DATA_HEADER_SIZE, "Channel data header is too big");
+
+inline ChannelDataHeader &get_channel_data_header(uint8_t *data) {
+	return *reinterpret_cast<ChannelDataHeader *>(data - CHANNEL_DATA_HEADER_SIZE);
+}
+
 inline uint8_t *allocate_channel_data(uint32_t size) {
+	const uint32_t allocated_size = size + CHANNEL_DATA_HEADER_SIZE;
 #ifdef VOXEL_BUFFER_USE_MEMORY_POOL
-	return VoxelMemoryPool::get_singleton()->allocate(size);
+	uint8_t *block = VoxelMemoryPool::get_singleton()->allocate(allocated_size);
 #else
-	return (uint8_t *)memalloc(size * sizeof(uint8_t));
+	uint8_t *block = (uint8_t *)memalloc(allocated_size * sizeof(uint8_t));
 #endif
+	uint8_t *data = block + CHANNEL_DATA_HEADER_SIZE;
+	get_channel_data_header(data).refcount.init(1);
+	return data;
 }
 
 inline void free_channel_data(uint8_t *data, uint32_t size) {
+	uint8_t *block = data - CHANNEL_DATA_HEADER_SIZE;
 #ifdef VOXEL_BUFFER_USE_MEMORY_POOL
-	VoxelMemoryPool::get_singleton()->recycle(data, size);
+	VoxelMemoryPool::get_singleton()->recycle(block, size + CHANNEL_DATA_HEADER_SIZE);
 #else
-	memfree(data);
+	memfree(block);
 #endif
 }
 
+// Takes an extra reference on channel memory, which will then be shared.
+inline void ref_channel_data(uint8_t *data) {
+	const bool referenced = get_channel_data_header(data).refcount.ref();
+	CRASH_COND(!referenced);
+}
+
+// Releases a reference on channel memory, and frees it if it was the last one.
+inline void unref_channel_data(uint8_t *data, uint32_t size) {
+	if (get_channel_data_header(data).refcount.unref()) {
+		free_channel_data(data, size);
+	}
+}
+
+inline bool is_channel_data_shared(uint8_t *data) {
+	return get_channel_data_header(data).refcount.get() > 1;
+}
+
 uint64_t g_depth_max_values[] = {
 	0xff, // 8
 	0xffff, // 16
@@ -112,6 +149,222 @@ inline real_t raw_voxel_to_real(uint64_t value, VoxelBuffer::Depth depth) {
 	}
 }
 
+// Fills sparse storage from dense channel data
+template <typename T>
+void build_sparse_channel(const VoxelBuffer &buffer, const uint8_t *p_src, VoxelSparseChannel &sparse,
+		VoxelBuffer::Depth depth, bool use_sdf_band, real_t sdf_band) {
+	const T *src = reinterpret_cast<const T *>(p_src);
+	const Box3i buffer_box(Vector3i(), buffer.get_size());
+	const T inside_value = real_to_raw_voxel(-sdf_band, depth);
+	const T outside_value = real_to_raw_voxel(sdf_band, depth);
+
+	Box3i(Vector3i(), sparse.brick_counts).for_each_cell_zxy([&](Vector3i brick_pos) {
+		const Box3i box = Box3i(brick_pos << VoxelSparseChannel::BRICK_SIZE_PO2, Vector3i(VoxelSparseChannel::BRICK_SIZE))
+								  .clipped(buffer_box);
+		const unsigned int brick_index = brick_pos.get_zxy_index(sparse.brick_counts);
+		const T first_value = src[buffer.get_index(box.pos.x, box.pos.y, box.pos.z)];
+
+		bool uniform = true;
+		real_t min_sd = first_value;
+		real_t max_sd = first_value;
+		if (use_sdf_band) {
+			min_sd = raw_voxel_to_real(first_value, depth);
+			max_sd = min_sd;
+		}
+		buffer.for_each_index_and_pos(box, [&](unsigned int i, Vector3i pos) {
+			const T v = src[i];
+			uniform &= (v == first_value);
+			if (use_sdf_band) {
+				const real_t sd = raw_voxel_to_real(v, depth);
+				min_sd = MIN(min_sd, sd);
+				max_sd = MAX(max_sd, sd);
+			}
+		});
+
+		if (uniform) {
+			sparse.uniform_values[brick_index] = first_value;
+
+		} else if (use_sdf_band && min_sd >= sdf_band) {
+			sparse.uniform_values[brick_index] = outside_value;
+
+		} else if (use_sdf_band && max_sd <= -sdf_band) {
+			sparse.uniform_values[brick_index] = inside_value;
+
+		} else {
+			T *brick = reinterpret_cast<T *>(sparse.add_dense_brick(brick_index));
+			// Parts of edge bricks outside of the buffer are not used
+			simd::fill<T>(brick, VoxelSparseChannel::BRICK_VOLUME, first_value);
+			buffer.for_each_index_and_pos(box, [brick, src](unsigned int i, Vector3i pos) {
+				brick[VoxelSparseChannel::get_index_in_brick(pos)] = src[i];
+			});
+		}
+	});
+}
+
+void build_sparse_channel(const VoxelBuffer &buffer, const uint8_t *src, VoxelSparseChannel &sparse,
+		VoxelBuffer::Depth depth, bool use_sdf_band, real_t sdf_band) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			build_sparse_channel<uint8_t>(buffer, src, sparse, depth, use_sdf_band, sdf_band);
+			break;
+		case VoxelBuffer::DEPTH_16_BIT:
+			build_sparse_channel<uint16_t>(buffer, src, sparse, depth, use_sdf_band, sdf_band);
+			break;
+		case VoxelBuffer::DEPTH_32_BIT:
+			build_sparse_channel<uint32_t>(buffer, src, sparse, depth, use_sdf_band, sdf_band);
+			break;
+		case VoxelBuffer::DEPTH_64_BIT:
+			build_sparse_channel<uint64_t>(buffer, src, sparse, depth, use_sdf_band, sdf_band);
+			break;
+		default:
+			CRASH_NOW();
+			break;
+	}
+}
+
+// Copies voxels of a box from sparse storage into dense channel data, at the box position plus `dst_offset`
+template <typename T>
+void copy_sparse_box(const VoxelSparseChannel &sparse, Box3i src_box, const VoxelBuffer &dst_buffer,
+		uint8_t *p_dst, Vector3i dst_offset) {
+	T *dst = reinterpret_cast<T *>(p_dst);
+	const Box3i brick_box = Box3i::from_min_max(src_box.pos >> VoxelSparseChannel::BRICK_SIZE_PO2,
+			((src_box.pos + src_box.size - Vector3i(1)) >> VoxelSparseChannel::BRICK_SIZE_PO2) + Vector3i(1));
+
+	brick_box.for_each_cell_zxy([&](Vector3i brick_pos) {
+		const Box3i box = Box3i(brick_pos << VoxelSparseChannel::BRICK_SIZE_PO2, Vector3i(VoxelSparseChannel::BRICK_SIZE))
+								  .clipped(src_box);
+		const Box3i dst_box(box.pos + dst_offset, box.size);
+		const unsigned int brick_index = brick_pos.get_zxy_index(sparse.brick_counts);
+		const uint32_t dense_index = sparse.brick_indices[brick_index];
+
+		if (dense_index == VoxelSparseChannel::UNIFORM_BRICK) {
+			const T v = sparse.uniform_values[brick_index];
+			dst_buffer.for_each_index_and_pos(dst_box, [dst, v](unsigned int i, Vector3i pos) {
+				dst[i] = v;
+			});
+
+		} else {
+			const T *brick = reinterpret_cast<const T *>(sparse.get_dense_brick(dense_index));
+			dst_buffer.for_each_index_and_pos(dst_box, [dst, brick, dst_offset](unsigned int i, Vector3i pos) {
+				dst[i] = brick[VoxelSparseChannel::get_index_in_brick(pos - dst_offset)];
+			});
+		}
+	});
+}
+
+void copy_sparse_box(const VoxelSparseChannel &sparse, Box3i src_box, const VoxelBuffer &dst_buffer, uint8_t *dst,
+		Vector3i dst_offset, VoxelBuffer::Depth depth) {
+	if (src_box.is_empty()) {
+		return;
+	}
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			copy_sparse_box<uint8_t>(sparse, src_box, dst_buffer, dst, dst_offset);
+			break;
+		case VoxelBuffer::DEPTH_16_BIT:
+			copy_sparse_box<uint16_t>(sparse, src_box, dst_buffer, dst, dst_offset);
+			break;
+		case VoxelBuffer::DEPTH_32_BIT:
+			copy_sparse_box<uint32_t>(sparse, src_box, dst_buffer, dst, dst_offset);
+			break;
+		case VoxelBuffer::DEPTH_64_BIT:
+			copy_sparse_box<uint64_t>(sparse, src_box, dst_buffer, dst, dst_offset);
+			break;
+		default:
+			CRASH_NOW();
+			break;
+	}
+}
+
+// Range of normalized SDF values 8-bit channels can represent, in units of another depth
+inline real_t get_sdf_8_bits_range(VoxelBuffer::Depth depth) {
+	return VoxelBuffer::get_sdf_quantization_scale(depth) / VoxelConstants::QUANTIZED_SDF_8_BITS_SCALE;
+}
+
+// Fits the range of quantized storage to dense channel data, and encodes it
+template <typename T>
+void build_quantized_sdf_channel(const VoxelBuffer &buffer, const uint8_t *p_src,
+		VoxelQuantizedSdfChannel &quantized, VoxelBuffer::Depth depth) {
+	const T *src = reinterpret_cast<const T *>(p_src);
+	const Vector3i size = buffer.get_size();
+	const Box3i box(Vector3i(), size);
+	const real_t range = get_sdf_8_bits_range(depth);
+
+	real_t min_sd = range;
+	real_t max_sd = -range;
+	buffer.for_each_index_and_pos(box, [src, depth, &min_sd, &max_sd](unsigned int i, Vector3i pos) {
+		const real_t sd = raw_voxel_to_real(src[i], depth);
+		min_sd = MIN(min_sd, sd);
+		max_sd = MAX(max_sd, sd);
+	});
+	// Distances further than 8-bit SDF can represent saturate
+	min_sd = CLAMP(min_sd, -range, range);
+	max_sd = CLAMP(max_sd, -range, range);
+
+	quantized.offset = min_sd;
+	quantized.scale = (max_sd - min_sd) / VoxelQuantizedSdfChannel::MAX_CODE;
+	quantized.codes.resize(size.volume());
+	buffer.for_each_index_and_pos(box, [src, depth, size, &quantized](unsigned int i, Vector3i pos) {
+		quantized.codes[pos.get_zxy_index(size)] = quantized.encode(raw_voxel_to_real(src[i], depth));
+	});
+}
+
+void build_quantized_sdf_channel(const VoxelBuffer &buffer, const uint8_t *src, VoxelQuantizedSdfChannel &quantized,
+		VoxelBuffer::Depth depth) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_16_BIT:
+			build_quantized_sdf_channel<uint16_t>(buffer, src, quantized, depth);
+			break;
+		case VoxelBuffer::DEPTH_32_BIT:
+			build_quantized_sdf_channel<uint32_t>(buffer, src, quantized, depth);
+			break;
+		case VoxelBuffer::DEPTH_64_BIT:
+			build_quantized_sdf_channel<uint64_t>(buffer, src, quantized, depth);
+			break;
+		default:
+			CRASH_NOW();
+			break;
+	}
+}
+
+// Decodes voxels of a box from quantized storage into dense channel data, at the box position plus `dst_offset`
+template <typename T>
+void copy_quantized_sdf_box(const VoxelQuantizedSdfChannel &quantized, Vector3i src_size, Box3i src_box,
+		const VoxelBuffer &dst_buffer, uint8_t *p_dst, Vector3i dst_offset, VoxelBuffer::Depth depth) {
+	// There are few possible codes, so decode each of them only once
+	FixedArray<T, VoxelQuantizedSdfChannel::MAX_CODE + 1> values;
+	for (unsigned int code = 0; code < values.size(); ++code) {
+		values[code] = real_to_raw_voxel(quantized.decode(code), depth);
+	}
+	T *dst = reinterpret_cast<T *>(p_dst);
+	const uint8_t *codes = quantized.codes.data();
+	const Box3i dst_box(src_box.pos + dst_offset, src_box.size);
+	dst_buffer.for_each_index_and_pos(dst_box, [dst, codes, &values, src_size, dst_offset](unsigned int i, Vector3i pos) {
+		dst[i] = values[codes[(pos - dst_offset).get_zxy_index(src_size)]];
+	});
+}
+
+void copy_quantized_sdf_box(const VoxelQuantizedSdfChannel &quantized, Vector3i src_size, Box3i src_box,
+		const VoxelBuffer &dst_buffer, uint8_t *dst, Vector3i dst_offset, VoxelBuffer::Depth depth) {
+	if (src_box.is_empty()) {
+		return;
+	}
+	switch (depth) {
+		case VoxelBuffer::DEPTH_16_BIT:
+			copy_quantized_sdf_box<uint16_t>(quantized, src_size, src_box, dst_buffer, dst, dst_offset, depth);
+			break;
+		case VoxelBuffer::DEPTH_32_BIT:
+			copy_quantized_sdf_box<uint32_t>(quantized, src_size, src_box, dst_buffer, dst, dst_offset, depth);
+			break;
+		case VoxelBuffer::DEPTH_64_BIT:
+			copy_quantized_sdf_box<uint64_t>(quantized, src_size, src_box, dst_buffer, dst, dst_offset, depth);
+			break;
+		default:
+			CRASH_NOW();
+			break;
+	}
+}
+
 } // namespace
 
 const char *VoxelBuffer::CHANNEL_ID_HINT_STRING = "Type,Sdf,Color,Indices,Weights,Data5,Data6,Data7";
@@ -149,6 +402,10 @@ void VoxelBuffer::create(unsigned int sx, unsigned int sy, unsigned int sz) {
 				// Channel already contained data
 				delete_channel(i);
 				create_channel(i, new_size, channel.defval);
+			} else if (channel.sparse != nullptr) {
+				delete_sparse_channel(i);
+			} else if (channel.quantized_sdf != nullptr) {
+				delete_quantized_sdf_channel(i);
 			}
 		}
 		_size = new_size;
@@ -164,6 +421,10 @@ void VoxelBuffer::clear() {
 		Channel &channel = _channels[i];
 		if (channel.data) {
 			delete_channel(i);
+		} else if (channel.sparse != nullptr) {
+			delete_sparse_channel(i);
+		} else if (channel.quantized_sdf != nullptr) {
+			delete_quantized_sdf_channel(i);
 		}
 	}
 	_size = Vector3i();
@@ -175,6 +436,10 @@ void VoxelBuffer::clear_channel(unsigned int channel_index, uint64_t clear_value
 	Channel &channel = _channels[channel_index];
 	if (channel.data != nullptr) {
 		delete_channel(channel_index);
+	} else if (channel.sparse != nullptr) {
+		delete_sparse_channel(channel_index);
+	} else if (channel.quantized_sdf != nullptr) {
+		delete_quantized_sdf_channel(channel_index);
 	}
 	channel.defval = clamp_value_for_depth(clear_value, channel.depth);
 }
@@ -218,6 +483,12 @@ uint64_t VoxelBuffer::get_voxel(int x, int y, int z, unsigned int channel_index)
 				return 0;
 		}
 
+	} else if (channel.sparse != nullptr) {
+		return channel.sparse->get(Vector3i(x, y, z));
+
+	} else if (channel.quantized_sdf != nullptr) {
+		return real_to_raw_voxel(channel.quantized_sdf->get(Vector3i(x, y, z), _size), channel.depth);
+
 	} else {
 		return channel.defval;
 	}
@@ -228,6 +499,11 @@ void VoxelBuffer::set_voxel(uint64_t value, int x, int y, int z, unsigned int ch
 	ERR_FAIL_COND_MSG(!is_position_valid(x, y, z), String("At position ({0}, {1}, {2})").format(varray(x, y, z)));
 
 	Channel &channel = _channels[channel_index];
+	if (channel.sparse != nullptr) {
+		decompress_sparse_channel(channel_index);
+	} else if (channel.quantized_sdf != nullptr) {
+		decompress_quantized_sdf_channel(channel_index);
+	}
 
 	value = clamp_value_for_depth(value, channel.depth);
 	bool do_set = true;
@@ -239,6 +515,8 @@ void VoxelBuffer::set_voxel(uint64_t value, int x, int y, int z, unsigned int ch
 		} else {
 			do_set = false;
 		}
+	} else {
+		make_channel_unique(channel_index);
 	}
 
 	if (do_set) {
@@ -285,6 +563,13 @@ void VoxelBuffer::fill(uint64_t defval, unsigned int channel_index) {
 
 	defval = clamp_value_for_depth(defval, channel.depth);
 
+	if (channel.sparse != nullptr) {
+		// All values are going to be overwritten
+		delete_sparse_channel(channel_index);
+	} else if (channel.quantized_sdf != nullptr) {
+		delete_quantized_sdf_channel(channel_index);
+	}
+
 	if (channel.data == nullptr) {
 		// Channel is already optimized and uniform
 		if (channel.defval == defval) {
@@ -297,29 +582,29 @@ void VoxelBuffer::fill(uint64_t defval, unsigned int channel_index) {
 		}
 	}
 
+	if (is_channel_data_shared(channel.data)) {
+		// All values are going to be overwritten, no need to copy them
+		delete_channel(channel_index);
+		create_channel_noinit(channel_index, _size);
+	}
+
 	const unsigned int volume = get_volume();
 
 	switch (channel.depth) {
 		case DEPTH_8_BIT:
-			memset(channel.data, defval, channel.size_in_bytes);
+			simd::fill<uint8_t>(channel.data, volume, defval);
 			break;
 
 		case DEPTH_16_BIT:
-			for (uint32_t i = 0; i < volume; ++i) {
-				reinterpret_cast<uint16_t *>(channel.data)[i] = defval;
-			}
+			simd::fill<uint16_t>(reinterpret_cast<uint16_t *>(channel.data), volume, defval);
 			break;
 
 		case DEPTH_32_BIT:
-			for (uint32_t i = 0; i < volume; ++i) {
-				reinterpret_cast<uint32_t *>(channel.data)[i] = defval;
-			}
+			simd::fill<uint32_t>(reinterpret_cast<uint32_t *>(channel.data), volume, defval);
 			break;
 
 		case DEPTH_64_BIT:
-			for (uint32_t i = 0; i < volume; ++i) {
-				reinterpret_cast<uint64_t *>(channel.data)[i] = defval;
-			}
+			simd::fill<uint64_t>(reinterpret_cast<uint64_t *>(channel.data), volume, defval);
 			break;
 
 		default:
@@ -342,62 +627,51 @@ void VoxelBuffer::fill_area(uint64_t defval, Vector3i min, Vector3i max, unsigne
 	Channel &channel = _channels[channel_index];
 	defval = clamp_value_for_depth(defval, channel.depth);
 
+	if (channel.sparse != nullptr) {
+		decompress_sparse_channel(channel_index);
+	} else if (channel.quantized_sdf != nullptr) {
+		decompress_quantized_sdf_channel(channel_index);
+	}
+
 	if (channel.data == nullptr) {
 		if (channel.defval == defval) {
 			return;
 		} else {
 			create_channel(channel_index, _size, channel.defval);
 		}
+	} else {
+		make_channel_unique(channel_index);
 	}
 
-	Vector3i pos;
-	const unsigned int volume = get_volume();
-	for (pos.z = min.z; pos.z < max.z; ++pos.z) {
-		for (pos.x = min.x; pos.x < max.x; ++pos.x) {
-			const unsigned int dst_ri = get_index(pos.x, pos.y + min.y, pos.z);
-			CRASH_COND(dst_ri >= volume);
-
-			switch (channel.depth) {
-				case DEPTH_8_BIT:
-					// Fill row by row
-					memset(&channel.data[dst_ri], defval, area_size.y * sizeof(uint8_t));
-					break;
+	// Hoist the depth switch out of the loops
+	Span<uint8_t> data(channel.data, 0, channel.size_in_bytes);
+	switch (channel.depth) {
+		case DEPTH_8_BIT:
+			fill_3d_region_zxy<uint8_t>(data, _size, min, max, defval);
+			break;
 
-				case DEPTH_16_BIT:
-					for (int i = 0; i < area_size.y; ++i) {
-						((uint16_t *)channel.data)[dst_ri + i] = defval;
-					}
-					break;
+		case DEPTH_16_BIT:
+			fill_3d_region_zxy<uint16_t>(data.reinterpret_cast_to<uint16_t>(), _size, min, max, defval);
+			break;
 
-				case DEPTH_32_BIT:
-					for (int i = 0; i < area_size.y; ++i) {
-						((uint32_t *)channel.data)[dst_ri + i] = defval;
-					}
-					break;
+		case DEPTH_32_BIT:
+			fill_3d_region_zxy<uint32_t>(data.reinterpret_cast_to<uint32_t>(), _size, min, max, defval);
+			break;
 
-				case DEPTH_64_BIT:
-					for (int i = 0; i < area_size.y; ++i) {
-						((uint64_t *)channel.data)[dst_ri + i] = defval;
-					}
-					break;
+		case DEPTH_64_BIT:
+			fill_3d_region_zxy<uint64_t>(data.reinterpret_cast_to<uint64_t>(), _size, min, max, defval);
+			break;
 
-				default:
-					CRASH_NOW();
-					break;
-			}
-		}
+		default:
+			CRASH_NOW();
+			break;
 	}
 }
 
 void VoxelBuffer::set_voxel_metadata_in_area(Box3i box, Variant meta) {
-	Map<Vector3i, Variant>::Element *elem = _voxel_metadata.front();
-	while (elem != nullptr) {
-		Map<Vector3i, Variant>::Element *next_elem = elem->next();
-		if (box.contains(elem->key())) {
-			_voxel_metadata[elem->key()] = meta;
-		}
-		elem = next_elem;
-	}
+	_voxel_metadata.for_each_in_area(box, [&meta](Vector3i pos, Variant &value) {
+		value = meta;
+	});
 }
 
 void VoxelBuffer::replace_voxel_in_area(Box3i box,uint64_t ovalue,uint64_t value, unsigned int channel_index) {
@@ -408,12 +682,20 @@ void VoxelBuffer::replace_voxel_in_area(Box3i box,uint64_t ovalue,uint64_t value
 	Channel &channel = _channels[channel_index];
 	value = clamp_value_for_depth(value, channel.depth);
 
+	if (channel.sparse != nullptr) {
+		decompress_sparse_channel(channel_index);
+	} else if (channel.quantized_sdf != nullptr) {
+		decompress_quantized_sdf_channel(channel_index);
+	}
+
 	if (channel.data == nullptr) {
 		if (channel.defval == value) {
 			return;
 		} else {
 			create_channel(channel_index, _size, channel.defval);
 		}
+	} else {
+		make_channel_unique(channel_index);
 	}
 
 	Vector3i pos;
@@ -487,6 +769,22 @@ bool VoxelBuffer::is_uniform(unsigned int channel_index) const {
 	ERR_FAIL_INDEX_V(channel_index, MAX_CHANNELS, true);
 
 	const Channel &channel = _channels[channel_index];
+	if (channel.sparse != nullptr) {
+		// Dense bricks always contain different values
+		if (channel.sparse->dense_bricks.size() > 0) {
+			return false;
+		}
+		const std::vector<uint64_t> &values = channel.sparse->uniform_values;
+		for (size_t i = 1; i < values.size(); ++i) {
+			if (values[i] != values[0]) {
+				return false;
+			}
+		}
+		return true;
+	}
+	if (channel.quantized_sdf != nullptr) {
+		return ::is_uniform<uint8_t>(channel.quantized_sdf->codes.data(), channel.quantized_sdf->codes.size());
+	}
 	if (channel.data == nullptr) {
 		// Channel has been optimized
 		return true;
@@ -514,7 +812,9 @@ bool VoxelBuffer::is_uniform(unsigned int channel_index) const {
 
 void VoxelBuffer::compress_uniform_channels() {
 	for (unsigned int i = 0; i < MAX_CHANNELS; ++i) {
-		if (_channels[i].data != nullptr && is_uniform(i)) {
+		const Channel &channel = _channels[i];
+		if ((channel.data != nullptr || channel.sparse != nullptr || channel.quantized_sdf != nullptr) &&
+				is_uniform(i)) {
 			// TODO More direct way
 			const uint64_t v = get_voxel(0, 0, 0, i);
 			clear_channel(i, v);
@@ -525,20 +825,125 @@ void VoxelBuffer::compress_uniform_channels() {
 void VoxelBuffer::decompress_channel(unsigned int channel_index) {
 	ERR_FAIL_INDEX(channel_index, MAX_CHANNELS);
 	Channel &channel = _channels[channel_index];
-	if (channel.data == nullptr) {
+	if (channel.sparse != nullptr) {
+		decompress_sparse_channel(channel_index);
+	} else if (channel.quantized_sdf != nullptr) {
+		decompress_quantized_sdf_channel(channel_index);
+	} else if (channel.data == nullptr) {
 		create_channel(channel_index, _size, channel.defval);
+	} else {
+		make_channel_unique(channel_index);
 	}
 }
 
 VoxelBuffer::Compression VoxelBuffer::get_channel_compression(unsigned int channel_index) const {
 	ERR_FAIL_INDEX_V(channel_index, MAX_CHANNELS, VoxelBuffer::COMPRESSION_NONE);
 	const Channel &channel = _channels[channel_index];
+	if (channel.sparse != nullptr) {
+		return COMPRESSION_SPARSE;
+	}
+	if (channel.quantized_sdf != nullptr) {
+		return COMPRESSION_SDF_8_BITS;
+	}
 	if (channel.data == nullptr) {
 		return COMPRESSION_UNIFORM;
 	}
 	return COMPRESSION_NONE;
 }
 
+void VoxelBuffer::compress_sparse_channel(unsigned int channel_index, float sdf_band) {
+	ERR_FAIL_INDEX(channel_index, MAX_CHANNELS);
+	Channel &channel = _channels[channel_index];
+	if (channel.data == nullptr) {
+		// Already uniform or sparse
+		return;
+	}
+
+	const bool use_sdf_band = channel_index == CHANNEL_SDF && sdf_band > 0.f;
+	VoxelSparseChannel *sparse = memnew(VoxelSparseChannel);
+	sparse->create(_size, get_depth_byte_count(channel.depth));
+	build_sparse_channel(*this, channel.data, *sparse, channel.depth, use_sdf_band,
+			sdf_band * get_sdf_quantization_scale(channel.depth));
+
+	// Not worth it if most bricks have variations
+	if (sparse->get_memory_usage() > channel.size_in_bytes / 2) {
+		memdelete(sparse);
+		return;
+	}
+
+	delete_channel(channel_index);
+	channel.sparse = sparse;
+
+	if (is_uniform(channel_index)) {
+		clear_channel(channel_index, sparse->uniform_values[0]);
+	}
+}
+
+const VoxelSparseChannel *VoxelBuffer::get_channel_sparse(unsigned int channel_index) const {
+	ERR_FAIL_INDEX_V(channel_index, MAX_CHANNELS, nullptr);
+	return _channels[channel_index].sparse;
+}
+
+void VoxelBuffer::set_channel_sparse(unsigned int channel_index, VoxelSparseChannel &&sparse) {
+	ERR_FAIL_INDEX(channel_index, MAX_CHANNELS);
+	Channel &channel = _channels[channel_index];
+	ERR_FAIL_COND(sparse.item_size != get_depth_byte_count(channel.depth));
+	ERR_FAIL_COND(sparse.brick_counts !=
+				  (_size + Vector3i(VoxelSparseChannel::BRICK_SIZE_MASK)) >> VoxelSparseChannel::BRICK_SIZE_PO2);
+	ERR_FAIL_COND(sparse.brick_indices.size() != static_cast<size_t>(sparse.brick_counts.volume()));
+	ERR_FAIL_COND(sparse.uniform_values.size() != sparse.brick_indices.size());
+	if (channel.data != nullptr) {
+		delete_channel(channel_index);
+	} else if (channel.sparse != nullptr) {
+		delete_sparse_channel(channel_index);
+	} else if (channel.quantized_sdf != nullptr) {
+		delete_quantized_sdf_channel(channel_index);
+	}
+	channel.sparse = memnew(VoxelSparseChannel(std::move(sparse)));
+}
+
+void VoxelBuffer::compress_sdf_to_8_bits() {
+	Channel &channel = _channels[CHANNEL_SDF];
+	if (channel.data == nullptr) {
+		// Already uniform or compressed
+		return;
+	}
+	// 8-bit channels have nothing to gain
+	ERR_FAIL_COND(channel.depth == DEPTH_8_BIT);
+
+	VoxelQuantizedSdfChannel *quantized = memnew(VoxelQuantizedSdfChannel);
+	build_quantized_sdf_channel(*this, channel.data, *quantized, channel.depth);
+
+	delete_channel(CHANNEL_SDF);
+
+	if (quantized->scale == 0.f) {
+		// All values are the same after saturation
+		clear_channel(CHANNEL_SDF, real_to_raw_voxel(quantized->offset, channel.depth));
+		memdelete(quantized);
+		return;
+	}
+
+	channel.quantized_sdf = quantized;
+}
+
+const VoxelQuantizedSdfChannel *VoxelBuffer::get_channel_quantized_sdf() const {
+	return _channels[CHANNEL_SDF].quantized_sdf;
+}
+
+void VoxelBuffer::set_channel_quantized_sdf(VoxelQuantizedSdfChannel &&quantized) {
+	Channel &channel = _channels[CHANNEL_SDF];
+	ERR_FAIL_COND(channel.depth == DEPTH_8_BIT);
+	ERR_FAIL_COND(quantized.codes.size() != static_cast<size_t>(_size.volume()));
+	if (channel.data != nullptr) {
+		delete_channel(CHANNEL_SDF);
+	} else if (channel.sparse != nullptr) {
+		delete_sparse_channel(CHANNEL_SDF);
+	} else if (channel.quantized_sdf != nullptr) {
+		delete_quantized_sdf_channel(CHANNEL_SDF);
+	}
+	channel.quantized_sdf = memnew(VoxelQuantizedSdfChannel(std::move(quantized)));
+}
+
 void VoxelBuffer::copy_format(const VoxelBuffer &other) {
 	for (unsigned int i = 0; i < MAX_CHANNELS; ++i) {
 		set_channel_depth(i, other.get_channel_depth(i));
@@ -561,12 +966,37 @@ void VoxelBuffer::copy_from(const VoxelBuffer &other, unsigned int channel_index
 
 	ERR_FAIL_COND(other_channel.depth != channel.depth);
 
-	if (other_channel.data != nullptr) {
-		if (channel.data == nullptr) {
-			create_channel_noinit(channel_index, _size);
+	if (channel.sparse != nullptr) {
+		delete_sparse_channel(channel_index);
+	} else if (channel.quantized_sdf != nullptr) {
+		delete_quantized_sdf_channel(channel_index);
+	}
+
+	if (other_channel.sparse != nullptr) {
+		if (channel.data != nullptr) {
+			delete_channel(channel_index);
+		}
+		channel.sparse = memnew(VoxelSparseChannel(*other_channel.sparse));
+
+	} else if (other_channel.quantized_sdf != nullptr) {
+		if (channel.data != nullptr) {
+			delete_channel(channel_index);
+		}
+		// Codes are always in ZXY order
+		channel.quantized_sdf = memnew(VoxelQuantizedSdfChannel(*other_channel.quantized_sdf));
+
+	} else if (other_channel.data != nullptr) {
+		if (channel.data == other_channel.data) {
+			// Already sharing the same memory
+			return;
 		}
-		CRASH_COND(channel.size_in_bytes != other_channel.size_in_bytes);
-		memcpy(channel.data, other_channel.data, channel.size_in_bytes);
+		if (channel.data != nullptr) {
+			delete_channel(channel_index);
+		}
+		// Share memory instead of copying it. It will be copied only if one of the buffers gets modified.
+		ref_channel_data(other_channel.data);
+		channel.data = other_channel.data;
+		channel.size_in_bytes = other_channel.size_in_bytes;
 
 	} else if (channel.data != nullptr) {
 		delete_channel(channel_index);
@@ -586,16 +1016,55 @@ void VoxelBuffer::copy_from(const VoxelBuffer &other, Vector3i src_min, Vector3i
 
 	ERR_FAIL_COND(other_channel.depth != channel.depth);
 
-	if (channel.data == nullptr && other_channel.data == nullptr && channel.defval == other_channel.defval) {
+	if (channel.sparse != nullptr) {
+		decompress_sparse_channel(channel_index);
+	} else if (channel.quantized_sdf != nullptr) {
+		decompress_quantized_sdf_channel(channel_index);
+	}
+
+	if (channel.data == nullptr && other_channel.data == nullptr && other_channel.sparse == nullptr &&
+			other_channel.quantized_sdf == nullptr && channel.defval == other_channel.defval) {
 		// No action needed
 		return;
 	}
 
-	if (other_channel.data != nullptr) {
+	if (other_channel.sparse != nullptr) {
+		Vector3i::sort_min_max(src_min, src_max);
+		clip_copy_region(src_min, src_max, other._size, dst_min, _size);
+		const Box3i src_box(src_min, src_max - src_min);
+		if (src_box.is_empty()) {
+			return;
+		}
+		if (channel.data == nullptr) {
+			create_channel(channel_index, _size, channel.defval);
+		} else {
+			make_channel_unique(channel_index);
+		}
+		copy_sparse_box(
+				*other_channel.sparse, src_box, *this, channel.data, dst_min - src_box.pos, channel.depth);
+
+	} else if (other_channel.quantized_sdf != nullptr) {
+		Vector3i::sort_min_max(src_min, src_max);
+		clip_copy_region(src_min, src_max, other._size, dst_min, _size);
+		const Box3i src_box(src_min, src_max - src_min);
+		if (src_box.is_empty()) {
+			return;
+		}
+		if (channel.data == nullptr) {
+			create_channel(channel_index, _size, channel.defval);
+		} else {
+			make_channel_unique(channel_index);
+		}
+		copy_quantized_sdf_box(*other_channel.quantized_sdf, other._size, src_box, *this, channel.data,
+				dst_min - src_box.pos, channel.depth);
+
+	} else if (other_channel.data != nullptr) {
 		if (channel.data == nullptr) {
 			// Note, we do this even if the pasted data happens to be all the same value as our current channel.
 			// We assume that this case is not frequent enough to bother, and compression can happen later
 			create_channel(channel_index, _size, channel.defval);
+		} else {
+			make_channel_unique(channel_index);
 		}
 		const unsigned int item_size = get_depth_byte_count(channel.depth);
 		Span<const uint8_t> src(other_channel.data, other_channel.size_in_bytes);
@@ -639,79 +1108,613 @@ bool VoxelBuffer::get_channel_raw(unsigned int channel_index, Span<uint8_t> &sli
 	return false;
 }
 
-void VoxelBuffer::create_channel(int i, Vector3i size, uint64_t defval) {
-	create_channel_noinit(i, size);
-	fill(defval, i);
-}
+namespace {
 
-uint32_t VoxelBuffer::get_size_in_bytes_for_volume(Vector3i size, Depth depth) {
-	// Calculate appropriate size based on bit depth
-	const unsigned int volume = size.x * size.y * size.z;
-	const unsigned int bits = volume * ::get_depth_bit_count(depth);
-	const unsigned int size_in_bytes = (bits >> 3);
-	return size_in_bytes;
+// Box between two corners given by scripts, in any order
+inline Box3i get_area_box(Vector3 min_pos, Vector3 max_pos) {
+	Vector3i min_pos_i(min_pos);
+	Vector3i max_pos_i(max_pos);
+	Vector3i::sort_min_max(min_pos_i, max_pos_i);
+	return Box3i::from_min_max(min_pos_i, max_pos_i);
 }
 
-void VoxelBuffer::create_channel_noinit(int i, Vector3i size) {
-	Channel &channel = _channels[i];
-	uint32_t size_in_bytes = get_size_in_bytes_for_volume(size, channel.depth);
-	CRASH_COND(channel.data != nullptr);
-	channel.data = allocate_channel_data(size_in_bytes);
-	channel.size_in_bytes = size_in_bytes;
+// Converts an array of raw values into normalized values, using the same convention as `get_voxel_f`
+template <typename T>
+void convert_raw_to_real(Span<const uint8_t> p_src, Span<real_t> dst, VoxelBuffer::Depth depth) {
+	Span<const T> src = p_src.reinterpret_cast_to<const T>();
+	for (size_t i = 0; i < dst.size(); ++i) {
+		dst[i] = raw_voxel_to_real(src[i], depth);
+	}
 }
 
-void VoxelBuffer::delete_channel(int i) {
-	Channel &channel = _channels[i];
-	ERR_FAIL_COND(channel.data == nullptr);
-	free_channel_data(channel.data, channel.size_in_bytes);
-	channel.data = nullptr;
-	channel.size_in_bytes = 0;
+void convert_raw_to_real(Span<const uint8_t> src, Span<real_t> dst, VoxelBuffer::Depth depth) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			convert_raw_to_real<uint8_t>(src, dst, depth);
+			break;
+		case VoxelBuffer::DEPTH_16_BIT:
+			convert_raw_to_real<uint16_t>(src, dst, depth);
+			break;
+		case VoxelBuffer::DEPTH_32_BIT:
+			convert_raw_to_real<uint32_t>(src, dst, depth);
+			break;
+		case VoxelBuffer::DEPTH_64_BIT:
+			convert_raw_to_real<uint64_t>(src, dst, depth);
+			break;
+		default:
+			CRASH_NOW();
+			break;
+	}
 }
 
-void VoxelBuffer::downscale_to(VoxelBuffer &dst, Vector3i src_min, Vector3i src_max, Vector3i dst_min) const {
-	// TODO Align input to multiple of two
+// Converts an array of normalized values into raw values, using the same convention as `set_voxel_f`
+template <typename T>
+void convert_real_to_raw(Span<const real_t> src, Span<uint8_t> p_dst, VoxelBuffer::Depth depth) {
+	Span<T> dst = p_dst.reinterpret_cast_to<T>();
+	for (size_t i = 0; i < src.size(); ++i) {
+		dst[i] = real_to_raw_voxel(src[i], depth);
+	}
+}
 
-	src_min.clamp_to(Vector3i(), _size);
-	src_max.clamp_to(Vector3i(), _size + Vector3i(1));
+void convert_real_to_raw(Span<const real_t> src, Span<uint8_t> dst, VoxelBuffer::Depth depth) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			convert_real_to_raw<uint8_t>(src, dst, depth);
+			break;
+		case VoxelBuffer::DEPTH_16_BIT:
+			convert_real_to_raw<uint16_t>(src, dst, depth);
+			break;
+		case VoxelBuffer::DEPTH_32_BIT:
+			convert_real_to_raw<uint32_t>(src, dst, depth);
+			break;
+		case VoxelBuffer::DEPTH_64_BIT:
+			convert_real_to_raw<uint64_t>(src, dst, depth);
+			break;
+		default:
+			CRASH_NOW();
+			break;
+	}
+}
+
+} // namespace
+
+void VoxelBuffer::copy_channel_area_to_raw(unsigned int channel_index, Box3i box, Span<uint8_t> dst) const {
+	ERR_FAIL_INDEX(channel_index, MAX_CHANNELS);
+	ERR_FAIL_COND(!Box3i(Vector3i(), _size).contains(box));
+	const Channel &channel = _channels[channel_index];
+	ERR_FAIL_COND(dst.size() != static_cast<size_t>(box.size.volume()) * get_depth_byte_count(channel.depth));
+	if (dst.size() == 0) {
+		return;
+	}
+
+	if (channel.data != nullptr && box.pos == Vector3i() && box.size == _size) {
+		// Same order as memory
+		memcpy(dst.data(), channel.data, channel.size_in_bytes);
+		return;
+	}
+
+	const Vector3i box_max = box.pos + box.size;
+	switch (channel.depth) {
+		case DEPTH_8_BIT:
+			copy_to(dst, box.size, Vector3i(), box.pos, box_max, channel_index);
+			break;
+		case DEPTH_16_BIT:
+			copy_to(dst.reinterpret_cast_to<uint16_t>(), box.size, Vector3i(), box.pos, box_max, channel_index);
+			break;
+		case DEPTH_32_BIT:
+			copy_to(dst.reinterpret_cast_to<uint32_t>(), box.size, Vector3i(), box.pos, box_max, channel_index);
+			break;
+		case DEPTH_64_BIT:
+			copy_to(dst.reinterpret_cast_to<uint64_t>(), box.size, Vector3i(), box.pos, box_max, channel_index);
+			break;
+		default:
+			CRASH_NOW();
+			break;
+	}
+}
+
+void VoxelBuffer::copy_channel_area_from_raw(unsigned int channel_index, Box3i box, Span<const uint8_t> src) {
+	ERR_FAIL_INDEX(channel_index, MAX_CHANNELS);
+	ERR_FAIL_COND(!Box3i(Vector3i(), _size).contains(box));
+	Channel &channel = _channels[channel_index];
+	ERR_FAIL_COND(src.size() != static_cast<size_t>(box.size.volume()) * get_depth_byte_count(channel.depth));
+	if (src.size() == 0) {
+		return;
+	}
+
+	if (box.pos == Vector3i() && box.size == _size) {
+		// All values get replaced, so previous contents don't need to be decompressed
+		clear_channel(channel_index, channel.defval);
+		create_channel_noinit(channel_index, _size);
+		memcpy(channel.data, src.data(), channel.size_in_bytes);
+		return;
+	}
+
+	switch (channel.depth) {
+		case DEPTH_8_BIT:
+			copy_from(src, box.size, Vector3i(), box.size, box.pos, channel_index);
+			break;
+		case DEPTH_16_BIT:
+			copy_from(src.reinterpret_cast_to<const uint16_t>(), box.size, Vector3i(), box.size, box.pos, channel_index);
+			break;
+		case DEPTH_32_BIT:
+			copy_from(src.reinterpret_cast_to<const uint32_t>(), box.size, Vector3i(), box.size, box.pos, channel_index);
+			break;
+		case DEPTH_64_BIT:
+			copy_from(src.reinterpret_cast_to<const uint64_t>(), box.size, Vector3i(), box.size, box.pos, channel_index);
+			break;
+		default:
+			CRASH_NOW();
+			break;
+	}
+}
+
+void VoxelBuffer::create_channel(int i, Vector3i size, uint64_t defval) {
+	create_channel_noinit(i, size);
+	fill(defval, i);
+}
+
+uint32_t VoxelBuffer::get_size_in_bytes_for_volume(Vector3i size, Depth depth) {
+	// Calculate appropriate size based on bit depth
+	const unsigned int volume = size.x * size.y * size.z;
+	const unsigned int bits = volume * ::get_depth_bit_count(depth);
+	const unsigned int size_in_bytes = (bits >> 3);
+	return size_in_bytes;
+}
+
+void VoxelBuffer::create_channel_noinit(int i, Vector3i size) {
+	Channel &channel = _channels[i];
+	uint32_t size_in_bytes = get_size_in_bytes_for_volume(size, channel.depth);
+	CRASH_COND(channel.data != nullptr);
+	channel.data = allocate_channel_data(size_in_bytes);
+	channel.size_in_bytes = size_in_bytes;
+}
+
+void VoxelBuffer::delete_channel(int i) {
+	Channel &channel = _channels[i];
+	ERR_FAIL_COND(channel.data == nullptr);
+	// Other buffers may still be using that memory
+	unref_channel_data(channel.data, channel.size_in_bytes);
+	channel.data = nullptr;
+	channel.size_in_bytes = 0;
+}
+
+void VoxelBuffer::delete_sparse_channel(int i) {
+	Channel &channel = _channels[i];
+	ERR_FAIL_COND(channel.sparse == nullptr);
+	memdelete(channel.sparse);
+	channel.sparse = nullptr;
+}
+
+void VoxelBuffer::decompress_sparse_channel(int i) {
+	Channel &channel = _channels[i];
+	ERR_FAIL_COND(channel.sparse == nullptr);
+	VoxelSparseChannel *sparse = channel.sparse;
+	channel.sparse = nullptr;
+	create_channel_noinit(i, _size);
+	copy_sparse_box(*sparse, Box3i(Vector3i(), _size), *this, channel.data, Vector3i(), channel.depth);
+	memdelete(sparse);
+}
+
+void VoxelBuffer::delete_quantized_sdf_channel(int i) {
+	Channel &channel = _channels[i];
+	ERR_FAIL_COND(channel.quantized_sdf == nullptr);
+	memdelete(channel.quantized_sdf);
+	channel.quantized_sdf = nullptr;
+}
+
+void VoxelBuffer::decompress_quantized_sdf_channel(int i) {
+	Channel &channel = _channels[i];
+	ERR_FAIL_COND(channel.quantized_sdf == nullptr);
+	VoxelQuantizedSdfChannel *quantized = channel.quantized_sdf;
+	channel.quantized_sdf = nullptr;
+	create_channel_noinit(i, _size);
+	copy_quantized_sdf_box(*quantized, _size, Box3i(Vector3i(), _size), *this, channel.data, Vector3i(), channel.depth);
+	memdelete(quantized);
+}
+
+namespace {
 
-	Vector3i dst_max = dst_min + ((src_max - src_min) >> 1);
+// Reorders voxels between ZXY and Morton order. The size must be cubic and a power of two.
+template <typename T>
+void reorder_zxy_morton(Span<const T> src, Span<T> dst, Vector3i size, bool to_morton) {
+	unsigned int zxy_index = 0;
+	Vector3i pos;
+	for (pos.z = 0; pos.z < size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < size.y; ++pos.y) {
+				const unsigned int morton_index = morton3d_encode(pos.x, pos.y, pos.z);
+				if (to_morton) {
+					dst[morton_index] = src[zxy_index];
+				} else {
+					dst[zxy_index] = src[morton_index];
+				}
+				++zxy_index;
+			}
+		}
+	}
+}
 
-	// TODO This will be wrong if it overlaps the border?
-	dst_min.clamp_to(Vector3i(), dst._size);
-	dst_max.clamp_to(Vector3i(), dst._size + Vector3i(1));
+void reorder_zxy_morton(Span<const uint8_t> src, Span<uint8_t> dst, Vector3i size, VoxelBuffer::Depth depth,
+		bool to_morton) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			reorder_zxy_morton(src, dst, size, to_morton);
+			break;
+		case VoxelBuffer::DEPTH_16_BIT:
+			reorder_zxy_morton(src.reinterpret_cast_to<const uint16_t>(), dst.reinterpret_cast_to<uint16_t>(), size,
+					to_morton);
+			break;
+		case VoxelBuffer::DEPTH_32_BIT:
+			reorder_zxy_morton(src.reinterpret_cast_to<const uint32_t>(), dst.reinterpret_cast_to<uint32_t>(), size,
+					to_morton);
+			break;
+		case VoxelBuffer::DEPTH_64_BIT:
+			reorder_zxy_morton(src.reinterpret_cast_to<const uint64_t>(), dst.reinterpret_cast_to<uint64_t>(), size,
+					to_morton);
+			break;
+		default:
+			CRASH_NOW();
+			break;
+	}
+}
+
+} // namespace
+
+bool VoxelBuffer::is_morton_size_supported(Vector3i size) {
+	// Morton indices would have holes otherwise
+	return size.x == size.y && size.y == size.z && size.x > 0 && (size.x & (size.x - 1)) == 0 && size.x <= 1024;
+}
+
+void VoxelBuffer::copy_channel_to_morton(unsigned int channel_index, Span<uint8_t> dst) const {
+	ERR_FAIL_INDEX(channel_index, MAX_CHANNELS);
+	ERR_FAIL_COND(!is_morton_size_supported(_size));
+	const Channel &channel = _channels[channel_index];
+	ERR_FAIL_COND(dst.size() != get_volume() * get_depth_byte_count(channel.depth));
+
+	// Going through ZXY first, so all channel compressions are handled
+	static thread_local std::vector<uint8_t> tls_zxy;
+	tls_zxy.resize(dst.size());
+	copy_channel_area_to_raw(channel_index, Box3i(Vector3i(), _size), to_span(tls_zxy));
+	reorder_zxy_morton(to_span_const(tls_zxy), dst, _size, channel.depth, true);
+}
+
+void VoxelBuffer::copy_channel_from_morton(unsigned int channel_index, Span<const uint8_t> src) {
+	ERR_FAIL_INDEX(channel_index, MAX_CHANNELS);
+	ERR_FAIL_COND(!is_morton_size_supported(_size));
+	const Channel &channel = _channels[channel_index];
+	ERR_FAIL_COND(src.size() != get_volume() * get_depth_byte_count(channel.depth));
+
+	static thread_local std::vector<uint8_t> tls_zxy;
+	tls_zxy.resize(src.size());
+	reorder_zxy_morton(src, to_span(tls_zxy), _size, channel.depth, false);
+	copy_channel_area_from_raw(channel_index, Box3i(Vector3i(), _size), to_span_const(tls_zxy));
+}
+
+void VoxelBuffer::make_channel_unique(int i) {
+	Channel &channel = _channels[i];
+	if (channel.data == nullptr || !is_channel_data_shared(channel.data)) {
+		return;
+	}
+	// Copy on write: other buffers keep the old memory
+	uint8_t *data = allocate_channel_data(channel.size_in_bytes);
+	memcpy(data, channel.data, channel.size_in_bytes);
+	unref_channel_data(channel.data, channel.size_in_bytes);
+	channel.data = data;
+}
+
+namespace {
+
+// Nearest-neighbor downscaling of a region, row by row
+template <typename T>
+void downscale_nearest_zxy(Span<T> dst, Vector3i dst_size, Vector3i dst_min, Vector3i dst_max,
+		Span<const T> src, Vector3i src_size, Vector3i src_min) {
+	const unsigned int row_length = dst_max.y - dst_min.y;
+	Vector3i pos;
+	pos.y = dst_min.y;
+	for (pos.z = dst_min.z; pos.z < dst_max.z; ++pos.z) {
+		for (pos.x = dst_min.x; pos.x < dst_max.x; ++pos.x) {
+			const Vector3i src_pos = src_min + ((pos - dst_min) << 1);
+			const unsigned int dst_i = pos.get_zxy_index(dst_size);
+			const unsigned int src_i = src_pos.get_zxy_index(src_size);
+			simd::copy_even_items(dst.data() + dst_i, src.data() + src_i, row_length);
+		}
+	}
+}
+
+// Reduces each cell of 2x2x2 source voxels into one destination voxel.
+// `T reduce(const T *cell)` receives the 8 values of the cell.
+// Cells must be entirely inside the source.
+template <typename T, typename F>
+void downscale_cells_zxy(Span<T> dst, Vector3i dst_size, Vector3i dst_min, Vector3i dst_max,
+		Span<const T> src, Vector3i src_size, Vector3i src_min, F reduce) {
+	// Offsets to move by one voxel along each axis in the source
+	const unsigned int oy = 1;
+	const unsigned int ox = src_size.y;
+	const unsigned int oz = src_size.y * src_size.x;
+	const T *s = src.data();
+
+	Vector3i pos;
+	pos.y = dst_min.y;
+	for (pos.z = dst_min.z; pos.z < dst_max.z; ++pos.z) {
+		for (pos.x = dst_min.x; pos.x < dst_max.x; ++pos.x) {
+			unsigned int dst_i = pos.get_zxy_index(dst_size);
+			unsigned int src_i = Vector3i(src_min + ((pos - dst_min) << 1)).get_zxy_index(src_size);
+			T *d = dst.data() + dst_i;
+
+			for (int y = dst_min.y; y < dst_max.y; ++y) {
+				const T cell[8] = {
+					s[src_i], //
+					s[src_i + oy], //
+					s[src_i + ox], //
+					s[src_i + ox + oy], //
+					s[src_i + oz], //
+					s[src_i + oz + oy], //
+					s[src_i + oz + ox], //
+					s[src_i + oz + ox + oy] //
+				};
+				*d = reduce(cell);
+				++d;
+				src_i += 2;
+			}
+		}
+	}
+}
+
+template <typename T>
+inline T reduce_cell_min(const T *cell) {
+	T v = cell[0];
+	for (unsigned int i = 1; i < 8; ++i) {
+		v = MIN(v, cell[i]);
+	}
+	return v;
+}
+
+template <typename T>
+inline T reduce_cell_average(const T *cell) {
+	// Integers up to 32 bits can be summed without overflow in 64 bits
+	uint64_t sum = 0;
+	for (unsigned int i = 0; i < 8; ++i) {
+		sum += cell[i];
+	}
+	// Round to nearest
+	return static_cast<T>((sum + 4) >> 3);
+}
+
+template <>
+inline uint64_t reduce_cell_average<uint64_t>(const uint64_t *cell) {
+	// Divide first to avoid overflow, then account for remainders
+	uint64_t sum = 0;
+	uint64_t remainders = 0;
+	for (unsigned int i = 0; i < 8; ++i) {
+		sum += cell[i] >> 3;
+		remainders += cell[i] & 7;
+	}
+	return sum + ((remainders + 4) >> 3);
+}
+
+template <>
+inline float reduce_cell_average<float>(const float *cell) {
+	float sum = 0.f;
+	for (unsigned int i = 0; i < 8; ++i) {
+		sum += cell[i];
+	}
+	return sum * 0.125f;
+}
+
+template <>
+inline double reduce_cell_average<double>(const double *cell) {
+	double sum = 0.0;
+	for (unsigned int i = 0; i < 8; ++i) {
+		sum += cell[i];
+	}
+	return sum * 0.125;
+}
+
+// Picks the most frequent value. Ties favor the value found first, which is the nearest-neighbor one.
+template <typename T>
+inline T reduce_cell_majority(const T *cell) {
+	T best_value = cell[0];
+	unsigned int best_count = 0;
+	for (unsigned int i = 0; i < 8; ++i) {
+		const T v = cell[i];
+		// If the value appeared before, it was already counted
+		bool seen = false;
+		for (unsigned int j = 0; j < i; ++j) {
+			if (cell[j] == v) {
+				seen = true;
+				break;
+			}
+		}
+		if (seen) {
+			continue;
+		}
+		unsigned int count = 1;
+		for (unsigned int j = i + 1; j < 8; ++j) {
+			if (cell[j] == v) {
+				++count;
+			}
+		}
+		if (count > best_count) {
+			best_count = count;
+			best_value = v;
+			if (count > 4) {
+				// Can't be beaten
+				break;
+			}
+		}
+	}
+	return best_value;
+}
+
+// Downscales values of type `T`, which may be different from the storage type of the channel,
+// for example when SDF is stored as floats.
+template <typename T>
+void downscale_channel_typed(Span<uint8_t> dst_data, Vector3i dst_size, Vector3i dst_min, Vector3i dst_max,
+		Span<const uint8_t> src_data, Vector3i src_size, Vector3i src_min, VoxelBuffer::DownscaleFilter filter) {
+	Span<T> dst = dst_data.reinterpret_cast_to<T>();
+	Span<const T> src = src_data.reinterpret_cast_to<const T>();
+
+	switch (filter) {
+		case VoxelBuffer::DOWNSCALE_NEAREST:
+			downscale_nearest_zxy<T>(dst, dst_size, dst_min, dst_max, src, src_size, src_min);
+			break;
+
+		case VoxelBuffer::DOWNSCALE_MIN:
+			downscale_cells_zxy<T>(dst, dst_size, dst_min, dst_max, src, src_size, src_min, reduce_cell_min<T>);
+			break;
+
+		case VoxelBuffer::DOWNSCALE_AVERAGE:
+			downscale_cells_zxy<T>(dst, dst_size, dst_min, dst_max, src, src_size, src_min, reduce_cell_average<T>);
+			break;
+
+		case VoxelBuffer::DOWNSCALE_MAJORITY:
+			downscale_cells_zxy<T>(dst, dst_size, dst_min, dst_max, src, src_size, src_min, reduce_cell_majority<T>);
+			break;
+
+		default:
+			CRASH_NOW();
+			break;
+	}
+}
+
+void downscale_channel(Span<uint8_t> dst_data, Vector3i dst_size, Vector3i dst_min, Vector3i dst_max,
+		Span<const uint8_t> src_data, Vector3i src_size, Vector3i src_min,
+		VoxelBuffer::Depth depth, VoxelBuffer::DownscaleFilter filter, bool as_real) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			downscale_channel_typed<uint8_t>(dst_data, dst_size, dst_min, dst_max, src_data, src_size, src_min, filter);
+			break;
+
+		case VoxelBuffer::DEPTH_16_BIT:
+			downscale_channel_typed<uint16_t>(
+					dst_data, dst_size, dst_min, dst_max, src_data, src_size, src_min, filter);
+			break;
+
+		case VoxelBuffer::DEPTH_32_BIT:
+			// Above 16 bits, SDF is stored as floating point
+			if (as_real) {
+				downscale_channel_typed<float>(
+						dst_data, dst_size, dst_min, dst_max, src_data, src_size, src_min, filter);
+			} else {
+				downscale_channel_typed<uint32_t>(
+						dst_data, dst_size, dst_min, dst_max, src_data, src_size, src_min, filter);
+			}
+			break;
+
+		case VoxelBuffer::DEPTH_64_BIT:
+			if (as_real) {
+				downscale_channel_typed<double>(
+						dst_data, dst_size, dst_min, dst_max, src_data, src_size, src_min, filter);
+			} else {
+				downscale_channel_typed<uint64_t>(
+						dst_data, dst_size, dst_min, dst_max, src_data, src_size, src_min, filter);
+			}
+			break;
+
+		default:
+			CRASH_NOW();
+			break;
+	}
+}
+
+// Clips a downscaling region on one axis, so that both source cells and destination voxels are in bounds.
+inline void clip_downscale_region_coord(int &src_min, int &cell_count, int &dst_min, const int dst_size) {
+	if (dst_min < 0) {
+		src_min += -dst_min * 2;
+		cell_count += dst_min;
+		dst_min = 0;
+	}
+	if (dst_min + cell_count > dst_size) {
+		cell_count = dst_size - dst_min;
+	}
+}
+
+} // namespace
+
+void VoxelBuffer::downscale_to(VoxelBuffer &dst, Vector3i src_min, Vector3i src_max, Vector3i dst_min,
+		DownscaleFilter sdf_filter) const {
+	ERR_FAIL_INDEX(sdf_filter, DOWNSCALE_FILTER_COUNT);
+	ERR_FAIL_COND_MSG(sdf_filter == DOWNSCALE_MAJORITY, "Majority filter is not meant for SDF");
+
+	for (int channel_index = 0; channel_index < MAX_CHANNELS; ++channel_index) {
+		if (_channels[channel_index].sparse != nullptr || _channels[channel_index].quantized_sdf != nullptr) {
+			// Filters read dense arrays, so downscale from a copy where compressed channels are decompressed
+			Ref<VoxelBuffer> dense = duplicate(false);
+			for (; channel_index < MAX_CHANNELS; ++channel_index) {
+				const Channel &channel = _channels[channel_index];
+				if (channel.sparse != nullptr || channel.quantized_sdf != nullptr) {
+					dense->decompress_channel(channel_index);
+				}
+			}
+			dense->downscale_to(dst, src_min, src_max, dst_min, sdf_filter);
+			return;
+		}
+	}
+
+	Vector3i::sort_min_max(src_min, src_max);
+	src_min.clamp_to(Vector3i(), _size + Vector3i(1));
+	src_max.clamp_to(Vector3i(), _size + Vector3i(1));
+
+	// Each destination voxel comes from a cell of 2x2x2 source voxels. Incomplete cells are ignored.
+	Vector3i cell_count = (src_max - src_min) >> 1;
+	clip_downscale_region_coord(src_min.x, cell_count.x, dst_min.x, dst._size.x);
+	clip_downscale_region_coord(src_min.y, cell_count.y, dst_min.y, dst._size.y);
+	clip_downscale_region_coord(src_min.z, cell_count.z, dst_min.z, dst._size.z);
+	if (cell_count.x <= 0 || cell_count.y <= 0 || cell_count.z <= 0) {
+		return;
+	}
+	const Vector3i dst_max = dst_min + cell_count;
 
 	for (int channel_index = 0; channel_index < MAX_CHANNELS; ++channel_index) {
 		const Channel &src_channel = _channels[channel_index];
 		const Channel &dst_channel = dst._channels[channel_index];
 
-		if (src_channel.data == nullptr && dst_channel.data == nullptr && src_channel.defval == dst_channel.defval) {
-			// No action needed
+		if (src_channel.data == nullptr) {
+			if (dst_channel.data == nullptr && dst_channel.sparse == nullptr && dst_channel.quantized_sdf == nullptr &&
+					src_channel.defval == dst_channel.defval) {
+				// No action needed
+				continue;
+			}
+			// Any filter gives the same value. Keeps the destination compressed if it can.
+			dst.fill_area(src_channel.defval, dst_min, dst_max, channel_index);
 			continue;
 		}
 
-		// Nearest-neighbor downscaling
-
-		Vector3i pos;
-		for (pos.z = dst_min.z; pos.z < dst_max.z; ++pos.z) {
-			for (pos.x = dst_min.x; pos.x < dst_max.x; ++pos.x) {
-				for (pos.y = dst_min.y; pos.y < dst_max.y; ++pos.y) {
-					const Vector3i src_pos = src_min + ((pos - dst_min) << 1);
-
-					// TODO Remove check once it works
-					CRASH_COND(!is_position_valid(src_pos.x, src_pos.y, src_pos.z));
-
-					uint64_t v;
-					if (src_channel.data) {
-						// TODO Optimized version?
-						v = get_voxel(src_pos, channel_index);
-					} else {
-						v = src_channel.defval;
+		if (src_channel.depth != dst_channel.depth) {
+			// Slow path, values get converted one by one
+			Vector3i pos;
+			for (pos.z = dst_min.z; pos.z < dst_max.z; ++pos.z) {
+				for (pos.x = dst_min.x; pos.x < dst_max.x; ++pos.x) {
+					for (pos.y = dst_min.y; pos.y < dst_max.y; ++pos.y) {
+						const Vector3i src_pos = src_min + ((pos - dst_min) << 1);
+						dst.set_voxel(get_voxel(src_pos, channel_index), pos, channel_index);
 					}
-
-					dst.set_voxel(v, pos, channel_index);
 				}
 			}
+			continue;
+		}
+
+		DownscaleFilter filter;
+		switch (channel_index) {
+			case CHANNEL_SDF:
+				filter = sdf_filter;
+				break;
+			case CHANNEL_TYPE:
+			case CHANNEL_INDICES:
+				// Blending these would produce values that didn't exist
+				filter = DOWNSCALE_MAJORITY;
+				break;
+			default:
+				filter = DOWNSCALE_NEAREST;
+				break;
 		}
+
+		dst.decompress_channel(channel_index);
+
+		downscale_channel(Span<uint8_t>(dst_channel.data, 0, dst_channel.size_in_bytes), dst._size, dst_min, dst_max,
+				Span<const uint8_t>(src_channel.data, 0, src_channel.size_in_bytes), _size, src_min,
+				src_channel.depth, filter, channel_index == CHANNEL_SDF);
 	}
 }
 
@@ -727,6 +1730,38 @@ bool VoxelBuffer::equals(const VoxelBuffer &p_other) const {
 		return false;
 	}
 
+	bool compare_per_voxel = false;
+	for (int channel_index = 0; channel_index < MAX_CHANNELS; ++channel_index) {
+		const Channel &channel = _channels[channel_index];
+		const Channel &other_channel = p_other._channels[channel_index];
+		if (channel.sparse != nullptr || other_channel.sparse != nullptr || channel.quantized_sdf != nullptr ||
+				other_channel.quantized_sdf != nullptr) {
+			compare_per_voxel = true;
+		}
+	}
+
+	if (compare_per_voxel) {
+		// Memory can't be compared directly
+		for (int channel_index = 0; channel_index < MAX_CHANNELS; ++channel_index) {
+			if (_channels[channel_index].depth != p_other._channels[channel_index].depth) {
+				return false;
+			}
+		}
+		Vector3i pos;
+		for (pos.z = 0; pos.z < _size.z; ++pos.z) {
+			for (pos.x = 0; pos.x < _size.x; ++pos.x) {
+				for (pos.y = 0; pos.y < _size.y; ++pos.y) {
+					for (int channel_index = 0; channel_index < MAX_CHANNELS; ++channel_index) {
+						if (get_voxel(pos, channel_index) != p_other.get_voxel(pos, channel_index)) {
+							return false;
+						}
+					}
+				}
+			}
+		}
+		return true;
+	}
+
 	for (int channel_index = 0; channel_index < MAX_CHANNELS; ++channel_index) {
 		const Channel &channel = _channels[channel_index];
 		const Channel &other_channel = p_other._channels[channel_index];
@@ -769,6 +1804,12 @@ void VoxelBuffer::set_channel_depth(unsigned int channel_index, Depth new_depth)
 		// TODO Implement conversion and do it when specified
 		WARN_PRINT("Changing VoxelBuffer depth with present data, this will reset the channel");
 		delete_channel(channel_index);
+	} else if (channel.sparse != nullptr) {
+		WARN_PRINT("Changing VoxelBuffer depth with present data, this will reset the channel");
+		delete_sparse_channel(channel_index);
+	} else if (channel.quantized_sdf != nullptr) {
+		WARN_PRINT("Changing VoxelBuffer depth with present data, this will reset the channel");
+		delete_quantized_sdf_channel(channel_index);
 	}
 	channel.defval = clamp_value_for_depth(channel.defval, new_depth);
 	channel.depth = new_depth;
@@ -802,9 +1843,9 @@ void VoxelBuffer::set_block_metadata(Variant meta) {
 
 Variant VoxelBuffer::get_voxel_metadata(Vector3i pos) const {
 	ERR_FAIL_COND_V(!is_position_valid(pos), Variant());
-	const Map<Vector3i, Variant>::Element *elem = _voxel_metadata.find(pos);
-	if (elem != nullptr) {
-		return elem->value();
+	const Variant *meta = _voxel_metadata.find(pos);
+	if (meta != nullptr) {
+		return *meta;
 	} else {
 		return Variant();
 	}
@@ -815,17 +1856,15 @@ void VoxelBuffer::set_voxel_metadata(Vector3i pos, Variant meta) {
 	if (meta.get_type() == Variant::NIL) {
 		_voxel_metadata.erase(pos);
 	} else {
-		_voxel_metadata[pos] = meta;
+		_voxel_metadata.set(pos, meta);
 	}
 }
 
 void VoxelBuffer::for_each_voxel_metadata(Ref<FuncRef> callback) const {
 	ERR_FAIL_COND(callback.is_null());
-	const Map<Vector3i, Variant>::Element *elem = _voxel_metadata.front();
-
-	while (elem != nullptr) {
-		const Variant key = elem->key().to_vec3();
-		const Variant *args[2] = { &key, &elem->value() };
+	_voxel_metadata.for_each([&callback](Vector3i pos, const Variant &meta) {
+		const Variant key = pos.to_vec3();
+		const Variant *args[2] = { &key, &meta };
 		Variant::CallError err;
 		callback->call_func(args, 2, err);
 
@@ -834,9 +1873,7 @@ void VoxelBuffer::for_each_voxel_metadata(Ref<FuncRef> callback) const {
 		// TODO Can't provide detailed error because FuncRef doesn't give us access to the object
 		// ERR_FAIL_COND_MSG(err.error != Variant::CallError::CALL_OK, false,
 		// 		Variant::get_call_error_text(callback->get_object(), method_name, nullptr, 0, err));
-
-		elem = elem->next();
-	}
+	});
 }
 
 void VoxelBuffer::for_each_voxel_metadata_in_area(Ref<FuncRef> callback, Box3i box) const {
@@ -860,14 +1897,7 @@ void VoxelBuffer::clear_voxel_metadata() {
 }
 
 void VoxelBuffer::clear_voxel_metadata_in_area(Box3i box) {
-	Map<Vector3i, Variant>::Element *elem = _voxel_metadata.front();
-	while (elem != nullptr) {
-		Map<Vector3i, Variant>::Element *next_elem = elem->next();
-		if (box.contains(elem->key())) {
-			_voxel_metadata.erase(elem);
-		}
-		elem = next_elem;
-	}
+	_voxel_metadata.erase_in_area(box);
 }
 
 void VoxelBuffer::copy_voxel_metadata_in_area(Ref<VoxelBuffer> src_buffer, Box3i src_box, Vector3i dst_origin) {
@@ -877,29 +1907,25 @@ void VoxelBuffer::copy_voxel_metadata_in_area(Ref<VoxelBuffer> src_buffer, Box3i
 	const Box3i clipped_src_box = src_box.clipped(Box3i(src_box.pos - dst_origin, _size));
 	const Vector3i clipped_dst_offset = dst_origin + clipped_src_box.pos - src_box.pos;
 
-	const Map<Vector3i, Variant>::Element *elem = src_buffer->_voxel_metadata.front();
+	// Gather items first, because the source can be this buffer, and inserting would invalidate the range being read
+	std::vector<VoxelMetadataMap::Item> items;
+	src_buffer->_voxel_metadata.for_each_in_area(src_box, [this, &items, clipped_dst_offset](Vector3i src_pos, const Variant &meta) {
+		const Vector3i dst_pos = src_pos + clipped_dst_offset;
+		CRASH_COND(!is_position_valid(dst_pos));
+		items.push_back(VoxelMetadataMap::Item{ VoxelMetadataMap::make_key(dst_pos), meta.duplicate() });
+	});
 
-	while (elem != nullptr) {
-		const Vector3i src_pos = elem->key();
-		if (src_box.contains(src_pos)) {
-			const Vector3i dst_pos = src_pos + clipped_dst_offset;
-			CRASH_COND(!is_position_valid(dst_pos));
-			_voxel_metadata[dst_pos] = elem->value().duplicate();
-		}
-		elem = elem->next();
+	for (auto it = items.begin(); it != items.end(); ++it) {
+		_voxel_metadata.set(VoxelMetadataMap::get_position(it->key), it->value);
 	}
 }
 
 void VoxelBuffer::copy_voxel_metadata(const VoxelBuffer &src_buffer) {
 	ERR_FAIL_COND(src_buffer.get_size() != _size);
 
-	const Map<Vector3i, Variant>::Element *elem = src_buffer._voxel_metadata.front();
-
-	while (elem != nullptr) {
-		const Vector3i pos = elem->key();
-		_voxel_metadata[pos] = elem->value().duplicate();
-		elem = elem->next();
-	}
+	src_buffer._voxel_metadata.for_each([this](Vector3i pos, const Variant &meta) {
+		_voxel_metadata.set(pos, meta.duplicate());
+	});
 
 	_block_metadata = src_buffer._block_metadata.duplicate();
 }
@@ -954,13 +1980,27 @@ void VoxelBuffer::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("copy_channel_from", "other", "channel"), &VoxelBuffer::_b_copy_channel_from);
 	ClassDB::bind_method(D_METHOD("copy_channel_from_area", "other", "src_min", "src_max", "dst_min", "channel"),
 			&VoxelBuffer::_b_copy_channel_from_area);
-	ClassDB::bind_method(D_METHOD("downscale_to", "dst", "src_min", "src_max", "dst_min"),
-			&VoxelBuffer::_b_downscale_to);
+	ClassDB::bind_method(D_METHOD("get_channel_as_byte_array", "channel"), &VoxelBuffer::_b_get_channel_as_byte_array);
+	ClassDB::bind_method(D_METHOD("set_channel_from_byte_array", "channel", "data"),
+			&VoxelBuffer::_b_set_channel_from_byte_array);
+	ClassDB::bind_method(D_METHOD("get_channel_area_as_byte_array", "channel", "min_pos", "max_pos"),
+			&VoxelBuffer::_b_get_channel_area_as_byte_array);
+	ClassDB::bind_method(D_METHOD("set_channel_area_from_byte_array", "channel", "data", "min_pos", "max_pos"),
+			&VoxelBuffer::_b_set_channel_area_from_byte_array);
+	ClassDB::bind_method(D_METHOD("get_channel_area_as_real_array", "channel", "min_pos", "max_pos"),
+			&VoxelBuffer::_b_get_channel_area_as_real_array);
+	ClassDB::bind_method(D_METHOD("set_channel_area_from_real_array", "channel", "data", "min_pos", "max_pos"),
+			&VoxelBuffer::_b_set_channel_area_from_real_array);
+	ClassDB::bind_method(D_METHOD("downscale_to", "dst", "src_min", "src_max", "dst_min", "sdf_filter"),
+			&VoxelBuffer::_b_downscale_to, DEFVAL(DOWNSCALE_NEAREST));
 
 	ClassDB::bind_method(D_METHOD("is_uniform", "channel"), &VoxelBuffer::is_uniform);
 	// TODO Rename `compress_uniform_channels`
 	ClassDB::bind_method(D_METHOD("optimize"), &VoxelBuffer::compress_uniform_channels);
 	ClassDB::bind_method(D_METHOD("get_channel_compression", "channel"), &VoxelBuffer::get_channel_compression);
+	ClassDB::bind_method(D_METHOD("compress_sparse_channel", "channel", "sdf_band"),
+			&VoxelBuffer::compress_sparse_channel, DEFVAL(0.0));
+	ClassDB::bind_method(D_METHOD("compress_sdf_to_8_bits"), &VoxelBuffer::compress_sdf_to_8_bits);
 
 	ClassDB::bind_method(D_METHOD("get_block_metadata"), &VoxelBuffer::get_block_metadata);
 	ClassDB::bind_method(D_METHOD("set_block_metadata", "meta"), &VoxelBuffer::set_block_metadata);
@@ -998,8 +2038,16 @@ void VoxelBuffer::_bind_methods() {
 
 	BIND_ENUM_CONSTANT(COMPRESSION_NONE);
 	BIND_ENUM_CONSTANT(COMPRESSION_UNIFORM);
+	BIND_ENUM_CONSTANT(COMPRESSION_SPARSE);
+	BIND_ENUM_CONSTANT(COMPRESSION_SDF_8_BITS);
 	BIND_ENUM_CONSTANT(COMPRESSION_COUNT);
 
+	BIND_ENUM_CONSTANT(DOWNSCALE_NEAREST);
+	BIND_ENUM_CONSTANT(DOWNSCALE_MIN);
+	BIND_ENUM_CONSTANT(DOWNSCALE_AVERAGE);
+	BIND_ENUM_CONSTANT(DOWNSCALE_MAJORITY);
+	BIND_ENUM_CONSTANT(DOWNSCALE_FILTER_COUNT);
+
 	BIND_CONSTANT(MAX_SIZE);
 }
 
@@ -1014,9 +2062,74 @@ void VoxelBuffer::_b_copy_channel_from_area(Ref<VoxelBuffer> other, Vector3 src_
 	copy_from(**other, Vector3i(src_min), Vector3i(src_max), Vector3i(dst_min), channel);
 }
 
-void VoxelBuffer::_b_downscale_to(Ref<VoxelBuffer> dst, Vector3 src_min, Vector3 src_max, Vector3 dst_min) const {
+PoolByteArray VoxelBuffer::_b_get_channel_as_byte_array(unsigned int channel_index) const {
+	return _b_get_channel_area_as_byte_array(channel_index, Vector3(), _size.to_vec3());
+}
+
+void VoxelBuffer::_b_set_channel_from_byte_array(unsigned int channel_index, PoolByteArray data) {
+	_b_set_channel_area_from_byte_array(channel_index, data, Vector3(), _size.to_vec3());
+}
+
+PoolByteArray VoxelBuffer::_b_get_channel_area_as_byte_array(
+		unsigned int channel_index, Vector3 min_pos, Vector3 max_pos) const {
+	ERR_FAIL_INDEX_V(channel_index, MAX_CHANNELS, PoolByteArray());
+	const Box3i box = get_area_box(min_pos, max_pos);
+	ERR_FAIL_COND_V(!Box3i(Vector3i(), _size).contains(box), PoolByteArray());
+	PoolByteArray data;
+	data.resize(box.size.volume() * get_depth_byte_count(_channels[channel_index].depth));
+	{
+		PoolByteArray::Write w = data.write();
+		copy_channel_area_to_raw(channel_index, box, Span<uint8_t>(w.ptr(), data.size()));
+	}
+	return data;
+}
+
+void VoxelBuffer::_b_set_channel_area_from_byte_array(
+		unsigned int channel_index, PoolByteArray data, Vector3 min_pos, Vector3 max_pos) {
+	const Box3i box = get_area_box(min_pos, max_pos);
+	PoolByteArray::Read r = data.read();
+	copy_channel_area_from_raw(channel_index, box, Span<const uint8_t>(r.ptr(), data.size()));
+}
+
+PoolRealArray VoxelBuffer::_b_get_channel_area_as_real_array(
+		unsigned int channel_index, Vector3 min_pos, Vector3 max_pos) const {
+	ERR_FAIL_INDEX_V(channel_index, MAX_CHANNELS, PoolRealArray());
+	const Box3i box = get_area_box(min_pos, max_pos);
+	ERR_FAIL_COND_V(!Box3i(Vector3i(), _size).contains(box), PoolRealArray());
+	const Depth depth = _channels[channel_index].depth;
+	std::vector<uint8_t> raw;
+	raw.resize(box.size.volume() * get_depth_byte_count(depth));
+	copy_channel_area_to_raw(channel_index, box, Span<uint8_t>(raw.data(), raw.size()));
+
+	PoolRealArray data;
+	data.resize(box.size.volume());
+	{
+		PoolRealArray::Write w = data.write();
+		convert_raw_to_real(Span<const uint8_t>(raw.data(), raw.size()), Span<real_t>(w.ptr(), data.size()), depth);
+	}
+	return data;
+}
+
+void VoxelBuffer::_b_set_channel_area_from_real_array(
+		unsigned int channel_index, PoolRealArray data, Vector3 min_pos, Vector3 max_pos) {
+	ERR_FAIL_INDEX(channel_index, MAX_CHANNELS);
+	const Box3i box = get_area_box(min_pos, max_pos);
+	ERR_FAIL_COND(!Box3i(Vector3i(), _size).contains(box));
+	ERR_FAIL_COND(data.size() != box.size.volume());
+	const Depth depth = _channels[channel_index].depth;
+	std::vector<uint8_t> raw;
+	raw.resize(box.size.volume() * get_depth_byte_count(depth));
+	{
+		PoolRealArray::Read r = data.read();
+		convert_real_to_raw(Span<const real_t>(r.ptr(), data.size()), Span<uint8_t>(raw.data(), raw.size()), depth);
+	}
+	copy_channel_area_from_raw(channel_index, box, Span<const uint8_t>(raw.data(), raw.size()));
+}
+
+void VoxelBuffer::_b_downscale_to(
+		Ref<VoxelBuffer> dst, Vector3 src_min, Vector3 src_max, Vector3 dst_min, DownscaleFilter sdf_filter) const {
 	ERR_FAIL_COND(dst.is_null());
-	downscale_to(**dst, Vector3i(src_min), Vector3i(src_max), Vector3i(dst_min));
+	downscale_to(**dst, Vector3i(src_min), Vector3i(src_max), Vector3i(dst_min), sdf_filter);
 }
 
 void VoxelBuffer::_b_for_each_voxel_metadata_in_area(Ref<FuncRef> callback, Vector3 min_pos, Vector3 max_pos) {
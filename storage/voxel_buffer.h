@@ -6,8 +6,10 @@
 #include "../util/math/box3i.h"
 #include "../util/span.h"
 #include "funcs.h"
+#include "voxel_metadata_map.h"
+#include "voxel_quantized_sdf_channel.h"
+#include "voxel_sparse_channel.h"
 
-#include <core/map.h>
 #include <core/reference.h>
 #include <core/vector.h>
 
@@ -43,6 +45,10 @@ public:
 	enum Compression {
 		COMPRESSION_NONE = 0,
 		COMPRESSION_UNIFORM,
+		// Only bricks with varying values are stored, see `VoxelSparseChannel`
+		COMPRESSION_SPARSE,
+		// SDF values are stored in 8 bits with a range fitted to the buffer, see `VoxelQuantizedSdfChannel`
+		COMPRESSION_SDF_8_BITS,
 		//COMPRESSION_RLE,
 		COMPRESSION_COUNT
 	};
@@ -55,6 +61,19 @@ public:
 		DEPTH_COUNT
 	};
 
+	// How 2x2x2 voxels are combined into one when downscaling
+	enum DownscaleFilter {
+		// Takes the voxel at the lower corner
+		DOWNSCALE_NEAREST = 0,
+		// Takes the lowest value. With SDF, this preserves thin features.
+		DOWNSCALE_MIN,
+		// Takes the average value. Smoothes SDF.
+		DOWNSCALE_AVERAGE,
+		// Takes the most frequent value. Used for types and indices, which can't be blended.
+		DOWNSCALE_MAJORITY,
+		DOWNSCALE_FILTER_COUNT
+	};
+
 	static inline uint32_t get_depth_byte_count(VoxelBuffer::Depth d) {
 		CRASH_COND(d < 0 || d >= VoxelBuffer::DEPTH_COUNT);
 		return 1 << d;
@@ -85,8 +104,18 @@ public:
 	struct Channel {
 		// Allocated when the channel is populated.
 		// Flat array, in order [z][x][y] because it allows faster vertical-wise access (the engine is Y-up).
+		// This memory is reference-counted and can be shared with copies of the buffer (copy-on-write).
+		// It must not be modified directly without calling `decompress_channel` first.
 		uint8_t *data = nullptr;
 
+		// Allocated instead of `data` when the channel is stored as bricks.
+		// Sparse channels are decompressed when written to.
+		VoxelSparseChannel *sparse = nullptr;
+
+		// Allocated instead of `data` when SDF is quantized to 8 bits.
+		// Quantized channels are decompressed when written to.
+		VoxelQuantizedSdfChannel *quantized_sdf = nullptr;
+
 		// Default value when data is null
 		uint64_t defval = 0;
 
@@ -131,9 +160,28 @@ public:
 	bool is_uniform(unsigned int channel_index) const;
 
 	void compress_uniform_channels();
+	// Makes sure the channel has its own writable memory. Must be called before writing into raw channel data.
 	void decompress_channel(unsigned int channel_index);
 	Compression get_channel_compression(unsigned int channel_index) const;
 
+	// Stores the channel as bricks, if enough of them have no variations to save memory.
+	// If the channel is SDF and `sdf_band` is greater than zero, bricks where all voxels are further than that
+	// distance from the surface (in voxels) are stored as uniform, with values clamped to the band.
+	void compress_sparse_channel(unsigned int channel_index, float sdf_band = 0.f);
+	// Returns null if the channel is not sparse
+	const VoxelSparseChannel *get_channel_sparse(unsigned int channel_index) const;
+	// Replaces the channel with sparse storage, taking ownership of its contents
+	void set_channel_sparse(unsigned int channel_index, VoxelSparseChannel &&sparse);
+
+	// Stores the SDF channel in 8 bits, with a scale and offset fitted to the range of its values.
+	// Distances are clamped to the range 8-bit SDF can represent, so precision is never worse than with it.
+	// The channel keeps its depth: values are decoded transparently when read.
+	void compress_sdf_to_8_bits();
+	// Returns null if the channel is not quantized
+	const VoxelQuantizedSdfChannel *get_channel_quantized_sdf() const;
+	// Replaces the SDF channel with quantized storage, taking ownership of its contents
+	void set_channel_quantized_sdf(VoxelQuantizedSdfChannel &&quantized);
+
 	static uint32_t get_size_in_bytes_for_volume(Vector3i size, Depth depth);
 
 	void copy_format(const VoxelBuffer &other);
@@ -141,6 +189,7 @@ public:
 	// Specialized copy functions.
 	// Note: these functions don't include metadata on purpose.
 	// If you also want to copy metadata, use the specialized functions.
+	// Copying whole channels doesn't copy memory: it is shared until one of the buffers gets modified.
 	void copy_from(const VoxelBuffer &other);
 	void copy_from(const VoxelBuffer &other, unsigned int channel_index);
 	void copy_from(const VoxelBuffer &other, Vector3i src_min, Vector3i src_max, Vector3i dst_min,
@@ -170,6 +219,13 @@ public:
 		copy_3d_region_zxy<T>(dst, _size, dst_min, src, src_size, src_min, src_max);
 	}
 
+	// Copies a box of a channel into an array of raw values in ZXY order, using the depth of the channel.
+	// The box must be inside the buffer, and `dst` must hold exactly its volume.
+	void copy_channel_area_to_raw(unsigned int channel_index, Box3i box, Span<uint8_t> dst) const;
+	// Copies an array of raw values in ZXY order into a box of a channel, using the depth of the channel.
+	// The box must be inside the buffer, and `src` must hold exactly its volume.
+	void copy_channel_area_from_raw(unsigned int channel_index, Box3i box, Span<const uint8_t> src);
+
 	// Copy a region of the data into a dense buffer.
 	// If the source is compressed, it is decompressed.
 	// `dst` is a raw array storing grid values in a box.
@@ -187,8 +243,36 @@ public:
 		ERR_FAIL_COND(channel.depth != get_depth_from_size(sizeof(T)));
 #endif
 
-		if (channel.data == nullptr) {
+		if (channel.sparse != nullptr) {
+			// Bricks are not stored in rows, read voxels one by one
+			Vector3i::sort_min_max(src_min, src_max);
+			clip_copy_region(src_min, src_max, _size, dst_min, dst_size);
+			const Box3i src_box(src_min, src_max - src_min);
+			if (src_box.size.x <= 0 || src_box.size.y <= 0 || src_box.size.z <= 0) {
+				return;
+			}
+			const VoxelSparseChannel &sparse = *channel.sparse;
+			const Vector3i offset = dst_min - src_min;
+			src_box.for_each_cell_zxy([&dst, &sparse, dst_size, offset](Vector3i pos) {
+				dst[(pos + offset).get_zxy_index(dst_size)] = sparse.get(pos);
+			});
+
+		} else if (channel.quantized_sdf != nullptr) {
+			// Codes have to be converted to the depth of the channel
+			Vector3i::sort_min_max(src_min, src_max);
+			clip_copy_region(src_min, src_max, _size, dst_min, dst_size);
+			const Box3i src_box(src_min, src_max - src_min);
+			if (src_box.size.x <= 0 || src_box.size.y <= 0 || src_box.size.z <= 0) {
+				return;
+			}
+			const Vector3i offset = dst_min - src_min;
+			src_box.for_each_cell_zxy([this, &dst, dst_size, offset, channel_index](Vector3i pos) {
+				dst[(pos + offset).get_zxy_index(dst_size)] = get_voxel(pos, channel_index);
+			});
+
+		} else if (channel.data == nullptr) {
 			fill_3d_region_zxy<T>(dst, dst_size, dst_min, dst_min + (src_max - src_min), channel.defval);
+
 		} else {
 			Span<const T> src(static_cast<const T *>(channel.data), channel.size_in_bytes / sizeof(T));
 			copy_3d_region_zxy<T>(dst, dst_size, dst_min, src, _size, src_min, src_max);
@@ -230,8 +314,16 @@ public:
 		return y + _size.y * (x + _size.x * z); // ZXY index
 	}
 
+	// Copies a whole channel into an array of raw values in Morton order (Z-order curve), using the depth of the
+	// channel. Neighbors on all axes tend to be close in memory, which suits code reading 3D neighborhoods around
+	// each voxel, like gradients. Requires a cubic, power-of-two size. Channels themselves stay in ZXY order.
+	void copy_channel_to_morton(unsigned int channel_index, Span<uint8_t> dst) const;
+	// Inverse of `copy_channel_to_morton`
+	void copy_channel_from_morton(unsigned int channel_index, Span<const uint8_t> src);
+	static bool is_morton_size_supported(Vector3i size);
+
 	template <typename F>
-	inline void for_each_index_and_pos(const Box3i &box, F f) {
+	inline void for_each_index_and_pos(const Box3i &box, F f) const {
 		const Vector3i min_pos = box.pos;
 		const Vector3i max_pos = box.pos + box.size;
 		Vector3i pos;
@@ -359,6 +451,8 @@ public:
 		return channels;
 	}
 
+	// Channels of the copy share memory with this buffer until either of them is modified, so this is cheap.
+	// It can be used to take snapshots of a buffer, so threaded tasks can read them without locking.
 	Ref<VoxelBuffer> duplicate(bool include_metadata) const;
 
 	_FORCE_INLINE_ bool is_position_valid(unsigned int x, unsigned int y, unsigned int z) const {
@@ -378,9 +472,13 @@ public:
 	}
 
 	// TODO Have a template version based on channel depth
+	// Returns false if the channel has no dense data (uniform or sparse).
 	bool get_channel_raw(unsigned int channel_index, Span<uint8_t> &slice) const;
 
-	void downscale_to(VoxelBuffer &dst, Vector3i src_min, Vector3i src_max, Vector3i dst_min) const;
+	// Downscales a region of this buffer into `dst`, at half resolution.
+	// `sdf_filter` applies to the SDF channel. Types and indices use majority, other channels use nearest.
+	void downscale_to(VoxelBuffer &dst, Vector3i src_min, Vector3i src_max, Vector3i dst_min,
+			DownscaleFilter sdf_filter = DOWNSCALE_NEAREST) const;
 	Ref<VoxelTool> get_voxel_tool();
 
 	bool equals(const VoxelBuffer &p_other) const;
@@ -405,13 +503,7 @@ public:
 
 	template <typename F>
 	void for_each_voxel_metadata_in_area(Box3i box, F callback) const {
-		const Map<Vector3i, Variant>::Element *elem = _voxel_metadata.front();
-		while (elem != nullptr) {
-			if (box.contains(elem->key())) {
-				callback(elem->key(), elem->value());
-			}
-			elem = elem->next();
-		}
+		_voxel_metadata.for_each_in_area(box, callback);
 	}
 
 	void for_each_voxel_metadata(Ref<FuncRef> callback) const;
@@ -423,7 +515,7 @@ public:
 	void copy_voxel_metadata_in_area(Ref<VoxelBuffer> src_buffer, Box3i src_box, Vector3i dst_origin);
 	void copy_voxel_metadata(const VoxelBuffer &src_buffer);
 
-	const Map<Vector3i, Variant> &get_voxel_metadata() const { return _voxel_metadata; }
+	const VoxelMetadataMap &get_voxel_metadata() const { return _voxel_metadata; }
 
 	// Internal synchronization.
 	// This lock is optional, and used internally at the moment, only in multithreaded areas.
@@ -438,6 +530,11 @@ private:
 	void create_channel_noinit(int i, Vector3i size);
 	void create_channel(int i, Vector3i size, uint64_t defval);
 	void delete_channel(int i);
+	void make_channel_unique(int i);
+	void delete_sparse_channel(int i);
+	void decompress_sparse_channel(int i);
+	void delete_quantized_sdf_channel(int i);
+	void decompress_quantized_sdf_channel(int i);
 
 	static void _bind_methods();
 
@@ -452,10 +549,19 @@ private:
 	void _b_set_voxel(uint64_t value, int x, int y, int z, unsigned int channel) { set_voxel(value, x, y, z, channel); }
 	void _b_copy_channel_from(Ref<VoxelBuffer> other, unsigned int channel);
 	void _b_copy_channel_from_area(Ref<VoxelBuffer> other, Vector3 src_min, Vector3 src_max, Vector3 dst_min, unsigned int channel);
+	PoolByteArray _b_get_channel_as_byte_array(unsigned int channel_index) const;
+	void _b_set_channel_from_byte_array(unsigned int channel_index, PoolByteArray data);
+	PoolByteArray _b_get_channel_area_as_byte_array(unsigned int channel_index, Vector3 min_pos, Vector3 max_pos) const;
+	void _b_set_channel_area_from_byte_array(
+			unsigned int channel_index, PoolByteArray data, Vector3 min_pos, Vector3 max_pos);
+	PoolRealArray _b_get_channel_area_as_real_array(unsigned int channel_index, Vector3 min_pos, Vector3 max_pos) const;
+	void _b_set_channel_area_from_real_array(
+			unsigned int channel_index, PoolRealArray data, Vector3 min_pos, Vector3 max_pos);
 	void _b_fill_area(uint64_t defval, Vector3 min, Vector3 max, unsigned int channel_index) { fill_area(defval, Vector3i(min), Vector3i(max), channel_index); }
 	void _b_set_voxel_f(real_t value, int x, int y, int z, unsigned int channel) { set_voxel_f(value, x, y, z, channel); }
 	void _b_set_voxel_v(uint64_t value, Vector3 pos, unsigned int channel_index = 0) { set_voxel(value, pos.x, pos.y, pos.z, channel_index); }
-	void _b_downscale_to(Ref<VoxelBuffer> dst, Vector3 src_min, Vector3 src_max, Vector3 dst_min) const;
+	void _b_downscale_to(
+			Ref<VoxelBuffer> dst, Vector3 src_min, Vector3 src_max, Vector3 dst_min, DownscaleFilter sdf_filter) const;
 	Variant _b_get_voxel_metadata(Vector3 pos) const { return get_voxel_metadata(Vector3i(pos)); }
 	void _b_set_voxel_metadata(Vector3 pos, Variant meta) { set_voxel_metadata(Vector3i(pos), meta); }
 	void _b_for_each_voxel_metadata_in_area(Ref<FuncRef> callback, Vector3 min_pos, Vector3 max_pos);
@@ -473,7 +579,7 @@ private:
 	Vector3i _size;
 
 	Variant _block_metadata;
-	Map<Vector3i, Variant> _voxel_metadata;
+	VoxelMetadataMap _voxel_metadata;
 
 	// TODO It may be preferable to actually move away from storing an RWLock in every buffer in the future.
 	// We should be able to find a solution because very few of these locks are actually used at a given time.
@@ -496,5 +602,6 @@ inline void debug_check_texture_indices_packed_u16(const VoxelBuffer &voxels) {
 VARIANT_ENUM_CAST(VoxelBuffer::ChannelId)
 VARIANT_ENUM_CAST(VoxelBuffer::Depth)
 VARIANT_ENUM_CAST(VoxelBuffer::Compression)
+VARIANT_ENUM_CAST(VoxelBuffer::DownscaleFilter)
 
 #endif // VOXEL_BUFFER_H
@@ -27,25 +27,94 @@ public:
 		}
 #endif
 		_modified = modified;
+		if (modified) {
+			_edited = true;
+		}
 	}
 
 	inline bool is_modified() const { return _modified; }
 
+	// Unlike `is_modified()`, this stays true after the block is saved
+	inline bool was_edited() const { return _edited; }
+
 	void set_needs_lodding(bool need_lodding) {
 		_needs_lodding = need_lodding;
 	}
 
 	inline bool get_needs_lodding() const { return _needs_lodding; }
 
+	// Marks regions of the block intersecting a box as changed since the last LOD update.
+	// The box is in voxels, relative to the block.
+	void mark_dirty_box(Box3i box) {
+		box.clip(Box3i(Vector3i(), voxels->get_size()));
+		if (box.is_empty()) {
+			return;
+		}
+		const Box3i cells = box.downscaled(get_dirty_cell_size());
+		cells.for_each_cell_zxy([this](Vector3i cell_pos) {
+			_dirty_cells |= uint64_t(1) << cell_pos.get_zxy_index(Vector3i(DIRTY_GRID_SIZE));
+		});
+	}
+
+	inline void mark_dirty() {
+		_dirty_cells = ~uint64_t(0);
+	}
+
+	inline void clear_dirty() {
+		_dirty_cells = 0;
+	}
+
+	inline bool is_dirty() const {
+		return _dirty_cells != 0;
+	}
+
+	// Gets the smallest box enclosing dirty regions, in voxels relative to the block.
+	// Its coordinates are multiples of the region size.
+	Box3i get_dirty_box() const {
+		if (_dirty_cells == 0) {
+			return Box3i();
+		}
+		Vector3i min_pos(DIRTY_GRID_SIZE);
+		Vector3i max_pos;
+		Vector3i cell_pos;
+		unsigned int i = 0;
+		for (cell_pos.z = 0; cell_pos.z < DIRTY_GRID_SIZE; ++cell_pos.z) {
+			for (cell_pos.x = 0; cell_pos.x < DIRTY_GRID_SIZE; ++cell_pos.x) {
+				for (cell_pos.y = 0; cell_pos.y < DIRTY_GRID_SIZE; ++cell_pos.y) {
+					if ((_dirty_cells & (uint64_t(1) << i)) != 0) {
+						min_pos = Vector3i::min(min_pos, cell_pos);
+						max_pos = Vector3i::max(max_pos, cell_pos + Vector3i(1));
+					}
+					++i;
+				}
+			}
+		}
+		const int cell_size = get_dirty_cell_size();
+		return Box3i::from_min_max(min_pos * cell_size, max_pos * cell_size);
+	}
+
 private:
 	VoxelDataBlock(Vector3i bpos, Ref<VoxelBuffer> buffer, unsigned int p_lod_index) :
 			voxels(buffer), position(bpos), lod_index(p_lod_index) {}
 
+	// Edits are tracked in a 4x4x4 grid of regions, one bit each in ZXY order
+	static const int DIRTY_GRID_SIZE = 4;
+
+	inline int get_dirty_cell_size() const {
+		return max(voxels->get_size().x / DIRTY_GRID_SIZE, 1);
+	}
+
 	// The block was edited, which requires its LOD counterparts to be recomputed
 	bool _needs_lodding = false;
 
+	// Regions of the block edited since the last LOD update
+	uint64_t _dirty_cells = 0;
+
 	// Indicates if this block is different from the time it was loaded (should be saved)
 	bool _modified = false;
+
+	// Indicates if this block was modified at any point since it was loaded
+	bool _edited = false;
 };
 
 #endif // VOXEL_DATA_BLOCK_H
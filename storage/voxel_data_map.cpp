@@ -201,6 +201,23 @@ bool VoxelDataMap::is_block_surrounded(Vector3i pos) const {
 	return true;
 }
 
+void VoxelDataMap::get_blocks_in_box_zxy(const Box3i &block_box, Span<VoxelDataBlock *> out_blocks) {
+	ERR_FAIL_COND(block_box.size.volume() > static_cast<int>(out_blocks.size()));
+	const Vector3i max = block_box.pos + block_box.size;
+	unsigned int i = 0;
+	Vector3i bpos;
+	for (bpos.z = block_box.pos.z; bpos.z < max.z; ++bpos.z) {
+		for (bpos.x = block_box.pos.x; bpos.x < max.x; ++bpos.x) {
+			for (bpos.y = block_box.pos.y; bpos.y < max.y; ++bpos.y) {
+				// Not going through `get_block`, the last accessed block is unlikely to match in a neighborhood
+				const unsigned int *iptr = _blocks_map.getptr(bpos);
+				out_blocks[i] = iptr != nullptr ? _blocks[*iptr] : nullptr;
+				++i;
+			}
+		}
+	}
+}
+
 void VoxelDataMap::copy(Vector3i min_pos, VoxelBuffer &dst_buffer, unsigned int channels_mask) {
 	const Vector3i max_pos = min_pos + dst_buffer.get_size();
 
@@ -2,9 +2,9 @@
 #define VOXEL_DATA_MAP_H
 
 #include "../util/fixed_array.h"
+#include "../util/vector3i_index_map.h"
 #include "voxel_data_block.h"
 
-#include <core/hash_map.h>
 #include <scene/main/node.h>
 
 // Infinite voxel storage by means of octants like Gridmap, within a constant LOD.
@@ -93,6 +93,10 @@ public:
 	bool has_block(Vector3i pos) const;
 	bool is_block_surrounded(Vector3i pos) const;
 
+	// Gets all blocks within a box of block positions, in ZXY order. Missing blocks are null.
+	// This is the order used by meshing requests.
+	void get_blocks_in_box_zxy(const Box3i &block_box, Span<VoxelDataBlock *> out_blocks);
+
 	void clear();
 
 	int get_block_count() const;
@@ -160,9 +164,9 @@ private:
 	// Voxel values that will be returned if access is out of map bounds
 	FixedArray<uint64_t, VoxelBuffer::MAX_CHANNELS> _default_voxel;
 
-	// Blocks stored with a spatial hash in all 3D directions.
-	// RELATIONSHIP = 2 because it delivers better performance with this kind of key and hash (less collisions).
-	HashMap<Vector3i, unsigned int, Vector3iHasher, HashMapComparatorDefault<Vector3i>, 3, 2> _blocks_map;
+	// Indexes of blocks stored with a spatial hash in all 3D directions.
+	// Uses a flat table, because neighbor lookups are very frequent.
+	Vector3iIndexMap _blocks_map;
 	std::vector<VoxelDataBlock *> _blocks;
 
 	// Voxel access will most frequently be in contiguous areas, so the same blocks are accessed.
@@ -0,0 +1,143 @@
+#ifndef VOXEL_METADATA_MAP_H
+#define VOXEL_METADATA_MAP_H
+
+#include "../util/math/box3i.h"
+
+#include <core/variant.h>
+#include <algorithm>
+#include <vector>
+
+// Associates Variant metadata to voxel positions.
+// Items are kept in a flat array sorted by position in ZXY order, so lookups are binary searches, iterating
+// is linear in memory and positions within a box are found in a contiguous range of the array.
+// Positions must be in [0..65535].
+class VoxelMetadataMap {
+public:
+	struct Item {
+		uint64_t key;
+		Variant value;
+	};
+
+	// Packs a position into a key whose ordering is ZXY
+	static inline uint64_t make_key(const Vector3i &pos) {
+		return (static_cast<uint64_t>(pos.z) << 32) | (static_cast<uint64_t>(pos.x) << 16) |
+			   static_cast<uint64_t>(pos.y);
+	}
+
+	static inline Vector3i get_position(uint64_t key) {
+		return Vector3i((key >> 16) & 0xffff, key & 0xffff, (key >> 32) & 0xffff);
+	}
+
+	inline Variant *find(const Vector3i &pos) {
+		const uint64_t key = make_key(pos);
+		auto it = lower_bound(key);
+		if (it != _items.end() && it->key == key) {
+			return &it->value;
+		}
+		return nullptr;
+	}
+
+	inline const Variant *find(const Vector3i &pos) const {
+		return const_cast<VoxelMetadataMap *>(this)->find(pos);
+	}
+
+	void set(const Vector3i &pos, const Variant &value) {
+		const uint64_t key = make_key(pos);
+		// Fast path when items are added in order, like when loading
+		if (_items.size() == 0 || _items.back().key < key) {
+			_items.push_back(Item{ key, value });
+			return;
+		}
+		auto it = lower_bound(key);
+		if (it != _items.end() && it->key == key) {
+			it->value = value;
+		} else {
+			_items.insert(it, Item{ key, value });
+		}
+	}
+
+	bool erase(const Vector3i &pos) {
+		const uint64_t key = make_key(pos);
+		auto it = lower_bound(key);
+		if (it != _items.end() && it->key == key) {
+			_items.erase(it);
+			return true;
+		}
+		return false;
+	}
+
+	// Removes all items within the box, in a single pass over the range it covers
+	void erase_in_area(Box3i box) {
+		box.clip(get_key_limits());
+		if (box.is_empty()) {
+			return;
+		}
+		auto begin = lower_bound(make_key(box.pos));
+		auto end = upper_bound(make_key(box.pos + box.size - Vector3i(1)));
+		auto new_end = std::remove_if(begin, end, [&box](const Item &item) {
+			return box.contains(get_position(item.key));
+		});
+		_items.erase(new_end, end);
+	}
+
+	void clear() {
+		_items.clear();
+	}
+
+	inline size_t size() const {
+		return _items.size();
+	}
+
+	// void f(Vector3i pos, const Variant &value)
+	template <typename F>
+	inline void for_each(F f) const {
+		for (auto it = _items.begin(); it != _items.end(); ++it) {
+			f(get_position(it->key), it->value);
+		}
+	}
+
+	// void f(Vector3i pos, const Variant &value)
+	template <typename F>
+	inline void for_each_in_area(const Box3i &box, F f) const {
+		const_cast<VoxelMetadataMap *>(this)->for_each_in_area(
+				box, [&f](Vector3i pos, Variant &value) { f(pos, static_cast<const Variant &>(value)); });
+	}
+
+	// void f(Vector3i pos, Variant &value)
+	// Only visits the range of items between the first and last positions of the box, instead of all of them.
+	template <typename F>
+	void for_each_in_area(Box3i box, F f) {
+		box.clip(get_key_limits());
+		if (box.is_empty()) {
+			return;
+		}
+		auto begin = lower_bound(make_key(box.pos));
+		auto end = upper_bound(make_key(box.pos + box.size - Vector3i(1)));
+		for (auto it = begin; it != end; ++it) {
+			const Vector3i pos = get_position(it->key);
+			if (box.contains(pos)) {
+				f(pos, it->value);
+			}
+		}
+	}
+
+private:
+	// Area queries compute keys from box corners, so they must be within representable positions
+	static inline Box3i get_key_limits() {
+		return Box3i(Vector3i(), Vector3i(0x10000));
+	}
+
+	inline std::vector<Item>::iterator lower_bound(uint64_t key) {
+		return std::lower_bound(_items.begin(), _items.end(), key,
+				[](const Item &item, uint64_t k) { return item.key < k; });
+	}
+
+	inline std::vector<Item>::iterator upper_bound(uint64_t key) {
+		return std::upper_bound(_items.begin(), _items.end(), key,
+				[](uint64_t k, const Item &item) { return k < item.key; });
+	}
+
+	std::vector<Item> _items;
+};
+
+#endif // VOXEL_METADATA_MAP_H
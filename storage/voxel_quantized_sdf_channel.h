@@ -0,0 +1,40 @@
+#ifndef VOXEL_QUANTIZED_SDF_CHANNEL_H
+#define VOXEL_QUANTIZED_SDF_CHANNEL_H
+
+#include "../util/math/vector3i.h"
+#include <vector>
+
+// Channel storage where SDF values are quantized to 8 bits, using a range fitted to the values of the buffer.
+// Each code decodes to `offset + scale * code`, in the normalized units of the channel's actual depth.
+// Blocks crossing a surface usually span a small range of distances, so their precision is much better than
+// with the fixed scale of 8-bit SDF channels.
+struct VoxelQuantizedSdfChannel {
+	static const unsigned int MAX_CODE = 0xff;
+
+	float offset = 0.f;
+	float scale = 0.f;
+	// Codes of voxels in ZXY order
+	std::vector<uint8_t> codes;
+
+	inline float decode(uint8_t code) const {
+		return offset + scale * static_cast<float>(code);
+	}
+
+	inline uint8_t encode(float value) const {
+		if (scale <= 0.f) {
+			return 0;
+		}
+		const int code = static_cast<int>((value - offset) / scale + 0.5f);
+		return code < 0 ? 0 : (code > static_cast<int>(MAX_CODE) ? MAX_CODE : code);
+	}
+
+	inline float get(const Vector3i &voxel_pos, const Vector3i &size) const {
+		return decode(codes[voxel_pos.get_zxy_index(size)]);
+	}
+
+	size_t get_memory_usage() const {
+		return codes.size() + sizeof(VoxelQuantizedSdfChannel);
+	}
+};
+
+#endif // VOXEL_QUANTIZED_SDF_CHANNEL_H
@@ -0,0 +1,104 @@
+#ifndef VOXEL_SPARSE_CHANNEL_H
+#define VOXEL_SPARSE_CHANNEL_H
+
+#include "../util/math/vector3i.h"
+#include <core/error_macros.h>
+#include <string.h>
+#include <vector>
+
+// Channel storage where voxels are grouped in cubic bricks, and only bricks containing different values are
+// allocated. Other bricks store a single value.
+// Mostly useful for SDF, where only voxels close to the surface carry information.
+struct VoxelSparseChannel {
+	static const unsigned int BRICK_SIZE_PO2 = 3;
+	static const unsigned int BRICK_SIZE = 1 << BRICK_SIZE_PO2;
+	static const unsigned int BRICK_SIZE_MASK = BRICK_SIZE - 1;
+	static const unsigned int BRICK_VOLUME = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+	static const uint32_t UNIFORM_BRICK = 0xffffffff;
+
+	// Number of bricks along each axis. Bricks on the positive edges may be partially outside of the buffer.
+	Vector3i brick_counts;
+	// Size of one voxel value in bytes
+	unsigned int item_size = 0;
+	// For each brick in ZXY order, index of its voxels in `dense_bricks`, or `UNIFORM_BRICK`
+	std::vector<uint32_t> brick_indices;
+	// For each brick in ZXY order, value of the brick if it is uniform
+	std::vector<uint64_t> uniform_values;
+	// Voxels of non-uniform bricks, each of them in ZXY order
+	std::vector<uint8_t> dense_bricks;
+
+	void create(Vector3i voxel_size, unsigned int p_item_size) {
+		brick_counts = (voxel_size + Vector3i(BRICK_SIZE_MASK)) >> BRICK_SIZE_PO2;
+		item_size = p_item_size;
+		const unsigned int brick_count = brick_counts.volume();
+		brick_indices.clear();
+		brick_indices.resize(brick_count, UNIFORM_BRICK);
+		uniform_values.clear();
+		uniform_values.resize(brick_count, 0);
+		dense_bricks.clear();
+	}
+
+	static inline unsigned int get_index_in_brick(const Vector3i &voxel_pos) {
+		return (voxel_pos.y & BRICK_SIZE_MASK) +
+			   BRICK_SIZE * ((voxel_pos.x & BRICK_SIZE_MASK) + BRICK_SIZE * (voxel_pos.z & BRICK_SIZE_MASK));
+	}
+
+	inline unsigned int get_brick_index(const Vector3i &voxel_pos) const {
+		return (voxel_pos >> BRICK_SIZE_PO2).get_zxy_index(brick_counts);
+	}
+
+	inline unsigned int get_brick_size_in_bytes() const {
+		return BRICK_VOLUME * item_size;
+	}
+
+	inline unsigned int get_dense_brick_count() const {
+		return dense_bricks.size() / get_brick_size_in_bytes();
+	}
+
+	// Appends a new dense brick and returns its voxels
+	uint8_t *add_dense_brick(unsigned int brick_index) {
+		CRASH_COND(brick_indices[brick_index] != UNIFORM_BRICK);
+		const unsigned int dense_index = get_dense_brick_count();
+		brick_indices[brick_index] = dense_index;
+		dense_bricks.resize(dense_bricks.size() + get_brick_size_in_bytes());
+		return get_dense_brick(dense_index);
+	}
+
+	inline uint8_t *get_dense_brick(unsigned int dense_index) {
+		return dense_bricks.data() + dense_index * get_brick_size_in_bytes();
+	}
+
+	inline const uint8_t *get_dense_brick(unsigned int dense_index) const {
+		return dense_bricks.data() + dense_index * get_brick_size_in_bytes();
+	}
+
+	inline uint64_t get(const Vector3i &voxel_pos) const {
+		const unsigned int brick_index = get_brick_index(voxel_pos);
+		const uint32_t dense_index = brick_indices[brick_index];
+		if (dense_index == UNIFORM_BRICK) {
+			return uniform_values[brick_index];
+		}
+		const uint8_t *brick = get_dense_brick(dense_index);
+		const unsigned int i = get_index_in_brick(voxel_pos);
+		switch (item_size) {
+			case 1:
+				return brick[i];
+			case 2:
+				return reinterpret_cast<const uint16_t *>(brick)[i];
+			case 4:
+				return reinterpret_cast<const uint32_t *>(brick)[i];
+			case 8:
+				return reinterpret_cast<const uint64_t *>(brick)[i];
+			default:
+				CRASH_NOW();
+				return 0;
+		}
+	}
+
+	size_t get_memory_usage() const {
+		return dense_bricks.size() + brick_indices.size() * sizeof(uint32_t) +
+			   uniform_values.size() * sizeof(uint64_t) + sizeof(VoxelSparseChannel);
+	}
+};
+
+#endif // VOXEL_SPARSE_CHANNEL_H
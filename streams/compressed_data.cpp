@@ -56,7 +56,7 @@ bool decompress(Span<const uint8_t> src, std::vector<uint8_t> &dst) {
 	return true;
 }
 
-bool compress(Span<const uint8_t> src, std::vector<uint8_t> &dst, Compression comp) {
+bool compress(Span<const uint8_t> src, std::vector<uint8_t> &dst, Compression comp, int lz4_acceleration) {
 	VOXEL_PROFILE_SCOPE();
 
 	switch (comp) {
@@ -79,11 +79,12 @@ bool compress(Span<const uint8_t> src, std::vector<uint8_t> &dst, Compression co
 			const uint32_t header_size = sizeof(uint8_t) + sizeof(uint32_t);
 			dst.resize(header_size + LZ4_compressBound(src.size()));
 
-			const uint32_t compressed_size = LZ4_compress_default(
+			const uint32_t compressed_size = LZ4_compress_fast(
 					(const char *)src.data(),
 					(char *)dst.data() + header_size,
 					src.size(),
-					dst.size() - header_size);
+					dst.size() - header_size,
+					lz4_acceleration);
 
 			ERR_FAIL_COND_V(compressed_size < 0, false);
 			ERR_FAIL_COND_V(compressed_size == 0, false);
@@ -99,4 +100,142 @@ bool compress(Span<const uint8_t> src, std::vector<uint8_t> &dst, Compression co
 	return true;
 }
 
+namespace {
+
+template <typename T>
+void encode_delta_y(const T *src, T *dst, size_t count, unsigned int column_size) {
+	for (size_t column_begin = 0; column_begin < count; column_begin += column_size) {
+		const size_t column_end = MIN(column_begin + column_size, count);
+		T prev = 0;
+		for (size_t i = column_begin; i < column_end; ++i) {
+			const T v = src[i];
+			// Unsigned arithmetic wraps around, so this is lossless
+			dst[i] = v - prev;
+			prev = v;
+		}
+	}
+}
+
+template <typename T>
+void decode_delta_y(const T *src, T *dst, size_t count, unsigned int column_size) {
+	for (size_t column_begin = 0; column_begin < count; column_begin += column_size) {
+		const size_t column_end = MIN(column_begin + column_size, count);
+		T prev = 0;
+		for (size_t i = column_begin; i < column_end; ++i) {
+			prev += src[i];
+			dst[i] = prev;
+		}
+	}
+}
+
+void encode_delta_y(const uint8_t *src, uint8_t *dst, size_t size, unsigned int item_size,
+		unsigned int column_size) {
+	switch (item_size) {
+		case 1:
+			encode_delta_y(src, dst, size, column_size);
+			break;
+		case 2:
+			encode_delta_y((const uint16_t *)src, (uint16_t *)dst, size / 2, column_size);
+			break;
+		case 4:
+			encode_delta_y((const uint32_t *)src, (uint32_t *)dst, size / 4, column_size);
+			break;
+		case 8:
+			encode_delta_y((const uint64_t *)src, (uint64_t *)dst, size / 8, column_size);
+			break;
+		default:
+			CRASH_NOW();
+	}
+}
+
+void decode_delta_y(const uint8_t *src, uint8_t *dst, size_t size, unsigned int item_size,
+		unsigned int column_size) {
+	switch (item_size) {
+		case 1:
+			decode_delta_y(src, dst, size, column_size);
+			break;
+		case 2:
+			decode_delta_y((const uint16_t *)src, (uint16_t *)dst, size / 2, column_size);
+			break;
+		case 4:
+			decode_delta_y((const uint32_t *)src, (uint32_t *)dst, size / 4, column_size);
+			break;
+		case 8:
+			decode_delta_y((const uint64_t *)src, (uint64_t *)dst, size / 8, column_size);
+			break;
+		default:
+			CRASH_NOW();
+	}
+}
+
+void shuffle_bytes(const uint8_t *src, uint8_t *dst, size_t size, unsigned int item_size) {
+	const size_t count = size / item_size;
+	for (unsigned int b = 0; b < item_size; ++b) {
+		uint8_t *plane = dst + b * count;
+		for (size_t i = 0; i < count; ++i) {
+			plane[i] = src[i * item_size + b];
+		}
+	}
+}
+
+void unshuffle_bytes(const uint8_t *src, uint8_t *dst, size_t size, unsigned int item_size) {
+	const size_t count = size / item_size;
+	for (unsigned int b = 0; b < item_size; ++b) {
+		const uint8_t *plane = src + b * count;
+		for (size_t i = 0; i < count; ++i) {
+			dst[i * item_size + b] = plane[i];
+		}
+	}
+}
+
+} // namespace
+
+void apply_filters(Span<const uint8_t> src, Span<uint8_t> dst, uint8_t filters, unsigned int item_size,
+		unsigned int column_size) {
+	VOXEL_PROFILE_SCOPE();
+	CRASH_COND(src.size() != dst.size());
+	CRASH_COND(src.size() % item_size != 0);
+	CRASH_COND(column_size == 0);
+
+	const bool delta = (filters & FILTER_DELTA_Y) != 0;
+	const bool shuffle = (filters & FILTER_BYTE_SHUFFLE) != 0 && item_size > 1;
+
+	if (delta && shuffle) {
+		static thread_local std::vector<uint8_t> tls_tmp;
+		tls_tmp.resize(src.size());
+		encode_delta_y(src.data(), tls_tmp.data(), src.size(), item_size, column_size);
+		shuffle_bytes(tls_tmp.data(), dst.data(), src.size(), item_size);
+	} else if (delta) {
+		encode_delta_y(src.data(), dst.data(), src.size(), item_size, column_size);
+	} else if (shuffle) {
+		shuffle_bytes(src.data(), dst.data(), src.size(), item_size);
+	} else {
+		memcpy(dst.data(), src.data(), src.size());
+	}
+}
+
+void revert_filters(Span<const uint8_t> src, Span<uint8_t> dst, uint8_t filters, unsigned int item_size,
+		unsigned int column_size) {
+	VOXEL_PROFILE_SCOPE();
+	CRASH_COND(src.size() != dst.size());
+	CRASH_COND(src.size() % item_size != 0);
+	CRASH_COND(column_size == 0);
+
+	const bool delta = (filters & FILTER_DELTA_Y) != 0;
+	const bool shuffle = (filters & FILTER_BYTE_SHUFFLE) != 0 && item_size > 1;
+
+	if (delta && shuffle) {
+		static thread_local std::vector<uint8_t> tls_tmp;
+		tls_tmp.resize(src.size());
+		unshuffle_bytes(src.data(), tls_tmp.data(), src.size(), item_size);
+		decode_delta_y(tls_tmp.data(), dst.data(), src.size(), item_size, column_size);
+	} else if (delta) {
+		decode_delta_y(src.data(), dst.data(), src.size(), item_size, column_size);
+	} else if (shuffle) {
+		unshuffle_bytes(src.data(), dst.data(), src.size(), item_size);
+	} else {
+		memcpy(dst.data(), src.data(), src.size());
+	}
+}
+
 } // namespace VoxelCompressedData
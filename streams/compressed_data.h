@@ -19,9 +19,29 @@ enum Compression {
 	COMPRESSION_COUNT = 2
 };
 
-bool compress(Span<const uint8_t> src, std::vector<uint8_t> &dst, Compression comp);
+// Acceleration only changes how data is compressed, it doesn't need to be known for decompression.
+// Higher values are faster, with a lower compression ratio.
+bool compress(Span<const uint8_t> src, std::vector<uint8_t> &dst, Compression comp, int lz4_acceleration = 1);
 bool decompress(Span<const uint8_t> src, std::vector<uint8_t> &dst);
 
+// Transforms that can be applied to arrays of values before compressing them, making them more compressible.
+// They don't change the size of the data.
+enum Filter {
+	// Each value is replaced with its difference with the previous one in the same column.
+	// Data is assumed to be in ZXY order, where columns are along Y. Smooth data turns into small values.
+	FILTER_DELTA_Y = 1,
+	// Bytes of values are grouped by significance, so similar high bytes end up next to each other.
+	FILTER_BYTE_SHUFFLE = 2,
+	// Combination of all the filters above. Other bits are not valid.
+	FILTER_ALL = FILTER_DELTA_Y | FILTER_BYTE_SHUFFLE
+};
+
+// `filters` is a combination of `Filter` flags. Values must be 1, 2, 4 or 8 bytes each.
+void apply_filters(Span<const uint8_t> src, Span<uint8_t> dst, uint8_t filters, unsigned int item_size,
+		unsigned int column_size);
+void revert_filters(Span<const uint8_t> src, Span<uint8_t> dst, uint8_t filters, unsigned int item_size,
+		unsigned int column_size);
+
 } // namespace VoxelCompressedData
 
 #endif // VOXEL_COMPRESSED_DATA_H
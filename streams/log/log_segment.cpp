@@ -0,0 +1,277 @@
+#include "log_segment.h"
+#include "../file_utils.h"
+#include <core/io/marshalls.h>
+#include <core/os/file_access.h>
+
+namespace {
+const uint8_t SEGMENT_MAGIC[4] = { 'V', 'X', 'L', 'S' };
+const char *SEGMENT_FILE_PREFIX = "seg_";
+// Offset of the checksum in a record header
+const unsigned int RECORD_CHECKSUM_OFFSET = 4;
+const unsigned int RECORD_CHECKSUM_END = 8;
+} // namespace
+
+const char *VoxelLogSegment::FILE_EXTENSION = "vxlog";
+
+VoxelLogSegment::~VoxelLogSegment() {
+	close();
+}
+
+Error VoxelLogSegment::open(const String &fpath, uint32_t id, uint8_t block_size_po2) {
+	close();
+
+	_file_path = fpath;
+	_id = id;
+
+	{
+		Error file_error;
+		FileAccessRef f = FileAccess::open(fpath, FileAccess::READ, &file_error);
+		if (file_error != OK) {
+			return file_error;
+		}
+		_file_size = f->get_len();
+	}
+
+	const Error reader_error = _reader.open(fpath);
+	if (reader_error != OK) {
+		ERR_PRINT(String("Failed to open {0} for reading").format(varray(fpath)));
+		return reader_error;
+	}
+
+	const Error header_error = check_header(id, block_size_po2);
+	if (header_error != OK) {
+		close();
+		return header_error;
+	}
+
+	// Until records are listed, only the header is known to be valid
+	_size = HEADER_SIZE;
+	return OK;
+}
+
+Error VoxelLogSegment::create(const String &fpath, uint32_t id, uint8_t block_size_po2) {
+	close();
+
+	_file_path = fpath;
+	_id = id;
+
+	const Error dir_err = check_directory_created(fpath.get_base_dir());
+	if (dir_err != OK) {
+		return ERR_CANT_CREATE;
+	}
+
+	// Not using WRITE mode, which writes to a temporary file until it is closed.
+	// Records must be readable as soon as they are flushed.
+	Error file_error;
+	FileAccess *f = FileAccess::open(fpath, FileAccess::WRITE_READ, &file_error);
+	if (file_error != OK) {
+		ERR_PRINT(String("Failed to create file {0}").format(varray(fpath)));
+		return file_error;
+	}
+
+	f->store_buffer(SEGMENT_MAGIC, 4);
+	f->store_8(FORMAT_VERSION);
+	f->store_8(block_size_po2);
+	f->store_16(0);
+	f->store_32(id);
+	f->store_32(0);
+	f->flush();
+
+	_write_file = f;
+	_size = HEADER_SIZE;
+	_file_size = HEADER_SIZE;
+
+	const Error reader_error = _reader.open(fpath);
+	if (reader_error != OK) {
+		ERR_PRINT(String("Failed to open {0} for reading").format(varray(fpath)));
+		close();
+		return reader_error;
+	}
+
+	return OK;
+}
+
+void VoxelLogSegment::close() {
+	seal();
+	_reader.close();
+	_size = 0;
+	_file_size = 0;
+}
+
+Error VoxelLogSegment::reopen_for_append(uint64_t data_size) {
+	ERR_FAIL_COND_V(_write_file != nullptr, ERR_ALREADY_IN_USE);
+	ERR_FAIL_COND_V(!_reader.is_open(), ERR_FILE_CANT_OPEN);
+
+	if (data_size != _file_size) {
+		// FileAccess can't truncate files, and new records must not follow invalid data
+		return ERR_FILE_CORRUPT;
+	}
+
+	Error file_error;
+	FileAccess *f = FileAccess::open(_file_path, FileAccess::READ_WRITE, &file_error);
+	if (file_error != OK) {
+		return file_error;
+	}
+	f->seek_end();
+
+	_write_file = f;
+	_size = data_size;
+	return OK;
+}
+
+void VoxelLogSegment::seal() {
+	if (_write_file != nullptr) {
+		_write_file->flush();
+		memdelete(_write_file);
+		_write_file = nullptr;
+	}
+}
+
+uint64_t VoxelLogSegment::append_record(const RecordHeader &header, Span<const uint8_t> payload) {
+	CRASH_COND(_write_file == nullptr);
+	CRASH_COND(header.payload_size != payload.size());
+
+	// The header and payload are checksummed together, so the header is encoded first
+	static thread_local std::vector<uint8_t> tls_record;
+	std::vector<uint8_t> &record = tls_record;
+	record.resize(RECORD_HEADER_SIZE + payload.size());
+	encode_record_header(header, record.data());
+	if (payload.size() > 0) {
+		memcpy(record.data() + RECORD_HEADER_SIZE, payload.data(), payload.size());
+	}
+	encode_uint32(compute_checksum(to_span_const(record)), record.data() + RECORD_CHECKSUM_OFFSET);
+
+	const uint64_t offset = _size;
+	_write_file->store_buffer(record.data(), record.size());
+	_size += record.size();
+	_file_size = _size;
+	return offset;
+}
+
+Error VoxelLogSegment::flush() {
+	ERR_FAIL_COND_V(_write_file == nullptr, ERR_FILE_CANT_WRITE);
+	_write_file->flush();
+	return OK;
+}
+
+Error VoxelLogSegment::read_record(uint64_t offset, uint32_t record_size, const RecordHeader &expected,
+		Span<const uint8_t> &out_payload) const {
+	ERR_FAIL_COND_V(!_reader.is_open(), ERR_FILE_CANT_READ);
+	ERR_FAIL_COND_V(record_size < RECORD_HEADER_SIZE, ERR_INVALID_PARAMETER);
+
+	// Header and payload are read together, so a record needs only one access to the file
+	Span<const uint8_t> record = _reader.get_mapped_range(offset, record_size);
+	if (record.size() != record_size) {
+		static thread_local std::vector<uint8_t> tls_record;
+		tls_record.resize(record_size);
+		const size_t read_size = _reader.read(offset, tls_record.data(), record_size);
+		ERR_FAIL_COND_V(read_size != record_size, ERR_FILE_CORRUPT);
+		record = to_span_const(tls_record);
+	}
+
+	const uint8_t *h = record.data();
+	const uint32_t payload_size = decode_uint32(h);
+	ERR_FAIL_COND_V(payload_size != record_size - RECORD_HEADER_SIZE, ERR_FILE_CORRUPT);
+	ERR_FAIL_COND_V(h[8] != expected.type || h[9] != expected.lod, ERR_FILE_CORRUPT);
+	const Vector3i position(
+			static_cast<int32_t>(decode_uint32(h + 12)),
+			static_cast<int32_t>(decode_uint32(h + 16)),
+			static_cast<int32_t>(decode_uint32(h + 20)));
+	ERR_FAIL_COND_V(position != expected.position, ERR_FILE_CORRUPT);
+	ERR_FAIL_COND_V_MSG(compute_checksum(record) != decode_uint32(h + RECORD_CHECKSUM_OFFSET), ERR_FILE_CORRUPT,
+			String("Checksum mismatch in {0} at offset {1}").format(varray(_file_path, offset)));
+
+	out_payload = Span<const uint8_t>(record.data() + RECORD_HEADER_SIZE, payload_size);
+	return OK;
+}
+
+Error VoxelLogSegment::check_header(uint32_t id, uint8_t block_size_po2) const {
+	uint8_t h[HEADER_SIZE];
+	if (_reader.read(0, h, HEADER_SIZE) != HEADER_SIZE) {
+		return ERR_FILE_EOF;
+	}
+	for (unsigned int i = 0; i < 4; ++i) {
+		if (h[i] != SEGMENT_MAGIC[i]) {
+			ERR_PRINT(String("Invalid magic in {0}").format(varray(_file_path)));
+			return ERR_FILE_UNRECOGNIZED;
+		}
+	}
+	if (h[4] != FORMAT_VERSION) {
+		ERR_PRINT(String("Unsupported version {0} in {1}").format(varray(h[4], _file_path)));
+		return ERR_FILE_UNRECOGNIZED;
+	}
+	if (h[5] != block_size_po2) {
+		ERR_PRINT(String("Block size mismatch in {0}").format(varray(_file_path)));
+		return ERR_FILE_CORRUPT;
+	}
+	if (decode_uint32(h + 8) != id) {
+		ERR_PRINT(String("Segment ID mismatch in {0}").format(varray(_file_path)));
+		return ERR_FILE_CORRUPT;
+	}
+	return OK;
+}
+
+bool VoxelLogSegment::read_record_header(uint64_t offset, RecordHeader &out_header, uint32_t &out_checksum) const {
+	uint8_t h[RECORD_HEADER_SIZE];
+	if (_reader.read(offset, h, RECORD_HEADER_SIZE) != RECORD_HEADER_SIZE) {
+		return false;
+	}
+	out_header.payload_size = decode_uint32(h);
+	if (out_header.payload_size > MAX_PAYLOAD_SIZE) {
+		return false;
+	}
+	out_checksum = decode_uint32(h + RECORD_CHECKSUM_OFFSET);
+	out_header.type = h[8];
+	out_header.lod = h[9];
+	out_header.position = Vector3i(
+			static_cast<int32_t>(decode_uint32(h + 12)),
+			static_cast<int32_t>(decode_uint32(h + 16)),
+			static_cast<int32_t>(decode_uint32(h + 20)));
+	return out_header.type < RECORD_TYPE_COUNT;
+}
+
+void VoxelLogSegment::encode_record_header(const RecordHeader &header, uint8_t *dst) {
+	encode_uint32(header.payload_size, dst);
+	encode_uint32(0, dst + RECORD_CHECKSUM_OFFSET);
+	dst[8] = header.type;
+	dst[9] = header.lod;
+	dst[10] = 0;
+	dst[11] = 0;
+	encode_uint32(static_cast<uint32_t>(header.position.x), dst + 12);
+	encode_uint32(static_cast<uint32_t>(header.position.y), dst + 16);
+	encode_uint32(static_cast<uint32_t>(header.position.z), dst + 20);
+}
+
+uint32_t VoxelLogSegment::compute_checksum(Span<const uint8_t> record) {
+	CRASH_COND(record.size() < RECORD_HEADER_SIZE);
+	uint32_t h = hash_djb2_buffer(record.data(), RECORD_CHECKSUM_OFFSET);
+	h = hash_djb2_buffer(record.data() + RECORD_CHECKSUM_END, record.size() - RECORD_CHECKSUM_END, h);
+	return h;
+}
+
+std::vector<uint8_t> &VoxelLogSegment::get_tls_scan_buffer() {
+	static thread_local std::vector<uint8_t> tls_buffer;
+	return tls_buffer;
+}
+
+String VoxelLogSegment::get_file_name(uint32_t id) {
+	return String(SEGMENT_FILE_PREFIX) + itos(id).pad_zeros(8) + "." + FILE_EXTENSION;
+}
+
+bool VoxelLogSegment::parse_file_name(const String &fname, uint32_t &out_id) {
+	const String extension = String(".") + FILE_EXTENSION;
+	if (!fname.begins_with(SEGMENT_FILE_PREFIX) || !fname.ends_with(extension)) {
+		return false;
+	}
+	const int prefix_length = String(SEGMENT_FILE_PREFIX).length();
+	const String id_str = fname.substr(prefix_length, fname.length() - prefix_length - extension.length());
+	if (!id_str.is_valid_integer()) {
+		return false;
+	}
+	const int64_t id = id_str.to_int64();
+	if (id <= 0 || id > 0xffffffff) {
+		return false;
+	}
+	out_id = id;
+	return true;
+}
@@ -0,0 +1,139 @@
+#ifndef VOXEL_LOG_SEGMENT_H
+#define VOXEL_LOG_SEGMENT_H
+
+#include "../../util/math/vector3i.h"
+#include "../../util/span.h"
+#include "../positional_file_reader.h"
+#include <vector>
+
+class FileAccess;
+
+// One file of a log-structured stream. Records are only ever appended to it, and never modified once written.
+//
+// File layout:
+// - Header (HEADER_SIZE bytes): magic "VXLS", version, block size po2, reserved, segment ID, reserved
+// - Records, each made of a header (RECORD_HEADER_SIZE bytes) followed by its payload:
+//   - uint32 payload size
+//   - uint32 checksum of the rest of the header and the payload
+//   - uint8 record type, uint8 LOD index, uint16 reserved
+//   - int32 x, y, z block position within the LOD
+//
+// A record interrupted by a crash fails its checksum, so readers stop at the last complete record.
+// All numbers are little-endian.
+//
+// Records can be read from multiple threads at the same time, while one thread appends.
+class VoxelLogSegment {
+public:
+	static const char *FILE_EXTENSION;
+	static const uint8_t FORMAT_VERSION = 0;
+	static const uint32_t HEADER_SIZE = 16;
+	static const uint32_t RECORD_HEADER_SIZE = 24;
+	// Guards against reading garbage sizes from corrupted files
+	static const uint32_t MAX_PAYLOAD_SIZE = 64 * 1024 * 1024;
+
+	enum RecordType {
+		RECORD_VOXELS = 0,
+		RECORD_INSTANCES,
+		RECORD_TYPE_COUNT
+	};
+
+	struct RecordHeader {
+		uint32_t payload_size = 0;
+		uint8_t type = RECORD_VOXELS;
+		uint8_t lod = 0;
+		Vector3i position;
+	};
+
+	~VoxelLogSegment();
+
+	// Opens an existing segment. Its records can then be listed with `for_each_record`.
+	Error open(const String &fpath, uint32_t id, uint8_t block_size_po2);
+	// Creates a new empty segment, ready to be appended to.
+	Error create(const String &fpath, uint32_t id, uint8_t block_size_po2);
+	void close();
+
+	// Makes an opened segment appendable again, after its valid records end at `data_size`.
+	// Fails if invalid data follows, because it can't be cut off. A new segment should be created instead.
+	Error reopen_for_append(uint64_t data_size);
+	// Closes the write handle. The segment can still be read.
+	void seal();
+
+	inline uint32_t get_id() const { return _id; }
+	inline const String &get_file_path() const { return _file_path; }
+	inline bool is_appendable() const { return _write_file != nullptr; }
+
+	// Size of the valid data in the file, including the header
+	inline uint64_t get_size() const { return _size; }
+	inline void set_size(uint64_t size) { _size = size; }
+
+	// Size of the file on disk, which can be larger than `get_size()` if a write got interrupted
+	inline uint64_t get_file_size() const { return _file_size; }
+
+	// Writes a record at the end of the segment, and returns its offset.
+	// Data is not visible to readers until `flush` is called.
+	// Only one thread may append at a time.
+	uint64_t append_record(const RecordHeader &header, Span<const uint8_t> payload);
+	Error flush();
+
+	// Reads the record at the given offset in a single access, and checks it matches what is expected.
+	// The returned payload is only valid until the next read from the same thread.
+	Error read_record(uint64_t offset, uint32_t record_size, const RecordHeader &expected,
+			Span<const uint8_t> &out_payload) const;
+
+	// Calls `f(const RecordHeader &header, uint64_t offset, Span<const uint8_t> payload)` for each valid record,
+	// in the order they were written, starting at `begin_offset` (use HEADER_SIZE to list them all).
+	// Returns the offset where valid data ends.
+	template <typename F>
+	uint64_t for_each_record(uint64_t begin_offset, F f) const {
+		const uint64_t file_size = get_file_size();
+		uint64_t offset = begin_offset;
+		std::vector<uint8_t> &buffer = get_tls_scan_buffer();
+
+		while (offset + RECORD_HEADER_SIZE <= file_size) {
+			RecordHeader header;
+			uint32_t checksum;
+			if (!read_record_header(offset, header, checksum)) {
+				break;
+			}
+			const uint64_t record_size = RECORD_HEADER_SIZE + header.payload_size;
+			if (offset + record_size > file_size) {
+				// Truncated by a crash
+				break;
+			}
+			buffer.resize(record_size);
+			if (_reader.read(offset, buffer.data(), record_size) != record_size) {
+				break;
+			}
+			if (compute_checksum(Span<const uint8_t>(buffer.data(), record_size)) != checksum) {
+				// Partially written by a crash, or corrupted
+				break;
+			}
+			f(header, offset, Span<const uint8_t>(buffer.data() + RECORD_HEADER_SIZE, header.payload_size));
+			offset += record_size;
+		}
+
+		return offset;
+	}
+
+	static String get_file_name(uint32_t id);
+	// Returns false if the file name is not one of a segment
+	static bool parse_file_name(const String &fname, uint32_t &out_id);
+
+private:
+	Error check_header(uint32_t id, uint8_t block_size_po2) const;
+	bool read_record_header(uint64_t offset, RecordHeader &out_header, uint32_t &out_checksum) const;
+
+	static void encode_record_header(const RecordHeader &header, uint8_t *dst);
+	// Checksum of a whole record, ignoring the bytes where the checksum is stored
+	static uint32_t compute_checksum(Span<const uint8_t> record);
+	static std::vector<uint8_t> &get_tls_scan_buffer();
+
+	String _file_path;
+	uint32_t _id = 0;
+	uint64_t _size = 0;
+	uint64_t _file_size = 0;
+	FileAccess *_write_file = nullptr;
+	VoxelPositionalFileReader _reader;
+};
+
+#endif // VOXEL_LOG_SEGMENT_H
@@ -0,0 +1,1135 @@
+#include "voxel_stream_log.h"
+#include "../../util/macros.h"
+#include "../../util/math/funcs.h"
+#include "../../util/profiling.h"
+#include "../compressed_data.h"
+#include "../file_utils.h"
+#include "../instance_data.h"
+#include <core/io/marshalls.h>
+#include <core/os/dir_access.h>
+#include <core/os/file_access.h>
+#include <core/os/os.h>
+#include <algorithm>
+
+namespace {
+
+const uint8_t CHECKPOINT_MAGIC[4] = { 'V', 'X', 'L', 'I' };
+const uint8_t CHECKPOINT_VERSION = 0;
+const unsigned int CHECKPOINT_HEADER_SIZE = 28;
+const unsigned int CHECKPOINT_ENTRY_SIZE = 32;
+
+// Records relocated by compaction are appended in batches of about this size
+const size_t COMPACTION_BATCH_SIZE = 4 * 1024 * 1024;
+
+inline VoxelLogSegment::RecordHeader make_record_key(
+		VoxelLogSegment::RecordType type, Vector3i position, unsigned int lod) {
+	VoxelLogSegment::RecordHeader key;
+	key.type = type;
+	key.lod = lod;
+	key.position = position;
+	return key;
+}
+
+} // namespace
+
+const char *VoxelStreamLog::CHECKPOINT_FILE_NAME = "index.vxcheckpoint";
+
+thread_local VoxelBlockSerializerInternal VoxelStreamLog::_voxel_block_serializer;
+
+VoxelStreamLog::VoxelStreamLog() {
+}
+
+VoxelStreamLog::~VoxelStreamLog() {
+	stop_background_thread();
+	MutexLock lock(_mutex);
+	close();
+}
+
+void VoxelStreamLog::set_directory(String dirpath) {
+	// Maintenance works on the current log, it must be done before switching
+	stop_background_thread();
+	MutexLock maintenance_lock(_maintenance_mutex);
+	MutexLock lock(_mutex);
+	if (dirpath == _directory_path) {
+		return;
+	}
+	close();
+	_directory_path = dirpath;
+	_change_notify();
+}
+
+String VoxelStreamLog::get_directory() const {
+	MutexLock lock(_mutex);
+	return _directory_path;
+}
+
+void VoxelStreamLog::set_segment_size(int size_in_bytes) {
+	ERR_FAIL_COND(size_in_bytes < static_cast<int>(MIN_SEGMENT_SIZE));
+	MutexLock lock(_mutex);
+	_segment_size = size_in_bytes;
+}
+
+int VoxelStreamLog::get_segment_size() const {
+	MutexLock lock(_mutex);
+	return _segment_size;
+}
+
+void VoxelStreamLog::set_compaction_threshold(float ratio) {
+	// Below some point, compaction would keep copying segments having almost no garbage
+	ratio = clamp(ratio, 0.05f, 1.f);
+	MutexLock lock(_mutex);
+	// Also read when the index changes
+	RWLockWrite wlock(_index_lock);
+	_compaction_threshold = ratio;
+}
+
+float VoxelStreamLog::get_compaction_threshold() const {
+	MutexLock lock(_mutex);
+	return _compaction_threshold;
+}
+
+VoxelStream::Result VoxelStreamLog::emerge_block(Ref<VoxelBuffer> out_buffer, Vector3i origin_in_voxels, int lod) {
+	VoxelBlockRequest r;
+	r.lod = lod;
+	r.origin_in_voxels = origin_in_voxels;
+	r.voxel_buffer = out_buffer;
+	Vector<VoxelBlockRequest> requests;
+	Vector<VoxelStream::Result> results;
+	requests.push_back(r);
+	emerge_blocks(requests, results);
+	return results[0];
+}
+
+void VoxelStreamLog::immerge_block(Ref<VoxelBuffer> buffer, Vector3i origin_in_voxels, int lod) {
+	VoxelBlockRequest r;
+	r.voxel_buffer = buffer;
+	r.origin_in_voxels = origin_in_voxels;
+	r.lod = lod;
+	Vector<VoxelBlockRequest> requests;
+	requests.push_back(r);
+	immerge_blocks(requests);
+}
+
+void VoxelStreamLog::emerge_blocks(Vector<VoxelBlockRequest> &p_blocks, Vector<Result> &out_results) {
+	VOXEL_PROFILE_SCOPE();
+
+	const int bs_po2 = get_block_size_po2();
+
+	out_results.resize(p_blocks.size());
+	for (int i = 0; i < out_results.size(); ++i) {
+		out_results.write[i] = RESULT_BLOCK_NOT_FOUND;
+	}
+
+	if (!ensure_loaded()) {
+		return;
+	}
+
+	static thread_local std::vector<RecordQuery> tls_queries;
+	std::vector<RecordQuery> &queries = tls_queries;
+	queries.clear();
+	for (int i = 0; i < p_blocks.size(); ++i) {
+		const VoxelBlockRequest &r = p_blocks[i];
+		ERR_CONTINUE(r.lod < 0 || r.lod >= static_cast<int>(VoxelConstants::MAX_LOD));
+		RecordQuery q;
+		q.request_index = i;
+		q.key = make_record_key(
+				VoxelLogSegment::RECORD_VOXELS, get_voxel_block_key(r.origin_in_voxels, bs_po2), r.lod);
+		queries.push_back(q);
+	}
+
+	find_records(queries);
+
+	for (size_t i = 0; i < queries.size(); ++i) {
+		RecordQuery &q = queries[i];
+		VoxelBlockRequest &r = p_blocks.write[q.request_index];
+
+		Span<const uint8_t> payload;
+		if (q.segment->file.read_record(q.location.offset, q.location.size, q.key, payload) != OK) {
+			out_results.write[q.request_index] = RESULT_ERROR;
+			continue;
+		}
+		if (!_voxel_block_serializer.decompress_and_deserialize(payload, **r.voxel_buffer)) {
+			ERR_PRINT("Failed to decompress and deserialize voxel block");
+			out_results.write[q.request_index] = RESULT_ERROR;
+			continue;
+		}
+		out_results.write[q.request_index] = RESULT_BLOCK_FOUND;
+	}
+
+	// Don't hold on segments that compaction might want to remove
+	queries.clear();
+}
+
+void VoxelStreamLog::immerge_blocks(const Vector<VoxelBlockRequest> &p_blocks) {
+	VOXEL_PROFILE_SCOPE();
+
+	const int bs_po2 = get_block_size_po2();
+	const int lz4_acceleration = get_lz4_acceleration();
+
+	// Serialized before locking, so threads saving at the same time only wait for each other to write
+	static thread_local std::vector<PendingRecord> tls_records;
+	std::vector<PendingRecord> &records = tls_records;
+	records.resize(p_blocks.size());
+	unsigned int record_count = 0;
+
+	for (int i = 0; i < p_blocks.size(); ++i) {
+		const VoxelBlockRequest &r = p_blocks[i];
+		ERR_CONTINUE(r.lod < 0 || r.lod >= static_cast<int>(VoxelConstants::MAX_LOD));
+
+		PendingRecord &record = records[record_count];
+		record.header = make_record_key(
+				VoxelLogSegment::RECORD_VOXELS, get_voxel_block_key(r.origin_in_voxels, bs_po2), r.lod);
+		record.previous_location = Location();
+		record.payload.clear();
+
+		// A null buffer deletes the block, which is recorded as an empty payload
+		if (r.voxel_buffer.is_valid()) {
+			VoxelBlockSerializerInternal::SerializeResult res =
+					_voxel_block_serializer.serialize_and_compress(**r.voxel_buffer, lz4_acceleration);
+			ERR_CONTINUE(!res.success);
+			record.payload = res.data;
+		}
+		record.header.payload_size = record.payload.size();
+		++record_count;
+	}
+
+	if (append_records(Span<const PendingRecord>(records.data(), 0, record_count))) {
+		request_background_work();
+	}
+}
+
+bool VoxelStreamLog::supports_instance_blocks() const {
+	return true;
+}
+
+void VoxelStreamLog::load_instance_blocks(Span<VoxelStreamInstanceDataRequest> out_blocks, Span<Result> out_results) {
+	VOXEL_PROFILE_SCOPE();
+
+	for (size_t i = 0; i < out_results.size(); ++i) {
+		out_results[i] = RESULT_BLOCK_NOT_FOUND;
+	}
+
+	if (!ensure_loaded()) {
+		return;
+	}
+
+	static thread_local std::vector<RecordQuery> tls_queries;
+	std::vector<RecordQuery> &queries = tls_queries;
+	queries.clear();
+	for (size_t i = 0; i < out_blocks.size(); ++i) {
+		const VoxelStreamInstanceDataRequest &r = out_blocks[i];
+		ERR_CONTINUE(r.lod >= VoxelConstants::MAX_LOD);
+		RecordQuery q;
+		q.request_index = i;
+		q.key = make_record_key(VoxelLogSegment::RECORD_INSTANCES, r.position, r.lod);
+		queries.push_back(q);
+	}
+
+	find_records(queries);
+
+	static thread_local std::vector<uint8_t> tls_data;
+	std::vector<uint8_t> &temp_data = tls_data;
+
+	for (size_t i = 0; i < queries.size(); ++i) {
+		RecordQuery &q = queries[i];
+		VoxelStreamInstanceDataRequest &r = out_blocks[q.request_index];
+
+		Span<const uint8_t> payload;
+		if (q.segment->file.read_record(q.location.offset, q.location.size, q.key, payload) != OK) {
+			out_results[q.request_index] = RESULT_ERROR;
+			continue;
+		}
+		if (!VoxelCompressedData::decompress(payload, temp_data)) {
+			ERR_PRINT("Failed to decompress instance block");
+			out_results[q.request_index] = RESULT_ERROR;
+			continue;
+		}
+		r.data = std::make_unique<VoxelInstanceBlockData>();
+		if (!deserialize_instance_block_data(*r.data, to_span_const(temp_data))) {
+			ERR_PRINT("Failed to deserialize instance block");
+			out_results[q.request_index] = RESULT_ERROR;
+			continue;
+		}
+		out_results[q.request_index] = RESULT_BLOCK_FOUND;
+	}
+
+	queries.clear();
+}
+
+void VoxelStreamLog::save_instance_blocks(Span<VoxelStreamInstanceDataRequest> p_blocks) {
+	VOXEL_PROFILE_SCOPE();
+
+	const int lz4_acceleration = get_lz4_acceleration();
+
+	static thread_local std::vector<PendingRecord> tls_records;
+	std::vector<PendingRecord> &records = tls_records;
+	records.resize(p_blocks.size());
+	unsigned int record_count = 0;
+
+	static thread_local std::vector<uint8_t> tls_data;
+	std::vector<uint8_t> &temp_data = tls_data;
+
+	for (size_t i = 0; i < p_blocks.size(); ++i) {
+		const VoxelStreamInstanceDataRequest &r = p_blocks[i];
+		ERR_CONTINUE(r.lod >= VoxelConstants::MAX_LOD);
+
+		PendingRecord &record = records[record_count];
+		record.header = make_record_key(VoxelLogSegment::RECORD_INSTANCES, r.position, r.lod);
+		record.previous_location = Location();
+		record.payload.clear();
+
+		// Null data deletes the block, which is recorded as an empty payload
+		if (r.data != nullptr) {
+			temp_data.clear();
+			serialize_instance_block_data(*r.data, temp_data);
+			ERR_CONTINUE(!VoxelCompressedData::compress(
+					to_span_const(temp_data), record.payload, VoxelCompressedData::COMPRESSION_LZ4, lz4_acceleration));
+		}
+		record.header.payload_size = record.payload.size();
+		++record_count;
+	}
+
+	if (append_records(Span<const PendingRecord>(records.data(), 0, record_count))) {
+		request_background_work();
+	}
+}
+
+bool VoxelStreamLog::may_have_block(Vector3i origin_in_voxels, int lod) {
+	ERR_FAIL_COND_V(lod < 0 || lod >= static_cast<int>(VoxelConstants::MAX_LOD), true);
+
+	if (!_loaded) {
+		// Loading lists segments and replays them, which callers like the main thread shouldn't wait for.
+		// Until the first load or save does it, blocks have to be looked up.
+		return true;
+	}
+
+	const int bs_po2 = get_block_size_po2();
+
+	RWLockRead rlock(_index_lock);
+	const std::unordered_map<Vector3i, IndexEntry> &lod_index = _index[lod];
+	return lod_index.find(get_voxel_block_key(origin_in_voxels, bs_po2)) != lod_index.end() ||
+			lod_index.find(get_instance_block_key(origin_in_voxels, lod, bs_po2)) != lod_index.end();
+}
+
+int VoxelStreamLog::get_used_channels_mask() const {
+	// Assuming all, since that stream can store anything.
+	return VoxelBuffer::ALL_CHANNELS_MASK;
+}
+
+void VoxelStreamLog::save_checkpoint() {
+	MutexLock maintenance_lock(_maintenance_mutex);
+	save_checkpoint_internal();
+}
+
+// Returns false if the checkpoint could not be written, in which case it will be tried again next time.
+// Must be called with the maintenance mutex locked
+bool VoxelStreamLog::save_checkpoint_internal() {
+	std::vector<uint8_t> data;
+	String fpath;
+	uint32_t change_count;
+	{
+		MutexLock lock(_mutex);
+		if (!_loaded) {
+			return false;
+		}
+		if (_change_count == _checkpoint_change_count) {
+			return true;
+		}
+		make_checkpoint(data);
+		fpath = _directory_path.plus_file(CHECKPOINT_FILE_NAME);
+		change_count = _change_count;
+	}
+	// Writing the file doesn't prevent saving more blocks
+	if (!write_checkpoint_file(fpath, data)) {
+		return false;
+	}
+	// Changes made while writing are not in the file, so the checkpoint is only up to date if there were none.
+	// The directory can't change meanwhile, since it requires the maintenance mutex.
+	MutexLock lock(_mutex);
+	_checkpoint_change_count = change_count;
+	return true;
+}
+
+void VoxelStreamLog::compact() {
+	VOXEL_PROFILE_SCOPE();
+	MutexLock maintenance_lock(_maintenance_mutex);
+
+	if (!ensure_loaded()) {
+		return;
+	}
+
+	std::vector<std::shared_ptr<Segment>> segments_to_compact;
+	{
+		RWLockRead rlock(_index_lock);
+		for (size_t i = 0; i < _segments.size(); ++i) {
+			const std::shared_ptr<Segment> &segment = _segments[i];
+			if (segment->sealed && is_worth_compacting(*segment)) {
+				segments_to_compact.push_back(segment);
+			}
+		}
+	}
+
+	if (segments_to_compact.size() == 0) {
+		if (_checkpoint_requested.exchange(false) && !save_checkpoint_internal()) {
+			// Tried again on next maintenance
+			_checkpoint_requested = true;
+		}
+		return;
+	}
+
+	const uint64_t time_before = OS::get_singleton()->get_ticks_usec();
+	uint64_t reclaimed_size = 0;
+
+	for (size_t i = 0; i < segments_to_compact.size(); ++i) {
+		compact_segment(*segments_to_compact[i]);
+	}
+
+	// The index must no longer need the old segments when the log is opened again, before they get removed.
+	// A checkpoint also saves having to read relocated records on next opening.
+	_checkpoint_requested = false;
+	if (!save_checkpoint_internal()) {
+		// Compacted segments are kept until a checkpoint gets written. They have nothing left to relocate, so they
+		// will be removed by the next compaction.
+		_checkpoint_requested = true;
+		return;
+	}
+
+	std::vector<std::shared_ptr<Segment>> segments_to_remove;
+	{
+		RWLockWrite wlock(_index_lock);
+		for (size_t i = 0; i < segments_to_compact.size(); ++i) {
+			std::shared_ptr<Segment> &segment = segments_to_compact[i];
+			if (segment->live_size != 0) {
+				// Failed to relocate some blocks
+				continue;
+			}
+			auto it = std::find(_segments.begin(), _segments.end(), segment);
+			if (it != _segments.end()) {
+				_segments.erase(it);
+			}
+			segments_to_remove.push_back(segment);
+		}
+	}
+	segments_to_compact.clear();
+
+	for (size_t i = 0; i < segments_to_remove.size(); ++i) {
+		std::shared_ptr<Segment> &segment = segments_to_remove[i];
+		const String fpath = segment->file.get_file_path();
+		reclaimed_size += segment->file.get_file_size();
+
+		// No new reader can find the segment anymore, but some might still be reading it
+		if (segment.use_count() == 1) {
+			segment->file.close();
+		}
+		segment.reset();
+
+		DirAccessRef da = DirAccess::create_for_path(fpath.get_base_dir());
+		if (!da || da->remove(fpath) != OK) {
+			// It will be compacted again when the log is opened next time
+			PRINT_VERBOSE(String("Could not remove compacted segment {0}").format(varray(fpath)));
+		}
+	}
+
+	const uint64_t time_spent = OS::get_singleton()->get_ticks_usec() - time_before;
+	PRINT_VERBOSE(String("VoxelStreamLog compacted {0} segments, reclaiming {1} bytes, took {2} us")
+						  .format(varray(SIZE_T_TO_VARIANT(segments_to_remove.size()),
+								  SIZE_T_TO_VARIANT(reclaimed_size), SIZE_T_TO_VARIANT(time_spent))));
+}
+
+bool VoxelStreamLog::ensure_loaded() {
+	if (_loaded) {
+		return true;
+	}
+	MutexLock lock(_mutex);
+	if (_loaded) {
+		return true;
+	}
+	if (_load_failed || _directory_path.empty()) {
+		return false;
+	}
+	if (!load()) {
+		// Not retried until the directory changes, so errors aren't printed for every block
+		_load_failed = true;
+		close();
+		return false;
+	}
+	_loaded = true;
+
+	bool compaction_needed = false;
+	{
+		RWLockRead rlock(_index_lock);
+		for (size_t i = 0; i < _segments.size(); ++i) {
+			const Segment &segment = *_segments[i];
+			if (segment.sealed && is_worth_compacting(segment)) {
+				compaction_needed = true;
+				break;
+			}
+		}
+	}
+	if (compaction_needed) {
+		// Requested on next save, because this could be the background thread itself
+		_compaction_pending = true;
+	}
+	return true;
+}
+
+// Must be called with the mutex locked
+bool VoxelStreamLog::load() {
+	VOXEL_PROFILE_SCOPE();
+	const uint64_t time_before = OS::get_singleton()->get_ticks_usec();
+	const int bs_po2 = get_block_size_po2();
+
+	// List segments
+	std::vector<uint32_t> segment_ids;
+	{
+		DirAccessRef da = DirAccess::create_for_path(_directory_path);
+		if (!da || !da->dir_exists(_directory_path)) {
+			// Nothing saved yet, the directory will be created on first save
+			return true;
+		}
+		ERR_FAIL_COND_V(da->change_dir(_directory_path) != OK, false);
+		ERR_FAIL_COND_V(da->list_dir_begin() != OK, false);
+		String fname = da->get_next();
+		while (fname != "") {
+			uint32_t id;
+			if (!da->current_is_dir() && VoxelLogSegment::parse_file_name(fname, id)) {
+				segment_ids.push_back(id);
+			}
+			fname = da->get_next();
+		}
+		da->list_dir_end();
+	}
+	std::sort(segment_ids.begin(), segment_ids.end());
+
+	LogPosition checkpoint_position;
+	const bool has_checkpoint = load_checkpoint(checkpoint_position);
+
+	// Read records written after the checkpoint.
+	// The index was written after them if it has a later position, so records are applied in the order they were
+	// written, and the latest version of each block wins.
+	std::vector<std::shared_ptr<Segment>> segments;
+	unsigned int replayed_record_count = 0;
+	for (size_t i = 0; i < segment_ids.size(); ++i) {
+		const uint32_t id = segment_ids[i];
+		const String fpath = _directory_path.plus_file(VoxelLogSegment::get_file_name(id));
+		// Even if the segment can't be opened, its ID must not be used for a new one, which would overwrite it
+		_next_segment_id = MAX(_next_segment_id, id + 1);
+
+		std::shared_ptr<Segment> segment = std::make_shared<Segment>();
+		const Error open_err = segment->file.open(fpath, id, bs_po2);
+		if (open_err != OK) {
+			ERR_PRINT(String("Could not open segment {0}, error {1}").format(varray(fpath, open_err)));
+			continue;
+		}
+
+		uint64_t begin_offset = VoxelLogSegment::HEADER_SIZE;
+		if (has_checkpoint) {
+			if (id < checkpoint_position.segment_id) {
+				// Fully covered by the checkpoint
+				begin_offset = segment->file.get_file_size();
+			} else if (id == checkpoint_position.segment_id) {
+				begin_offset = checkpoint_position.offset;
+			}
+		}
+
+		uint64_t end_offset = begin_offset;
+		if (begin_offset < segment->file.get_file_size()) {
+			RWLockWrite wlock(_index_lock);
+			end_offset = segment->file.for_each_record(begin_offset,
+					[this, id, &replayed_record_count](const VoxelLogSegment::RecordHeader &header, uint64_t offset,
+							Span<const uint8_t>) {
+						Location location;
+						location.segment_id = id;
+						location.size = VoxelLogSegment::RECORD_HEADER_SIZE + header.payload_size;
+						location.offset = offset;
+						apply_record(header, location);
+						++replayed_record_count;
+					});
+		}
+		segment->file.set_size(end_offset);
+
+		if (end_offset != segment->file.get_file_size()) {
+			WARN_PRINT(String("Segment {0} has {1} bytes of incomplete data after offset {2}, they will be ignored")
+							   .format(varray(fpath, SIZE_T_TO_VARIANT(segment->file.get_file_size() - end_offset),
+									   SIZE_T_TO_VARIANT(end_offset))));
+		}
+
+		segments.push_back(segment);
+	}
+
+	RWLockWrite wlock(_index_lock);
+	_segments = segments;
+
+	// Count live data, and forget blocks stored in segments that went missing
+	unsigned int missing_count = 0;
+	for (unsigned int lod_index = 0; lod_index < _index.size(); ++lod_index) {
+		std::unordered_map<Vector3i, IndexEntry> &lod = _index[lod_index];
+		for (auto it = lod.begin(); it != lod.end();) {
+			IndexEntry &entry = it->second;
+			bool empty = true;
+			for (unsigned int type = 0; type < entry.locations.size(); ++type) {
+				Location &location = entry.locations[type];
+				if (location.segment_id == 0) {
+					continue;
+				}
+				std::shared_ptr<Segment> segment = find_segment(location.segment_id);
+				if (segment == nullptr || location.offset + location.size > segment->file.get_size()) {
+					location = Location();
+					++missing_count;
+					continue;
+				}
+				segment->live_size += location.size;
+				empty = false;
+			}
+			if (empty) {
+				it = lod.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+	if (missing_count > 0) {
+		ERR_PRINT(String("{0} blocks of {1} were lost because their segment is missing or incomplete")
+						  .format(varray(missing_count, _directory_path)));
+	}
+
+	// Continue appending to the last segment if it ended cleanly
+	if (_segments.size() > 0) {
+		std::shared_ptr<Segment> &last = _segments.back();
+		if (last->file.get_size() < _segment_size && last->file.reopen_for_append(last->file.get_size()) == OK) {
+			last->sealed = false;
+			_active_segment = last;
+		}
+	}
+
+	if (replayed_record_count > 0 || missing_count > 0) {
+		++_change_count;
+	}
+
+	const uint64_t time_spent = OS::get_singleton()->get_ticks_usec() - time_before;
+	PRINT_VERBOSE(String("VoxelStreamLog loaded {0} segments from {1}, replayed {2} records, took {3} us")
+						  .format(varray(SIZE_T_TO_VARIANT(_segments.size()), _directory_path, replayed_record_count,
+								  SIZE_T_TO_VARIANT(time_spent))));
+	return true;
+}
+
+// Must be called with the mutex locked
+void VoxelStreamLog::close() {
+	if (_loaded && _change_count != _checkpoint_change_count) {
+		std::vector<uint8_t> data;
+		make_checkpoint(data);
+		// If it fails, records after the previous checkpoint will be read again on next opening
+		write_checkpoint_file(_directory_path.plus_file(CHECKPOINT_FILE_NAME), data);
+	}
+
+	if (_active_segment != nullptr) {
+		_active_segment->file.seal();
+		_active_segment.reset();
+	}
+
+	{
+		RWLockWrite wlock(_index_lock);
+		for (unsigned int lod_index = 0; lod_index < _index.size(); ++lod_index) {
+			_index[lod_index].clear();
+		}
+		_segments.clear();
+	}
+
+	_loaded = false;
+	_load_failed = false;
+	_next_segment_id = 1;
+	_change_count = 0;
+	_checkpoint_change_count = 0;
+	_compaction_pending = false;
+	_checkpoint_requested = false;
+}
+
+// Checkpoint file layout:
+// - Header (CHECKPOINT_HEADER_SIZE bytes): magic "VXLI", version, block size po2, reserved,
+//   next segment ID, segment ID and offset up to which the log is indexed, entry count
+// - Entries (CHECKPOINT_ENTRY_SIZE bytes each): int32 x, y, z, uint8 LOD, uint8 record type, uint16 reserved,
+//   uint32 segment ID, uint32 record size, uint64 record offset
+// - uint32 checksum of everything before it
+//
+// Must be called with the mutex locked
+void VoxelStreamLog::make_checkpoint(std::vector<uint8_t> &out_data) {
+	VOXEL_PROFILE_SCOPE();
+
+	// Records must be readable from the file before the checkpoint refers to them
+	LogPosition position;
+	if (_active_segment != nullptr) {
+		_active_segment->file.flush();
+		position.segment_id = _active_segment->file.get_id();
+		position.offset = _active_segment->file.get_size();
+	} else {
+		position.segment_id = _next_segment_id;
+		position.offset = VoxelLogSegment::HEADER_SIZE;
+	}
+
+	RWLockRead rlock(_index_lock);
+
+	uint32_t entry_count = 0;
+	for (unsigned int lod_index = 0; lod_index < _index.size(); ++lod_index) {
+		const std::unordered_map<Vector3i, IndexEntry> &lod = _index[lod_index];
+		for (auto it = lod.begin(); it != lod.end(); ++it) {
+			for (unsigned int type = 0; type < it->second.locations.size(); ++type) {
+				if (it->second.locations[type].segment_id != 0) {
+					++entry_count;
+				}
+			}
+		}
+	}
+
+	out_data.resize(CHECKPOINT_HEADER_SIZE + entry_count * CHECKPOINT_ENTRY_SIZE + 4);
+	uint8_t *dst = out_data.data();
+
+	memcpy(dst, CHECKPOINT_MAGIC, 4);
+	dst[4] = CHECKPOINT_VERSION;
+	dst[5] = get_block_size_po2();
+	encode_uint16(0, dst + 6);
+	encode_uint32(_next_segment_id, dst + 8);
+	encode_uint32(position.segment_id, dst + 12);
+	encode_uint64(position.offset, dst + 16);
+	encode_uint32(entry_count, dst + 24);
+	dst += CHECKPOINT_HEADER_SIZE;
+
+	for (unsigned int lod_index = 0; lod_index < _index.size(); ++lod_index) {
+		const std::unordered_map<Vector3i, IndexEntry> &lod = _index[lod_index];
+		for (auto it = lod.begin(); it != lod.end(); ++it) {
+			for (unsigned int type = 0; type < it->second.locations.size(); ++type) {
+				const Location &location = it->second.locations[type];
+				if (location.segment_id == 0) {
+					continue;
+				}
+				encode_uint32(static_cast<uint32_t>(it->first.x), dst);
+				encode_uint32(static_cast<uint32_t>(it->first.y), dst + 4);
+				encode_uint32(static_cast<uint32_t>(it->first.z), dst + 8);
+				dst[12] = lod_index;
+				dst[13] = type;
+				encode_uint16(0, dst + 14);
+				encode_uint32(location.segment_id, dst + 16);
+				encode_uint32(location.size, dst + 20);
+				encode_uint64(location.offset, dst + 24);
+				dst += CHECKPOINT_ENTRY_SIZE;
+			}
+		}
+	}
+
+	const uint32_t checksum = hash_djb2_buffer(out_data.data(), out_data.size() - 4);
+	encode_uint32(checksum, dst);
+}
+
+bool VoxelStreamLog::write_checkpoint_file(const String &fpath, const std::vector<uint8_t> &data) {
+	VOXEL_PROFILE_SCOPE();
+
+	const Error dir_err = check_directory_created(fpath.get_base_dir());
+	ERR_FAIL_COND_V(dir_err != OK, false);
+
+	// WRITE mode writes to a temporary file, which replaces the previous checkpoint only when closed.
+	// So a crash while writing leaves the previous checkpoint intact.
+	Error err;
+	FileAccessRef f = FileAccess::open(fpath, FileAccess::WRITE, &err);
+	ERR_FAIL_COND_V_MSG(err != OK, false, String("Could not write checkpoint {0}").format(varray(fpath)));
+	f->store_buffer(data.data(), data.size());
+	ERR_FAIL_COND_V_MSG(f->get_error() != OK, false, String("Could not write checkpoint {0}").format(varray(fpath)));
+	return true;
+}
+
+// Must be called with the mutex locked
+bool VoxelStreamLog::load_checkpoint(LogPosition &out_position) {
+	const String fpath = _directory_path.plus_file(CHECKPOINT_FILE_NAME);
+	if (!FileAccess::exists(fpath)) {
+		return false;
+	}
+
+	Error err;
+	const Vector<uint8_t> data = FileAccess::get_file_as_array(fpath, &err);
+	ERR_FAIL_COND_V(err != OK, false);
+	const uint8_t *src = data.ptr();
+
+	if (data.size() < static_cast<int>(CHECKPOINT_HEADER_SIZE + 4) || memcmp(src, CHECKPOINT_MAGIC, 4) != 0) {
+		ERR_PRINT(String("Invalid checkpoint {0}, the whole log will be read").format(varray(fpath)));
+		return false;
+	}
+	if (src[4] != CHECKPOINT_VERSION || src[5] != get_block_size_po2()) {
+		ERR_PRINT(String("Unsupported checkpoint {0}, the whole log will be read").format(varray(fpath)));
+		return false;
+	}
+	const uint32_t entry_count = decode_uint32(src + 24);
+	const uint64_t expected_size = CHECKPOINT_HEADER_SIZE + static_cast<uint64_t>(entry_count) * CHECKPOINT_ENTRY_SIZE + 4;
+	if (expected_size != static_cast<uint64_t>(data.size()) ||
+			hash_djb2_buffer(src, data.size() - 4) != decode_uint32(src + data.size() - 4)) {
+		ERR_PRINT(String("Corrupted checkpoint {0}, the whole log will be read").format(varray(fpath)));
+		return false;
+	}
+
+	// Segments removed by compaction must not get their ID reused
+	const uint32_t next_segment_id = decode_uint32(src + 8);
+	out_position.segment_id = decode_uint32(src + 12);
+	out_position.offset = decode_uint64(src + 16);
+	src += CHECKPOINT_HEADER_SIZE;
+
+	RWLockWrite wlock(_index_lock);
+	for (uint32_t i = 0; i < entry_count; ++i) {
+		const Vector3i position(
+				static_cast<int32_t>(decode_uint32(src)),
+				static_cast<int32_t>(decode_uint32(src + 4)),
+				static_cast<int32_t>(decode_uint32(src + 8)));
+		const uint8_t lod_index = src[12];
+		const uint8_t type = src[13];
+		if (lod_index >= _index.size() || type >= VoxelLogSegment::RECORD_TYPE_COUNT) {
+			ERR_PRINT(String("Invalid entry in checkpoint {0}").format(varray(fpath)));
+			src += CHECKPOINT_ENTRY_SIZE;
+			continue;
+		}
+		Location &location = _index[lod_index][position].locations[type];
+		location.segment_id = decode_uint32(src + 16);
+		location.size = decode_uint32(src + 20);
+		location.offset = decode_uint64(src + 24);
+		src += CHECKPOINT_ENTRY_SIZE;
+	}
+
+	_next_segment_id = next_segment_id;
+	return true;
+}
+
+// Updates the index with a record, and returns where the previous version of the block was.
+// Must be called with the index locked for writing.
+VoxelStreamLog::Location VoxelStreamLog::apply_record(
+		const VoxelLogSegment::RecordHeader &header, Location location) {
+	std::unordered_map<Vector3i, IndexEntry> &lod = _index[header.lod];
+
+	if (header.payload_size == 0) {
+		// Deleted
+		auto it = lod.find(header.position);
+		if (it == lod.end()) {
+			return Location();
+		}
+		IndexEntry &entry = it->second;
+		const Location previous_location = entry.locations[header.type];
+		entry.locations[header.type] = Location();
+		bool empty = true;
+		for (unsigned int type = 0; type < entry.locations.size(); ++type) {
+			if (entry.locations[type].segment_id != 0) {
+				empty = false;
+				break;
+			}
+		}
+		if (empty) {
+			lod.erase(it);
+		}
+		return previous_location;
+	}
+
+	Location &current_location = lod[header.position].locations[header.type];
+	const Location previous_location = current_location;
+	current_location = location;
+	return previous_location;
+}
+
+// Must be called with the mutex locked
+bool VoxelStreamLog::start_new_segment() {
+	const uint32_t id = _next_segment_id;
+	const String fpath = _directory_path.plus_file(VoxelLogSegment::get_file_name(id));
+
+	std::shared_ptr<Segment> segment = std::make_shared<Segment>();
+	const Error err = segment->file.create(fpath, id, get_block_size_po2());
+	ERR_FAIL_COND_V_MSG(err != OK, false, String("Could not create segment {0}").format(varray(fpath)));
+	segment->sealed = false;
+	++_next_segment_id;
+
+	if (_active_segment != nullptr) {
+		_active_segment->file.seal();
+	}
+
+	RWLockWrite wlock(_index_lock);
+	if (_active_segment != nullptr) {
+		_active_segment->sealed = true;
+	}
+	_segments.push_back(segment);
+	_active_segment = segment;
+	return true;
+}
+
+// Appends records to the log and makes them visible in the index.
+// Returns true if background maintenance should be requested.
+bool VoxelStreamLog::append_records(Span<const PendingRecord> records) {
+	VOXEL_PROFILE_SCOPE();
+
+	if (records.size() == 0 || !ensure_loaded()) {
+		return false;
+	}
+
+	MutexLock lock(_mutex);
+	if (!_loaded) {
+		// Closed in the meantime
+		return false;
+	}
+
+	struct AppendedRecord {
+		const PendingRecord *record;
+		Location location;
+	};
+	static thread_local std::vector<AppendedRecord> tls_appended_records;
+	std::vector<AppendedRecord> &appended_records = tls_appended_records;
+	appended_records.clear();
+
+	bool maintenance_needed = false;
+	bool segment_full = false;
+
+	for (size_t i = 0; i < records.size(); ++i) {
+		const PendingRecord &record = records[i];
+
+		if (record.previous_location.segment_id != 0) {
+			// Relocated by compaction. The index only changes with the mutex locked, so this stays valid until the
+			// record is published.
+			RWLockRead rlock(_index_lock);
+			const std::unordered_map<Vector3i, IndexEntry> &lod = _index[record.header.lod];
+			auto it = lod.find(record.header.position);
+			if (record.header.payload_size == 0) {
+				// Deletions are not in the index, they are only needed while the block stays deleted
+				if (it != lod.end() && it->second.locations[record.header.type].segment_id != 0) {
+					continue;
+				}
+			} else if (it == lod.end() || !(it->second.locations[record.header.type] == record.previous_location)) {
+				continue;
+			}
+		}
+
+		if (_active_segment == nullptr || segment_full) {
+			if (_active_segment != nullptr) {
+				// Sealing the segment is a good time to checkpoint, so the next opening reads at most one segment
+				maintenance_needed = true;
+				_checkpoint_requested = true;
+			}
+			if (!start_new_segment()) {
+				break;
+			}
+			segment_full = false;
+		}
+
+		AppendedRecord appended;
+		appended.record = &record;
+		appended.location.segment_id = _active_segment->file.get_id();
+		appended.location.size = VoxelLogSegment::RECORD_HEADER_SIZE + record.payload.size();
+		appended.location.offset = _active_segment->file.append_record(record.header, to_span_const(record.payload));
+		appended_records.push_back(appended);
+
+		if (_active_segment->file.get_size() >= _segment_size) {
+			// Published before sealing, so the index never refers to unflushed data
+			_active_segment->file.flush();
+			segment_full = true;
+		}
+	}
+
+	if (_active_segment != nullptr && !segment_full) {
+		_active_segment->file.flush();
+	}
+
+	// Published only once flushed, so readers finding these records in the index can read them
+	RWLockWrite wlock(_index_lock);
+	for (size_t i = 0; i < appended_records.size(); ++i) {
+		const AppendedRecord &appended = appended_records[i];
+		const Location previous_location = apply_record(appended.record->header, appended.location);
+
+		if (previous_location.segment_id != 0) {
+			std::shared_ptr<Segment> previous_segment = find_segment(previous_location.segment_id);
+			if (previous_segment != nullptr) {
+				previous_segment->live_size -= previous_location.size;
+				if (previous_segment->sealed && is_worth_compacting(*previous_segment)) {
+					maintenance_needed = true;
+				}
+			}
+		}
+		if (appended.record->header.payload_size != 0) {
+			std::shared_ptr<Segment> segment = find_segment(appended.location.segment_id);
+			CRASH_COND(segment == nullptr);
+			segment->live_size += appended.location.size;
+		}
+	}
+
+	if (appended_records.size() > 0) {
+		++_change_count;
+	}
+	if (_compaction_pending) {
+		_compaction_pending = false;
+		maintenance_needed = true;
+	}
+	return maintenance_needed;
+}
+
+// Finds where queried blocks are stored. Blocks absent from the log are removed from the list, and the others are
+// sorted in the order they are stored, so reading them goes forward in files.
+void VoxelStreamLog::find_records(std::vector<RecordQuery> &queries) {
+	{
+		RWLockRead rlock(_index_lock);
+		size_t found_count = 0;
+		for (size_t i = 0; i < queries.size(); ++i) {
+			RecordQuery &q = queries[i];
+			const std::unordered_map<Vector3i, IndexEntry> &lod = _index[q.key.lod];
+			auto it = lod.find(q.key.position);
+			if (it == lod.end()) {
+				continue;
+			}
+			const Location &location = it->second.locations[q.key.type];
+			if (location.segment_id == 0) {
+				continue;
+			}
+			q.location = location;
+			q.key.payload_size = location.size - VoxelLogSegment::RECORD_HEADER_SIZE;
+			// Holding the segment, so compaction can't close it while we read
+			q.segment = find_segment(location.segment_id);
+			CRASH_COND(q.segment == nullptr);
+			queries[found_count] = q;
+			++found_count;
+		}
+		queries.resize(found_count);
+	}
+
+	std::sort(queries.begin(), queries.end(), [](const RecordQuery &a, const RecordQuery &b) {
+		if (a.location.segment_id != b.location.segment_id) {
+			return a.location.segment_id < b.location.segment_id;
+		}
+		return a.location.offset < b.location.offset;
+	});
+}
+
+// Must be called with the index locked
+std::shared_ptr<VoxelStreamLog::Segment> VoxelStreamLog::find_segment(uint32_t id) const {
+	// Segments are sorted by ID
+	auto it = std::lower_bound(_segments.begin(), _segments.end(), id,
+			[](const std::shared_ptr<Segment> &segment, uint32_t id) { return segment->file.get_id() < id; });
+	if (it == _segments.end() || (*it)->file.get_id() != id) {
+		return nullptr;
+	}
+	return *it;
+}
+
+// Must be called with the index locked
+bool VoxelStreamLog::is_worth_compacting(const Segment &segment) const {
+	const uint64_t data_size = segment.file.get_size() - VoxelLogSegment::HEADER_SIZE;
+	const uint64_t garbage_size = data_size - segment.live_size;
+	return segment.live_size == 0 || garbage_size >= static_cast<uint64_t>(_compaction_threshold * data_size);
+}
+
+// Appends the blocks of a sealed segment the index still refers to, so the segment can be removed.
+// Deletions are appended again too while older segments might have the deleted blocks. They don't count as live data,
+// so they move forward with compactions until they reach the oldest segment.
+// Must be called with the maintenance mutex locked.
+void VoxelStreamLog::compact_segment(Segment &segment) {
+	VOXEL_PROFILE_SCOPE();
+
+	const uint32_t segment_id = segment.file.get_id();
+	std::vector<PendingRecord> records;
+	size_t batch_size = 0;
+
+	// If the checkpoint gets lost, the log is replayed from the start. Deletions must then still come after older
+	// versions of their block, so they can only be dropped when no older segment remains.
+	bool keep_deletions;
+	{
+		RWLockRead rlock(_index_lock);
+		keep_deletions = _segments.size() > 0 && _segments.front()->file.get_id() < segment_id;
+	}
+
+	// Reads the segment sequentially
+	segment.file.for_each_record(VoxelLogSegment::HEADER_SIZE,
+			[this, segment_id, keep_deletions, &records, &batch_size](const VoxelLogSegment::RecordHeader &header,
+					uint64_t offset, Span<const uint8_t> payload) {
+				Location location;
+				location.segment_id = segment_id;
+				location.size = VoxelLogSegment::RECORD_HEADER_SIZE + header.payload_size;
+				location.offset = offset;
+
+				{
+					RWLockRead rlock(_index_lock);
+					const std::unordered_map<Vector3i, IndexEntry> &lod = _index[header.lod];
+					auto it = lod.find(header.position);
+					if (header.payload_size == 0) {
+						if (!keep_deletions || (it != lod.end() && it->second.locations[header.type].segment_id != 0)) {
+							// Not needed, or the block was saved again since then
+							return;
+						}
+					} else if (it == lod.end() || !(it->second.locations[header.type] == location)) {
+						// Superseded
+						return;
+					}
+				}
+
+				PendingRecord record;
+				record.header = header;
+				record.payload.assign(payload.data(), payload.data() + payload.size());
+				record.previous_location = location;
+				batch_size += VoxelLogSegment::RECORD_HEADER_SIZE + record.payload.size();
+				records.push_back(std::move(record));
+
+				if (batch_size >= COMPACTION_BATCH_SIZE) {
+					append_records(to_span_const(records));
+					records.clear();
+					batch_size = 0;
+				}
+			});
+
+	append_records(to_span_const(records));
+}
+
+void VoxelStreamLog::request_background_work() {
+	{
+		MutexLock lock(_background_thread_mutex);
+		if (!_background_thread_started) {
+			// Started only when needed, because many streams are created without ever saving anything
+			_background_thread_started = true;
+			_background_thread.start(background_thread_func_static, this);
+		}
+	}
+	// Requests made while the thread is already going to work are merged
+	if (!_background_work_requested.exchange(true)) {
+		_background_semaphore.post();
+	}
+}
+
+void VoxelStreamLog::stop_background_thread() {
+	MutexLock lock(_background_thread_mutex);
+	if (!_background_thread_started) {
+		return;
+	}
+	_background_thread_stop = true;
+	_background_semaphore.post();
+	_background_thread.wait_to_finish();
+	_background_thread_started = false;
+	_background_thread_stop = false;
+	_background_work_requested = false;
+}
+
+void VoxelStreamLog::background_thread_func_static(void *p_data) {
+	VoxelStreamLog &stream = *static_cast<VoxelStreamLog *>(p_data);
+	Thread::set_name("Voxel log maintenance");
+
+	while (true) {
+		stream._background_semaphore.wait();
+		if (stream._background_thread_stop) {
+			break;
+		}
+		stream._background_work_requested = false;
+		stream.compact();
+	}
+}
+
+void VoxelStreamLog::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_directory", "directory"), &VoxelStreamLog::set_directory);
+	ClassDB::bind_method(D_METHOD("get_directory"), &VoxelStreamLog::get_directory);
+
+	ClassDB::bind_method(D_METHOD("set_segment_size", "size_in_bytes"), &VoxelStreamLog::set_segment_size);
+	ClassDB::bind_method(D_METHOD("get_segment_size"), &VoxelStreamLog::get_segment_size);
+
+	ClassDB::bind_method(D_METHOD("set_compaction_threshold", "ratio"), &VoxelStreamLog::set_compaction_threshold);
+	ClassDB::bind_method(D_METHOD("get_compaction_threshold"), &VoxelStreamLog::get_compaction_threshold);
+
+	ClassDB::bind_method(D_METHOD("save_checkpoint"), &VoxelStreamLog::save_checkpoint);
+	ClassDB::bind_method(D_METHOD("compact"), &VoxelStreamLog::compact);
+
+	ADD_PROPERTY(PropertyInfo(Variant::STRING, "directory", PROPERTY_HINT_DIR), "set_directory", "get_directory");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "segment_size", PROPERTY_HINT_RANGE, "1048576,1073741824,1048576"),
+			"set_segment_size", "get_segment_size");
+	ADD_PROPERTY(PropertyInfo(Variant::REAL, "compaction_threshold", PROPERTY_HINT_RANGE, "0.05,1.0,0.01"),
+			"set_compaction_threshold", "get_compaction_threshold");
+}
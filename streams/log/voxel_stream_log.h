@@ -0,0 +1,178 @@
+#ifndef VOXEL_STREAM_LOG_H
+#define VOXEL_STREAM_LOG_H
+
+#include "../../constants/voxel_constants.h"
+#include "../../util/fixed_array.h"
+#include "../voxel_block_serializer.h"
+#include "../voxel_stream.h"
+#include "log_segment.h"
+#include <core/os/mutex.h>
+#include <core/os/rw_lock.h>
+#include <core/os/semaphore.h>
+#include <core/os/thread.h>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Saves blocks by appending them to segment files under a directory, like a log.
+// Saving never rewrites existing data, so writes are sequential and a crash can only lose the last saves.
+// An in-memory index tells where the latest version of each block is, so loading a block takes a single read.
+//
+// The index is checkpointed to a file when a segment gets full, so opening the stream only has to read the
+// checkpoint and the records written after it. Older versions of blocks are garbage, and segments having too much
+// of it get compacted in the background: their live blocks are appended again, then the file is removed.
+//
+// Intended for servers saving lots of blocks frequently.
+class VoxelStreamLog : public VoxelStream {
+	GDCLASS(VoxelStreamLog, VoxelStream)
+public:
+	static const char *CHECKPOINT_FILE_NAME;
+	static const uint32_t DEFAULT_SEGMENT_SIZE = 32 * 1024 * 1024;
+	static const uint32_t MIN_SEGMENT_SIZE = 1024 * 1024;
+
+	VoxelStreamLog();
+	~VoxelStreamLog();
+
+	void set_directory(String dirpath);
+	String get_directory() const;
+
+	// Segments are sealed and a new one is started once they reach this size in bytes
+	void set_segment_size(int size_in_bytes);
+	int get_segment_size() const;
+
+	// Sealed segments are compacted when at least this ratio of their size is taken by superseded blocks
+	void set_compaction_threshold(float ratio);
+	float get_compaction_threshold() const;
+
+	Result emerge_block(Ref<VoxelBuffer> out_buffer, Vector3i origin_in_voxels, int lod) override;
+	void immerge_block(Ref<VoxelBuffer> buffer, Vector3i origin_in_voxels, int lod) override;
+
+	void emerge_blocks(Vector<VoxelBlockRequest> &p_blocks, Vector<Result> &out_results) override;
+	void immerge_blocks(const Vector<VoxelBlockRequest> &p_blocks) override;
+
+	bool supports_instance_blocks() const override;
+	void load_instance_blocks(
+			Span<VoxelStreamInstanceDataRequest> out_blocks, Span<Result> out_results) override;
+	void save_instance_blocks(Span<VoxelStreamInstanceDataRequest> p_blocks) override;
+
+	bool may_have_block(Vector3i origin_in_voxels, int lod) override;
+
+	int get_used_channels_mask() const override;
+
+	// Writes the index to the checkpoint file, so the next opening doesn't have to read the whole log
+	void save_checkpoint();
+	// Compacts segments having enough garbage. This is normally done in the background.
+	void compact();
+
+private:
+	// Where a version of a block is stored
+	struct Location {
+		// 0 means there is none
+		uint32_t segment_id = 0;
+		// Size of the record, including its header
+		uint32_t size = 0;
+		uint64_t offset = 0;
+
+		inline bool operator==(const Location &other) const {
+			return segment_id == other.segment_id && offset == other.offset;
+		}
+	};
+
+	struct IndexEntry {
+		FixedArray<Location, VoxelLogSegment::RECORD_TYPE_COUNT> locations;
+	};
+
+	struct Segment {
+		VoxelLogSegment file;
+		// Bytes taken by records the index refers to. The rest of the file is garbage.
+		uint64_t live_size = 0;
+		// Sealed segments are no longer appended to, and can be compacted
+		bool sealed = true;
+	};
+
+	// Serialized version of a block, ready to be appended
+	struct PendingRecord {
+		VoxelLogSegment::RecordHeader header;
+		std::vector<uint8_t> payload;
+		// When compacting, where the record was. It is skipped if the block got saved again since then.
+		// For deletions, it is skipped if the block got saved again at all.
+		Location previous_location;
+	};
+
+	// Lookup of a block in the index
+	struct RecordQuery {
+		unsigned int request_index;
+		VoxelLogSegment::RecordHeader key;
+		Location location;
+		std::shared_ptr<Segment> segment;
+	};
+
+	// Position of the log up to which the checkpoint has all records
+	struct LogPosition {
+		uint32_t segment_id = 0;
+		uint64_t offset = 0;
+	};
+
+	bool ensure_loaded();
+	bool load();
+	void close();
+	bool load_checkpoint(LogPosition &out_position);
+	void make_checkpoint(std::vector<uint8_t> &out_data);
+	bool write_checkpoint_file(const String &fpath, const std::vector<uint8_t> &data);
+	bool save_checkpoint_internal();
+	Location apply_record(const VoxelLogSegment::RecordHeader &header, Location location);
+	bool start_new_segment();
+	bool append_records(Span<const PendingRecord> records);
+	void find_records(std::vector<RecordQuery> &queries);
+	std::shared_ptr<Segment> find_segment(uint32_t id) const;
+	bool is_worth_compacting(const Segment &segment) const;
+	void compact_segment(Segment &segment);
+
+	void request_background_work();
+	void stop_background_thread();
+	static void background_thread_func_static(void *p_data);
+
+	static void _bind_methods();
+
+	String _directory_path;
+	uint32_t _segment_size = DEFAULT_SEGMENT_SIZE;
+	// Modified with both the mutex and the index locked
+	float _compaction_threshold = 0.5f;
+
+	// Protects the directory path, loading, and appending to the log.
+	// The index is only modified with this mutex locked, so appends and index updates happen in the same order.
+	Mutex _mutex;
+	std::atomic<bool> _loaded{ false };
+	bool _load_failed = false;
+	std::shared_ptr<Segment> _active_segment;
+	// Segment IDs are never reused, even after compaction removed the last ones
+	uint32_t _next_segment_id = 1;
+	// Incremented when the index changes. The checkpoint file is up to date when both counts are equal.
+	uint32_t _change_count = 0;
+	uint32_t _checkpoint_change_count = 0;
+	bool _compaction_pending = false;
+
+	// Protects the index and the list of segments.
+	// Readers only need this lock, so loading blocks doesn't wait for saves to be written.
+	RWLock _index_lock;
+	FixedArray<std::unordered_map<Vector3i, IndexEntry>, VoxelConstants::MAX_LOD> _index;
+	// Sorted by ID, which is also the order they were written
+	std::vector<std::shared_ptr<Segment>> _segments;
+
+	// Only one checkpoint or compaction runs at a time
+	Mutex _maintenance_mutex;
+
+	// Saves checkpoints and compacts segments in the background
+	Thread _background_thread;
+	Semaphore _background_semaphore;
+	Mutex _background_thread_mutex;
+	bool _background_thread_started = false;
+	std::atomic<bool> _background_thread_stop{ false };
+	std::atomic<bool> _background_work_requested{ false };
+	std::atomic<bool> _checkpoint_requested{ false };
+
+	static thread_local VoxelBlockSerializerInternal _voxel_block_serializer;
+};
+
+#endif // VOXEL_STREAM_LOG_H
@@ -0,0 +1,203 @@
+#include "positional_file_reader.h"
+
+#include <core/os/file_access.h>
+#include <core/project_settings.h>
+#include <string.h>
+
+#if defined(UNIX_ENABLED)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(WINDOWS_ENABLED)
+#include <windows.h>
+#endif
+
+VoxelPositionalFileReader::~VoxelPositionalFileReader() {
+	close();
+}
+
+Error VoxelPositionalFileReader::open(const String &fpath) {
+	close();
+
+	const String global_path = ProjectSettings::get_singleton()->globalize_path(fpath);
+
+#if defined(UNIX_ENABLED)
+	_fd = ::open(global_path.utf8().get_data(), O_RDONLY);
+	if (_fd != -1) {
+		update_mapping();
+		return OK;
+	}
+#elif defined(WINDOWS_ENABLED)
+	HANDLE handle = CreateFileW(global_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle != INVALID_HANDLE_VALUE) {
+		_handle = handle;
+		update_mapping();
+		return OK;
+	}
+#endif
+
+	Error err;
+	_fallback_file = FileAccess::open(fpath, FileAccess::READ, &err);
+	return err;
+}
+
+void VoxelPositionalFileReader::close() {
+	unmap();
+#if defined(UNIX_ENABLED)
+	if (_fd != -1) {
+		::close(_fd);
+		_fd = -1;
+	}
+#elif defined(WINDOWS_ENABLED)
+	if (_handle != nullptr) {
+		CloseHandle(_handle);
+		_handle = nullptr;
+	}
+#endif
+	if (_fallback_file != nullptr) {
+		memdelete(_fallback_file);
+		_fallback_file = nullptr;
+	}
+}
+
+bool VoxelPositionalFileReader::is_open() const {
+#if defined(UNIX_ENABLED)
+	if (_fd != -1) {
+		return true;
+	}
+#elif defined(WINDOWS_ENABLED)
+	if (_handle != nullptr) {
+		return true;
+	}
+#endif
+	return _fallback_file != nullptr;
+}
+
+void VoxelPositionalFileReader::unmap() {
+#if defined(UNIX_ENABLED)
+	if (_mapped_data != nullptr) {
+		munmap(const_cast<uint8_t *>(_mapped_data), _mapped_size);
+	}
+#elif defined(WINDOWS_ENABLED)
+	if (_mapped_data != nullptr) {
+		UnmapViewOfFile(_mapped_data);
+	}
+	if (_mapping_handle != nullptr) {
+		CloseHandle(_mapping_handle);
+		_mapping_handle = nullptr;
+	}
+#endif
+	_mapped_data = nullptr;
+	_mapped_size = 0;
+}
+
+void VoxelPositionalFileReader::update_mapping() {
+	// If mapping fails, reads will use the regular path
+#if defined(UNIX_ENABLED)
+	if (_fd == -1) {
+		return;
+	}
+	struct stat st;
+	if (fstat(_fd, &st) != 0) {
+		return;
+	}
+	const size_t file_size = st.st_size;
+	if (file_size == _mapped_size) {
+		return;
+	}
+	unmap();
+	if (file_size == 0) {
+		return;
+	}
+	void *data = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, _fd, 0);
+	if (data == MAP_FAILED) {
+		return;
+	}
+	_mapped_data = static_cast<const uint8_t *>(data);
+	_mapped_size = file_size;
+
+#elif defined(WINDOWS_ENABLED)
+	if (_handle == nullptr) {
+		return;
+	}
+	LARGE_INTEGER st;
+	if (!GetFileSizeEx(_handle, &st)) {
+		return;
+	}
+	const uint64_t file_size = st.QuadPart;
+	if (file_size == _mapped_size || file_size > SIZE_MAX) {
+		return;
+	}
+	unmap();
+	if (file_size == 0) {
+		// Empty files can't be mapped
+		return;
+	}
+	_mapping_handle = CreateFileMappingW(_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (_mapping_handle == nullptr) {
+		return;
+	}
+	const void *data = MapViewOfFile(_mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		CloseHandle(_mapping_handle);
+		_mapping_handle = nullptr;
+		return;
+	}
+	_mapped_data = static_cast<const uint8_t *>(data);
+	_mapped_size = file_size;
+#endif
+}
+
+Span<const uint8_t> VoxelPositionalFileReader::get_mapped_range(uint64_t offset, size_t size) const {
+	if (_mapped_data == nullptr || offset > _mapped_size || size > _mapped_size - offset) {
+		return Span<const uint8_t>();
+	}
+	return Span<const uint8_t>(_mapped_data + offset, size);
+}
+
+size_t VoxelPositionalFileReader::read(uint64_t offset, uint8_t *dst, size_t size) const {
+	const Span<const uint8_t> mapped = get_mapped_range(offset, size);
+	if (mapped.size() != 0) {
+		memcpy(dst, mapped.data(), size);
+		return size;
+	}
+
+#if defined(UNIX_ENABLED)
+	if (_fd != -1) {
+		size_t total = 0;
+		while (total < size) {
+			const ssize_t n = ::pread(_fd, dst + total, size - total, offset + total);
+			if (n <= 0) {
+				// End of file or error
+				break;
+			}
+			total += n;
+		}
+		return total;
+	}
+#elif defined(WINDOWS_ENABLED)
+	if (_handle != nullptr) {
+		size_t total = 0;
+		while (total < size) {
+			// Reads with an offset don't use the file pointer, as long as they are all done this way
+			OVERLAPPED overlapped = {};
+			const uint64_t pos = offset + total;
+			overlapped.Offset = static_cast<DWORD>(pos & 0xffffffff);
+			overlapped.OffsetHigh = static_cast<DWORD>(pos >> 32);
+			const DWORD to_read = static_cast<DWORD>(MIN(size - total, static_cast<size_t>(0x40000000)));
+			DWORD n = 0;
+			if (!ReadFile(_handle, dst + total, to_read, &n, &overlapped) || n == 0) {
+				break;
+			}
+			total += n;
+		}
+		return total;
+	}
+#endif
+	ERR_FAIL_COND_V(_fallback_file == nullptr, 0);
+	MutexLock lock(_fallback_mutex);
+	_fallback_file->seek(offset);
+	return _fallback_file->get_buffer(dst, size);
+}
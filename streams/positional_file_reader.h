@@ -0,0 +1,50 @@
+#ifndef VOXEL_POSITIONAL_FILE_READER_H
+#define VOXEL_POSITIONAL_FILE_READER_H
+
+#include "../util/span.h"
+#include <core/os/mutex.h>
+#include <core/ustring.h>
+
+class FileAccess;
+
+// Read-only file handle where each read specifies its own offset, instead of sharing a cursor.
+// Multiple threads can read from the same instance at the same time.
+// Uses the OS API when the file has a native path, and falls back on a locked `FileAccess` otherwise
+// (for example with files packed inside the game executable).
+// When possible, the file is also mapped in memory, so reads within the mapping don't need system calls.
+class VoxelPositionalFileReader {
+public:
+	~VoxelPositionalFileReader();
+
+	Error open(const String &fpath);
+	void close();
+	bool is_open() const;
+
+	// Returns how many bytes were read, which is less than `size` if the end of the file was reached
+	size_t read(uint64_t offset, uint8_t *dst, size_t size) const;
+
+	// Gets a range of the file directly from the memory mapping, without copying it.
+	// Returns an empty span if the range isn't mapped, in which case `read` should be used instead.
+	Span<const uint8_t> get_mapped_range(uint64_t offset, size_t size) const;
+
+	// Maps the file again if its size changed since the last mapping.
+	// Data written within the mapped range is visible without doing this, but data appended after it is not.
+	// Must not be called while other threads are reading.
+	void update_mapping();
+
+private:
+	void unmap();
+
+#if defined(UNIX_ENABLED)
+	int _fd = -1;
+#elif defined(WINDOWS_ENABLED)
+	void *_handle = nullptr;
+	void *_mapping_handle = nullptr;
+#endif
+	const uint8_t *_mapped_data = nullptr;
+	size_t _mapped_size = 0;
+	FileAccess *_fallback_file = nullptr;
+	mutable Mutex _fallback_mutex;
+};
+
+#endif // VOXEL_POSITIONAL_FILE_READER_H
@@ -3,6 +3,7 @@
 #include "../../util/macros.h"
 #include "../../util/profiling.h"
 #include "../file_utils.h"
+#include <core/io/marshalls.h>
 #include <core/os/file_access.h>
 #include <algorithm>
 
@@ -18,6 +19,8 @@ const char *FORMAT_REGION_MAGIC = "VXR_";
 const uint32_t MAGIC_AND_VERSION_SIZE = 4 + 1;
 const uint32_t FIXED_HEADER_DATA_SIZE = 7 + VoxelRegionFormat::CHANNEL_COUNT;
 const uint32_t PALETTE_SIZE_IN_BYTES = 256 * 4;
+// Adjacent blocks are read together as long as it doesn't exceed this size
+const uint32_t MAX_BATCHED_READ_SIZE = 1024 * 1024;
 } // namespace
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -208,6 +211,7 @@ Error VoxelRegionFile::open(const String &fpath, bool create_if_not_found) {
 
 			_header.version = FORMAT_VERSION;
 			ERR_FAIL_COND_V(save_header(f) == false, ERR_FILE_CANT_WRITE);
+			f->flush();
 
 		} else {
 			return file_error;
@@ -222,6 +226,13 @@ Error VoxelRegionFile::open(const String &fpath, bool create_if_not_found) {
 
 	_file_access = f;
 
+	const Error reader_error = _reader.open(fpath);
+	if (reader_error != OK) {
+		ERR_PRINT(String("Failed to open {0} for reading").format(varray(fpath)));
+		close();
+		return reader_error;
+	}
+
 	// Precalculate location of sectors and which block they contain.
 	// This will be useful to know when sectors get moved on insertion and removal
 
@@ -248,13 +259,29 @@ Error VoxelRegionFile::open(const String &fpath, bool create_if_not_found) {
 			});
 
 	CRASH_COND(_sectors.size() != 0);
+	CRASH_COND(_free_sectors.size() != 0);
 	for (unsigned int i = 0; i < blocks_sorted_by_offset.size(); ++i) {
 		const BlockInfoAndIndex b = blocks_sorted_by_offset[i];
+		const uint32_t sector_index = b.b.get_sector_index();
+		if (sector_index < _sectors.size()) {
+			ERR_PRINT(String("Overlapping blocks in region file {0}").format(varray(fpath)));
+			close();
+			return ERR_FILE_CORRUPT;
+		}
+		if (sector_index > _sectors.size()) {
+			// Sectors between blocks are free
+			SectorRange range;
+			range.index = _sectors.size();
+			range.count = sector_index - _sectors.size();
+			_free_sectors.push_back(range);
+			_sectors.resize(sector_index);
+		}
 		Vector3i bpos = get_block_position_from_index(b.i);
 		for (unsigned int j = 0; j < b.b.get_sector_count(); ++j) {
 			_sectors.push_back(bpos);
 		}
 	}
+	_saved_header_sector_count = _sectors.size();
 
 #ifdef DEBUG_ENABLED
 	debug_check();
@@ -278,7 +305,10 @@ Error VoxelRegionFile::close() {
 		memdelete(_file_access);
 		_file_access = nullptr;
 	}
+	_reader.close();
 	_sectors.clear();
+	_free_sectors.clear();
+	_saved_header_sector_count = 0;
 	return err;
 }
 
@@ -302,10 +332,10 @@ const VoxelRegionFormat &VoxelRegionFile::get_format() const {
 }
 
 Error VoxelRegionFile::load_block(
-		Vector3i position, Ref<VoxelBuffer> out_block, VoxelBlockSerializerInternal &serializer) {
+		Vector3i position, Ref<VoxelBuffer> out_block, VoxelBlockSerializerInternal &serializer) const {
 	ERR_FAIL_COND_V(out_block.is_null(), ERR_INVALID_PARAMETER);
 	ERR_FAIL_COND_V(_file_access == nullptr, ERR_FILE_CANT_READ);
-	FileAccess *f = _file_access;
+	ERR_FAIL_COND_V(!_reader.is_open(), ERR_FILE_CANT_READ);
 
 	const unsigned int lut_index = get_block_index_in_header(position);
 	ERR_FAIL_COND_V(lut_index >= _header.blocks.size(), ERR_INVALID_PARAMETER);
@@ -315,27 +345,133 @@ Error VoxelRegionFile::load_block(
 		return ERR_DOES_NOT_EXIST;
 	}
 
-	ERR_FAIL_COND_V(out_block->get_size() != out_block->get_size(), ERR_INVALID_PARAMETER);
-	// Configure block format
-	for (unsigned int channel_index = 0; channel_index < _header.format.channel_depths.size(); ++channel_index) {
-		out_block->set_channel_depth(channel_index, _header.format.channel_depths[channel_index]);
+	const unsigned int sector_index = block_info.get_sector_index();
+	const uint64_t block_begin = _blocks_begin_offset + static_cast<uint64_t>(sector_index) * _header.format.sector_size;
+	const size_t sectors_size = block_info.get_sector_count() * _header.format.sector_size;
+
+	// Decompress straight from the file mapping if possible, otherwise read a copy.
+	// Reading with explicit offsets, so other threads can load blocks from the same file at the same time.
+	Span<const uint8_t> sectors = _reader.get_mapped_range(block_begin, sectors_size);
+	if (sectors.size() != sectors_size) {
+		static thread_local std::vector<uint8_t> tls_block_data;
+		tls_block_data.resize(sectors_size);
+		// The last block of the file might not be padded, so we can get less than requested
+		const size_t read_size = _reader.read(block_begin, tls_block_data.data(), sectors_size);
+		sectors = Span<const uint8_t>(tls_block_data.data(), read_size);
 	}
 
-	const unsigned int sector_index = block_info.get_sector_index();
-	const unsigned int block_begin = _blocks_begin_offset + sector_index * _header.format.sector_size;
+	return load_block_from_sectors(sectors, position, **out_block, serializer);
+}
+
+void VoxelRegionFile::load_blocks(Span<const Vector3i> positions, Span<Ref<VoxelBuffer>> out_blocks,
+		Span<Error> out_errors, VoxelBlockSerializerInternal &serializer) const {
+	VOXEL_PROFILE_SCOPE();
+	CRASH_COND(positions.size() != out_blocks.size());
+	CRASH_COND(positions.size() != out_errors.size());
 
-	f->seek(block_begin);
+	for (size_t i = 0; i < out_errors.size(); ++i) {
+		out_errors[i] = ERR_FILE_CANT_READ;
+	}
+	ERR_FAIL_COND(_file_access == nullptr);
+	ERR_FAIL_COND(!_reader.is_open());
 
-	unsigned int block_data_size = f->get_32();
-	CRASH_COND(f->eof_reached());
+	struct BlockLocation {
+		uint32_t sector_index;
+		uint32_t sector_count;
+		unsigned int request_index;
+	};
 
-	ERR_FAIL_COND_V_MSG(!serializer.decompress_and_deserialize(f, block_data_size, **out_block), ERR_PARSE_ERROR,
-			String("Failed to read block {0}").format(varray(position.to_vec3())));
+	static thread_local std::vector<BlockLocation> tls_locations;
+	std::vector<BlockLocation> &locations = tls_locations;
+	locations.clear();
+
+	for (size_t i = 0; i < positions.size(); ++i) {
+		ERR_CONTINUE(out_blocks[i].is_null());
+		const unsigned int lut_index = get_block_index_in_header(positions[i]);
+		if (lut_index >= _header.blocks.size()) {
+			out_errors[i] = ERR_INVALID_PARAMETER;
+			continue;
+		}
+		const VoxelRegionBlockInfo &block_info = _header.blocks[lut_index];
+		if (block_info.data == 0) {
+			out_errors[i] = ERR_DOES_NOT_EXIST;
+			continue;
+		}
+		BlockLocation location;
+		location.sector_index = block_info.get_sector_index();
+		location.sector_count = block_info.get_sector_count();
+		location.request_index = i;
+		locations.push_back(location);
+	}
+
+	std::sort(locations.begin(), locations.end(), [](const BlockLocation &a, const BlockLocation &b) {
+		return a.sector_index < b.sector_index;
+	});
+
+	const unsigned int sector_size = _header.format.sector_size;
+	static thread_local std::vector<uint8_t> tls_range_data;
+
+	unsigned int begin = 0;
+	while (begin < locations.size()) {
+		// Find following blocks stored right after this one
+		const uint32_t range_begin = locations[begin].sector_index;
+		uint32_t range_end = range_begin + locations[begin].sector_count;
+		unsigned int end = begin + 1;
+		while (end < locations.size() && locations[end].sector_index == range_end &&
+				(range_end + locations[end].sector_count - range_begin) * sector_size <= MAX_BATCHED_READ_SIZE) {
+			range_end += locations[end].sector_count;
+			++end;
+		}
+
+		const uint64_t range_offset = _blocks_begin_offset + static_cast<uint64_t>(range_begin) * sector_size;
+		const size_t range_size = (range_end - range_begin) * sector_size;
+
+		Span<const uint8_t> range_data = _reader.get_mapped_range(range_offset, range_size);
+		if (range_data.size() != range_size) {
+			tls_range_data.resize(range_size);
+			// The last block of the file might not be padded, so we can get less than requested
+			const size_t read_size = _reader.read(range_offset, tls_range_data.data(), range_size);
+			range_data = Span<const uint8_t>(tls_range_data.data(), read_size);
+		}
+
+		for (unsigned int i = begin; i < end; ++i) {
+			const BlockLocation &location = locations[i];
+			const size_t offset = (location.sector_index - range_begin) * sector_size;
+			const unsigned int ri = location.request_index;
+			if (offset >= range_data.size()) {
+				out_errors[ri] = ERR_FILE_CORRUPT;
+				continue;
+			}
+			const size_t size = MIN(static_cast<size_t>(location.sector_count) * sector_size, range_data.size() - offset);
+			out_errors[ri] = load_block_from_sectors(
+					Span<const uint8_t>(range_data.data() + offset, size), positions[ri], **out_blocks[ri], serializer);
+		}
+
+		begin = end;
+	}
+}
+
+// Decodes a block from the sectors it is stored in
+Error VoxelRegionFile::load_block_from_sectors(Span<const uint8_t> sectors, Vector3i position,
+		VoxelBuffer &out_block, VoxelBlockSerializerInternal &serializer) const {
+	// Configure block format
+	for (unsigned int channel_index = 0; channel_index < _header.format.channel_depths.size(); ++channel_index) {
+		out_block.set_channel_depth(channel_index, _header.format.channel_depths[channel_index]);
+	}
+
+	ERR_FAIL_COND_V(sectors.size() < sizeof(uint32_t), ERR_FILE_CORRUPT);
+	const unsigned int block_data_size = decode_uint32(sectors.data());
+	ERR_FAIL_COND_V(block_data_size > sectors.size() - sizeof(uint32_t), ERR_FILE_CORRUPT);
+
+	ERR_FAIL_COND_V_MSG(!serializer.decompress_and_deserialize(
+								Span<const uint8_t>(sectors.data() + sizeof(uint32_t), block_data_size), out_block),
+			ERR_PARSE_ERROR, String("Failed to read block {0}").format(varray(position.to_vec3())));
 
 	return OK;
 }
 
-Error VoxelRegionFile::save_block(Vector3i position, Ref<VoxelBuffer> block, VoxelBlockSerializerInternal &serializer) {
+Error VoxelRegionFile::save_block(
+		Vector3i position, Ref<VoxelBuffer> block, VoxelBlockSerializerInternal &serializer, int lz4_acceleration) {
 	ERR_FAIL_COND_V(block.is_null(), ERR_INVALID_PARAMETER);
 	ERR_FAIL_COND_V(_header.format.verify_block(**block) == false, ERR_INVALID_PARAMETER);
 
@@ -351,32 +487,19 @@ Error VoxelRegionFile::save_block(Vector3i position, Ref<VoxelBuffer> block, Vox
 	ERR_FAIL_COND_V(lut_index >= _header.blocks.size(), ERR_INVALID_PARAMETER);
 	VoxelRegionBlockInfo &block_info = _header.blocks[lut_index];
 
-	if (block_info.data == 0) {
-		// The block isn't in the file yet, append at the end
-
-		const unsigned int end_offset = _blocks_begin_offset + _sectors.size() * _header.format.sector_size;
-		f->seek(end_offset);
-		const unsigned int block_offset = f->get_position();
-		// Check position matches the sectors rule
-		CRASH_COND((block_offset - _blocks_begin_offset) % _header.format.sector_size != 0);
-
-		VoxelBlockSerializerInternal::SerializeResult res = serializer.serialize_and_compress(**block);
-		ERR_FAIL_COND_V(!res.success, ERR_INVALID_PARAMETER);
-		f->store_32(res.data.size());
-		const unsigned int written_size = sizeof(int) + res.data.size();
-		f->store_buffer(res.data.data(), res.data.size());
-
-		const unsigned int end_pos = f->get_position();
-		CRASH_COND(written_size != (end_pos - block_offset));
-		pad_to_sector_size(f);
+	VoxelBlockSerializerInternal::SerializeResult res = serializer.serialize_and_compress(**block, lz4_acceleration);
+	ERR_FAIL_COND_V(!res.success, ERR_INVALID_PARAMETER);
+	const std::vector<uint8_t> &data = res.data;
+	const unsigned int written_size = sizeof(uint32_t) + data.size();
 
-		block_info.set_sector_index((block_offset - _blocks_begin_offset) / _header.format.sector_size);
-		block_info.set_sector_count(get_sector_count_from_bytes(written_size));
+	const uint32_t new_sector_count = get_sector_count_from_bytes(written_size);
+	ERR_FAIL_COND_V(new_sector_count > VoxelRegionBlockInfo::MAX_SECTOR_COUNT, ERR_INVALID_PARAMETER);
 
-		for (unsigned int i = 0; i < block_info.get_sector_count(); ++i) {
-			_sectors.push_back(position);
-		}
+	uint32_t sector_index;
 
+	if (block_info.data == 0) {
+		// The block isn't in the file yet
+		ERR_FAIL_COND_V(!allocate_sectors(position, new_sector_count, sector_index), ERR_FILE_CANT_WRITE);
 		_header_modified = true;
 
 	} else {
@@ -384,64 +507,50 @@ Error VoxelRegionFile::save_block(Vector3i position, Ref<VoxelBuffer> block, Vox
 
 		CRASH_COND(_sectors.size() == 0);
 
-		const int old_sector_index = block_info.get_sector_index();
-		const int old_sector_count = block_info.get_sector_count();
+		const uint32_t old_sector_index = block_info.get_sector_index();
+		const uint32_t old_sector_count = block_info.get_sector_count();
 		CRASH_COND(old_sector_count < 1);
 
-		VoxelBlockSerializerInternal::SerializeResult res = serializer.serialize_and_compress(**block);
-		ERR_FAIL_COND_V(!res.success, ERR_INVALID_PARAMETER);
-		const std::vector<uint8_t> &data = res.data;
-		const int written_size = sizeof(int) + data.size();
-
-		const int new_sector_count = get_sector_count_from_bytes(written_size);
-		CRASH_COND(new_sector_count < 1);
-
 		if (new_sector_count <= old_sector_count) {
 			// We can write the block at the same spot
-
 			if (new_sector_count < old_sector_count) {
-				// The block now uses less sectors, we can compact others.
-				remove_sectors_from_block(position, old_sector_count - new_sector_count);
+				// The block now uses less sectors, the remaining ones become free
+				free_sectors(old_sector_index + new_sector_count, old_sector_count - new_sector_count);
 				_header_modified = true;
 			}
-
-			const int block_offset = _blocks_begin_offset + old_sector_index * _header.format.sector_size;
-			f->seek(block_offset);
-
-			f->store_32(data.size());
-			f->store_buffer(data.data(), data.size());
-
-			int end_pos = f->get_position();
-			CRASH_COND(written_size != (end_pos - block_offset));
+			sector_index = old_sector_index;
 
 		} else {
-			// The block now uses more sectors, we have to move others.
-			// Note: we could shift blocks forward, but we can also remove the block entirely and rewrite it at the end.
-			// Need to investigate if it's worth implementing forward shift instead.
-
-			remove_sectors_from_block(position, old_sector_count);
+			// The block now uses more sectors.
+			// Instead of shifting all following sectors, find another spot and free the current ones.
+			// They are freed after, so the header saved in the file keeps pointing to intact data.
+			ERR_FAIL_COND_V(!allocate_sectors(position, new_sector_count, sector_index), ERR_FILE_CANT_WRITE);
+			free_sectors(old_sector_index, old_sector_count);
+			_header_modified = true;
+		}
+	}
 
-			const int block_offset = _blocks_begin_offset + _sectors.size() * _header.format.sector_size;
-			f->seek(block_offset);
+	const unsigned int block_offset = _blocks_begin_offset + sector_index * _header.format.sector_size;
+	f->seek(block_offset);
 
-			f->store_32(data.size());
-			f->store_buffer(data.data(), data.size());
+	f->store_32(data.size());
+	f->store_buffer(data.data(), data.size());
 
-			const int end_pos = f->get_position();
-			CRASH_COND(written_size != (end_pos - block_offset));
+	const unsigned int end_pos = f->get_position();
+	CRASH_COND(written_size != (end_pos - block_offset));
 
-			pad_to_sector_size(f);
+	if (sector_index + new_sector_count == _sectors.size()) {
+		// The block is at the end of the file
+		pad_to_sector_size(f);
+	}
 
-			block_info.set_sector_index(_sectors.size());
-			for (int i = 0; i < new_sector_count; ++i) {
-				_sectors.push_back(Vector3u16(position));
-			}
+	block_info.set_sector_index(sector_index);
+	block_info.set_sector_count(new_sector_count);
 
-			_header_modified = true;
-		}
-
-		block_info.set_sector_count(new_sector_count);
-	}
+	// Blocks are read with a different handle, which must see what we wrote.
+	// The caller prevents reads during saves, so the mapping can be updated if the file grew.
+	f->flush();
+	_reader.update_mapping();
 
 	return OK;
 }
@@ -459,80 +568,215 @@ void VoxelRegionFile::pad_to_sector_size(FileAccess *f) {
 	}
 }
 
-void VoxelRegionFile::remove_sectors_from_block(Vector3i block_pos, unsigned int p_sector_count) {
-	VOXEL_PROFILE_SCOPE();
+// Finds room for a block, and outputs the index of its first sector
+bool VoxelRegionFile::allocate_sectors(Vector3i block_pos, uint32_t sector_count, uint32_t &out_sector_index) {
+	CRASH_COND(sector_count == 0);
+
+	// Best fit: use the smallest free range the block fits in, so larger ones remain available
+	int best_range_index = -1;
+	for (unsigned int i = 0; i < _free_sectors.size(); ++i) {
+		const SectorRange &range = _free_sectors[i];
+		if (range.count >= sector_count &&
+				(best_range_index == -1 || range.count < _free_sectors[best_range_index].count)) {
+			best_range_index = i;
+			if (range.count == sector_count) {
+				break;
+			}
+		}
+	}
 
-	// Removes sectors from a block, starting from the last ones.
-	// So if a block has 5 sectors and we remove 2, the first 3 will be preserved.
-	// Then all following sectors are moved earlier in the file to fill the gap.
+	const uint32_t sector_index = best_range_index == -1 ? _sectors.size() : _free_sectors[best_range_index].index;
 
-	CRASH_COND(_file_access == nullptr);
-	CRASH_COND(p_sector_count <= 0);
+	// Free sectors may still be used by blocks of the header saved in the file, if it wasn't saved since they
+	// were freed. Save it before overwriting them, so the file stays valid if the process stops while writing.
+	if (_header_modified && sector_index < _saved_header_sector_count) {
+		ERR_FAIL_COND_V(!save_header(_file_access), false);
+		_file_access->flush();
+	}
 
-	FileAccess *f = _file_access;
-	const unsigned int sector_size = _header.format.sector_size;
-	const unsigned int old_end_offset = _blocks_begin_offset + _sectors.size() * sector_size;
+	if (best_range_index == -1) {
+		// No free range is large enough, append at the end
+		_sectors.resize(_sectors.size() + sector_count);
 
-	const unsigned int block_index = get_block_index_in_header(block_pos);
-	CRASH_COND(block_index >= _header.blocks.size());
-	VoxelRegionBlockInfo &block_info = _header.blocks[block_index];
+	} else {
+		SectorRange &range = _free_sectors[best_range_index];
+		if (range.count == sector_count) {
+			_free_sectors.erase(_free_sectors.begin() + best_range_index);
+		} else {
+			range.index += sector_count;
+			range.count -= sector_count;
+		}
+	}
+
+	CRASH_COND(sector_index + sector_count > VoxelRegionBlockInfo::MAX_SECTOR_INDEX);
 
-	unsigned int src_offset = _blocks_begin_offset +
-							  (block_info.get_sector_index() + block_info.get_sector_count()) * sector_size;
+	for (unsigned int i = 0; i < sector_count; ++i) {
+		_sectors[sector_index + i] = Vector3u16(block_pos);
+	}
 
-	unsigned int dst_offset = src_offset - p_sector_count * sector_size;
+	out_sector_index = sector_index;
+	return true;
+}
 
-	// Note: removing the last block from a region doesn't make the file invalid, but is not a known use case
-	CRASH_COND(_sectors.size() - p_sector_count <= 0);
-	CRASH_COND(src_offset - sector_size < dst_offset);
-	CRASH_COND(block_info.get_sector_index() + p_sector_count > _sectors.size());
-	CRASH_COND(p_sector_count > block_info.get_sector_count());
-	CRASH_COND(dst_offset < _blocks_begin_offset);
+void VoxelRegionFile::free_sectors(uint32_t sector_index, uint32_t sector_count) {
+	CRASH_COND(sector_count == 0);
+	CRASH_COND(sector_index + sector_count > _sectors.size());
 
-	std::vector<uint8_t> temp;
-	temp.resize(sector_size);
+	for (unsigned int i = 0; i < sector_count; ++i) {
+		_sectors[sector_index + i] = Vector3u16();
+	}
 
-	// TODO There might be a faster way to shrink a file
-	// Erase sectors from file
-	while (src_offset < old_end_offset) {
-		f->seek(src_offset);
-		size_t read_bytes = f->get_buffer(temp.data(), sector_size);
-		CRASH_COND(read_bytes != sector_size); // Corrupted file
+	// Insert in sorted order
+	unsigned int range_index = 0;
+	while (range_index < _free_sectors.size() && _free_sectors[range_index].index < sector_index) {
+		++range_index;
+	}
+	SectorRange new_range;
+	new_range.index = sector_index;
+	new_range.count = sector_count;
+	_free_sectors.insert(_free_sectors.begin() + range_index, new_range);
+
+	// Merge with next range
+	if (range_index + 1 < _free_sectors.size()) {
+		SectorRange &range = _free_sectors[range_index];
+		const SectorRange &next = _free_sectors[range_index + 1];
+		CRASH_COND(range.index + range.count > next.index);
+		if (range.index + range.count == next.index) {
+			range.count += next.count;
+			_free_sectors.erase(_free_sectors.begin() + range_index + 1);
+		}
+	}
 
-		f->seek(dst_offset);
-		f->store_buffer(temp.data(), sector_size);
+	// Merge with previous range
+	if (range_index > 0) {
+		SectorRange &prev = _free_sectors[range_index - 1];
+		const SectorRange &range = _free_sectors[range_index];
+		CRASH_COND(prev.index + prev.count > range.index);
+		if (prev.index + prev.count == range.index) {
+			prev.count += range.count;
+			_free_sectors.erase(_free_sectors.begin() + range_index);
+			--range_index;
+		}
+	}
 
-		src_offset += sector_size;
-		dst_offset += sector_size;
+	// Free sectors at the end of the file can be reused by appending blocks
+	const SectorRange &range = _free_sectors[range_index];
+	if (range.index + range.count == _sectors.size()) {
+		// TODO We need to truncate the end of the file since we effectively shortened it,
+		// but FileAccess doesn't have any function to do that... so can't rely on EOF either.
+		// Until then, the file keeps its size and these sectors are overwritten by the next appended blocks.
+		_sectors.resize(range.index);
+		_free_sectors.erase(_free_sectors.begin() + range_index);
 	}
+}
 
-	// TODO We need to truncate the end of the file since we effectively shortened it,
-	// but FileAccess doesn't have any function to do that... so can't rely on EOF either
+Error VoxelRegionFile::compact() {
+	VOXEL_PROFILE_SCOPE();
 
-	// Erase sectors from cache
-	_sectors.erase(
-			_sectors.begin() + (block_info.get_sector_index() + block_info.get_sector_count() - p_sector_count),
-			_sectors.begin() + (block_info.get_sector_index() + block_info.get_sector_count()));
+	if (_free_sectors.size() == 0) {
+		return OK;
+	}
 
-	const unsigned int old_sector_index = block_info.get_sector_index();
+	ERR_FAIL_COND_V(_file_access == nullptr, ERR_FILE_CANT_WRITE);
+	FileAccess *f = _file_access;
 
-	// Reduce sectors of current block in header.
-	if (block_info.get_sector_count() > p_sector_count) {
-		block_info.set_sector_count(block_info.get_sector_count() - p_sector_count);
-	} else {
-		// Block removed
-		block_info.data = 0;
+	// We should be allowed to migrate before write operations
+	if (_header.version != FORMAT_VERSION) {
+		ERR_FAIL_COND_V(migrate_to_latest(f) == false, ERR_UNAVAILABLE);
+	}
+
+	// Blocks saved since the last header write may have left sectors which the header in the file still uses
+	if (_header_modified) {
+		f->flush();
+		ERR_FAIL_COND_V(!save_header(f), ERR_FILE_CANT_WRITE);
+		f->flush();
 	}
 
-	// Shift sector index of following blocks
-	if (old_sector_index < _sectors.size()) {
-		for (unsigned int i = 0; i < _header.blocks.size(); ++i) {
-			VoxelRegionBlockInfo &b = _header.blocks[i];
-			if (b.data != 0 && b.get_sector_index() > old_sector_index) {
-				b.set_sector_index(b.get_sector_index() - p_sector_count);
+	std::vector<unsigned int> block_indices;
+	for (unsigned int i = 0; i < _header.blocks.size(); ++i) {
+		if (_header.blocks[i].data != 0) {
+			block_indices.push_back(i);
+		}
+	}
+
+	const unsigned int sector_size = _header.format.sector_size;
+	std::vector<uint8_t> temp;
+	// Sectors blocks were moved from. The header saved in the file still points to them.
+	std::vector<SectorRange> moved_from;
+
+	// Blocks are moved from the end of the file into free ranges before them. Since the header was just saved,
+	// free ranges are not used by any block of the header in the file, so if the process stops before it is saved
+	// again, that header still points to intact blocks. Sectors blocks were moved from only become free after that,
+	// and can be used in the next pass.
+	// This gathers free sectors at the end, where new blocks get appended. The file itself doesn't get smaller,
+	// because FileAccess cannot truncate it.
+	while (_free_sectors.size() > 0) {
+		std::sort(block_indices.begin(), block_indices.end(), [this](unsigned int a, unsigned int b) {
+			return _header.blocks[a].get_sector_index() > _header.blocks[b].get_sector_index();
+		});
+
+		for (unsigned int i = 0; i < block_indices.size(); ++i) {
+			VoxelRegionBlockInfo &block_info = _header.blocks[block_indices[i]];
+			const uint32_t src_sector_index = block_info.get_sector_index();
+			const uint32_t sector_count = block_info.get_sector_count();
+
+			// First free range before the block which is large enough
+			unsigned int range_index = 0;
+			while (range_index < _free_sectors.size() && _free_sectors[range_index].index < src_sector_index &&
+					_free_sectors[range_index].count < sector_count) {
+				++range_index;
+			}
+			if (range_index == _free_sectors.size() || _free_sectors[range_index].index > src_sector_index) {
+				continue;
 			}
+			SectorRange &range = _free_sectors[range_index];
+			const uint32_t dst_sector_index = range.index;
+
+			temp.resize(sector_count * sector_size);
+			f->seek(_blocks_begin_offset + src_sector_index * sector_size);
+			// The last block might not be padded
+			const size_t read_bytes = f->get_buffer(temp.data(), temp.size());
+			ERR_FAIL_COND_V(read_bytes < sizeof(uint32_t), ERR_FILE_CORRUPT);
+
+			f->seek(_blocks_begin_offset + dst_sector_index * sector_size);
+			f->store_buffer(temp.data(), read_bytes);
+
+			if (range.count == sector_count) {
+				_free_sectors.erase(_free_sectors.begin() + range_index);
+			} else {
+				range.index += sector_count;
+				range.count -= sector_count;
+			}
+			for (unsigned int j = 0; j < sector_count; ++j) {
+				_sectors[dst_sector_index + j] = Vector3u16(get_block_position_from_index(block_indices[i]));
+			}
+
+			block_info.set_sector_index(dst_sector_index);
+			SectorRange old_range;
+			old_range.index = src_sector_index;
+			old_range.count = sector_count;
+			moved_from.push_back(old_range);
 		}
+
+		if (moved_from.size() == 0) {
+			// Remaining free ranges are too small for the blocks after them
+			break;
+		}
+
+		// Moved blocks must be written before the header points to them
+		f->flush();
+		ERR_FAIL_COND_V(!save_header(f), ERR_FILE_CANT_WRITE);
+		f->flush();
+
+		for (unsigned int i = 0; i < moved_from.size(); ++i) {
+			free_sectors(moved_from[i].index, moved_from[i].count);
+		}
+		moved_from.clear();
 	}
+
+	_reader.update_mapping();
+
+	return OK;
 }
 
 bool VoxelRegionFile::save_header(FileAccess *f) {
@@ -543,6 +787,7 @@ bool VoxelRegionFile::save_header(FileAccess *f) {
 	ERR_FAIL_COND_V(!::save_header(f, _header.version, _header.format, _header.blocks), false);
 	_blocks_begin_offset = f->get_position();
 	_header_modified = false;
+	_saved_header_sector_count = _sectors.size();
 	return true;
 }
 
@@ -628,6 +873,22 @@ bool VoxelRegionFile::has_block(Vector3i position) const {
 	return _header.blocks[bi].data != 0;
 }
 
+const std::vector<VoxelRegionBlockInfo> &VoxelRegionFile::get_block_infos() const {
+	return _header.blocks;
+}
+
+unsigned int VoxelRegionFile::get_sector_count() const {
+	return _sectors.size();
+}
+
+unsigned int VoxelRegionFile::get_free_sector_count() const {
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < _free_sectors.size(); ++i) {
+		count += _free_sectors[i].count;
+	}
+	return count;
+}
+
 bool VoxelRegionFile::has_block(unsigned int index) const {
 	ERR_FAIL_COND_V(!is_open(), false);
 	CRASH_COND(index >= _header.blocks.size());
@@ -5,6 +5,7 @@
 #include "../../util/fixed_array.h"
 #include "../../util/math/color8.h"
 #include "../../util/math/vector3i.h"
+#include "../positional_file_reader.h"
 #include <vector>
 
 class FileAccess;
@@ -65,7 +66,8 @@ struct VoxelRegionBlockInfo {
 //
 // This is a stream implementation, where the file handle remains in use for read and write and only keeps a fraction
 // of data in memory.
-// It isn't thread-safe.
+// It isn't thread-safe by itself, but block reads don't use the cursor of the main file handle.
+// So multiple threads can call `load_block` at the same time, as long as no other function is running.
 //
 class VoxelRegionFile {
 public:
@@ -79,13 +81,31 @@ public:
 	bool set_format(const VoxelRegionFormat &format);
 	const VoxelRegionFormat &get_format() const;
 
-	Error load_block(Vector3i position, Ref<VoxelBuffer> out_block, VoxelBlockSerializerInternal &serializer);
-	Error save_block(Vector3i position, Ref<VoxelBuffer> block, VoxelBlockSerializerInternal &serializer);
+	Error load_block(Vector3i position, Ref<VoxelBuffer> out_block, VoxelBlockSerializerInternal &serializer) const;
+	// Loads multiple blocks, reading sectors in the order they appear in the file.
+	// Blocks stored next to each other are read with a single call.
+	void load_blocks(Span<const Vector3i> positions, Span<Ref<VoxelBuffer>> out_blocks, Span<Error> out_errors,
+			VoxelBlockSerializerInternal &serializer) const;
+	Error save_block(Vector3i position, Ref<VoxelBuffer> block, VoxelBlockSerializerInternal &serializer,
+			int lz4_acceleration = 1);
 
 	unsigned int get_header_block_count() const;
 	bool has_block(Vector3i position) const;
 	bool has_block(unsigned int index) const;
 	Vector3i get_block_position_from_index(uint32_t i) const;
+	const std::vector<VoxelRegionBlockInfo> &get_block_infos() const;
+
+	// Total number of sectors in the file, including free ones
+	unsigned int get_sector_count() const;
+	// Number of sectors between blocks which are not used anymore
+	unsigned int get_free_sector_count() const;
+
+	// Moves blocks from the end of the file into free sectors before them, so new blocks can be appended over
+	// the sectors left at the end. The file doesn't get smaller, since FileAccess cannot truncate it.
+	// A moved block keeps its old sectors until the header pointing to its new ones is saved, so the file remains
+	// valid if the process stops during compaction.
+	// This is slow on large files, and is best done from a thread.
+	Error compact();
 
 	void debug_check();
 
@@ -93,11 +113,15 @@ private:
 	bool save_header(FileAccess *f);
 	Error load_header(FileAccess *f);
 
+	Error load_block_from_sectors(Span<const uint8_t> sectors, Vector3i position, VoxelBuffer &out_block,
+			VoxelBlockSerializerInternal &serializer) const;
+
 	unsigned int get_block_index_in_header(const Vector3i &rpos) const;
 	uint32_t get_sector_count_from_bytes(uint32_t size_in_bytes) const;
 
 	void pad_to_sector_size(FileAccess *f);
-	void remove_sectors_from_block(Vector3i block_pos, unsigned int p_sector_count);
+	bool allocate_sectors(Vector3i block_pos, uint32_t sector_count, uint32_t &out_sector_index);
+	void free_sectors(uint32_t sector_index, uint32_t sector_count);
 
 	bool migrate_to_latest(FileAccess *f);
 	bool migrate_from_v2_to_v3(FileAccess *f, VoxelRegionFormat &format);
@@ -112,6 +136,8 @@ private:
 	};
 
 	FileAccess *_file_access = nullptr;
+	// Separate handle on the same file, only used to read blocks
+	VoxelPositionalFileReader _reader;
 	bool _header_modified = false;
 
 	Header _header;
@@ -121,15 +147,30 @@ private:
 		uint16_t y;
 		uint16_t z;
 
+		// Used for free sectors
+		Vector3u16() :
+				x(0xffff), y(0xffff), z(0xffff) {}
+
 		Vector3u16(Vector3i p) :
 				x(p.x), y(p.y), z(p.z) {}
 	};
 
+	struct SectorRange {
+		uint32_t index;
+		uint32_t count;
+	};
+
 	// TODO Is it ever read?
 	// List of sectors in the order they appear in the file,
 	// and which position their block is. The same block can span multiple sectors.
 	// This is essentially a reverse table of `Header::blocks`.
 	std::vector<Vector3u16> _sectors;
+	// Ranges of sectors no block is using, sorted by index. Adjacent ranges are always merged.
+	// They are not stored in the file, since they can be found from the header.
+	// Until the header is saved again, the one in the file may still use some of them.
+	std::vector<SectorRange> _free_sectors;
+	// Number of sectors when the header was last saved or loaded. Sectors past it are not used by that header.
+	uint32_t _saved_header_sector_count = 0;
 	uint32_t _blocks_begin_offset;
 	String _file_path;
 };
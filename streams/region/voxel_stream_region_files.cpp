@@ -16,6 +16,15 @@ const uint8_t FORMAT_VERSION_LEGACY_2 = 2;
 
 const uint8_t FORMAT_VERSION_LEGACY_1 = 1;
 const char *META_FILE_NAME = "meta.vxrm";
+const unsigned int MIN_FREE_SECTORS_BEFORE_COMPACTION = 64;
+
+// Blocks growing leave free sectors behind. Compact once they take as much room as used ones,
+// so the cost stays proportional to the amount of saved data.
+inline bool needs_compaction(const VoxelRegionFile &region) {
+	const unsigned int free_sector_count = region.get_free_sector_count();
+	return free_sector_count >= MIN_FREE_SECTORS_BEFORE_COMPACTION &&
+		   free_sector_count * 2 >= region.get_sector_count();
+}
 } // namespace
 
 thread_local VoxelBlockSerializerInternal VoxelStreamRegionFiles::_block_serializer;
@@ -59,34 +68,66 @@ void VoxelStreamRegionFiles::emerge_blocks(Vector<VoxelBlockRequest> &p_blocks,
 	VOXEL_PROFILE_SCOPE();
 
 	// In order to minimize opening/closing files, requests are grouped according to their region.
+	// Then blocks of each region are read in the order they are stored in the file.
 
-	// Had to copy input to sort it, as some areas in the module break if they get responses in different order
-	Vector<VoxelBlockRequest> sorted_blocks;
-	sorted_blocks.append_array(p_blocks);
+	// Sorting indices, so results are given in the same order as requests
+	std::vector<unsigned int> sorted_indices;
+	sorted_indices.resize(p_blocks.size());
+	for (unsigned int i = 0; i < sorted_indices.size(); ++i) {
+		sorted_indices[i] = i;
+	}
+	BlockRequestComparator comparator;
+	comparator.self = this;
+	std::sort(sorted_indices.begin(), sorted_indices.end(), [&p_blocks, &comparator](unsigned int a, unsigned int b) {
+		return comparator(p_blocks[a], p_blocks[b]);
+	});
 
-	SortArray<VoxelBlockRequest, BlockRequestComparator> sorter;
-	sorter.compare.self = this;
-	sorter.sort(sorted_blocks.ptrw(), sorted_blocks.size());
+	const int results_begin = out_results.size();
+	out_results.resize(results_begin + p_blocks.size());
 
-	Vector<VoxelBlockRequest> fallback_requests;
+	std::vector<VoxelBlockRequest *> group;
+	std::vector<EmergeResult> group_results;
 
-	for (int i = 0; i < sorted_blocks.size(); ++i) {
-		VoxelBlockRequest &r = sorted_blocks.write[i];
-		const EmergeResult result = _emerge_block(r.voxel_buffer, r.origin_in_voxels, r.lod);
+	auto to_stream_result = [](EmergeResult result) {
 		switch (result) {
 			case EMERGE_OK:
-				out_results.push_back(RESULT_BLOCK_FOUND);
-				break;
+				return RESULT_BLOCK_FOUND;
 			case EMERGE_OK_FALLBACK:
-				out_results.push_back(RESULT_BLOCK_NOT_FOUND);
-				break;
+				return RESULT_BLOCK_NOT_FOUND;
 			case EMERGE_FAILED:
-				out_results.push_back(RESULT_ERROR);
-				break;
+				return RESULT_ERROR;
 			default:
 				CRASH_NOW();
-				break;
+				return RESULT_ERROR;
 		}
+	};
+
+	unsigned int begin = 0;
+	while (begin < sorted_indices.size()) {
+		// Find requests in the same region
+		unsigned int end = begin + 1;
+		while (end < sorted_indices.size() &&
+				!comparator(p_blocks[sorted_indices[begin]], p_blocks[sorted_indices[end]])) {
+			++end;
+		}
+
+		group.clear();
+		for (unsigned int i = begin; i < end; ++i) {
+			group.push_back(&p_blocks.write[sorted_indices[i]]);
+		}
+		group_results.resize(group.size());
+
+		if (group.size() == 1) {
+			group_results[0] = _emerge_block(group[0]->voxel_buffer, group[0]->origin_in_voxels, group[0]->lod);
+		} else {
+			_emerge_blocks_in_region(to_span(group), to_span(group_results));
+		}
+
+		for (unsigned int i = 0; i < group.size(); ++i) {
+			out_results.write[results_begin + sorted_indices[begin + i]] = to_stream_result(group_results[i]);
+		}
+
+		begin = end;
 	}
 }
 
@@ -117,8 +158,60 @@ VoxelStreamRegionFiles::EmergeResult VoxelStreamRegionFiles::_emerge_block(
 	VOXEL_PROFILE_SCOPE();
 	ERR_FAIL_COND_V(out_buffer.is_null(), EMERGE_FAILED);
 
-	MutexLock lock(_mutex);
+	std::shared_ptr<CachedRegion> cache;
+	Vector3i block_rpos;
+
+	{
+		MutexLock lock(_mutex);
 
+		const EmergeResult meta_result = prepare_meta_for_emerge();
+		if (meta_result != EMERGE_OK) {
+			return meta_result;
+		}
+
+		const Vector3i block_size = Vector3i(1 << _meta.block_size_po2);
+		const Vector3i region_size = Vector3i(1 << _meta.region_size_po2);
+
+		ERR_FAIL_COND_V(lod >= _meta.lod_count, EMERGE_FAILED);
+		ERR_FAIL_COND_V(block_size != out_buffer->get_size(), EMERGE_FAILED);
+
+		// Configure depths, as they currently are only specified in the meta file.
+		// Regions are expected to contain such depths, and use those in the buffer to know how much data to read.
+		for (unsigned int channel_index = 0; channel_index < _meta.channel_depths.size(); ++channel_index) {
+			out_buffer->set_channel_depth(channel_index, _meta.channel_depths[channel_index]);
+		}
+
+		const Vector3i block_pos = get_block_position_from_voxels(origin_in_voxels) >> lod;
+		const Vector3i region_pos = get_region_position_from_blocks(block_pos);
+		block_rpos = block_pos.wrap(region_size);
+
+		if (!region_may_have_block(region_pos, lod, block_rpos)) {
+			return EMERGE_OK_FALLBACK;
+		}
+
+		cache = open_region(region_pos, lod, false);
+		if (cache == nullptr || !cache->file_exists) {
+			return EMERGE_OK_FALLBACK;
+		}
+	}
+
+	// Other threads may load from the same region at the same time
+	RWLockRead rlock(cache->rw_lock);
+	const Error err = cache->region.load_block(block_rpos, out_buffer, _block_serializer);
+	switch (err) {
+		case OK:
+			return EMERGE_OK;
+
+		case ERR_DOES_NOT_EXIST:
+			return EMERGE_OK_FALLBACK;
+
+		default:
+			return EMERGE_FAILED;
+	}
+}
+
+// Must be called with `_mutex` locked. Returns `EMERGE_OK` if blocks can be loaded.
+VoxelStreamRegionFiles::EmergeResult VoxelStreamRegionFiles::prepare_meta_for_emerge() {
 	if (_directory_path.empty()) {
 		return EMERGE_OK_FALLBACK;
 	}
@@ -137,86 +230,245 @@ VoxelStreamRegionFiles::EmergeResult VoxelStreamRegionFiles::_emerge_block(
 		}
 	}
 
-	const Vector3i block_size = Vector3i(1 << _meta.block_size_po2);
-	const Vector3i region_size = Vector3i(1 << _meta.region_size_po2);
-
 	CRASH_COND(!_meta_loaded);
-	ERR_FAIL_COND_V(lod >= _meta.lod_count, EMERGE_FAILED);
-	ERR_FAIL_COND_V(block_size != out_buffer->get_size(), EMERGE_FAILED);
+	return EMERGE_OK;
+}
 
-	// Configure depths, as they currently are only specified in the meta file.
-	// Regions are expected to contain such depths, and use those in the buffer to know how much data to read.
-	for (unsigned int channel_index = 0; channel_index < _meta.channel_depths.size(); ++channel_index) {
-		out_buffer->set_channel_depth(channel_index, _meta.channel_depths[channel_index]);
-	}
+// Loads blocks which are all in the same region, reading them in the order they are stored in the file
+void VoxelStreamRegionFiles::_emerge_blocks_in_region(
+		Span<VoxelBlockRequest *> requests, Span<EmergeResult> out_results) {
+	VOXEL_PROFILE_SCOPE();
+	CRASH_COND(requests.size() != out_results.size());
+	CRASH_COND(requests.size() == 0);
 
-	const Vector3i block_pos = get_block_position_from_voxels(origin_in_voxels) >> lod;
-	const Vector3i region_pos = get_region_position_from_blocks(block_pos);
+	static thread_local std::vector<Vector3i> tls_positions;
+	static thread_local std::vector<Ref<VoxelBuffer>> tls_buffers;
+	static thread_local std::vector<unsigned int> tls_request_indices;
+	tls_positions.clear();
+	tls_buffers.clear();
+	tls_request_indices.clear();
 
-	CachedRegion *cache = open_region(region_pos, lod, false);
-	if (cache == nullptr || !cache->file_exists) {
-		return EMERGE_OK_FALLBACK;
-	}
+	std::shared_ptr<CachedRegion> cache;
 
-	const Vector3i block_rpos = block_pos.wrap(region_size);
+	{
+		MutexLock lock(_mutex);
 
-	Error err = cache->region.load_block(block_rpos, out_buffer, _block_serializer);
-	switch (err) {
-		case OK:
-			return EMERGE_OK;
+		const EmergeResult meta_result = prepare_meta_for_emerge();
+		if (meta_result != EMERGE_OK) {
+			out_results.fill(meta_result);
+			return;
+		}
 
-		case ERR_DOES_NOT_EXIST:
-			return EMERGE_OK_FALLBACK;
+		const Vector3i block_size = Vector3i(1 << _meta.block_size_po2);
+		const Vector3i region_size = Vector3i(1 << _meta.region_size_po2);
+		const int lod = requests[0]->lod;
 
-		default:
-			return EMERGE_FAILED;
+		if (lod >= _meta.lod_count) {
+			ERR_PRINT("Invalid LOD index");
+			out_results.fill(EMERGE_FAILED);
+			return;
+		}
+
+		const Vector3i region_pos =
+				get_region_position_from_blocks(get_block_position_from_voxels(requests[0]->origin_in_voxels) >> lod);
+
+		for (unsigned int i = 0; i < requests.size(); ++i) {
+			VoxelBlockRequest &r = *requests[i];
+			if (r.voxel_buffer.is_null() || r.voxel_buffer->get_size() != block_size) {
+				ERR_PRINT("Invalid block buffer");
+				out_results[i] = EMERGE_FAILED;
+				continue;
+			}
+
+			// Configure depths, as they currently are only specified in the meta file.
+			for (unsigned int channel_index = 0; channel_index < _meta.channel_depths.size(); ++channel_index) {
+				r.voxel_buffer->set_channel_depth(channel_index, _meta.channel_depths[channel_index]);
+			}
+
+			const Vector3i block_pos = get_block_position_from_voxels(r.origin_in_voxels) >> lod;
+			CRASH_COND(get_region_position_from_blocks(block_pos) != region_pos);
+			const Vector3i block_rpos = block_pos.wrap(region_size);
+
+			if (!region_may_have_block(region_pos, lod, block_rpos)) {
+				out_results[i] = EMERGE_OK_FALLBACK;
+				continue;
+			}
+
+			tls_positions.push_back(block_rpos);
+			tls_buffers.push_back(r.voxel_buffer);
+			tls_request_indices.push_back(i);
+		}
+
+		if (tls_positions.size() == 0) {
+			return;
+		}
+
+		cache = open_region(region_pos, lod, false);
+		if (cache == nullptr || !cache->file_exists) {
+			for (unsigned int i = 0; i < tls_request_indices.size(); ++i) {
+				out_results[tls_request_indices[i]] = EMERGE_OK_FALLBACK;
+			}
+			return;
+		}
+	}
+
+	static thread_local std::vector<Error> tls_errors;
+	tls_errors.resize(tls_positions.size());
+
+	{
+		// Other threads may load from the same region at the same time
+		RWLockRead rlock(cache->rw_lock);
+		cache->region.load_blocks(to_span_const(tls_positions), to_span(tls_buffers), to_span(tls_errors),
+				_block_serializer);
+	}
+
+	for (unsigned int i = 0; i < tls_errors.size(); ++i) {
+		EmergeResult &result = out_results[tls_request_indices[i]];
+		switch (tls_errors[i]) {
+			case OK:
+				result = EMERGE_OK;
+				break;
+			case ERR_DOES_NOT_EXIST:
+				result = EMERGE_OK_FALLBACK;
+				break;
+			default:
+				result = EMERGE_FAILED;
+				break;
+		}
 	}
 }
 
 void VoxelStreamRegionFiles::_immerge_block(Ref<VoxelBuffer> voxel_buffer, Vector3i origin_in_voxels, int lod) {
 	VOXEL_PROFILE_SCOPE();
 
-	MutexLock lock(_mutex);
-
-	ERR_FAIL_COND(_directory_path.empty());
 	ERR_FAIL_COND(voxel_buffer.is_null());
 
-	if (!_meta_loaded) {
-		// If it's not loaded, always try to load meta file first if it exists already,
-		// because we could want to save blocks without reading any
-		VoxelFileResult load_res = load_meta();
-		if (load_res != VOXEL_FILE_OK && load_res != VOXEL_FILE_CANT_OPEN) {
-			// The file is present but there is a problem with it
-			String meta_path = _directory_path.plus_file(META_FILE_NAME);
-			ERR_PRINT(String("Could not read {0}: error {1}").format(varray(meta_path, ::to_string(load_res))));
-			return;
+	std::shared_ptr<CachedRegion> cache;
+	Vector3i block_rpos;
+
+	{
+		MutexLock lock(_mutex);
+
+		ERR_FAIL_COND(_directory_path.empty());
+
+		if (!_meta_loaded) {
+			// If it's not loaded, always try to load meta file first if it exists already,
+			// because we could want to save blocks without reading any
+			VoxelFileResult load_res = load_meta();
+			if (load_res != VOXEL_FILE_OK && load_res != VOXEL_FILE_CANT_OPEN) {
+				// The file is present but there is a problem with it
+				String meta_path = _directory_path.plus_file(META_FILE_NAME);
+				ERR_PRINT(String("Could not read {0}: error {1}").format(varray(meta_path, ::to_string(load_res))));
+				return;
+			}
+		}
+
+		if (!_meta_saved) {
+			// First time we save the meta file, initialize it from the first block format
+			for (unsigned int i = 0; i < _meta.channel_depths.size(); ++i) {
+				_meta.channel_depths[i] = voxel_buffer->get_channel_depth(i);
+			}
+			VoxelFileResult err = save_meta();
+			ERR_FAIL_COND(err != VOXEL_FILE_OK);
+		}
+
+		// Verify format
+		const Vector3i block_size = Vector3i(1 << _meta.block_size_po2);
+		ERR_FAIL_COND(voxel_buffer->get_size() != block_size);
+		for (unsigned int i = 0; i < VoxelBuffer::MAX_CHANNELS; ++i) {
+			ERR_FAIL_COND(voxel_buffer->get_channel_depth(i) != _meta.channel_depths[i]);
 		}
+
+		const Vector3i region_size = Vector3i(1 << _meta.region_size_po2);
+		const Vector3i block_pos = get_block_position_from_voxels(origin_in_voxels) >> lod;
+		const Vector3i region_pos = get_region_position_from_blocks(block_pos);
+		block_rpos = block_pos.wrap(region_size);
+
+		cache = open_region(region_pos, lod, true);
+		ERR_FAIL_COND_MSG(cache == nullptr, "Could not save region file data");
+	}
+
+	const int lz4_acceleration = get_lz4_acceleration();
+	bool compact = false;
+	{
+		RWLockWrite wlock(cache->rw_lock);
+		ERR_FAIL_COND(cache->region.save_block(block_rpos, voxel_buffer, _block_serializer, lz4_acceleration) != OK);
+		compact = needs_compaction(cache->region);
+	}
+
+	if (compact) {
+		request_compaction(cache);
+	}
+}
+
+void VoxelStreamRegionFiles::request_compaction(const std::shared_ptr<CachedRegion> &region) {
+	MutexLock lock(_compaction_mutex);
+	if (region->compaction_requested) {
+		return;
 	}
+	region->compaction_requested = true;
+	_regions_to_compact.push_back(region);
+	if (!_compaction_thread_started) {
+		// Started only when needed, because most streams never have to compact anything
+		_compaction_thread_started = true;
+		_compaction_thread.start(compaction_thread_func_static, this);
+	}
+	_compaction_semaphore.post();
+}
 
-	if (!_meta_saved) {
-		// First time we save the meta file, initialize it from the first block format
-		for (unsigned int i = 0; i < _meta.channel_depths.size(); ++i) {
-			_meta.channel_depths[i] = voxel_buffer->get_channel_depth(i);
+void VoxelStreamRegionFiles::stop_compaction_thread() {
+	{
+		MutexLock lock(_compaction_mutex);
+		if (!_compaction_thread_started) {
+			return;
 		}
-		VoxelFileResult err = save_meta();
-		ERR_FAIL_COND(err != VOXEL_FILE_OK);
+		_compaction_thread_stop = true;
+		_compaction_semaphore.post();
 	}
+	// Not waiting with the mutex locked, the thread needs it to get its next region
+	_compaction_thread.wait_to_finish();
 
-	// Verify format
-	const Vector3i block_size = Vector3i(1 << _meta.block_size_po2);
-	ERR_FAIL_COND(voxel_buffer->get_size() != block_size);
-	for (unsigned int i = 0; i < VoxelBuffer::MAX_CHANNELS; ++i) {
-		ERR_FAIL_COND(voxel_buffer->get_channel_depth(i) != _meta.channel_depths[i]);
+	MutexLock lock(_compaction_mutex);
+	for (unsigned int i = 0; i < _regions_to_compact.size(); ++i) {
+		_regions_to_compact[i]->compaction_requested = false;
 	}
+	_regions_to_compact.clear();
+	_compaction_thread_started = false;
+	_compaction_thread_stop = false;
+}
+
+void VoxelStreamRegionFiles::compaction_thread_func_static(void *p_data) {
+	VoxelStreamRegionFiles &stream = *static_cast<VoxelStreamRegionFiles *>(p_data);
+	Thread::set_name("Voxel region compaction");
+
+	while (true) {
+		stream._compaction_semaphore.wait();
 
-	const Vector3i region_size = Vector3i(1 << _meta.region_size_po2);
-	Vector3i block_pos = get_block_position_from_voxels(origin_in_voxels) >> lod;
-	Vector3i region_pos = get_region_position_from_blocks(block_pos);
-	Vector3i block_rpos = block_pos.wrap(region_size);
+		while (!stream._compaction_thread_stop) {
+			std::shared_ptr<CachedRegion> cache;
+			{
+				MutexLock lock(stream._compaction_mutex);
+				if (stream._regions_to_compact.size() == 0) {
+					break;
+				}
+				cache = stream._regions_to_compact.back();
+				stream._regions_to_compact.pop_back();
+				cache->compaction_requested = false;
+			}
 
-	CachedRegion *cache = open_region(region_pos, lod, true);
-	ERR_FAIL_COND_MSG(cache == nullptr, "Could not save region file data");
-	ERR_FAIL_COND(cache->region.save_block(block_rpos, voxel_buffer, _block_serializer) != OK);
+			// Saves may have happened since the request
+			RWLockWrite wlock(cache->rw_lock);
+			if (needs_compaction(cache->region)) {
+				PRINT_VERBOSE(String("Compacting region lod{0}/{1}")
+									  .format(varray(cache->lod, cache->position.to_vec3())));
+				ERR_CONTINUE(cache->region.compact() != OK);
+			}
+		}
+
+		if (stream._compaction_thread_stop) {
+			break;
+		}
+	}
 }
 
 String VoxelStreamRegionFiles::get_directory() const {
@@ -302,6 +554,8 @@ VoxelFileResult VoxelStreamRegionFiles::save_meta() {
 	_meta_saved = true;
 	_meta_loaded = true;
 
+	scan_existing_regions();
+
 	return VOXEL_FILE_OK;
 }
 
@@ -382,6 +636,8 @@ VoxelFileResult VoxelStreamRegionFiles::load_meta() {
 	_meta_loaded = true;
 	_meta_saved = true;
 
+	scan_existing_regions();
+
 	return VOXEL_FILE_OK;
 }
 
@@ -402,12 +658,63 @@ Vector3i VoxelStreamRegionFiles::get_region_position_from_blocks(const Vector3i
 }
 
 void VoxelStreamRegionFiles::close_all_regions() {
-	for (unsigned int i = 0; i < _region_cache.size(); ++i) {
-		CachedRegion *cache = _region_cache[i];
-		close_region(cache);
-		memdelete(cache);
-	}
+	// Compaction must not touch files after we are done with them
+	stop_compaction_thread();
+	// Regions still used by other threads will be closed when they are done with them
 	_region_cache.clear();
+	_region_headers.clear();
+	for (unsigned int lod_index = 0; lod_index < _existing_regions.size(); ++lod_index) {
+		_existing_regions[lod_index].clear();
+	}
+	_existing_regions_scanned = false;
+}
+
+// Must be called with `_mutex` locked, after meta is loaded.
+// If listing fails, regions are looked up in the filesystem when they are first needed, as if nothing was scanned.
+void VoxelStreamRegionFiles::scan_existing_regions() {
+	VOXEL_PROFILE_SCOPE();
+	ERR_FAIL_COND(!_meta_loaded);
+
+	for (unsigned int lod_index = 0; lod_index < _existing_regions.size(); ++lod_index) {
+		_existing_regions[lod_index].clear();
+	}
+	_existing_regions_scanned = false;
+
+	const String extension = String(".") + VoxelRegionFormat::FILE_EXTENSION;
+
+	for (unsigned int lod_index = 0; lod_index < _meta.lod_count; ++lod_index) {
+		// Same naming as `get_region_file_path`
+		const String lod_dir_path = _directory_path.plus_file(String("regions/lod{0}").format(varray(lod_index)));
+
+		DirAccessRef da = DirAccess::create_for_path(lod_dir_path);
+		if (!da->dir_exists(lod_dir_path)) {
+			// No region was saved at this LOD
+			continue;
+		}
+		if (da->change_dir(lod_dir_path) != OK || da->list_dir_begin() != OK) {
+			ERR_PRINT(String("Could not list region files in {0}").format(varray(lod_dir_path)));
+			return;
+		}
+
+		std::unordered_set<Vector3i> &regions = _existing_regions[lod_index];
+
+		for (String fname = da->get_next(); !fname.empty(); fname = da->get_next()) {
+			if (da->current_is_dir() || !fname.begins_with("r.") || !fname.ends_with(extension)) {
+				continue;
+			}
+			// r.{x}.{y}.{z}.{extension}
+			const Vector<String> parts = fname.substr(2, fname.length() - 2 - extension.length()).split(".");
+			if (parts.size() != 3 ||
+					!parts[0].is_valid_integer() || !parts[1].is_valid_integer() || !parts[2].is_valid_integer()) {
+				continue;
+			}
+			regions.insert(Vector3i(parts[0].to_int(), parts[1].to_int(), parts[2].to_int()));
+		}
+
+		da->list_dir_end();
+	}
+
+	_existing_regions_scanned = true;
 }
 
 String VoxelStreamRegionFiles::get_region_file_path(const Vector3i &region_pos, unsigned int lod) const {
@@ -421,11 +728,12 @@ String VoxelStreamRegionFiles::get_region_file_path(const Vector3i &region_pos,
 	return _directory_path.plus_file(String("regions/lod{0}/r.{1}.{2}.{3}.{4}").format(a));
 }
 
-VoxelStreamRegionFiles::CachedRegion *VoxelStreamRegionFiles::get_region_from_cache(const Vector3i pos, int lod) const {
+std::shared_ptr<VoxelStreamRegionFiles::CachedRegion> VoxelStreamRegionFiles::get_region_from_cache(
+		const Vector3i pos, int lod) const {
 	// A linear search might be better than a Map data structure,
 	// because it's unlikely to have more than about 10 regions cached at a time
 	for (unsigned int i = 0; i < _region_cache.size(); ++i) {
-		CachedRegion *r = _region_cache[i];
+		const std::shared_ptr<CachedRegion> &r = _region_cache[i];
 		if (r->position == pos && r->lod == lod) {
 			return r;
 		}
@@ -433,25 +741,29 @@ VoxelStreamRegionFiles::CachedRegion *VoxelStreamRegionFiles::get_region_from_ca
 	return nullptr;
 }
 
-VoxelStreamRegionFiles::CachedRegion *VoxelStreamRegionFiles::open_region(
+// Must be called with `_mutex` locked
+std::shared_ptr<VoxelStreamRegionFiles::CachedRegion> VoxelStreamRegionFiles::open_region(
 		const Vector3i region_pos, unsigned int lod, bool create_if_not_found) {
 	VOXEL_PROFILE_SCOPE();
 	ERR_FAIL_COND_V(!_meta_loaded, nullptr);
 	ERR_FAIL_COND_V(lod < 0, nullptr);
 
-	CachedRegion *cached_region = get_region_from_cache(region_pos, lod);
+	std::shared_ptr<CachedRegion> cached_region = get_region_from_cache(region_pos, lod);
 	if (cached_region != nullptr) {
 		return cached_region;
 	}
 
 	while (_region_cache.size() > _max_open_regions - 1) {
-		close_oldest_region();
+		if (!close_oldest_region()) {
+			// All regions are in use, we'll temporarily exceed the limit
+			break;
+		}
 	}
 	// Not in cache, we'll have to open or create it
 
 	String fpath = get_region_file_path(region_pos, lod);
 
-	cached_region = memnew(CachedRegion);
+	cached_region = std::make_shared<CachedRegion>();
 
 	// Configure format because we might have to create the file, and some old file versions don't embed format
 	{
@@ -471,18 +783,18 @@ VoxelStreamRegionFiles::CachedRegion *VoxelStreamRegionFiles::open_region(
 	const Error err = cached_region->region.open(fpath, create_if_not_found);
 
 	// Things we could do for optimization:
-	// - Cache the fact the file doesnt exist, so we won't need to do a system call to actually check it every time
 	// - No need to read the header again when it has been read once,
 	//   we assume no other process will modify region files
 
 	if (err != OK) {
-		memdelete(cached_region);
 		if (create_if_not_found) {
 			// Could not create it apparently
 			ERR_PRINT(String("Could not open or create region file {0}, error: {1}").format(varray(fpath, err)));
 			return nullptr;
 		} else {
-			// Does not exist, it was probably expected
+			// Does not exist, it was probably expected.
+			// Remember it so next queries won't have to check the filesystem.
+			cache_region_header(region_pos, lod, nullptr);
 			return nullptr;
 		}
 	}
@@ -495,7 +807,6 @@ VoxelStreamRegionFiles::CachedRegion *VoxelStreamRegionFiles::open_region(
 				format.region_size != Vector3i(1 << _meta.region_size_po2) ||
 				format.sector_size != _meta.sector_size) {
 			ERR_PRINT("Region file has unexpected format");
-			memdelete(cached_region);
 			return nullptr;
 		}
 	}
@@ -503,22 +814,27 @@ VoxelStreamRegionFiles::CachedRegion *VoxelStreamRegionFiles::open_region(
 	// TODO Debug check to make sure we did not already cache it
 	_region_cache.push_back(cached_region);
 
+	// The open region is now the reference
+	for (unsigned int i = 0; i < _region_headers.size(); ++i) {
+		const RegionHeader &header = _region_headers[i];
+		if (header.position == region_pos && header.lod == static_cast<int>(lod)) {
+			_region_headers.erase(_region_headers.begin() + i);
+			break;
+		}
+	}
+
 	cached_region->file_exists = true;
+	_existing_regions[lod].insert(region_pos);
 	cached_region->last_opened = OS::get_singleton()->get_ticks_usec();
 
 	return cached_region;
 }
 
-// TODO Get rid of to simplify?
-void VoxelStreamRegionFiles::close_region(CachedRegion *region) {
-	region->region.close();
-}
-
-void VoxelStreamRegionFiles::close_oldest_region() {
+bool VoxelStreamRegionFiles::close_oldest_region() {
 	// Close region assumed to be the least recently used
 
 	if (_region_cache.size() == 0) {
-		return;
+		return false;
 	}
 
 	int oldest_index = -1;
@@ -526,18 +842,118 @@ void VoxelStreamRegionFiles::close_oldest_region() {
 	const uint64_t now = OS::get_singleton()->get_ticks_usec();
 
 	for (unsigned int i = 0; i < _region_cache.size(); ++i) {
-		const CachedRegion *r = _region_cache[i];
+		const std::shared_ptr<CachedRegion> &r = _region_cache[i];
+		if (r.use_count() > 1) {
+			// Another thread is using it. Dropping it now would let the same file be opened twice.
+			continue;
+		}
 		const uint64_t time = now - r->last_opened;
 		if (time >= oldest_time) {
 			oldest_index = i;
+			oldest_time = time;
 		}
 	}
 
-	CachedRegion *region = _region_cache[oldest_index];
+	if (oldest_index == -1) {
+		return false;
+	}
+
+	// Keep its header so we can still tell which blocks it has
+	const std::shared_ptr<CachedRegion> &region = _region_cache[oldest_index];
+	cache_region_header(region->position, region->lod, &region->region);
+
+	// The file gets closed when the region is destroyed
 	_region_cache.erase(_region_cache.begin() + oldest_index);
+	return true;
+}
+
+VoxelStreamRegionFiles::RegionHeader *VoxelStreamRegionFiles::get_region_header_from_cache(
+		const Vector3i pos, int lod) {
+	for (unsigned int i = 0; i < _region_headers.size(); ++i) {
+		RegionHeader &header = _region_headers[i];
+		if (header.position == pos && header.lod == lod) {
+			return &header;
+		}
+	}
+	return nullptr;
+}
+
+// Remembers the blocks a region contains after it gets closed, or that its file doesn't exist if `region` is null
+void VoxelStreamRegionFiles::cache_region_header(const Vector3i pos, int lod, const VoxelRegionFile *region) {
+	RegionHeader *header = get_region_header_from_cache(pos, lod);
+
+	if (header == nullptr) {
+		if (_region_headers.size() >= _max_cached_region_headers && _region_headers.size() > 0) {
+			// Replace the least recently used one
+			unsigned int oldest_index = 0;
+			for (unsigned int i = 1; i < _region_headers.size(); ++i) {
+				if (_region_headers[i].last_used < _region_headers[oldest_index].last_used) {
+					oldest_index = i;
+				}
+			}
+			header = &_region_headers[oldest_index];
+		} else {
+			_region_headers.push_back(RegionHeader());
+			header = &_region_headers.back();
+		}
+		header->position = pos;
+		header->lod = lod;
+	}
+
+	header->last_used = OS::get_singleton()->get_ticks_usec();
+
+	if (region != nullptr && region->is_open()) {
+		header->file_exists = true;
+		header->blocks = region->get_block_infos();
+	} else {
+		header->file_exists = false;
+		header->blocks.clear();
+	}
+}
+
+// Must be called with `_mutex` locked.
+// Returns false if the block is known to be absent, using only cached information.
+bool VoxelStreamRegionFiles::region_may_have_block(const Vector3i region_pos, int lod, const Vector3i block_rpos) {
+	if (get_region_from_cache(region_pos, lod) != nullptr) {
+		// The region is open, it will tell
+		return true;
+	}
+
+	if (_existing_regions_scanned) {
+		const std::unordered_set<Vector3i> &regions = _existing_regions[lod];
+		if (regions.find(region_pos) == regions.end()) {
+			return false;
+		}
+	}
 
-	close_region(region);
-	memdelete(region);
+	RegionHeader *header = get_region_header_from_cache(region_pos, lod);
+	if (header == nullptr) {
+		return true;
+	}
+	header->last_used = OS::get_singleton()->get_ticks_usec();
+
+	if (!header->file_exists) {
+		return false;
+	}
+
+	const unsigned int block_index = block_rpos.get_zxy_index(Vector3i(1 << _meta.region_size_po2));
+	ERR_FAIL_COND_V(block_index >= header->blocks.size(), true);
+	return header->blocks[block_index].data != 0;
+}
+
+bool VoxelStreamRegionFiles::may_have_block(Vector3i origin_in_voxels, int lod) {
+	MutexLock lock(_mutex);
+
+	if (!_meta_loaded || lod < 0 || lod >= _meta.lod_count) {
+		// Loading will tell
+		return true;
+	}
+
+	const Vector3i block_pos = get_block_position_from_voxels(origin_in_voxels) >> lod;
+	const Vector3i region_pos = get_region_position_from_blocks(block_pos);
+	const Vector3i block_rpos = block_pos.wrap(Vector3i(1 << _meta.region_size_po2));
+
+	return region_may_have_block(region_pos, lod, block_rpos);
 }
 
 static inline int convert_block_coordinate(int p_x, int old_size, int new_size) {
@@ -657,7 +1073,11 @@ void VoxelStreamRegionFiles::_convert_files(Meta new_meta) {
 	for (unsigned int i = 0; i < old_region_list.size(); ++i) {
 		PositionAndLod region_info = old_region_list[i];
 
-		const CachedRegion *old_region = old_stream->open_region(region_info.position, region_info.lod, false);
+		std::shared_ptr<CachedRegion> old_region;
+		{
+			MutexLock old_lock(old_stream->_mutex);
+			old_region = old_stream->open_region(region_info.position, region_info.lod, false);
+		}
 		if (old_region == nullptr) {
 			continue;
 		}
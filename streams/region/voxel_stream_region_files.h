@@ -6,6 +6,12 @@
 #include "../voxel_block_serializer.h"
 #include "../voxel_stream.h"
 #include "region_file.h"
+#include <core/os/mutex.h>
+#include <core/os/semaphore.h>
+#include <core/os/thread.h>
+#include <atomic>
+#include <memory>
+#include <unordered_set>
 
 class FileAccess;
 
@@ -16,7 +22,8 @@ class FileAccess;
 // because it allows to keep using the same file handles and avoid switching.
 // Inspired by https://www.seedofandromeda.com/blogs/1-creating-a-region-file-system-for-a-voxel-game
 //
-// Region files are not thread-safe. Because of this, internal mutexing may often constrain the use by one thread only.
+// Each cached region has its own lock, so multiple threads can load blocks at the same time,
+// even from the same region. Saving a block locks its region exclusively.
 //
 class VoxelStreamRegionFiles : public VoxelStream {
 	GDCLASS(VoxelStreamRegionFiles, VoxelStream)
@@ -30,6 +37,8 @@ public:
 	void emerge_blocks(Vector<VoxelBlockRequest> &p_blocks, Vector<Result> &out_results) override;
 	void immerge_blocks(const Vector<VoxelBlockRequest> &p_blocks) override;
 
+	bool may_have_block(Vector3i origin_in_voxels, int lod) override;
+
 	int get_used_channels_mask() const override;
 
 	String get_directory() const;
@@ -66,6 +75,8 @@ private:
 	};
 
 	EmergeResult _emerge_block(Ref<VoxelBuffer> out_buffer, Vector3i origin_in_voxels, int lod);
+	void _emerge_blocks_in_region(Span<VoxelBlockRequest *> requests, Span<EmergeResult> out_results);
+	EmergeResult prepare_meta_for_emerge();
 	void _immerge_block(Ref<VoxelBuffer> voxel_buffer, Vector3i origin_in_voxels, int lod);
 
 	VoxelFileResult save_meta();
@@ -73,12 +84,18 @@ private:
 	Vector3i get_block_position_from_voxels(const Vector3i &origin_in_voxels) const;
 	Vector3i get_region_position_from_blocks(const Vector3i &block_position) const;
 	void close_all_regions();
+	void scan_existing_regions();
 	String get_region_file_path(const Vector3i &region_pos, unsigned int lod) const;
-	CachedRegion *open_region(const Vector3i region_pos, unsigned int lod, bool create_if_not_found);
-	void close_region(CachedRegion *cache);
-	CachedRegion *get_region_from_cache(const Vector3i pos, int lod) const;
-	int get_sectors_count(const RegionHeader &header) const;
-	void close_oldest_region();
+	std::shared_ptr<CachedRegion> open_region(const Vector3i region_pos, unsigned int lod, bool create_if_not_found);
+	std::shared_ptr<CachedRegion> get_region_from_cache(const Vector3i pos, int lod) const;
+	bool close_oldest_region();
+	RegionHeader *get_region_header_from_cache(const Vector3i pos, int lod);
+	void cache_region_header(const Vector3i pos, int lod, const VoxelRegionFile *region);
+	bool region_may_have_block(const Vector3i region_pos, int lod, const Vector3i block_rpos);
+
+	void request_compaction(const std::shared_ptr<CachedRegion> &region);
+	void stop_compaction_thread();
+	static void compaction_thread_func_static(void *p_data);
 
 	struct Meta {
 		uint8_t version = -1;
@@ -113,28 +130,57 @@ private:
 
 	static thread_local VoxelBlockSerializerInternal _block_serializer;
 
-	// TODO This is not thread-friendly.
-	// `VoxelRegionFile` is not thread-safe so we have to limit the usage to one thread at once, blocking the others.
-	// A refactoring should be done to allow better threading.
-
+	// Regions are shared with the threads using them, so one can be removed from the cache while it is still in use.
+	// The file is closed when the last thread is done with it.
 	struct CachedRegion {
 		Vector3i position;
 		int lod = 0;
 		bool file_exists = false;
+		// Read lock to load blocks, write lock to save blocks
+		RWLock rw_lock;
 		VoxelRegionFile region;
 		uint64_t last_opened = 0;
+		// Protected by `_compaction_mutex`
+		bool compaction_requested = false;
 		//uint64_t last_accessed;
 	};
 
+	// Block table of a region which is not open, so we can tell which blocks it contains without opening it
+	struct RegionHeader {
+		Vector3i position;
+		int lod = 0;
+		bool file_exists = false;
+		std::vector<VoxelRegionBlockInfo> blocks;
+		uint64_t last_used = 0;
+	};
+
 	String _directory_path;
 	Meta _meta;
 	bool _meta_loaded = false;
 	bool _meta_saved = false;
-	std::vector<CachedRegion *> _region_cache;
+	std::vector<std::shared_ptr<CachedRegion>> _region_cache;
 	// TODO Add memory caches to increase capacity.
 	unsigned int _max_open_regions = MIN(8, FOPEN_MAX);
-
+	// Headers are small compared to file handles, so we can keep many more of them.
+	// A region is either open or has its header cached, not both.
+	std::vector<RegionHeader> _region_headers;
+	unsigned int _max_cached_region_headers = 64;
+	// Positions of all region files, listed when meta is loaded, so we know which regions don't exist
+	// without checking the filesystem. Only used if `_existing_regions_scanned` is true.
+	FixedArray<std::unordered_set<Vector3i>, VoxelConstants::MAX_LOD> _existing_regions;
+	bool _existing_regions_scanned = false;
+
+	// Protects meta and the list of cached regions. Not held during block IO.
 	Mutex _mutex;
+
+	// Region files are compacted in a separate thread, so saves don't have to wait for it.
+	// Queued regions are kept open until they are compacted.
+	Thread _compaction_thread;
+	Semaphore _compaction_semaphore;
+	Mutex _compaction_mutex;
+	std::vector<std::shared_ptr<CachedRegion>> _regions_to_compact;
+	bool _compaction_thread_started = false;
+	std::atomic<bool> _compaction_thread_stop{ false };
 };
 
 #endif // VOXEL_STREAM_REGION_H
@@ -1,8 +1,11 @@
 #include "voxel_stream_sqlite.h"
 #include "../../thirdparty/sqlite/sqlite3.h"
 #include "../../util/macros.h"
+#include "../../util/math/morton.h"
 #include "../../util/profiling.h"
 #include "../compressed_data.h"
+#include <core/os/os.h>
+#include <algorithm>
 #include <limits>
 #include <string>
 
@@ -22,6 +25,7 @@ struct BlockLocation {
 		return true;
 	}
 
+	// Key used by databases of version 0
 	uint64_t encode() const {
 		// 0l xx yy zz
 		return ((static_cast<uint64_t>(lod) & 0xffff) << 48) |
@@ -30,6 +34,18 @@ struct BlockLocation {
 			   (static_cast<uint64_t>(z) & 0xffff);
 	}
 
+	// Key used by databases of version 1 and later.
+	// Coordinates are interleaved, so blocks close to each other in space tend to be close in the table too,
+	// and batches of nearby blocks are found in fewer pages. LOD comes first, so each LOD is contiguous.
+	uint64_t encode_morton() const {
+		// 0l mm mm mm
+		return (static_cast<uint64_t>(lod) << 48) |
+			   morton3d_encode_64(
+					   static_cast<int32_t>(x) - std::numeric_limits<int16_t>::min(),
+					   static_cast<int32_t>(y) - std::numeric_limits<int16_t>::min(),
+					   static_cast<int32_t>(z) - std::numeric_limits<int16_t>::min());
+	}
+
 	static BlockLocation decode(uint64_t id) {
 		BlockLocation b;
 		b.z = (id & 0xffff);
@@ -38,6 +54,17 @@ struct BlockLocation {
 		b.lod = ((id >> 48) & 0xff);
 		return b;
 	}
+
+	static BlockLocation decode_morton(uint64_t id) {
+		uint32_t x, y, z;
+		morton3d_decode_64(id & ((uint64_t(1) << 48) - 1), x, y, z);
+		BlockLocation b;
+		b.x = static_cast<int32_t>(x) + std::numeric_limits<int16_t>::min();
+		b.y = static_cast<int32_t>(y) + std::numeric_limits<int16_t>::min();
+		b.z = static_cast<int32_t>(z) + std::numeric_limits<int16_t>::min();
+		b.lod = ((id >> 48) & 0xff);
+		return b;
+	}
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -45,7 +72,12 @@ struct BlockLocation {
 // One connection to the database, with our prepared statements
 class VoxelStreamSQLiteInternal {
 public:
-	static const int VERSION = 0;
+	// 0: Blocks are keyed with `BlockLocation::encode`
+	// 1: Blocks are keyed with `BlockLocation::encode_morton`
+	static const int VERSION = 1;
+
+	// Maximum number of blocks fetched by one batched query
+	static const unsigned int LOAD_BATCH_SIZE = 32;
 
 	struct Meta {
 		int version = -1;
@@ -64,10 +96,13 @@ public:
 		INSTANCES
 	};
 
+	// How long a connection waits for another one to release its write lock, before failing with SQLITE_BUSY
+	static const int BUSY_TIMEOUT_MS = 5000;
+
 	VoxelStreamSQLiteInternal();
 	~VoxelStreamSQLiteInternal();
 
-	bool open(const char *fpath);
+	bool open(const char *fpath, VoxelStreamSQLite::SynchronousMode synchronous_mode, int wal_autocheckpoint);
 	void close();
 
 	bool is_open() const { return _db != nullptr; }
@@ -81,12 +116,28 @@ public:
 		return _opened_path.c_str();
 	}
 
+	bool has_options(VoxelStreamSQLite::SynchronousMode synchronous_mode, int wal_autocheckpoint) const {
+		return _synchronous_mode == synchronous_mode && _wal_autocheckpoint == wal_autocheckpoint;
+	}
+
 	bool begin_transaction();
 	bool end_transaction();
 
 	bool save_block(BlockLocation loc, const std::vector<uint8_t> &block_data, BlockType type);
 	VoxelStream::Result load_block(BlockLocation loc, std::vector<uint8_t> &out_block_data, BlockType type);
 
+	// Loads multiple blocks with as few queries as possible.
+	// For each block which is found, calls `found_func(index, data)`, where `index` is the position of the block
+	// in `locations`, and `data` is only valid during the call.
+	// Returns false if a query failed, in which case some blocks may not have been looked up.
+	template <typename F>
+	bool load_blocks(Span<const BlockLocation> locations, BlockType type, F found_func);
+
+	// Calls `f(BlockLocation)` for every block present in the database.
+	// Only keys are read, but it still goes through the whole table, so it should be done rarely.
+	template <typename F>
+	bool for_each_block_location(F f);
+
 	Meta load_meta();
 	void save_meta(Meta meta);
 
@@ -118,14 +169,45 @@ private:
 		}
 	}
 
+	bool exec(const char *sql) {
+		char *error_message = nullptr;
+		const int rc = sqlite3_exec(_db, sql, nullptr, nullptr, &error_message);
+		if (rc != SQLITE_OK) {
+			ERR_PRINT(String("Executing `{0}` failed: {1}").format(varray(sql, error_message)));
+			sqlite3_free(error_message);
+			return false;
+		}
+		return true;
+	}
+
+	uint64_t encode_location(BlockLocation loc) const {
+		return _version == 0 ? loc.encode() : loc.encode_morton();
+	}
+
+	BlockLocation decode_location(uint64_t key) const {
+		return _version == 0 ? BlockLocation::decode(key) : BlockLocation::decode_morton(key);
+	}
+
+	struct KeyAndIndex {
+		uint64_t key;
+		unsigned int index;
+
+		inline bool operator<(const KeyAndIndex &other) const {
+			return key < other.key;
+		}
+	};
+
 	std::string _opened_path;
+	int _version = VERSION;
+	VoxelStreamSQLite::SynchronousMode _synchronous_mode = VoxelStreamSQLite::SYNCHRONOUS_NORMAL;
+	int _wal_autocheckpoint = 0;
 	sqlite3 *_db = nullptr;
 	sqlite3_stmt *_begin_statement = nullptr;
 	sqlite3_stmt *_end_statement = nullptr;
 	sqlite3_stmt *_update_voxel_block_statement = nullptr;
-	sqlite3_stmt *_get_voxel_block_statement = nullptr;
+	sqlite3_stmt *_get_voxel_blocks_statement = nullptr;
 	sqlite3_stmt *_update_instance_block_statement = nullptr;
-	sqlite3_stmt *_get_instance_block_statement = nullptr;
+	sqlite3_stmt *_get_instance_blocks_statement = nullptr;
 	sqlite3_stmt *_load_meta_statement = nullptr;
 	sqlite3_stmt *_save_meta_statement = nullptr;
 	sqlite3_stmt *_load_channels_statement = nullptr;
@@ -139,11 +221,13 @@ VoxelStreamSQLiteInternal::~VoxelStreamSQLiteInternal() {
 	close();
 }
 
-bool VoxelStreamSQLiteInternal::open(const char *fpath) {
+bool VoxelStreamSQLiteInternal::open(
+		const char *fpath, VoxelStreamSQLite::SynchronousMode synchronous_mode, int wal_autocheckpoint) {
 	VOXEL_PROFILE_SCOPE();
 	close();
 
-	int rc = sqlite3_open_v2(fpath, &_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+	// A connection is only ever used by one thread at a time, so SQLite doesn't need to lock it
+	int rc = sqlite3_open_v2(fpath, &_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr);
 	if (rc != 0) {
 		ERR_PRINT(String("Could not open database: {0}").format(varray(sqlite3_errmsg(_db))));
 		close();
@@ -153,6 +237,34 @@ bool VoxelStreamSQLiteInternal::open(const char *fpath) {
 	sqlite3 *db = _db;
 	char *error_message = nullptr;
 
+	sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+
+	// With write-ahead logging, readers don't block the writer and the writer doesn't block readers,
+	// so loading blocks can go on while the cache is being flushed. The mode is persistent in the database file.
+	// If it can't be used (for example on some network file systems), we stay with the rollback journal.
+	if (!exec("PRAGMA journal_mode=WAL")) {
+		WARN_PRINT("Could not enable write-ahead logging, loading and saving blocks will not run in parallel");
+	}
+
+	const char *synchronous_pragmas[VoxelStreamSQLite::SYNCHRONOUS_MODE_COUNT] = {
+		"PRAGMA synchronous=OFF",
+		"PRAGMA synchronous=NORMAL",
+		"PRAGMA synchronous=FULL"
+	};
+	CRASH_COND(synchronous_mode < 0 || synchronous_mode >= VoxelStreamSQLite::SYNCHRONOUS_MODE_COUNT);
+	if (!exec(synchronous_pragmas[synchronous_mode])) {
+		close();
+		return false;
+	}
+
+	// Automatic checkpoints run at the end of the transaction which makes the log grow past the threshold,
+	// which is the one flushing the cache. A value of 0 disables them, and the log is then only written back
+	// into the database when the last connection is closed.
+	rc = sqlite3_wal_autocheckpoint(db, wal_autocheckpoint);
+	if (rc != SQLITE_OK) {
+		ERR_PRINT(sqlite3_errmsg(db));
+	}
+
 	// Create tables if they dont exist
 	const char *tables[3] = {
 		"CREATE TABLE IF NOT EXISTS meta (version INTEGER, block_size_po2 INTEGER)",
@@ -175,16 +287,24 @@ bool VoxelStreamSQLiteInternal::open(const char *fpath) {
 				"ON CONFLICT(loc) DO UPDATE SET vb=excluded.vb")) {
 		return false;
 	}
-	if (!prepare(db, &_get_voxel_block_statement, "SELECT vb FROM blocks WHERE loc=:loc")) {
-		return false;
-	}
 	if (!prepare(db, &_update_instance_block_statement,
 				"INSERT INTO blocks VALUES (:loc, null, :instances) "
 				"ON CONFLICT(loc) DO UPDATE SET instances=excluded.instances")) {
 		return false;
 	}
-	if (!prepare(db, &_get_instance_block_statement, "SELECT instances FROM blocks WHERE loc=:loc")) {
-		return false;
+	{
+		std::string keys = "?";
+		for (unsigned int i = 1; i < LOAD_BATCH_SIZE; ++i) {
+			keys += ",?";
+		}
+		const std::string get_voxel_blocks_sql = "SELECT loc, vb FROM blocks WHERE loc IN (" + keys + ")";
+		if (!prepare(db, &_get_voxel_blocks_statement, get_voxel_blocks_sql.c_str())) {
+			return false;
+		}
+		const std::string get_instance_blocks_sql = "SELECT loc, instances FROM blocks WHERE loc IN (" + keys + ")";
+		if (!prepare(db, &_get_instance_blocks_statement, get_instance_blocks_sql.c_str())) {
+			return false;
+		}
 	}
 	if (!prepare(db, &_begin_statement, "BEGIN")) {
 		return false;
@@ -220,9 +340,18 @@ bool VoxelStreamSQLiteInternal::open(const char *fpath) {
 			channel.depth = VoxelBuffer::DEPTH_16_BIT;
 		}
 		save_meta(meta);
+
+	} else if (meta.version > VERSION) {
+		ERR_PRINT(String("Database version {0} is not supported, it was probably created by a newer version")
+						  .format(varray(meta.version)));
+		close();
+		return false;
 	}
 
+	_version = meta.version;
 	_opened_path = fpath;
+	_synchronous_mode = synchronous_mode;
+	_wal_autocheckpoint = wal_autocheckpoint;
 	return true;
 }
 
@@ -233,9 +362,9 @@ void VoxelStreamSQLiteInternal::close() {
 	finalize(_begin_statement);
 	finalize(_end_statement);
 	finalize(_update_voxel_block_statement);
-	finalize(_get_voxel_block_statement);
+	finalize(_get_voxel_blocks_statement);
 	finalize(_update_instance_block_statement);
-	finalize(_get_instance_block_statement);
+	finalize(_get_instance_blocks_statement);
 	finalize(_load_meta_statement);
 	finalize(_save_meta_statement);
 	finalize(_load_channels_statement);
@@ -303,7 +432,7 @@ bool VoxelStreamSQLiteInternal::save_block(BlockLocation loc, const std::vector<
 		return false;
 	}
 
-	const uint64_t eloc = loc.encode();
+	const uint64_t eloc = encode_location(loc);
 
 	rc = sqlite3_bind_int64(update_block_statement, 1, eloc);
 	if (rc != SQLITE_OK) {
@@ -335,58 +464,176 @@ VoxelStream::Result VoxelStreamSQLiteInternal::load_block(
 		BlockLocation loc, std::vector<uint8_t> &out_block_data, BlockType type) {
 	sqlite3 *db = _db;
 
-	sqlite3_stmt *get_block_statement;
+	const char *column;
 	switch (type) {
 		case VOXELS:
-			get_block_statement = _get_voxel_block_statement;
+			column = "vb";
 			break;
 		case INSTANCES:
-			get_block_statement = _get_instance_block_statement;
+			column = "instances";
 			break;
 		default:
 			CRASH_NOW();
 	}
 
-	int rc;
-
-	rc = sqlite3_reset(get_block_statement);
+	// `loc` is the integer primary key of the table, which makes it an alias of the rowid.
+	// That allows to use incremental blob I/O, which copies the blob directly from database pages into our buffer
+	// instead of going through a statement.
+	const uint64_t eloc = encode_location(loc);
+	sqlite3_blob *blob = nullptr;
+	int rc = sqlite3_blob_open(db, "main", "blocks", column, eloc, 0, &blob);
+	if (rc == SQLITE_ERROR) {
+		// The row doesn't exist, or the column is null
+		return VoxelStream::RESULT_BLOCK_NOT_FOUND;
+	}
 	if (rc != SQLITE_OK) {
 		ERR_PRINT(sqlite3_errmsg(db));
 		return VoxelStream::RESULT_ERROR;
 	}
 
-	const uint64_t eloc = loc.encode();
+	VoxelStream::Result result = VoxelStream::RESULT_BLOCK_NOT_FOUND;
 
-	rc = sqlite3_bind_int64(get_block_statement, 1, eloc);
-	if (rc != SQLITE_OK) {
-		ERR_PRINT(sqlite3_errmsg(db));
-		return VoxelStream::RESULT_ERROR;
+	const int blob_size = sqlite3_blob_bytes(blob);
+	if (blob_size != 0) {
+		out_block_data.resize(blob_size);
+		rc = sqlite3_blob_read(blob, out_block_data.data(), blob_size, 0);
+		if (rc == SQLITE_OK) {
+			result = VoxelStream::RESULT_BLOCK_FOUND;
+		} else {
+			ERR_PRINT(sqlite3_errmsg(db));
+			result = VoxelStream::RESULT_ERROR;
+		}
 	}
 
-	VoxelStream::Result result = VoxelStream::RESULT_BLOCK_NOT_FOUND;
+	sqlite3_blob_close(blob);
+	return result;
+}
+
+template <typename F>
+bool VoxelStreamSQLiteInternal::load_blocks(Span<const BlockLocation> locations, BlockType type, F found_func) {
+	VOXEL_PROFILE_SCOPE();
+	sqlite3 *db = _db;
+
+	sqlite3_stmt *get_blocks_statement;
+	switch (type) {
+		case VOXELS:
+			get_blocks_statement = _get_voxel_blocks_statement;
+			break;
+		case INSTANCES:
+			get_blocks_statement = _get_instance_blocks_statement;
+			break;
+		default:
+			CRASH_NOW();
+	}
 
+	// Sort keys so each query covers nearby blocks, and rows can be matched back to their requests
+	static thread_local std::vector<KeyAndIndex> tls_keys;
+	std::vector<KeyAndIndex> &keys = tls_keys;
+	keys.resize(locations.size());
+	for (unsigned int i = 0; i < locations.size(); ++i) {
+		keys[i] = KeyAndIndex{ encode_location(locations[i]), i };
+	}
+	std::sort(keys.begin(), keys.end());
+
+	size_t batch_begin = 0;
+	while (batch_begin < keys.size()) {
+		// Duplicate keys are bound once, so they don't take the place of other blocks
+		size_t batch_end = batch_begin;
+		unsigned int bound_count = 0;
+		uint64_t last_bound_key = 0;
+
+		int rc = sqlite3_reset(get_blocks_statement);
+		if (rc != SQLITE_OK) {
+			ERR_PRINT(sqlite3_errmsg(db));
+			return false;
+		}
+
+		while (batch_end < keys.size()) {
+			const uint64_t key = keys[batch_end].key;
+			if (bound_count == 0 || key != last_bound_key) {
+				if (bound_count == LOAD_BATCH_SIZE) {
+					break;
+				}
+				++bound_count;
+				rc = sqlite3_bind_int64(get_blocks_statement, bound_count, key);
+				if (rc != SQLITE_OK) {
+					ERR_PRINT(sqlite3_errmsg(db));
+					return false;
+				}
+				last_bound_key = key;
+			}
+			++batch_end;
+		}
+		// Fill remaining parameters with a key we already look for
+		for (unsigned int i = bound_count + 1; i <= LOAD_BATCH_SIZE; ++i) {
+			rc = sqlite3_bind_int64(get_blocks_statement, i, last_bound_key);
+			if (rc != SQLITE_OK) {
+				ERR_PRINT(sqlite3_errmsg(db));
+				return false;
+			}
+		}
+
+		const auto batch_begin_it = keys.begin() + batch_begin;
+		const auto batch_end_it = keys.begin() + batch_end;
+
+		while (true) {
+			rc = sqlite3_step(get_blocks_statement);
+			if (rc == SQLITE_ROW) {
+				const uint64_t key = sqlite3_column_int64(get_blocks_statement, 0);
+				const uint8_t *blob = reinterpret_cast<const uint8_t *>(sqlite3_column_blob(get_blocks_statement, 1));
+				const size_t blob_size = sqlite3_column_bytes(get_blocks_statement, 1);
+				if (blob_size != 0) {
+					const Span<const uint8_t> data(blob, blob_size);
+					auto it = std::lower_bound(batch_begin_it, batch_end_it, KeyAndIndex{ key, 0 });
+					for (; it != batch_end_it && it->key == key; ++it) {
+						found_func(it->index, data);
+					}
+				}
+				continue;
+			}
+			if (rc != SQLITE_DONE) {
+				ERR_PRINT(sqlite3_errmsg(db));
+				return false;
+			}
+			break;
+		}
+
+		batch_begin = batch_end;
+	}
+
+	return true;
+}
+
+template <typename F>
+bool VoxelStreamSQLiteInternal::for_each_block_location(F f) {
+	VOXEL_PROFILE_SCOPE();
+
+	// Not kept prepared, because it is only used once per database
+	sqlite3_stmt *statement = nullptr;
+	if (!prepare(_db, &statement, "SELECT loc FROM blocks")) {
+		return false;
+	}
+
+	TransactionScope transaction(*this);
+
+	bool success = true;
 	while (true) {
-		rc = sqlite3_step(get_block_statement);
+		const int rc = sqlite3_step(statement);
 		if (rc == SQLITE_ROW) {
-			const void *blob = sqlite3_column_blob(get_block_statement, 0);
-			//const uint8_t *b = reinterpret_cast<const uint8_t *>(blob);
-			const size_t blob_size = sqlite3_column_bytes(get_block_statement, 0);
-			if (blob_size != 0) {
-				result = VoxelStream::RESULT_BLOCK_FOUND;
-				out_block_data.resize(blob_size);
-				memcpy(out_block_data.data(), blob, blob_size);
+			const uint64_t key = sqlite3_column_int64(statement, 0);
+			f(decode_location(key));
+
+		} else {
+			if (rc != SQLITE_DONE) {
+				ERR_PRINT(sqlite3_errmsg(_db));
+				success = false;
 			}
-			// The query is still ongoing, we'll need to step one more time to complete it
-			continue;
-		}
-		if (rc != SQLITE_DONE) {
-			ERR_PRINT(sqlite3_errmsg(db));
-			return VoxelStream::RESULT_ERROR;
+			break;
 		}
-		break;
 	}
 
-	return result;
+	finalize(statement);
+	return success;
 }
 
 VoxelStreamSQLiteInternal::Meta VoxelStreamSQLiteInternal::load_meta() {
@@ -521,25 +768,26 @@ void VoxelStreamSQLiteInternal::save_meta(Meta meta) {
 thread_local VoxelBlockSerializerInternal VoxelStreamSQLite::_voxel_block_serializer;
 thread_local std::vector<uint8_t> VoxelStreamSQLite::_temp_block_data;
 thread_local std::vector<uint8_t> VoxelStreamSQLite::_temp_compressed_block_data;
+thread_local std::vector<BlockLocation> VoxelStreamSQLite::_temp_locations;
 
 VoxelStreamSQLite::VoxelStreamSQLite() {
 }
 
 VoxelStreamSQLite::~VoxelStreamSQLite() {
 	PRINT_VERBOSE("~VoxelStreamSQLite");
+	stop_background_thread();
 	if (!_connection_path.empty() && _cache.get_indicative_block_count() > 0) {
 		PRINT_VERBOSE("~VoxelStreamSQLite flushy flushy");
 		flush_cache();
 		PRINT_VERBOSE("~VoxelStreamSQLite flushy done");
 	}
-	for (auto it = _connection_pool.begin(); it != _connection_pool.end(); ++it) {
-		delete *it;
-	}
-	_connection_pool.clear();
+	clear_connection_pool();
 	PRINT_VERBOSE("~VoxelStreamSQLite done");
 }
 
 void VoxelStreamSQLite::set_database_path(String path) {
+	// Locked first, so the index can't be loading from the previous database while we reset it
+	MutexLock presence_index_lock(_presence_index_mutex);
 	MutexLock lock(_connection_mutex);
 	if (path == _connection_path) {
 		return;
@@ -548,19 +796,19 @@ void VoxelStreamSQLite::set_database_path(String path) {
 		// Save cached data before changing the path.
 		// Not using get_connection() because it locks.
 		VoxelStreamSQLiteInternal con;
-		CharString cpath = path.utf8();
+		CharString cpath = _connection_path.utf8();
 		// Note, the path could be invalid,
 		// Since Godot helpfully sets the property for every character typed in the inspector.
 		// So there can be lots of errors in the editor if you type it.
-		if (con.open(cpath)) {
+		if (con.open(cpath, _synchronous_mode, _wal_autocheckpoint)) {
 			flush_cache(&con);
 		}
 	}
-	for (auto it = _connection_pool.begin(); it != _connection_pool.end(); ++it) {
-		delete *it;
-	}
-	_connection_pool.clear();
+	clear_connection_pool();
 	_connection_path = path;
+	_presence_index.clear();
+	_presence_index_loaded = false;
+	_presence_index_requested = false;
 	// Don't actually open anything here. We'll do it only when necessary
 }
 
@@ -569,6 +817,37 @@ String VoxelStreamSQLite::get_database_path() const {
 	return _connection_path;
 }
 
+void VoxelStreamSQLite::set_synchronous_mode(SynchronousMode mode) {
+	ERR_FAIL_INDEX(mode, SYNCHRONOUS_MODE_COUNT);
+	MutexLock lock(_connection_mutex);
+	if (mode == _synchronous_mode) {
+		return;
+	}
+	_synchronous_mode = mode;
+	// Connections in use will be closed when they get recycled
+	clear_connection_pool();
+}
+
+VoxelStreamSQLite::SynchronousMode VoxelStreamSQLite::get_synchronous_mode() const {
+	MutexLock lock(_connection_mutex);
+	return _synchronous_mode;
+}
+
+void VoxelStreamSQLite::set_wal_autocheckpoint(int page_count) {
+	ERR_FAIL_COND(page_count < 0);
+	MutexLock lock(_connection_mutex);
+	if (page_count == _wal_autocheckpoint) {
+		return;
+	}
+	_wal_autocheckpoint = page_count;
+	clear_connection_pool();
+}
+
+int VoxelStreamSQLite::get_wal_autocheckpoint() const {
+	MutexLock lock(_connection_mutex);
+	return _wal_autocheckpoint;
+}
+
 VoxelStream::Result VoxelStreamSQLite::emerge_block(Ref<VoxelBuffer> out_buffer, Vector3i origin_in_voxels, int lod) {
 	VoxelBlockRequest r;
 	r.lod = lod;
@@ -603,17 +882,27 @@ void VoxelStreamSQLite::emerge_blocks(Vector<VoxelBlockRequest> &p_blocks, Vecto
 	Vector<int> blocks_to_load;
 	for (int i = 0; i < p_blocks.size(); ++i) {
 		VoxelBlockRequest &wr = p_blocks.write[i];
-		const Vector3i pos = wr.origin_in_voxels >> bs_po2;
-
-		Ref<VoxelBuffer> vb;
-		if (_cache.load_voxel_block(pos, wr.lod, wr.voxel_buffer)) {
-			out_results.write[i] = RESULT_BLOCK_FOUND;
-
-		} else {
-			blocks_to_load.push_back(i);
+		const Vector3i pos = get_voxel_block_key(wr.origin_in_voxels, bs_po2);
+
+		switch (_cache.load_voxel_block(pos, wr.lod, wr.voxel_buffer)) {
+			case VoxelStreamCache::FOUND:
+				out_results.write[i] = RESULT_BLOCK_FOUND;
+				break;
+			case VoxelStreamCache::ERASED:
+				// The database might still have it until the cache is flushed
+				out_results.write[i] = RESULT_BLOCK_NOT_FOUND;
+				break;
+			default:
+				blocks_to_load.push_back(i);
+				break;
 		}
 	}
 
+	// Saves may stop for a while, so old changes are also checked here
+	if (_cache.has_changes_older_than(CACHE_FLUSH_AGE_MSEC)) {
+		request_background_flush();
+	}
+
 	if (blocks_to_load.size() == 0) {
 		// Everything was cached, no need to query the database
 		return;
@@ -625,14 +914,15 @@ void VoxelStreamSQLite::emerge_blocks(Vector<VoxelBlockRequest> &p_blocks, Vecto
 	// TODO We should handle busy return codes
 	ERR_FAIL_COND(con->begin_transaction() == false);
 
-	for (int i = 0; i < blocks_to_load.size(); ++i) {
-		const int ri = blocks_to_load[i];
+	if (blocks_to_load.size() == 1) {
+		const int ri = blocks_to_load[0];
 		const VoxelBlockRequest &r = p_blocks[ri];
 
+		const Vector3i pos = get_voxel_block_key(r.origin_in_voxels, bs_po2);
 		BlockLocation loc;
-		loc.x = r.origin_in_voxels.x >> bs_po2;
-		loc.y = r.origin_in_voxels.y >> bs_po2;
-		loc.z = r.origin_in_voxels.z >> bs_po2;
+		loc.x = pos.x;
+		loc.y = pos.y;
+		loc.z = pos.z;
 		loc.lod = r.lod;
 
 		const Result res = con->load_block(loc, _temp_block_data, VoxelStreamSQLiteInternal::VOXELS);
@@ -641,10 +931,45 @@ void VoxelStreamSQLite::emerge_blocks(Vector<VoxelBlockRequest> &p_blocks, Vecto
 			VoxelBlockRequest &wr = p_blocks.write[ri];
 			// TODO Not sure if we should actually expect non-null. There can be legit not found blocks.
 			ERR_FAIL_COND(wr.voxel_buffer.is_null());
-			_voxel_block_serializer.decompress_and_deserialize(_temp_block_data, **wr.voxel_buffer);
+			_voxel_block_serializer.decompress_and_deserialize(to_span_const(_temp_block_data), **wr.voxel_buffer);
+		}
+
+		out_results.write[ri] = res;
+
+	} else {
+		// Query the whole batch at once
+		std::vector<BlockLocation> &locations = _temp_locations;
+		locations.resize(blocks_to_load.size());
+		for (int i = 0; i < blocks_to_load.size(); ++i) {
+			const int ri = blocks_to_load[i];
+			const VoxelBlockRequest &r = p_blocks[ri];
+			const Vector3i pos = get_voxel_block_key(r.origin_in_voxels, bs_po2);
+			BlockLocation &loc = locations[i];
+			loc.x = pos.x;
+			loc.y = pos.y;
+			loc.z = pos.z;
+			loc.lod = r.lod;
+			out_results.write[ri] = RESULT_BLOCK_NOT_FOUND;
 		}
 
-		out_results.write[i] = res;
+		VoxelBlockSerializerInternal &serializer = _voxel_block_serializer;
+		const bool success = con->load_blocks(to_span_const(locations), VoxelStreamSQLiteInternal::VOXELS,
+				[&p_blocks, &out_results, &blocks_to_load, &serializer](unsigned int i, Span<const uint8_t> data) {
+					const int ri = blocks_to_load[i];
+					VoxelBlockRequest &wr = p_blocks.write[ri];
+					ERR_FAIL_COND(wr.voxel_buffer.is_null());
+					if (serializer.decompress_and_deserialize(data, **wr.voxel_buffer)) {
+						out_results.write[ri] = RESULT_BLOCK_FOUND;
+					} else {
+						out_results.write[ri] = RESULT_ERROR;
+					}
+				});
+
+		if (!success) {
+			for (int i = 0; i < blocks_to_load.size(); ++i) {
+				out_results.write[blocks_to_load[i]] = RESULT_ERROR;
+			}
+		}
 	}
 
 	ERR_FAIL_COND(con->end_transaction() == false);
@@ -659,20 +984,18 @@ void VoxelStreamSQLite::immerge_blocks(const Vector<VoxelBlockRequest> &p_blocks
 	// First put in cache
 	for (int i = 0; i < p_blocks.size(); ++i) {
 		const VoxelBlockRequest &r = p_blocks[i];
-		const Vector3i pos = r.origin_in_voxels >> bs_po2;
+		const Vector3i pos = get_voxel_block_key(r.origin_in_voxels, bs_po2);
 
 		if (!BlockLocation::validate(pos, r.lod)) {
 			ERR_PRINT(String("Block position {0} is outside of supported range").format(varray(pos.to_vec3())));
 			continue;
 		}
 
+		_presence_index.set_present(pos, r.lod);
 		_cache.save_voxel_block(pos, r.lod, r.voxel_buffer);
 	}
 
-	// TODO We should consider using a serialized cache, and measure the threshold in bytes
-	if (_cache.get_indicative_block_count() >= CACHE_SIZE) {
-		flush_cache();
-	}
+	flush_cache_if_needed();
 }
 
 bool VoxelStreamSQLite::supports_instance_blocks() const {
@@ -691,11 +1014,16 @@ void VoxelStreamSQLite::load_instance_blocks(
 	for (size_t i = 0; i < out_blocks.size(); ++i) {
 		VoxelStreamInstanceDataRequest &r = out_blocks[i];
 
-		if (_cache.load_instance_block(r.position, r.lod, r.data)) {
-			out_results[i] = RESULT_BLOCK_FOUND;
-
-		} else {
-			blocks_to_load.push_back(i);
+		switch (_cache.load_instance_block(r.position, r.lod, r.data)) {
+			case VoxelStreamCache::FOUND:
+				out_results[i] = RESULT_BLOCK_FOUND;
+				break;
+			case VoxelStreamCache::ERASED:
+				out_results[i] = RESULT_BLOCK_NOT_FOUND;
+				break;
+			default:
+				blocks_to_load.push_back(i);
+				break;
 		}
 	}
 
@@ -711,33 +1039,42 @@ void VoxelStreamSQLite::load_instance_blocks(
 	// TODO recycle on error
 	ERR_FAIL_COND(con->begin_transaction() == false);
 
+	std::vector<BlockLocation> &locations = _temp_locations;
+	locations.resize(blocks_to_load.size());
 	for (int i = 0; i < blocks_to_load.size(); ++i) {
 		const int ri = blocks_to_load[i];
-		VoxelStreamInstanceDataRequest &r = out_blocks[ri];
-
-		BlockLocation loc;
+		const VoxelStreamInstanceDataRequest &r = out_blocks[ri];
+		BlockLocation &loc = locations[i];
 		loc.x = r.position.x;
 		loc.y = r.position.y;
 		loc.z = r.position.z;
 		loc.lod = r.lod;
+		out_results[ri] = RESULT_BLOCK_NOT_FOUND;
+	}
 
-		const Result res = con->load_block(loc, _temp_compressed_block_data, VoxelStreamSQLiteInternal::INSTANCES);
-
-		if (res == RESULT_BLOCK_FOUND) {
-			if (!VoxelCompressedData::decompress(to_span_const(_temp_compressed_block_data), _temp_block_data)) {
-				ERR_PRINT("Failed to decompress instance block");
-				out_results[i] = RESULT_ERROR;
-				continue;
-			}
-			r.data = std::make_unique<VoxelInstanceBlockData>();
-			if (!deserialize_instance_block_data(*r.data, to_span_const(_temp_block_data))) {
-				ERR_PRINT("Failed to deserialize instance block");
-				out_results[i] = RESULT_ERROR;
-				continue;
-			}
+	std::vector<uint8_t> &temp_data = _temp_block_data;
+	const bool success = con->load_blocks(to_span_const(locations), VoxelStreamSQLiteInternal::INSTANCES,
+			[&out_blocks, &out_results, &blocks_to_load, &temp_data](unsigned int i, Span<const uint8_t> data) {
+				const int ri = blocks_to_load[i];
+				VoxelStreamInstanceDataRequest &r = out_blocks[ri];
+				if (!VoxelCompressedData::decompress(data, temp_data)) {
+					ERR_PRINT("Failed to decompress instance block");
+					out_results[ri] = RESULT_ERROR;
+					return;
+				}
+				r.data = std::make_unique<VoxelInstanceBlockData>();
+				if (!deserialize_instance_block_data(*r.data, to_span_const(temp_data))) {
+					ERR_PRINT("Failed to deserialize instance block");
+					out_results[ri] = RESULT_ERROR;
+					return;
+				}
+				out_results[ri] = RESULT_BLOCK_FOUND;
+			});
+
+	if (!success) {
+		for (int i = 0; i < blocks_to_load.size(); ++i) {
+			out_results[blocks_to_load[i]] = RESULT_ERROR;
 		}
-
-		out_results[i] = res;
 	}
 
 	ERR_FAIL_COND(con->end_transaction() == false);
@@ -752,13 +1089,56 @@ void VoxelStreamSQLite::save_instance_blocks(Span<VoxelStreamInstanceDataRequest
 	// First put in cache
 	for (size_t i = 0; i < p_blocks.size(); ++i) {
 		VoxelStreamInstanceDataRequest &r = p_blocks[i];
+		_presence_index.set_present(r.position, r.lod);
 		_cache.save_instance_block(r.position, r.lod, std::move(r.data));
 	}
 
-	// TODO Optimization: we should consider using a serialized cache, and measure the threshold in bytes
-	if (_cache.get_indicative_block_count() >= CACHE_SIZE) {
-		flush_cache();
+	flush_cache_if_needed();
+}
+
+bool VoxelStreamSQLite::may_have_block(Vector3i origin_in_voxels, int lod) {
+	ERR_FAIL_COND_V(lod < 0 || lod >= static_cast<int>(VoxelConstants::MAX_LOD), true);
+
+	if (!_presence_index_loaded) {
+		// Reading all block locations takes a while on large databases, so it is done in the background.
+		// Until then, blocks have to be looked up. If loading fails, loading blocks will report the error.
+		request_presence_index_load();
+		return true;
 	}
+
+	// TODO Get block size from database
+	const int bs_po2 = VoxelConstants::DEFAULT_BLOCK_SIZE_PO2;
+
+	return _presence_index.is_present(get_voxel_block_key(origin_in_voxels, bs_po2), lod) ||
+			_presence_index.is_present(get_instance_block_key(origin_in_voxels, lod, bs_po2), lod);
+}
+
+bool VoxelStreamSQLite::load_presence_index() {
+	MutexLock lock(_presence_index_mutex);
+	if (_presence_index_loaded) {
+		return true;
+	}
+
+	VoxelStreamSQLiteInternal *con = get_connection();
+	if (con == nullptr) {
+		return false;
+	}
+
+	const uint64_t time_before = OS::get_singleton()->get_ticks_usec();
+
+	// Blocks saved since the stream was created are already in it, this adds those from previous sessions
+	VoxelBlockPresenceIndex &index = _presence_index;
+	const bool success = con->for_each_block_location([&index](BlockLocation loc) {
+		index.set_present(Vector3i(loc.x, loc.y, loc.z), loc.lod);
+	});
+
+	recycle_connection(con);
+
+	PRINT_VERBOSE(String("VoxelStreamSQLite: Loaded presence index ({0} regions) in {1} us")
+						  .format(varray(index.get_region_count(), OS::get_singleton()->get_ticks_usec() - time_before)));
+
+	_presence_index_loaded = success;
+	return success;
 }
 
 int VoxelStreamSQLite::get_used_channels_mask() const {
@@ -776,55 +1156,139 @@ void VoxelStreamSQLite::flush_cache() {
 // This function does not lock any mutex for internal use.
 void VoxelStreamSQLite::flush_cache(VoxelStreamSQLiteInternal *con) {
 	VOXEL_PROFILE_SCOPE();
-	PRINT_VERBOSE(String("VoxelStreamSQLite: Flushing cache ({0} elements)")
-						  .format(varray(_cache.get_indicative_block_count())));
-
-	VoxelBlockSerializerInternal &serializer = _voxel_block_serializer;
-
 	ERR_FAIL_COND(con == nullptr);
-	ERR_FAIL_COND(con->begin_transaction() == false);
 
+	VoxelBlockSerializerInternal &serializer = _voxel_block_serializer;
 	std::vector<uint8_t> &temp_data = _temp_block_data;
 	std::vector<uint8_t> &temp_compressed_data = _temp_compressed_block_data;
 
-	// TODO Needs better error rollback handling
-	_cache.flush([&serializer, con, &temp_data, &temp_compressed_data](VoxelStreamCache::Block &block) {
-		ERR_FAIL_COND(!BlockLocation::validate(block.position, block.lod));
+	// Blocks can still be loaded from the cache while they are written
+	const int lz4_acceleration = get_lz4_acceleration();
 
-		BlockLocation loc;
-		loc.x = block.position.x;
-		loc.y = block.position.y;
-		loc.z = block.position.z;
-		loc.lod = block.lod;
-
-		// Save voxels
-		if (block.has_voxels) {
-			if (block.voxels.is_valid()) {
-				VoxelBlockSerializerInternal::SerializeResult res = serializer.serialize_and_compress(**block.voxels);
-				ERR_FAIL_COND(!res.success);
-				con->save_block(loc, res.data, VoxelStreamSQLiteInternal::VOXELS);
-			} else {
-				const std::vector<uint8_t> empty;
-				con->save_block(loc, empty, VoxelStreamSQLiteInternal::VOXELS);
-			}
+	_cache.flush([&serializer, con, &temp_data, &temp_compressed_data, lz4_acceleration](
+						 Span<VoxelStreamCache::Block *> blocks) {
+		if (blocks.size() == 0) {
+			return;
 		}
+		PRINT_VERBOSE(String("VoxelStreamSQLite: Flushing cache ({0} elements)").format(varray(blocks.size())));
+
+		ERR_FAIL_COND(con->begin_transaction() == false);
+
+		// TODO Needs better error rollback handling
+		for (size_t i = 0; i < blocks.size(); ++i) {
+			const VoxelStreamCache::Block &block = *blocks[i];
+			ERR_CONTINUE(!BlockLocation::validate(block.position, block.lod));
+
+			BlockLocation loc;
+			loc.x = block.position.x;
+			loc.y = block.position.y;
+			loc.z = block.position.z;
+			loc.lod = block.lod;
+
+			// Save voxels
+			if (block.has_voxels) {
+				if (block.voxels.is_valid()) {
+					VoxelBlockSerializerInternal::SerializeResult res =
+							serializer.serialize_and_compress(**block.voxels, lz4_acceleration);
+					ERR_CONTINUE(!res.success);
+					con->save_block(loc, res.data, VoxelStreamSQLiteInternal::VOXELS);
+				} else {
+					const std::vector<uint8_t> empty;
+					con->save_block(loc, empty, VoxelStreamSQLiteInternal::VOXELS);
+				}
+			}
 
-		// Save instances
-		temp_compressed_data.clear();
-		if (block.instances != nullptr) {
-			temp_data.clear();
+			// Save instances
+			if (block.has_instances) {
+				temp_compressed_data.clear();
+				if (block.instances != nullptr) {
+					temp_data.clear();
 
-			serialize_instance_block_data(*block.instances, temp_data);
+					serialize_instance_block_data(*block.instances, temp_data);
+
+					ERR_CONTINUE(!VoxelCompressedData::compress(
+							to_span_const(temp_data), temp_compressed_data, VoxelCompressedData::COMPRESSION_NONE));
+				}
+				con->save_block(loc, temp_compressed_data, VoxelStreamSQLiteInternal::INSTANCES);
+			}
 
-			ERR_FAIL_COND(!VoxelCompressedData::compress(
-					to_span_const(temp_data), temp_compressed_data, VoxelCompressedData::COMPRESSION_NONE));
+			// TODO Optimization: add a version of the query that can update both at once
 		}
-		con->save_block(loc, temp_compressed_data, VoxelStreamSQLiteInternal::INSTANCES);
 
-		// TODO Optimization: add a version of the query that can update both at once
+		ERR_FAIL_COND(con->end_transaction() == false);
 	});
+}
 
-	ERR_FAIL_COND(con->end_transaction() == false);
+void VoxelStreamSQLite::flush_cache_if_needed() {
+	const size_t size_in_bytes = _cache.get_size_in_bytes();
+	if (size_in_bytes >= CACHE_MAX_SIZE_IN_BYTES) {
+		// Saves come faster than the background flush can write them, wait for it
+		flush_cache();
+
+	} else if (size_in_bytes >= CACHE_FLUSH_SIZE_IN_BYTES || _cache.has_changes_older_than(CACHE_FLUSH_AGE_MSEC)) {
+		request_background_flush();
+	}
+}
+
+void VoxelStreamSQLite::request_background_flush() {
+	start_background_thread_if_needed();
+	// Requests made while the thread is already going to flush are merged
+	if (!_flush_requested.exchange(true)) {
+		_background_semaphore.post();
+	}
+}
+
+void VoxelStreamSQLite::request_presence_index_load() {
+	// Requested once per database, so if loading fails, queries don't keep retrying it
+	if (!_presence_index_requested.exchange(true)) {
+		start_background_thread_if_needed();
+		_presence_index_load_pending = true;
+		_background_semaphore.post();
+	}
+}
+
+void VoxelStreamSQLite::start_background_thread_if_needed() {
+	MutexLock lock(_background_thread_mutex);
+	if (!_background_thread_started) {
+		// Started only when needed, because many streams are created without ever saving anything
+		_background_thread_started = true;
+		_background_thread.start(background_thread_func_static, this);
+	}
+}
+
+void VoxelStreamSQLite::stop_background_thread() {
+	MutexLock lock(_background_thread_mutex);
+	if (!_background_thread_started) {
+		return;
+	}
+	_background_thread_stop = true;
+	_background_semaphore.post();
+	_background_thread.wait_to_finish();
+	_background_thread_started = false;
+	_background_thread_stop = false;
+	_flush_requested = false;
+	if (_presence_index_load_pending.exchange(false)) {
+		// The load didn't happen, let the next query request it again
+		_presence_index_requested = false;
+	}
+}
+
+void VoxelStreamSQLite::background_thread_func_static(void *p_data) {
+	VoxelStreamSQLite &stream = *static_cast<VoxelStreamSQLite *>(p_data);
+	Thread::set_name("Voxel SQLite background");
+
+	while (true) {
+		stream._background_semaphore.wait();
+		if (stream._background_thread_stop) {
+			break;
+		}
+		if (stream._presence_index_load_pending.exchange(false)) {
+			stream.load_presence_index();
+		}
+		if (stream._flush_requested.exchange(false)) {
+			stream.flush_cache();
+		}
+	}
 }
 
 VoxelStreamSQLiteInternal *VoxelStreamSQLite::get_connection() {
@@ -840,14 +1304,18 @@ VoxelStreamSQLiteInternal *VoxelStreamSQLite::get_connection() {
 		return s;
 	}
 	String fpath = _connection_path;
+	const SynchronousMode synchronous_mode = _synchronous_mode;
+	const int wal_autocheckpoint = _wal_autocheckpoint;
 	_connection_mutex.unlock();
 
 	if (fpath.empty()) {
 		return nullptr;
 	}
+	// Each thread ends up with its own connection, and its own set of prepared statements.
+	// With write-ahead logging, they can all read at the same time.
 	VoxelStreamSQLiteInternal *con = new VoxelStreamSQLiteInternal();
 	CharString fpath_utf8 = fpath.utf8();
-	if (!con->open(fpath_utf8)) {
+	if (!con->open(fpath_utf8, synchronous_mode, wal_autocheckpoint)) {
 		delete con;
 		con = nullptr;
 	}
@@ -857,8 +1325,8 @@ VoxelStreamSQLiteInternal *VoxelStreamSQLite::get_connection() {
 void VoxelStreamSQLite::recycle_connection(VoxelStreamSQLiteInternal *con) {
 	String con_path = con->get_opened_file_path();
 	_connection_mutex.lock();
-	// If path differs, delete this connection
-	if (_connection_path != con_path) {
+	// If path or options differ, delete this connection
+	if (_connection_path != con_path || !con->has_options(_synchronous_mode, _wal_autocheckpoint)) {
 		_connection_mutex.unlock();
 		delete con;
 	} else {
@@ -867,10 +1335,33 @@ void VoxelStreamSQLite::recycle_connection(VoxelStreamSQLiteInternal *con) {
 	}
 }
 
+// Must be called with the connection mutex locked
+void VoxelStreamSQLite::clear_connection_pool() {
+	for (auto it = _connection_pool.begin(); it != _connection_pool.end(); ++it) {
+		delete *it;
+	}
+	_connection_pool.clear();
+}
+
 void VoxelStreamSQLite::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_database_path", "path"), &VoxelStreamSQLite::set_database_path);
 	ClassDB::bind_method(D_METHOD("get_database_path"), &VoxelStreamSQLite::get_database_path);
 
+	ClassDB::bind_method(D_METHOD("set_synchronous_mode", "mode"), &VoxelStreamSQLite::set_synchronous_mode);
+	ClassDB::bind_method(D_METHOD("get_synchronous_mode"), &VoxelStreamSQLite::get_synchronous_mode);
+
+	ClassDB::bind_method(D_METHOD("set_wal_autocheckpoint", "page_count"), &VoxelStreamSQLite::set_wal_autocheckpoint);
+	ClassDB::bind_method(D_METHOD("get_wal_autocheckpoint"), &VoxelStreamSQLite::get_wal_autocheckpoint);
+
 	ADD_PROPERTY(PropertyInfo(Variant::STRING, "database_path", PROPERTY_HINT_FILE),
 			"set_database_path", "get_database_path");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "synchronous_mode", PROPERTY_HINT_ENUM, "Off,Normal,Full"),
+			"set_synchronous_mode", "get_synchronous_mode");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "wal_autocheckpoint", PROPERTY_HINT_RANGE, "0,100000,1"),
+			"set_wal_autocheckpoint", "get_wal_autocheckpoint");
+
+	BIND_ENUM_CONSTANT(SYNCHRONOUS_OFF);
+	BIND_ENUM_CONSTANT(SYNCHRONOUS_NORMAL);
+	BIND_ENUM_CONSTANT(SYNCHRONOUS_FULL);
+	BIND_ENUM_CONSTANT(SYNCHRONOUS_MODE_COUNT);
 }
@@ -1,19 +1,41 @@
 #ifndef VOXEL_STREAM_SQLITE_H
 #define VOXEL_STREAM_SQLITE_H
 
+#include "../voxel_block_presence_index.h"
 #include "../voxel_block_serializer.h"
 #include "../voxel_stream.h"
 #include "../voxel_stream_cache.h"
 #include <core/os/mutex.h>
+#include <core/os/semaphore.h>
+#include <core/os/thread.h>
+#include <atomic>
 #include <vector>
 
 class VoxelStreamSQLiteInternal;
+struct BlockLocation;
 
 // Saves voxel data into a single SQLite database file.
 class VoxelStreamSQLite : public VoxelStream {
 	GDCLASS(VoxelStreamSQLite, VoxelStream)
 public:
-	static const unsigned int CACHE_SIZE = 64;
+	// Saved blocks are written in the background when the cache reaches this size,
+	// or when the oldest of them reaches this age
+	static const size_t CACHE_FLUSH_SIZE_IN_BYTES = 8 * 1024 * 1024;
+	static const uint64_t CACHE_FLUSH_AGE_MSEC = 5000;
+	// If blocks are saved faster than they can be written and the cache reaches this size,
+	// saving waits for the cache to be flushed
+	static const size_t CACHE_MAX_SIZE_IN_BYTES = 4 * CACHE_FLUSH_SIZE_IN_BYTES;
+	// Same as SQLite's default
+	static const int DEFAULT_WAL_AUTOCHECKPOINT = 1000;
+
+	// How often SQLite waits for writes to reach the disk. See SQLite's `PRAGMA synchronous`.
+	// With write-ahead logging, `NORMAL` cannot corrupt the database, but may lose the last saves on power loss.
+	enum SynchronousMode {
+		SYNCHRONOUS_OFF = 0,
+		SYNCHRONOUS_NORMAL,
+		SYNCHRONOUS_FULL,
+		SYNCHRONOUS_MODE_COUNT
+	};
 
 	VoxelStreamSQLite();
 	~VoxelStreamSQLite();
@@ -21,6 +43,14 @@ public:
 	void set_database_path(String path);
 	String get_database_path() const;
 
+	void set_synchronous_mode(SynchronousMode mode);
+	SynchronousMode get_synchronous_mode() const;
+
+	// Number of pages the write-ahead log can reach before it gets written back into the database.
+	// 0 disables automatic checkpoints, the log is then only written back when the database is closed.
+	void set_wal_autocheckpoint(int page_count);
+	int get_wal_autocheckpoint() const;
+
 	Result emerge_block(Ref<VoxelBuffer> out_buffer, Vector3i origin_in_voxels, int lod) override;
 	void immerge_block(Ref<VoxelBuffer> buffer, Vector3i origin_in_voxels, int lod) override;
 
@@ -32,6 +62,8 @@ public:
 			Span<VoxelStreamInstanceDataRequest> out_blocks, Span<Result> out_results) override;
 	void save_instance_blocks(Span<VoxelStreamInstanceDataRequest> p_blocks) override;
 
+	bool may_have_block(Vector3i origin_in_voxels, int lod) override;
+
 	int get_used_channels_mask() const override;
 
 	void flush_cache();
@@ -50,22 +82,54 @@ private:
 	//
 	// Because of this, in our use case, it might be simpler to just leave SQLite in thread-safe mode,
 	// and synchronize ourselves.
+	//
+	// So each thread borrows a connection from a pool, which has its own prepared statements.
+	// The database uses write-ahead logging so these connections can read while another one writes.
 
 	VoxelStreamSQLiteInternal *get_connection();
 	void recycle_connection(VoxelStreamSQLiteInternal *con);
+	void clear_connection_pool();
 	void flush_cache(VoxelStreamSQLiteInternal *con);
+	void flush_cache_if_needed();
+	void request_background_flush();
+	void request_presence_index_load();
+	void start_background_thread_if_needed();
+	void stop_background_thread();
+	static void background_thread_func_static(void *p_data);
+	bool load_presence_index();
 
 	static void _bind_methods();
 
 	String _connection_path;
 	std::vector<VoxelStreamSQLiteInternal *> _connection_pool;
 	Mutex _connection_mutex;
+	SynchronousMode _synchronous_mode = SYNCHRONOUS_NORMAL;
+	int _wal_autocheckpoint = DEFAULT_WAL_AUTOCHECKPOINT;
 	VoxelStreamCache _cache;
 
+	// Writes the cache and loads the presence index in the background, so other threads don't have to wait for it
+	Thread _background_thread;
+	Semaphore _background_semaphore;
+	Mutex _background_thread_mutex;
+	bool _background_thread_started = false;
+	std::atomic<bool> _background_thread_stop{ false };
+	std::atomic<bool> _flush_requested{ false };
+
+	// Blocks present in the database or in the cache. Loaded in the background the first time it is needed,
+	// then updated on save.
+	VoxelBlockPresenceIndex _presence_index;
+	Mutex _presence_index_mutex;
+	std::atomic<bool> _presence_index_loaded{ false };
+	std::atomic<bool> _presence_index_requested{ false };
+	std::atomic<bool> _presence_index_load_pending{ false };
+
 	// TODO I should consider specialized memory allocators
 	static thread_local VoxelBlockSerializerInternal _voxel_block_serializer;
 	static thread_local std::vector<uint8_t> _temp_block_data;
 	static thread_local std::vector<uint8_t> _temp_compressed_block_data;
+	static thread_local std::vector<BlockLocation> _temp_locations;
 };
 
+VARIANT_ENUM_CAST(VoxelStreamSQLite::SynchronousMode);
+
 #endif // VOXEL_STREAM_SQLITE_H
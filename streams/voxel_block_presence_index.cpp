@@ -0,0 +1,53 @@
+#include "voxel_block_presence_index.h"
+
+namespace {
+
+inline unsigned int get_block_index_in_region(Vector3i block_pos) {
+	const Vector3i rpos = block_pos.wrap(Vector3i(VoxelBlockPresenceIndex::REGION_SIZE));
+	return rpos.get_zxy_index(Vector3i(VoxelBlockPresenceIndex::REGION_SIZE));
+}
+
+} // namespace
+
+void VoxelBlockPresenceIndex::set_present(Vector3i block_pos, unsigned int lod_index) {
+	ERR_FAIL_COND(lod_index >= _lods.size());
+	const Vector3i region_pos = block_pos >> REGION_SIZE_PO2;
+	const unsigned int i = get_block_index_in_region(block_pos);
+
+	Lod &lod = _lods[lod_index];
+	RWLockWrite wlock(lod.rw_lock);
+	Region &region = lod.regions[region_pos];
+	region.bits[i >> 6] |= (uint64_t(1) << (i & 63));
+}
+
+bool VoxelBlockPresenceIndex::is_present(Vector3i block_pos, unsigned int lod_index) const {
+	ERR_FAIL_COND_V(lod_index >= _lods.size(), false);
+	const Vector3i region_pos = block_pos >> REGION_SIZE_PO2;
+	const unsigned int i = get_block_index_in_region(block_pos);
+
+	const Lod &lod = _lods[lod_index];
+	RWLockRead rlock(lod.rw_lock);
+	auto it = lod.regions.find(region_pos);
+	if (it == lod.regions.end()) {
+		return false;
+	}
+	return (it->second.bits[i >> 6] & (uint64_t(1) << (i & 63))) != 0;
+}
+
+void VoxelBlockPresenceIndex::clear() {
+	for (unsigned int lod_index = 0; lod_index < _lods.size(); ++lod_index) {
+		Lod &lod = _lods[lod_index];
+		RWLockWrite wlock(lod.rw_lock);
+		lod.regions.clear();
+	}
+}
+
+unsigned int VoxelBlockPresenceIndex::get_region_count() const {
+	unsigned int count = 0;
+	for (unsigned int lod_index = 0; lod_index < _lods.size(); ++lod_index) {
+		const Lod &lod = _lods[lod_index];
+		RWLockRead rlock(lod.rw_lock);
+		count += lod.regions.size();
+	}
+	return count;
+}
@@ -0,0 +1,43 @@
+#ifndef VOXEL_BLOCK_PRESENCE_INDEX_H
+#define VOXEL_BLOCK_PRESENCE_INDEX_H
+
+#include "../constants/voxel_constants.h"
+#include "../util/fixed_array.h"
+#include "../util/math/vector3i.h"
+#include <core/os/rw_lock.h>
+#include <unordered_map>
+
+// Remembers which blocks a stream contains, so it can tell which ones are absent without doing any IO.
+// Blocks are grouped in regions, each storing one bit per block. Regions with no blocks use no memory.
+// Can be used from multiple threads.
+class VoxelBlockPresenceIndex {
+public:
+	// Regions are 16x16x16 blocks
+	static const unsigned int REGION_SIZE_PO2 = 4;
+	static const unsigned int REGION_SIZE = 1 << REGION_SIZE_PO2;
+	static const unsigned int REGION_BLOCK_COUNT = REGION_SIZE * REGION_SIZE * REGION_SIZE;
+
+	void set_present(Vector3i block_pos, unsigned int lod_index);
+	bool is_present(Vector3i block_pos, unsigned int lod_index) const;
+	void clear();
+
+	// Number of regions having at least one block
+	unsigned int get_region_count() const;
+
+private:
+	struct Region {
+		FixedArray<uint64_t, REGION_BLOCK_COUNT / 64> bits;
+
+		Region() :
+				bits(0) {}
+	};
+
+	struct Lod {
+		std::unordered_map<Vector3i, Region> regions;
+		RWLock rw_lock;
+	};
+
+	FixedArray<Lod, VoxelConstants::MAX_LOD> _lods;
+};
+
+#endif // VOXEL_BLOCK_PRESENCE_INDEX_H
@@ -13,51 +13,14 @@
 #include <limits>
 
 namespace {
-const uint8_t BLOCK_VERSION = 2;
+const uint8_t BLOCK_VERSION = 3;
+// Version 3 added sparse, 8-bit SDF and filtered channels. Version 2 blocks don't use them, and read the same way.
+const uint8_t BLOCK_VERSION_LEGACY_2 = 2;
 const unsigned int BLOCK_TRAILING_MAGIC = 0x900df00d;
 const unsigned int BLOCK_TRAILING_MAGIC_SIZE = 4;
 const unsigned int BLOCK_METADATA_HEADER_SIZE = sizeof(uint32_t);
 } // namespace
 
-size_t get_metadata_size_in_bytes(const VoxelBuffer &buffer) {
-	size_t size = 0;
-
-	const Map<Vector3i, Variant>::Element *elem = buffer.get_voxel_metadata().front();
-	while (elem != nullptr) {
-		const Vector3i pos = elem->key();
-
-		ERR_FAIL_COND_V_MSG(pos.x < 0 || static_cast<uint32_t>(pos.x) >= VoxelBuffer::MAX_SIZE, 0,
-				"Invalid voxel metadata X position");
-		ERR_FAIL_COND_V_MSG(pos.y < 0 || static_cast<uint32_t>(pos.y) >= VoxelBuffer::MAX_SIZE, 0,
-				"Invalid voxel metadata Y position");
-		ERR_FAIL_COND_V_MSG(pos.z < 0 || static_cast<uint32_t>(pos.z) >= VoxelBuffer::MAX_SIZE, 0,
-				"Invalid voxel metadata Z position");
-
-		size += 3 * sizeof(uint16_t); // Positions are stored as 3 unsigned shorts
-
-		int len;
-		const Error err = encode_variant(elem->value(), nullptr, len, false);
-		ERR_FAIL_COND_V_MSG(err != OK, 0, "Error when trying to encode voxel metadata.");
-		size += len;
-
-		elem = elem->next();
-	}
-
-	// If no metadata is found at all, nothing is serialized, not even null.
-	// It spares 24 bytes (40 if real_t == double),
-	// and is backward compatible with saves made before introduction of metadata.
-
-	if (size != 0 || buffer.get_block_metadata() != Variant()) {
-		int len;
-		// Get size first by invoking the function is "length mode"
-		const Error err = encode_variant(buffer.get_block_metadata(), nullptr, len, false);
-		ERR_FAIL_COND_V_MSG(err != OK, 0, "Error when trying to encode block metadata.");
-		size += len;
-	}
-
-	return size;
-}
-
 template <typename T>
 inline void write(uint8_t *&dst, T d) {
 	*(T *)dst = d;
@@ -71,42 +34,161 @@ inline T read(uint8_t *&src) {
 	return d;
 }
 
-// The target buffer MUST have correct size. Recoverable errors must have been checked before.
-void serialize_metadata(uint8_t *p_dst, const VoxelBuffer &buffer, const size_t metadata_size) {
-	uint8_t *dst = p_dst;
+// Stores a voxel value using as many bytes as the depth requires
+void store_raw_value(FileAccess *f, uint64_t v, VoxelBuffer::Depth depth) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			f->store_8(v);
+			break;
+		case VoxelBuffer::DEPTH_16_BIT:
+			f->store_16(v);
+			break;
+		case VoxelBuffer::DEPTH_32_BIT:
+			f->store_32(v);
+			break;
+		case VoxelBuffer::DEPTH_64_BIT:
+			f->store_64(v);
+			break;
+		default:
+			CRASH_NOW();
+	}
+}
 
-	{
-		int written_length;
-		encode_variant(buffer.get_block_metadata(), dst, written_length, false);
-		dst += written_length;
+uint64_t get_raw_value(FileAccess *f, VoxelBuffer::Depth depth) {
+	switch (depth) {
+		case VoxelBuffer::DEPTH_8_BIT:
+			return f->get_8();
+		case VoxelBuffer::DEPTH_16_BIT:
+			return f->get_16();
+		case VoxelBuffer::DEPTH_32_BIT:
+			return f->get_32();
+		case VoxelBuffer::DEPTH_64_BIT:
+			return f->get_64();
+		default:
+			CRASH_NOW();
+			return 0;
+	}
+}
 
-		// I chose to cast this way to fix a GCC warning.
-		// If dst - p_dst is negative (which is wrong), it will wrap and cause a justified assertion failure
-		CRASH_COND_MSG(static_cast<size_t>(dst - p_dst) > metadata_size, "Wrote block metadata out of expected bounds");
+// Sparse channels are saved as the brick size, followed by bricks in ZXY order.
+// Each brick starts with one of these flags.
+enum SparseBrickFlag {
+	SPARSE_BRICK_UNIFORM = 0, // Followed by one value
+	SPARSE_BRICK_DENSE = 1 // Followed by all values of the brick, in ZXY order
+};
+
+// Dense channels saved with filters use this value instead of `COMPRESSION_NONE` in their format byte.
+// It is followed by a byte of `VoxelCompressedData::Filter` flags, and the filtered values.
+// It is not a VoxelBuffer compression, it only exists in saved data.
+const uint8_t SERIALIZED_COMPRESSION_FILTERED = 0xf;
+
+// Chooses filters making dense channels more compressible
+uint8_t get_channel_filters(unsigned int channel_index, VoxelBuffer::Depth depth) {
+	if (depth == VoxelBuffer::DEPTH_8_BIT) {
+		return 0;
 	}
+	if (channel_index == VoxelBuffer::CHANNEL_SDF && depth == VoxelBuffer::DEPTH_16_BIT) {
+		// Distances vary smoothly, so differences are small
+		return VoxelCompressedData::FILTER_DELTA_Y | VoxelCompressedData::FILTER_BYTE_SHUFFLE;
+	}
+	return VoxelCompressedData::FILTER_BYTE_SHUFFLE;
+}
 
-	const Map<Vector3i, Variant>::Element *elem = buffer.get_voxel_metadata().front();
-	while (elem != nullptr) {
-		// Serializing key as ushort because it's more than enough for a 3D dense array
-		static_assert(VoxelBuffer::MAX_SIZE <= 65535, "Maximum size exceeds serialization support");
-		const Vector3i pos = elem->key();
-		write<uint16_t>(dst, pos.x);
-		write<uint16_t>(dst, pos.y);
-		write<uint16_t>(dst, pos.z);
+size_t get_sparse_channel_size_in_bytes(const VoxelSparseChannel &sparse) {
+	const unsigned int brick_count = sparse.brick_indices.size();
+	const unsigned int dense_brick_count = sparse.get_dense_brick_count();
+	return 1 + brick_count + (brick_count - dense_brick_count) * sparse.item_size +
+		   dense_brick_count * sparse.get_brick_size_in_bytes();
+}
+
+// Upper bound of the encoded size of types accepted by `has_bounded_encoding`
+const size_t MAX_BOUNDED_VARIANT_SIZE = 128;
+
+// Tells if the encoded size of a type doesn't depend on its value and is at most `MAX_BOUNDED_VARIANT_SIZE`
+inline bool has_bounded_encoding(Variant::Type type) {
+	switch (type) {
+		case Variant::NIL:
+		case Variant::BOOL:
+		case Variant::INT:
+		case Variant::REAL:
+		case Variant::VECTOR2:
+		case Variant::RECT2:
+		case Variant::VECTOR3:
+		case Variant::TRANSFORM2D:
+		case Variant::PLANE:
+		case Variant::QUAT:
+		case Variant::AABB:
+		case Variant::BASIS:
+		case Variant::TRANSFORM:
+		case Variant::COLOR:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// Appends an encoded variant at the end of `dst`.
+// `encode_variant` doesn't check bounds, so the length must be known before writing. Small fixed-size types are
+// written directly into reserved space, other types need a length query first.
+bool append_variant(std::vector<uint8_t> &dst, const Variant &v) {
+	const size_t pos = dst.size();
+	int len;
+	if (has_bounded_encoding(v.get_type())) {
+		dst.resize(pos + MAX_BOUNDED_VARIANT_SIZE);
+	} else {
+		const Error err = encode_variant(v, nullptr, len, false);
+		ERR_FAIL_COND_V(err != OK, false);
+		dst.resize(pos + len);
+	}
+	const Error err = encode_variant(v, dst.data() + pos, len, false);
+	ERR_FAIL_COND_V(err != OK, false);
+	CRASH_COND(pos + len > dst.size());
+	dst.resize(pos + len);
+	return true;
+}
+
+// Encodes block and voxel metadata in a single pass, into a buffer that may be reused.
+// If a recoverable error occurs, we just discard all metadata as if it was empty.
+void serialize_metadata(std::vector<uint8_t> &dst, const VoxelBuffer &buffer) {
+	dst.clear();
 
-		int written_length;
-		const Error err = encode_variant(elem->value(), dst, written_length, false);
-		CRASH_COND_MSG(err != OK, "Error when trying to encode voxel metadata.");
-		dst += written_length;
+	const VoxelMetadataMap &voxel_metadata = buffer.get_voxel_metadata();
 
-		CRASH_COND_MSG(static_cast<size_t>(dst - p_dst) > metadata_size, "Wrote voxel metadata out of expected bounds");
+	// If no metadata is found at all, nothing is serialized, not even null.
+	// It spares 24 bytes (40 if real_t == double),
+	// and is backward compatible with saves made before introduction of metadata.
+	if (voxel_metadata.size() == 0 && buffer.get_block_metadata() == Variant()) {
+		return;
+	}
 
-		elem = elem->next();
+	if (!append_variant(dst, buffer.get_block_metadata())) {
+		ERR_PRINT("Error when trying to encode block metadata.");
+		dst.clear();
+		return;
 	}
 
-	CRASH_COND_MSG(static_cast<size_t>(dst - p_dst) != metadata_size,
-			String("Written metadata doesn't match expected count (expected {0}, got {1})")
-					.format(varray(SIZE_T_TO_VARIANT(metadata_size), (int)(dst - p_dst))));
+	bool success = true;
+	voxel_metadata.for_each([&dst, &success](Vector3i pos, const Variant &meta) {
+		if (!success) {
+			return;
+		}
+		// Serializing key as ushort because it's more than enough for a 3D dense array.
+		// Positions are always valid since they are checked when metadata is set.
+		static_assert(VoxelBuffer::MAX_SIZE <= 65535, "Maximum size exceeds serialization support");
+		const size_t pos_offset = dst.size();
+		dst.resize(pos_offset + 3 * sizeof(uint16_t));
+		uint8_t *pos_dst = dst.data() + pos_offset;
+		write<uint16_t>(pos_dst, pos.x);
+		write<uint16_t>(pos_dst, pos.y);
+		write<uint16_t>(pos_dst, pos.z);
+
+		success = append_variant(dst, meta);
+	});
+
+	if (!success) {
+		ERR_PRINT("Error when trying to encode voxel metadata.");
+		dst.clear();
+	}
 }
 
 bool deserialize_metadata(uint8_t *p_src, VoxelBuffer &buffer, const size_t metadata_size) {
@@ -146,7 +228,7 @@ bool deserialize_metadata(uint8_t *p_src, VoxelBuffer &buffer, const size_t meta
 	return true;
 }
 
-size_t get_size_in_bytes(const VoxelBuffer &buffer, size_t &metadata_size) {
+size_t get_size_in_bytes(const VoxelBuffer &buffer, size_t metadata_size) {
 	// Version and size
 	size_t size = 1 * sizeof(uint8_t) + 3 * sizeof(uint16_t);
 
@@ -161,6 +243,10 @@ size_t get_size_in_bytes(const VoxelBuffer &buffer, size_t &metadata_size) {
 
 		switch (compression) {
 			case VoxelBuffer::COMPRESSION_NONE: {
+				if (get_channel_filters(channel_index, depth) != 0) {
+					// Filter flags
+					size += 1;
+				}
 				size += VoxelBuffer::get_size_in_bytes_for_volume(size_in_voxels, depth);
 			} break;
 
@@ -168,14 +254,21 @@ size_t get_size_in_bytes(const VoxelBuffer &buffer, size_t &metadata_size) {
 				size += VoxelBuffer::get_depth_bit_count(depth) >> 3;
 			} break;
 
+			case VoxelBuffer::COMPRESSION_SPARSE: {
+				size += get_sparse_channel_size_in_bytes(*buffer.get_channel_sparse(channel_index));
+			} break;
+
+			case VoxelBuffer::COMPRESSION_SDF_8_BITS: {
+				// Offset and scale, then one code per voxel
+				size += 2 * sizeof(float) + buffer.get_channel_quantized_sdf()->codes.size();
+			} break;
+
 			default:
 				ERR_PRINT("Unhandled compression mode");
 				CRASH_NOW();
 		}
 	}
 
-	metadata_size = get_metadata_size_in_bytes(buffer);
-
 	size_t metadata_size_with_header = 0;
 	if (metadata_size > 0) {
 		metadata_size_with_header = metadata_size + BLOCK_METADATA_HEADER_SIZE;
@@ -187,7 +280,9 @@ size_t get_size_in_bytes(const VoxelBuffer &buffer, size_t &metadata_size) {
 VoxelBlockSerializerInternal::SerializeResult VoxelBlockSerializerInternal::serialize(const VoxelBuffer &voxel_buffer) {
 	VOXEL_PROFILE_SCOPE();
 
-	size_t metadata_size = 0;
+	serialize_metadata(_metadata_tmp, voxel_buffer);
+	const size_t metadata_size = _metadata_tmp.size();
+
 	const size_t data_size = get_size_in_bytes(voxel_buffer, metadata_size);
 	_data.resize(data_size);
 
@@ -208,50 +303,65 @@ VoxelBlockSerializerInternal::SerializeResult VoxelBlockSerializerInternal::seri
 	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
 		const VoxelBuffer::Compression compression = voxel_buffer.get_channel_compression(channel_index);
 		const VoxelBuffer::Depth depth = voxel_buffer.get_channel_depth(channel_index);
+		const uint8_t filters =
+				compression == VoxelBuffer::COMPRESSION_NONE ? get_channel_filters(channel_index, depth) : 0;
+		const uint8_t serialized_compression =
+				filters != 0 ? SERIALIZED_COMPRESSION_FILTERED : static_cast<uint8_t>(compression);
 		// Low nibble: compression (up to 16 values allowed)
 		// High nibble: depth (up to 16 values allowed)
-		const uint8_t fmt = static_cast<uint8_t>(compression) | (static_cast<uint8_t>(depth) << 4);
+		const uint8_t fmt = serialized_compression | (static_cast<uint8_t>(depth) << 4);
 		f->store_8(fmt);
 
 		switch (compression) {
 			case VoxelBuffer::COMPRESSION_NONE: {
 				Span<uint8_t> data;
 				ERR_FAIL_COND_V(!voxel_buffer.get_channel_raw(channel_index, data), SerializeResult(_data, false));
-				f->store_buffer(data.data(), data.size());
+				if (filters != 0) {
+					f->store_8(filters);
+					_filtered_tmp.resize(data.size());
+					VoxelCompressedData::apply_filters(Span<const uint8_t>(data.data(), data.size()),
+							to_span(_filtered_tmp), filters, VoxelBuffer::get_depth_byte_count(depth),
+							voxel_buffer.get_size().y);
+					f->store_buffer(_filtered_tmp.data(), _filtered_tmp.size());
+				} else {
+					f->store_buffer(data.data(), data.size());
+				}
 			} break;
 
 			case VoxelBuffer::COMPRESSION_UNIFORM: {
 				const uint64_t v = voxel_buffer.get_voxel(Vector3i(), channel_index);
-				switch (depth) {
-					case VoxelBuffer::DEPTH_8_BIT:
-						f->store_8(v);
-						break;
-					case VoxelBuffer::DEPTH_16_BIT:
-						f->store_16(v);
-						break;
-					case VoxelBuffer::DEPTH_32_BIT:
-						f->store_32(v);
-						break;
-					case VoxelBuffer::DEPTH_64_BIT:
-						f->store_64(v);
-						break;
-					default:
-						CRASH_NOW();
+				store_raw_value(f, v, depth);
+			} break;
+
+			case VoxelBuffer::COMPRESSION_SPARSE: {
+				const VoxelSparseChannel &sparse = *voxel_buffer.get_channel_sparse(channel_index);
+				f->store_8(VoxelSparseChannel::BRICK_SIZE_PO2);
+				for (unsigned int brick_index = 0; brick_index < sparse.brick_indices.size(); ++brick_index) {
+					const uint32_t dense_index = sparse.brick_indices[brick_index];
+					if (dense_index == VoxelSparseChannel::UNIFORM_BRICK) {
+						f->store_8(SPARSE_BRICK_UNIFORM);
+						store_raw_value(f, sparse.uniform_values[brick_index], depth);
+					} else {
+						f->store_8(SPARSE_BRICK_DENSE);
+						f->store_buffer(sparse.get_dense_brick(dense_index), sparse.get_brick_size_in_bytes());
+					}
 				}
 			} break;
 
+			case VoxelBuffer::COMPRESSION_SDF_8_BITS: {
+				const VoxelQuantizedSdfChannel &quantized = *voxel_buffer.get_channel_quantized_sdf();
+				f->store_float(quantized.offset);
+				f->store_float(quantized.scale);
+				f->store_buffer(quantized.codes.data(), quantized.codes.size());
+			} break;
+
 			default:
 				CRASH_COND("Unhandled compression mode");
 		}
 	}
 
-	// Metadata has more reasons to fail. If a recoverable error occurs prior to serializing,
-	// we just discard all metadata as if it was empty.
 	if (metadata_size > 0) {
 		f->store_32(metadata_size);
-		_metadata_tmp.resize(metadata_size);
-		// This function brings me joy. </irony>
-		serialize_metadata(_metadata_tmp.data(), voxel_buffer, metadata_size);
 		f->store_buffer(_metadata_tmp.data(), _metadata_tmp.size());
 	}
 
@@ -284,7 +394,7 @@ bool VoxelBlockSerializerInternal::deserialize(const std::vector<uint8_t> &p_dat
 		WARN_PRINT("Reading block version < 2. Attempting to migrate.");
 
 	} else {
-		ERR_FAIL_COND_V(version != BLOCK_VERSION, false);
+		ERR_FAIL_COND_V(version != BLOCK_VERSION && version != BLOCK_VERSION_LEGACY_2, false);
 
 		const unsigned int size_x = f->get_16();
 		const unsigned int size_y = f->get_16();
@@ -297,15 +407,37 @@ bool VoxelBlockSerializerInternal::deserialize(const std::vector<uint8_t> &p_dat
 		const uint8_t fmt = f->get_8();
 		const uint8_t compression_value = fmt & 0xf;
 		const uint8_t depth_value = (fmt >> 4) & 0xf;
-		ERR_FAIL_COND_V_MSG(compression_value >= VoxelBuffer::COMPRESSION_COUNT, false,
-				"At offset 0x" + String::num_int64(f->get_position() - 1, 16));
 		ERR_FAIL_COND_V_MSG(depth_value >= VoxelBuffer::DEPTH_COUNT, false,
 				"At offset 0x" + String::num_int64(f->get_position() - 1, 16));
-		VoxelBuffer::Compression compression = (VoxelBuffer::Compression)compression_value;
 		VoxelBuffer::Depth depth = (VoxelBuffer::Depth)depth_value;
 
 		out_voxel_buffer.set_channel_depth(channel_index, depth);
 
+		if (compression_value == SERIALIZED_COMPRESSION_FILTERED) {
+			const uint8_t filters = f->get_8();
+			// Filters we don't know can't be reverted, and ignoring them would load wrong values
+			ERR_FAIL_COND_V_MSG((filters & ~VoxelCompressedData::FILTER_ALL) != 0, false,
+					"Unknown filters at offset 0x" + String::num_int64(f->get_position() - 1, 16));
+			out_voxel_buffer.decompress_channel(channel_index);
+
+			Span<uint8_t> buffer;
+			CRASH_COND(!out_voxel_buffer.get_channel_raw(channel_index, buffer));
+
+			_filtered_tmp.resize(buffer.size());
+			const uint32_t read_len = f->get_buffer(_filtered_tmp.data(), _filtered_tmp.size());
+			if (read_len != buffer.size()) {
+				ERR_PRINT("Unexpected end of file");
+				return false;
+			}
+			VoxelCompressedData::revert_filters(to_span_const(_filtered_tmp), buffer, filters,
+					VoxelBuffer::get_depth_byte_count(depth), out_voxel_buffer.get_size().y);
+			continue;
+		}
+
+		ERR_FAIL_COND_V_MSG(compression_value >= VoxelBuffer::COMPRESSION_COUNT, false,
+				"At offset 0x" + String::num_int64(f->get_position() - 1, 16));
+		VoxelBuffer::Compression compression = (VoxelBuffer::Compression)compression_value;
+
 		switch (compression) {
 			case VoxelBuffer::COMPRESSION_NONE: {
 				out_voxel_buffer.decompress_channel(channel_index);
@@ -322,26 +454,58 @@ bool VoxelBlockSerializerInternal::deserialize(const std::vector<uint8_t> &p_dat
 			} break;
 
 			case VoxelBuffer::COMPRESSION_UNIFORM: {
-				uint64_t v;
-				switch (out_voxel_buffer.get_channel_depth(channel_index)) {
-					case VoxelBuffer::DEPTH_8_BIT:
-						v = f->get_8();
-						break;
-					case VoxelBuffer::DEPTH_16_BIT:
-						v = f->get_16();
-						break;
-					case VoxelBuffer::DEPTH_32_BIT:
-						v = f->get_32();
-						break;
-					case VoxelBuffer::DEPTH_64_BIT:
-						v = f->get_64();
-						break;
-					default:
-						CRASH_NOW();
-				}
+				const uint64_t v = get_raw_value(f, depth);
 				out_voxel_buffer.clear_channel(channel_index, v);
 			} break;
 
+			case VoxelBuffer::COMPRESSION_SPARSE: {
+				const uint8_t brick_size_po2 = f->get_8();
+				ERR_FAIL_COND_V_MSG(brick_size_po2 != VoxelSparseChannel::BRICK_SIZE_PO2, false,
+						"Unsupported sparse brick size at offset 0x" + String::num_int64(f->get_position() - 1, 16));
+
+				VoxelSparseChannel sparse;
+				sparse.create(out_voxel_buffer.get_size(), VoxelBuffer::get_depth_byte_count(depth));
+
+				for (unsigned int brick_index = 0; brick_index < sparse.brick_indices.size(); ++brick_index) {
+					const uint8_t brick_flag = f->get_8();
+					if (brick_flag == SPARSE_BRICK_UNIFORM) {
+						sparse.uniform_values[brick_index] = get_raw_value(f, depth);
+
+					} else if (brick_flag == SPARSE_BRICK_DENSE) {
+						uint8_t *brick = sparse.add_dense_brick(brick_index);
+						const uint32_t read_len = f->get_buffer(brick, sparse.get_brick_size_in_bytes());
+						if (read_len != sparse.get_brick_size_in_bytes()) {
+							ERR_PRINT("Unexpected end of file");
+							return false;
+						}
+
+					} else {
+						ERR_PRINT("Invalid sparse brick flag at offset 0x" +
+								  String::num_int64(f->get_position() - 1, 16));
+						return false;
+					}
+				}
+
+				out_voxel_buffer.set_channel_sparse(channel_index, std::move(sparse));
+			} break;
+
+			case VoxelBuffer::COMPRESSION_SDF_8_BITS: {
+				ERR_FAIL_COND_V_MSG(channel_index != VoxelBuffer::CHANNEL_SDF || depth == VoxelBuffer::DEPTH_8_BIT,
+						false, "Invalid quantized SDF channel at offset 0x" + String::num_int64(f->get_position() - 1, 16));
+
+				VoxelQuantizedSdfChannel quantized;
+				quantized.offset = f->get_float();
+				quantized.scale = f->get_float();
+				quantized.codes.resize(out_voxel_buffer.get_size().volume());
+				const uint32_t read_len = f->get_buffer(quantized.codes.data(), quantized.codes.size());
+				if (read_len != quantized.codes.size()) {
+					ERR_PRINT("Unexpected end of file");
+					return false;
+				}
+
+				out_voxel_buffer.set_channel_quantized_sdf(std::move(quantized));
+			} break;
+
 			default:
 				ERR_PRINT("Unhandled compression mode");
 				return false;
@@ -362,7 +526,7 @@ bool VoxelBlockSerializerInternal::deserialize(const std::vector<uint8_t> &p_dat
 }
 
 VoxelBlockSerializerInternal::SerializeResult VoxelBlockSerializerInternal::serialize_and_compress(
-		const VoxelBuffer &voxel_buffer) {
+		const VoxelBuffer &voxel_buffer, int lz4_acceleration) {
 	VOXEL_PROFILE_SCOPE();
 
 	SerializeResult res = serialize(voxel_buffer);
@@ -371,7 +535,7 @@ VoxelBlockSerializerInternal::SerializeResult VoxelBlockSerializerInternal::seri
 
 	res.success = VoxelCompressedData::compress(
 			Span<const uint8_t>(data.data(), 0, data.size()), _compressed_data,
-			VoxelCompressedData::COMPRESSION_LZ4);
+			VoxelCompressedData::COMPRESSION_LZ4, lz4_acceleration);
 	ERR_FAIL_COND_V(!res.success, SerializeResult(_compressed_data, false));
 
 	return SerializeResult(_compressed_data, true);
@@ -379,9 +543,14 @@ VoxelBlockSerializerInternal::SerializeResult VoxelBlockSerializerInternal::seri
 
 bool VoxelBlockSerializerInternal::decompress_and_deserialize(
 		const std::vector<uint8_t> &p_data, VoxelBuffer &out_voxel_buffer) {
+	return decompress_and_deserialize(Span<const uint8_t>(p_data.data(), 0, p_data.size()), out_voxel_buffer);
+}
+
+bool VoxelBlockSerializerInternal::decompress_and_deserialize(
+		Span<const uint8_t> p_data, VoxelBuffer &out_voxel_buffer) {
 	VOXEL_PROFILE_SCOPE();
 
-	const bool res = VoxelCompressedData::decompress(Span<const uint8_t>(p_data.data(), 0, p_data.size()), _data);
+	const bool res = VoxelCompressedData::decompress(p_data, _data);
 	ERR_FAIL_COND_V(!res, false);
 
 	return deserialize(_data, out_voxel_buffer);
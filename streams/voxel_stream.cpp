@@ -51,6 +51,11 @@ void VoxelStream::save_instance_blocks(Span<VoxelStreamInstanceDataRequest> p_bl
 	// Can be implemented in subclasses
 }
 
+bool VoxelStream::may_have_block(Vector3i origin_in_voxels, int lod) {
+	// Can be implemented in subclasses
+	return true;
+}
+
 int VoxelStream::get_used_channels_mask() const {
 	return 0;
 }
@@ -65,6 +70,17 @@ bool VoxelStream::get_save_generator_output() const {
 	return _parameters.save_generator_output;
 }
 
+void VoxelStream::set_lz4_acceleration(int acceleration) {
+	RWLockWrite wlock(_parameters_lock);
+	// LZ4 clamps it to this range too
+	_parameters.lz4_acceleration = CLAMP(acceleration, 1, 65537);
+}
+
+int VoxelStream::get_lz4_acceleration() const {
+	RWLockRead rlock(_parameters_lock);
+	return _parameters.lz4_acceleration;
+}
+
 int VoxelStream::get_block_size_po2() const {
 	return VoxelConstants::DEFAULT_BLOCK_SIZE_PO2;
 }
@@ -103,10 +119,15 @@ void VoxelStream::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_save_generator_output", "enabled"), &VoxelStream::set_save_generator_output);
 	ClassDB::bind_method(D_METHOD("get_save_generator_output"), &VoxelStream::get_save_generator_output);
 
+	ClassDB::bind_method(D_METHOD("set_lz4_acceleration", "acceleration"), &VoxelStream::set_lz4_acceleration);
+	ClassDB::bind_method(D_METHOD("get_lz4_acceleration"), &VoxelStream::get_lz4_acceleration);
+
 	ClassDB::bind_method(D_METHOD("get_block_size"), &VoxelStream::_b_get_block_size);
 
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "save_generator_output"),
 			"set_save_generator_output", "get_save_generator_output");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "lz4_acceleration", PROPERTY_HINT_RANGE, "1,64,1,or_greater"),
+			"set_lz4_acceleration", "get_lz4_acceleration");
 
 	BIND_ENUM_CONSTANT(RESULT_ERROR);
 	BIND_ENUM_CONSTANT(RESULT_BLOCK_FOUND);
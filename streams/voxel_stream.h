@@ -60,6 +60,12 @@ public:
 
 	virtual void save_instance_blocks(Span<VoxelStreamInstanceDataRequest> p_blocks);
 
+	// Tells if the stream might contain voxels or instances for the block at the given world-space voxel position
+	// and LOD. Returns false only if the block is known to be absent, in which case it doesn't need to be queried.
+	// Must be fast and must not access files, as it is checked before every block load.
+	// The default implementation doesn't know, so it always returns true.
+	virtual bool may_have_block(Vector3i origin_in_voxels, int lod);
+
 	// Tells which channels can be found in this stream.
 	// The simplest implementation is to return them all.
 	// One reason to specify which channels are available is to help the editor detect configuration issues,
@@ -78,6 +84,21 @@ public:
 	void set_save_generator_output(bool enabled);
 	bool get_save_generator_output() const;
 
+	// Acceleration of LZ4 compression, for streams saving compressed blocks.
+	// Higher values save faster, with a lower compression ratio. Loading is not affected.
+	void set_lz4_acceleration(int acceleration);
+	int get_lz4_acceleration() const;
+
+protected:
+	// Streams indexing blocks by position key voxel blocks by their origin divided by the block size,
+	// and instance blocks by their position within their LOD. Both are the same at LOD 0.
+	static inline Vector3i get_voxel_block_key(Vector3i origin_in_voxels, int block_size_po2) {
+		return origin_in_voxels >> block_size_po2;
+	}
+	static inline Vector3i get_instance_block_key(Vector3i origin_in_voxels, int lod, int block_size_po2) {
+		return origin_in_voxels >> (block_size_po2 + lod);
+	}
+
 private:
 	static void _bind_methods();
 
@@ -88,6 +109,7 @@ private:
 
 	struct Parameters {
 		bool save_generator_output = false;
+		int lz4_acceleration = 1;
 	};
 
 	Parameters _parameters;
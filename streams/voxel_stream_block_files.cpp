@@ -144,7 +144,7 @@ void VoxelStreamBlockFiles::immerge_block(Ref<VoxelBuffer> buffer, Vector3i orig
 		f->store_buffer((uint8_t *)FORMAT_BLOCK_MAGIC, 4);
 		f->store_8(FORMAT_VERSION);
 
-		VoxelBlockSerializerInternal::SerializeResult res = _block_serializer.serialize_and_compress(**buffer);
+		VoxelBlockSerializerInternal::SerializeResult res = _block_serializer.serialize_and_compress(**buffer, get_lz4_acceleration());
 		if (!res.success) {
 			memdelete(f);
 			ERR_PRINT("Failed to save block");
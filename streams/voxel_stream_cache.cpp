@@ -1,21 +1,81 @@
 #include "voxel_stream_cache.h"
+#include <core/os/os.h>
+
+namespace {
+
+size_t get_estimated_size_in_bytes(const VoxelBuffer &vb) {
+	size_t size = sizeof(VoxelBuffer);
+	for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+		switch (vb.get_channel_compression(channel_index)) {
+			case VoxelBuffer::COMPRESSION_NONE:
+				size += VoxelBuffer::get_size_in_bytes_for_volume(vb.get_size(), vb.get_channel_depth(channel_index));
+				break;
+			case VoxelBuffer::COMPRESSION_SPARSE:
+				size += vb.get_channel_sparse(channel_index)->get_memory_usage();
+				break;
+			case VoxelBuffer::COMPRESSION_SDF_8_BITS:
+				size += vb.get_channel_quantized_sdf()->get_memory_usage();
+				break;
+			default:
+				break;
+		}
+	}
+	return size;
+}
 
-bool VoxelStreamCache::load_voxel_block(Vector3i position, uint8_t lod_index, Ref<VoxelBuffer> &out_voxels) {
-	ERR_FAIL_COND_V(out_voxels.is_null(), false);
+size_t get_estimated_size_in_bytes(const VoxelInstanceBlockData &instances) {
+	size_t size = sizeof(VoxelInstanceBlockData);
+	for (auto it = instances.layers.begin(); it != instances.layers.end(); ++it) {
+		size += sizeof(VoxelInstanceBlockData::LayerData) +
+				it->instances.size() * sizeof(VoxelInstanceBlockData::InstanceData);
+	}
+	return size;
+}
 
-	const Lod &lod = _cache[lod_index];
-	lod.rw_lock.read_lock();
+} // namespace
+
+VoxelStreamCache::Block &VoxelStreamCache::get_or_create_block(Lod &lod, Vector3i position, uint8_t lod_index) {
 	auto it = lod.blocks.find(position);
 
 	if (it == lod.blocks.end()) {
-		// Not in cache, will have to query
-		lod.rw_lock.read_unlock();
-		return false;
+		// Not cached yet, create an entry
+		Block b;
+		b.position = position;
+		b.lod = lod_index;
+		it = lod.blocks.insert(std::make_pair(position, std::move(b))).first;
+		++lod.count;
+		++_count;
+
+		uint64_t expected_time = 0;
+		_first_change_time_msec.compare_exchange_strong(expected_time, OS::get_singleton()->get_ticks_msec());
+	}
+	// Else, cached already, it will be overwritten
+
+	return it->second;
+}
+
+VoxelStreamCache::LoadResult VoxelStreamCache::load_voxel_block(
+		Vector3i position, uint8_t lod_index, Ref<VoxelBuffer> &out_voxels) {
+	ERR_FAIL_COND_V(out_voxels.is_null(), NOT_CACHED);
+
+	const Lod &lod = _cache[lod_index];
+	RWLockRead rlock(lod.rw_lock);
+
+	// Blocks saved since the flush started are more recent than those being flushed
+	const std::unordered_map<Vector3i, Block> *maps[2] = { &lod.blocks, &lod.flushing_blocks };
+
+	for (unsigned int i = 0; i < 2; ++i) {
+		auto it = maps[i]->find(position);
+		if (it == maps[i]->end() || !it->second.has_voxels) {
+			continue;
+		}
 
-	} else {
 		// In cache, serve it
 
 		Ref<VoxelBuffer> vb = it->second.voxels;
+		if (vb.is_null()) {
+			return ERASED;
+		}
 
 		// Copying is required since the cache has ownership on its data,
 		// and the requests wants us to populate the buffer it provides
@@ -23,84 +83,91 @@ bool VoxelStreamCache::load_voxel_block(Vector3i position, uint8_t lod_index, Re
 		out_voxels->copy_from(**vb);
 		out_voxels->copy_voxel_metadata(**vb);
 
-		lod.rw_lock.read_unlock();
-		return true;
+		return FOUND;
 	}
+
+	// Not in cache, will have to query
+	return NOT_CACHED;
 }
 
 void VoxelStreamCache::save_voxel_block(Vector3i position, uint8_t lod_index, Ref<VoxelBuffer> voxels) {
+	const size_t size_in_bytes = voxels.is_valid() ? get_estimated_size_in_bytes(**voxels) : 0;
+
 	Lod &lod = _cache[lod_index];
 	RWLockWrite wlock(lod.rw_lock);
-	auto it = lod.blocks.find(position);
 
-	if (it == lod.blocks.end()) {
-		// Not cached yet, create an entry
-		Block b;
-		b.position = position;
-		b.lod = lod_index;
-		b.voxels = voxels;
-		b.has_voxels = true;
-		lod.blocks.insert(std::make_pair(position, std::move(b)));
-		++_count;
+	Block &block = get_or_create_block(lod, position, lod_index);
+	block.voxels = voxels;
+	block.has_voxels = true;
 
-	} else {
-		// Cached already, overwrite
-		it->second.voxels = voxels;
-		it->second.has_voxels = true;
-	}
+	lod.size_in_bytes = lod.size_in_bytes - block.voxels_size_in_bytes + size_in_bytes;
+	_size_in_bytes -= block.voxels_size_in_bytes;
+	_size_in_bytes += size_in_bytes;
+	block.voxels_size_in_bytes = size_in_bytes;
 }
 
-bool VoxelStreamCache::load_instance_block(
+VoxelStreamCache::LoadResult VoxelStreamCache::load_instance_block(
 		Vector3i position, uint8_t lod_index, std::unique_ptr<VoxelInstanceBlockData> &out_instances) {
 
 	const Lod &lod = _cache[lod_index];
-	lod.rw_lock.read_lock();
-	auto it = lod.blocks.find(position);
+	RWLockRead rlock(lod.rw_lock);
 
-	if (it == lod.blocks.end()) {
-		// Not in cache, will have to query
-		lod.rw_lock.read_unlock();
-		return false;
+	// Blocks saved since the flush started are more recent than those being flushed
+	const std::unordered_map<Vector3i, Block> *maps[2] = { &lod.blocks, &lod.flushing_blocks };
+
+	for (unsigned int i = 0; i < 2; ++i) {
+		auto it = maps[i]->find(position);
+		if (it == maps[i]->end() || !it->second.has_instances) {
+			continue;
+		}
 
-	} else {
 		// In cache, serve it
 
 		if (it->second.instances == nullptr) {
 			out_instances = nullptr;
-
-		} else {
-			// Copying is required since the cache has ownership on its data
-			out_instances = std::make_unique<VoxelInstanceBlockData>();
-			it->second.instances->copy_to(*out_instances);
+			return ERASED;
 		}
 
-		lod.rw_lock.read_unlock();
-		return true;
+		// Copying is required since the cache has ownership on its data
+		out_instances = std::make_unique<VoxelInstanceBlockData>();
+		it->second.instances->copy_to(*out_instances);
+		return FOUND;
 	}
+
+	// Not in cache, will have to query
+	return NOT_CACHED;
 }
 
 void VoxelStreamCache::save_instance_block(
 		Vector3i position, uint8_t lod_index, std::unique_ptr<VoxelInstanceBlockData> instances) {
 
+	const size_t size_in_bytes = instances != nullptr ? get_estimated_size_in_bytes(*instances) : 0;
+
 	Lod &lod = _cache[lod_index];
 	RWLockWrite wlock(lod.rw_lock);
-	auto it = lod.blocks.find(position);
 
-	if (it == lod.blocks.end()) {
-		// Not cached yet, create an entry
-		Block b;
-		b.position = position;
-		b.lod = lod_index;
-		b.instances = std::move(instances);
-		lod.blocks.insert(std::make_pair(position, std::move(b)));
-		++_count;
+	Block &block = get_or_create_block(lod, position, lod_index);
+	block.instances = std::move(instances);
+	block.has_instances = true;
 
-	} else {
-		// Cached already, overwrite
-		it->second.instances = std::move(instances);
-	}
+	lod.size_in_bytes = lod.size_in_bytes - block.instances_size_in_bytes + size_in_bytes;
+	_size_in_bytes -= block.instances_size_in_bytes;
+	_size_in_bytes += size_in_bytes;
+	block.instances_size_in_bytes = size_in_bytes;
 }
 
 unsigned int VoxelStreamCache::get_indicative_block_count() const {
 	return _count;
 }
+
+size_t VoxelStreamCache::get_size_in_bytes() const {
+	return _size_in_bytes;
+}
+
+bool VoxelStreamCache::has_changes_older_than(uint64_t age_msec) const {
+	const uint64_t first_change_time = _first_change_time_msec;
+	if (first_change_time == 0 || _count == 0) {
+		return false;
+	}
+	return OS::get_singleton()->get_ticks_msec() - first_change_time >= age_msec;
+}
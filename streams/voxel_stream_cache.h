@@ -2,12 +2,17 @@
 #define VOXEL_STREAM_CACHE_H
 
 #include "../storage/voxel_buffer.h"
+#include "../util/span.h"
 #include "instance_data.h"
+#include <core/os/mutex.h>
+#include <atomic>
 #include <memory>
 #include <unordered_map>
 
 // In-memory database for voxel streams.
 // It allows to cache blocks so we can save to the filesystem less frequently, or quickly reload recent blocks.
+// Repeated saves of the same block are coalesced, only the latest data gets written.
+// It can be flushed from a different thread while blocks are being saved and loaded.
 class VoxelStreamCache {
 public:
 	struct Block {
@@ -18,48 +23,109 @@ public:
 		// - true: Voxel data has been erased
 		// - false: Voxel data should be left untouched
 		bool has_voxels = false;
+		// Same for `instances`
+		bool has_instances = false;
 
 		Ref<VoxelBuffer> voxels;
 		std::unique_ptr<VoxelInstanceBlockData> instances;
+
+		// Estimated memory used by `voxels` and `instances`
+		size_t voxels_size_in_bytes = 0;
+		size_t instances_size_in_bytes = 0;
+	};
+
+	enum LoadResult {
+		// Not in the cache, the stream has to be queried
+		NOT_CACHED,
+		// Found in the cache
+		FOUND,
+		// The block was erased, and the stream might still have old data until the next flush
+		ERASED
 	};
 
 	// Copies cached block into provided buffer
-	bool load_voxel_block(Vector3i position, uint8_t lod_index, Ref<VoxelBuffer> &out_voxels);
+	LoadResult load_voxel_block(Vector3i position, uint8_t lod_index, Ref<VoxelBuffer> &out_voxels);
 
 	// Stores provided block into the cache. The cache will take ownership of the provided data.
 	void save_voxel_block(Vector3i position, uint8_t lod_index, Ref<VoxelBuffer> voxels);
 
 	// Copies cached data into the provided pointer. A new instance will be made if found.
-	bool load_instance_block(
+	LoadResult load_instance_block(
 			Vector3i position, uint8_t lod_index, std::unique_ptr<VoxelInstanceBlockData> &out_instances);
 
 	// Stores provided block into the cache. The cache will take ownership of the provided data.
 	void save_instance_block(Vector3i position, uint8_t lod_index, std::unique_ptr<VoxelInstanceBlockData> instances);
 
+	// Number of blocks waiting to be flushed
 	unsigned int get_indicative_block_count() const;
 
+	// Estimated memory used by blocks waiting to be flushed
+	size_t get_size_in_bytes() const;
+
+	// Tells if a block waiting to be flushed was saved at least `age_msec` milliseconds ago
+	bool has_changes_older_than(uint64_t age_msec) const;
+
+	// Calls `save_func(Span<Block *>)` with all blocks saved since the last flush.
+	// While `save_func` runs, these blocks can still be loaded, and new saves are kept for the next flush.
+	// Blocks must not be modified by `save_func`.
+	// Only one flush runs at a time, others wait for it to finish.
 	template <typename F>
 	void flush(F save_func) {
-		_count = 0;
+		MutexLock flush_lock(_flush_mutex);
+
+		_first_change_time_msec = 0;
+
 		for (unsigned int lod_index = 0; lod_index < _cache.size(); ++lod_index) {
 			Lod &lod = _cache[lod_index];
 			RWLockWrite wlock(lod.rw_lock);
-			for (auto it = lod.blocks.begin(); it != lod.blocks.end(); ++it) {
-				Block &block = it->second;
-				save_func(block);
+			CRASH_COND(lod.flushing_blocks.size() != 0);
+			lod.flushing_blocks.swap(lod.blocks);
+			_count -= lod.count;
+			_size_in_bytes -= lod.size_in_bytes;
+			lod.count = 0;
+			lod.size_in_bytes = 0;
+		}
+
+		// Blocks being flushed are only modified with the write lock, so we can read them without locking
+		_flushing_list.clear();
+		for (unsigned int lod_index = 0; lod_index < _cache.size(); ++lod_index) {
+			Lod &lod = _cache[lod_index];
+			for (auto it = lod.flushing_blocks.begin(); it != lod.flushing_blocks.end(); ++it) {
+				_flushing_list.push_back(&it->second);
 			}
-			lod.blocks.clear();
+		}
+
+		save_func(to_span(_flushing_list));
+
+		_flushing_list.clear();
+		for (unsigned int lod_index = 0; lod_index < _cache.size(); ++lod_index) {
+			Lod &lod = _cache[lod_index];
+			RWLockWrite wlock(lod.rw_lock);
+			lod.flushing_blocks.clear();
 		}
 	}
 
 private:
 	struct Lod {
+		// Blocks saved since the last flush
 		std::unordered_map<Vector3i, Block> blocks;
+		// Blocks being written by the current flush
+		std::unordered_map<Vector3i, Block> flushing_blocks;
+		unsigned int count = 0;
+		size_t size_in_bytes = 0;
 		RWLock rw_lock;
 	};
 
+	Block &get_or_create_block(Lod &lod, Vector3i position, uint8_t lod_index);
+
 	FixedArray<Lod, VoxelConstants::MAX_LOD> _cache;
-	unsigned int _count = 0;
+	std::atomic<unsigned int> _count{ 0 };
+	std::atomic<size_t> _size_in_bytes{ 0 };
+	// Time of the first save since the last flush, or 0
+	std::atomic<uint64_t> _first_change_time_msec{ 0 };
+
+	Mutex _flush_mutex;
+	std::vector<Block *> _flushing_list;
 };
 
 #endif // VOXEL_STREAM_CACHE_H
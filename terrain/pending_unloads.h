@@ -0,0 +1,55 @@
+#ifndef VOXEL_PENDING_UNLOADS_H
+#define VOXEL_PENDING_UNLOADS_H
+
+#include "../util/math/box3i.h"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// Removes entries of `pending` which can be unloaded, and gives their position to `unload_func`.
+// An entry can be unloaded once it waited long enough and is beyond the margin of all viewed boxes.
+// If too many entries remain, the oldest are unloaded too.
+template <typename T, typename GetTimeF, typename UnloadF>
+void unload_expired_blocks(std::unordered_map<Vector3i, T> &pending, const std::vector<Box3i> &viewed_boxes,
+		uint64_t now_msec, uint64_t delay_msec, int margin, unsigned int max_count, GetTimeF get_time_func,
+		UnloadF unload_func) {
+	std::vector<Vector3i> to_unload;
+	std::vector<std::pair<uint64_t, Vector3i>> remaining;
+
+	for (auto it = pending.begin(); it != pending.end(); ++it) {
+		const Vector3i bpos = it->first;
+		const uint64_t time_msec = get_time_func(it->second);
+
+		if (now_msec - time_msec >= delay_msec) {
+			bool in_margin = false;
+			for (size_t i = 0; i < viewed_boxes.size() && !in_margin; ++i) {
+				in_margin = viewed_boxes[i].padded(margin).contains(bpos);
+			}
+			if (!in_margin) {
+				to_unload.push_back(bpos);
+				continue;
+			}
+		}
+
+		remaining.push_back(std::make_pair(time_msec, bpos));
+	}
+
+	if (remaining.size() > max_count) {
+		// Memory pressure, evict the blocks that were left the longest ago
+		const size_t excess = remaining.size() - max_count;
+		std::nth_element(remaining.begin(), remaining.begin() + excess, remaining.end(),
+				[](const std::pair<uint64_t, Vector3i> &a, const std::pair<uint64_t, Vector3i> &b) {
+					return a.first < b.first;
+				});
+		for (size_t i = 0; i < excess; ++i) {
+			to_unload.push_back(remaining[i].second);
+		}
+	}
+
+	// Done after iterating because unloading removes entries
+	for (size_t i = 0; i < to_unload.size(); ++i) {
+		unload_func(to_unload[i]);
+	}
+}
+
+#endif // VOXEL_PENDING_UNLOADS_H
@@ -76,6 +76,17 @@ static inline void schedule_mesh_update(VoxelMeshBlock *block, std::vector<Vecto
 	}
 }
 
+// Schedules updates of existing mesh blocks within a box, in mesh block coordinates
+static void schedule_mesh_updates_in_area(
+		VoxelMeshMap &mesh_map, std::vector<Vector3i> &blocks_pending_update, Box3i mesh_box) {
+	mesh_box.for_each_cell([&mesh_map, &blocks_pending_update](Vector3i mesh_block_pos) {
+		VoxelMeshBlock *mesh_block = mesh_map.get_block(mesh_block_pos);
+		if (mesh_block != nullptr) {
+			schedule_mesh_update(mesh_block, blocks_pending_update);
+		}
+	});
+}
+
 struct BeforeUnloadDataAction {
 	std::vector<VoxelLodTerrain::BlockToSave> &blocks_to_save;
 	bool save;
@@ -417,10 +428,11 @@ void VoxelLodTerrain::set_mesh_block_active(VoxelMeshBlock &block, bool active)
 // The provided box must be at LOD0 coordinates.
 void VoxelLodTerrain::post_edit_area(Box3i p_box) {
 	const Box3i box = p_box.padded(1);
-	const Box3i bbox = box.downscaled(get_data_block_size());
+	const int bs = get_data_block_size();
+	const Box3i bbox = box.downscaled(bs);
 
-	bbox.for_each_cell([this](Vector3i block_pos_lod0) {
-		post_edit_block_lod0(block_pos_lod0);
+	bbox.for_each_cell([this, &box, bs](Vector3i block_pos_lod0) {
+		post_edit_block_lod0(block_pos_lod0, Box3i(box.pos - block_pos_lod0 * bs, box.size));
 	});
 
 	if (_instancer != nullptr) {
@@ -429,11 +441,17 @@ void VoxelLodTerrain::post_edit_area(Box3i p_box) {
 }
 
 void VoxelLodTerrain::post_edit_block_lod0(Vector3i block_pos_lod0) {
+	post_edit_block_lod0(block_pos_lod0, Box3i(Vector3i(), Vector3i(get_data_block_size())));
+}
+
+void VoxelLodTerrain::post_edit_block_lod0(Vector3i block_pos_lod0, Box3i box_in_block) {
 	Lod &lod0 = _lods[0];
 	VoxelDataBlock *block = lod0.data_map.get_block(block_pos_lod0);
 	ERR_FAIL_COND(block == nullptr);
 
 	block->set_modified(true);
+	// Only the edited part needs to be propagated to other LODs and remeshed
+	block->mark_dirty_box(box_in_block);
 
 	if (!block->get_needs_lodding()) {
 		block->set_needs_lodding(true);
@@ -810,7 +828,7 @@ void VoxelLodTerrain::try_schedule_loading_with_neighbors(const Vector3i &p_data
 			for (bpos.x = min_x; bpos.x < max_x; ++bpos.x) {
 				VoxelDataBlock *block = lod.data_map.get_block(bpos);
 
-				if (block == nullptr) {
+				if (block == nullptr && get_implicit_block_source(bpos, lod_index) == nullptr) {
 					if (!lod.loading_blocks.has(bpos)) {
 						lod.blocks_to_load.push_back(bpos);
 						lod.loading_blocks.insert(bpos);
@@ -873,7 +891,7 @@ bool VoxelLodTerrain::check_block_loaded_and_meshed(const Vector3i &p_mesh_block
 					const Vector3i data_block_pos(data_block_pos0 + Vector3i(x, y, z));
 					VoxelDataBlock *data_block = lod.data_map.get_block(data_block_pos);
 
-					if (data_block == nullptr) {
+					if (data_block == nullptr && get_implicit_block_source(data_block_pos, lod_index) == nullptr) {
 						loaded = false;
 						// TODO This is quite lossy in this case, if we ask for 8 blocks in an octant
 						try_schedule_loading_with_neighbors(data_block_pos, lod_index);
@@ -889,7 +907,7 @@ bool VoxelLodTerrain::check_block_loaded_and_meshed(const Vector3i &p_mesh_block
 	} else if (mesh_block_size == data_block_size) {
 		const Vector3i data_block_pos = p_mesh_block_pos;
 		VoxelDataBlock *block = lod.data_map.get_block(data_block_pos);
-		if (block == nullptr) {
+		if (block == nullptr && get_implicit_block_source(data_block_pos, lod_index) == nullptr) {
 			try_schedule_loading_with_neighbors(data_block_pos, lod_index);
 			return false;
 		}
@@ -936,7 +954,7 @@ bool VoxelLodTerrain::check_block_mesh_updated(VoxelMeshBlock *block) {
 			bool surrounded = true;
 			for (unsigned int i = 0; i < neighbor_positions_count; ++i) {
 				const Vector3i npos = neighbor_positions[i];
-				if (!lod.data_map.has_block(npos)) {
+				if (!lod.data_map.has_block(npos) && get_implicit_block_source(npos, block->lod_index) == nullptr) {
 					// That neighbor is not loaded
 					surrounded = false;
 					if (!lod.loading_blocks.has(npos)) {
@@ -1007,7 +1025,8 @@ void VoxelLodTerrain::send_block_data_requests() {
 
 		for (unsigned int i = 0; i < lod.blocks_to_load.size(); ++i) {
 			const Vector3i block_pos = lod.blocks_to_load[i];
-			VoxelServer::get_singleton()->request_block_load(_volume_id, block_pos, lod_index, request_instances);
+			VoxelServer::get_singleton()->request_block_load(
+					_volume_id, block_pos, lod_index, request_instances, false);
 		}
 
 		lod.blocks_to_load.clear();
@@ -1055,6 +1074,9 @@ void VoxelLodTerrain::_process(float delta) {
 
 		// This should be the same distance relatively to each LOD
 		const int data_block_region_extent = get_data_block_region_extent();
+		// Blocks are unloaded a bit further than they are loaded,
+		// so viewers moving back and forth around a block boundary don't keep reloading them
+		const int data_block_unload_extent = data_block_region_extent + _block_unload_margin;
 
 		// Ignore largest lod because it can extend a little beyond due to the view distance setting.
 		// Instead, those blocks are unloaded by the octree forest management.
@@ -1075,11 +1097,13 @@ void VoxelLodTerrain::_process(float delta) {
 
 			const Box3i new_box =
 					Box3i::from_center_extents(viewer_block_pos_within_lod, Vector3i(data_block_region_extent));
-			const Box3i prev_box =
+			const Box3i new_unload_box =
+					Box3i::from_center_extents(viewer_block_pos_within_lod, Vector3i(data_block_unload_extent));
+			const Box3i prev_unload_box =
 					Box3i::from_center_extents(
 							lod.last_viewer_data_block_pos, Vector3i(lod.last_view_distance_data_blocks));
 
-			if (!new_box.intersects(bounds_in_blocks) && !prev_box.intersects(bounds_in_blocks)) {
+			if (!new_unload_box.intersects(bounds_in_blocks) && !prev_unload_box.intersects(bounds_in_blocks)) {
 				// If this box doesn't intersect either now or before, there is no chance a smaller one will
 				break;
 			}
@@ -1090,9 +1114,9 @@ void VoxelLodTerrain::_process(float delta) {
 			// Let's assert so it will pop on your face the day that assumption changes
 			CRASH_COND(!lod.blocks_to_load.empty());
 
-			if (prev_box != new_box) {
+			if (prev_unload_box != new_unload_box) {
 				VOXEL_PROFILE_SCOPE();
-				prev_box.difference(new_box, [this, lod_index](Box3i out_of_range_box) {
+				prev_unload_box.difference(new_unload_box, [this, lod_index](Box3i out_of_range_box) {
 					out_of_range_box.for_each_cell([=](Vector3i pos) {
 
 						//print_line(String("Immerge {0}").format(varray(pos.to_vec3())));
@@ -1129,7 +1153,7 @@ void VoxelLodTerrain::_process(float delta) {
 			}
 
 			lod.last_viewer_data_block_pos = viewer_block_pos_within_lod;
-			lod.last_view_distance_data_blocks = data_block_region_extent;
+			lod.last_view_distance_data_blocks = data_block_unload_extent;
 		}
 	}
 
@@ -1140,6 +1164,8 @@ void VoxelLodTerrain::_process(float delta) {
 
 		// This should be the same distance relatively to each LOD
 		const int mesh_block_region_extent = get_mesh_block_region_extent();
+		const int mesh_block_unload_margin = ceildiv(_block_unload_margin * get_data_block_size(), get_mesh_block_size());
+		const int mesh_block_unload_extent = mesh_block_region_extent + mesh_block_unload_margin;
 
 		// Ignore largest lod because it can extend a little beyond due to the view distance setting.
 		// Instead, those blocks are unloaded by the octree forest management.
@@ -1157,19 +1183,22 @@ void VoxelLodTerrain::_process(float delta) {
 
 			const Box3i new_box =
 					Box3i::from_center_extents(viewer_block_pos_within_lod, Vector3i(mesh_block_region_extent));
-			const Box3i prev_box =
+			const Box3i new_unload_box =
+					Box3i::from_center_extents(viewer_block_pos_within_lod, Vector3i(mesh_block_unload_extent));
+			const Box3i prev_unload_box =
 					Box3i::from_center_extents(lod.last_viewer_mesh_block_pos, Vector3i(lod.last_view_distance_mesh_blocks));
 
-			if (!new_box.intersects(bounds_in_blocks) && !prev_box.intersects(bounds_in_blocks)) {
+			if (!new_unload_box.intersects(bounds_in_blocks) && !prev_unload_box.intersects(bounds_in_blocks)) {
 				// If this box doesn't intersect either now or before, there is no chance a smaller one will
 				break;
 			}
 
 			// Eliminate pending blocks that aren't needed
 
-			if (prev_box != new_box) {
+			if (prev_unload_box != new_unload_box) {
 				VOXEL_PROFILE_SCOPE();
-				prev_box.difference(new_box, [this, lod_index](Box3i out_of_range_box) {
+				// Blocks within the margin stay loaded. The octree hides them when they are not part of the view.
+				prev_unload_box.difference(new_unload_box, [this, lod_index](Box3i out_of_range_box) {
 					out_of_range_box.for_each_cell([=](Vector3i pos) {
 						//print_line(String("Immerge {0}").format(varray(pos.to_vec3())));
 						unload_mesh_block(pos, lod_index);
@@ -1186,7 +1215,7 @@ void VoxelLodTerrain::_process(float delta) {
 			}
 
 			lod.last_viewer_mesh_block_pos = viewer_block_pos_within_lod;
-			lod.last_view_distance_mesh_blocks = mesh_block_region_extent;
+			lod.last_view_distance_mesh_blocks = mesh_block_unload_extent;
 		}
 	}
 
@@ -1508,6 +1537,16 @@ void VoxelLodTerrain::_process(float delta) {
 				continue;
 			}
 
+			if (_sparse_sdf_band > 0.f) {
+				// Only voxels near the surface are kept at full precision, saving memory on large terrains
+				ob.voxels->compress_sparse_channel(VoxelBuffer::CHANNEL_SDF, _sparse_sdf_band);
+			}
+			if (_adaptive_8_bits_sdf &&
+					ob.voxels->get_channel_depth(VoxelBuffer::CHANNEL_SDF) != VoxelBuffer::DEPTH_8_BIT) {
+				// Does nothing if the channel is already uniform or sparse
+				ob.voxels->compress_sdf_to_8_bits();
+			}
+
 			// Store buffer
 			VoxelDataBlock *block = lod.data_map.set_block_buffer(ob.position, ob.voxels);
 			CRASH_COND(block == nullptr);
@@ -1557,14 +1596,22 @@ void VoxelLodTerrain::_process(float delta) {
 				// Iteration order matters for thread access.
 				// The array also implicitely encodes block position due to the convention being used,
 				// so there is no need to also include positions in the request
-				data_box.for_each_cell_zxy([&mesh_request, &lod](Vector3i data_block_pos) {
-					VoxelDataBlock *nblock = lod.data_map.get_block(data_block_pos);
+				FixedArray<VoxelDataBlock *, VoxelConstants::MAX_BLOCK_COUNT_PER_REQUEST> data_blocks;
+				lod.data_map.get_blocks_in_box_zxy(data_box, to_span(data_blocks, data_box.size.volume()));
+				mesh_request.data_blocks_count = data_box.size.volume();
+				unsigned int i = 0;
+				data_box.for_each_cell_zxy([this, lod_index, &data_blocks, &mesh_request, &i](Vector3i data_block_pos) {
+					const VoxelDataBlock *nblock = data_blocks[i];
+					if (nblock == nullptr) {
+						// Uniform, so the ancestor has the same voxels
+						nblock = get_implicit_block_source(data_block_pos, lod_index);
+					}
 					// The block can actually be null on some occasions. Not sure yet if it's that bad
 					//CRASH_COND(nblock == nullptr);
 					if (nblock != nullptr) {
-						mesh_request.data_blocks[mesh_request.data_blocks_count] = nblock->voxels;
+						mesh_request.data_blocks[i] = nblock->voxels;
 					}
-					++mesh_request.data_blocks_count;
+					++i;
 				});
 
 				VoxelServer::get_singleton()->request_block_mesh(_volume_id, mesh_request);
@@ -1814,7 +1861,8 @@ void VoxelLodTerrain::flush_pending_lod_edits() {
 
 	//ProfilingClock profiling_clock;
 
-	const int data_to_mesh_factor = get_mesh_block_size() / get_data_block_size();
+	const int data_block_size = get_data_block_size();
+	const int mesh_block_size = get_mesh_block_size();
 
 	// Make sure LOD0 gets updates even if _lod_count is 1
 	Lod &lod0 = _lods[0];
@@ -1824,16 +1872,18 @@ void VoxelLodTerrain::flush_pending_lod_edits() {
 		ERR_CONTINUE(data_block == nullptr);
 		data_block->set_needs_lodding(false);
 
-		const Vector3i mesh_block_pos = data_block_pos.floordiv(data_to_mesh_factor);
-		VoxelMeshBlock *mesh_block = lod0.mesh_map.get_block(mesh_block_pos);
-		if (mesh_block != nullptr) {
-			// If a mesh exists here, it will need an update.
-			// If there is no mesh, it will probably get created later when we come closer to it
-			schedule_mesh_update(mesh_block, lod0.blocks_pending_update);
+		// Edited boxes are already padded, so this includes neighbor meshes affected by the edit.
+		// If there is no mesh, it will probably get created later when we come closer to it
+		const Box3i dirty_box = data_block->get_dirty_box();
+		schedule_mesh_updates_in_area(lod0.mesh_map, lod0.blocks_pending_update,
+				Box3i(dirty_box.pos + data_block_pos * data_block_size, dirty_box.size).downscaled(mesh_block_size));
+
+		if (_lod_count == 1) {
+			data_block->clear_dirty();
 		}
 	}
 
-	const int half_bs = get_data_block_size() >> 1;
+	const int half_bs = data_block_size >> 1;
 
 	// Process downscales upwards in pairs of consecutive LODs.
 	// This ensures we don't process multiple times the same blocks.
@@ -1864,31 +1914,37 @@ void VoxelLodTerrain::flush_pending_lod_edits() {
 			CRASH_COND(src_block->voxels.is_null());
 			CRASH_COND(dst_block->voxels.is_null());
 
-			{
-				const Vector3i mesh_block_pos = dst_bpos.floordiv(data_to_mesh_factor);
-				VoxelMeshBlock *mesh_block = dst_lod.mesh_map.get_block(mesh_block_pos);
-				if (mesh_block != nullptr) {
-					schedule_mesh_update(mesh_block, dst_lod.blocks_pending_update);
-				}
-				// If there is no mesh, it will probably get created later when we come closer to it
+			// Only the edited part of the source block is downscaled.
+			// Regions are at least 2 voxels wide, so the box maps exactly to half resolution.
+			const Box3i src_box = src_block->get_dirty_box();
+			src_block->clear_dirty();
+			if (src_box.is_empty()) {
+				continue;
 			}
+			const Vector3i rel = src_bpos - (dst_bpos << 1);
+			const Box3i dst_box(rel * half_bs + (src_box.pos >> 1), src_box.size >> 1);
+
+			// Neighbors of the changed voxels are padded, since meshes depend on them.
+			// If there is no mesh, it will probably get created later when we come closer to it
+			schedule_mesh_updates_in_area(dst_lod.mesh_map, dst_lod.blocks_pending_update,
+					Box3i(dst_box.pos + dst_bpos * data_block_size, dst_box.size)
+							.padded(1)
+							.downscaled(mesh_block_size));
 
 			dst_block->set_modified(true);
+			dst_block->mark_dirty_box(dst_box);
 
 			if (dst_lod_index != _lod_count - 1 && !dst_block->get_needs_lodding()) {
 				dst_block->set_needs_lodding(true);
 				dst_lod.blocks_pending_lodding.push_back(dst_bpos);
 			}
 
-			const Vector3i rel = src_bpos - (dst_bpos << 1);
-
 			// Update lower LOD
 			// This must always be done after an edit before it gets saved, otherwise LODs won't match and it will look ugly.
-			// TODO Try to narrow to edited region instead of taking whole block
 			{
 				RWLockWrite lock(src_block->voxels->get_lock());
-				src_block->voxels->downscale_to(
-						**dst_block->voxels, Vector3i(), src_block->voxels->get_size(), rel * half_bs);
+				src_block->voxels->downscale_to(**dst_block->voxels, src_box.pos, src_box.pos + src_box.size,
+						dst_box.pos, _lod_sdf_filter);
 			}
 		}
 
@@ -1937,10 +1993,9 @@ void VoxelLodTerrain::unload_data_block(Vector3i block_pos, int lod_index) {
 	
 }
 
-VoxelDataMap VoxelLodTerrain::get_data_map(int lod_index){
-
-	VoxelDataMap &datamap = _lods[lod_index].data_map;
-	return datamap;
+VoxelDataMap &VoxelLodTerrain::get_data_map(int lod_index) {
+	CRASH_COND(lod_index < 0 || lod_index >= static_cast<int>(_lods.size()));
+	return _lods[lod_index].data_map;
 }
 
 void VoxelLodTerrain::unload_mesh_block(Vector3i block_pos, int lod_index) {
@@ -2212,6 +2267,15 @@ int VoxelLodTerrain::get_collision_update_delay() const {
 	return _collision_update_delay;
 }
 
+void VoxelLodTerrain::set_block_unload_margin(int margin_in_blocks) {
+	ERR_FAIL_COND(margin_in_blocks < 0);
+	_block_unload_margin = margin_in_blocks;
+}
+
+int VoxelLodTerrain::get_block_unload_margin() const {
+	return _block_unload_margin;
+}
+
 void VoxelLodTerrain::set_lod_fade_duration(float seconds) {
 	_lod_fade_duration = clamp(seconds, 0.f, 1.f);
 }
@@ -2220,6 +2284,107 @@ float VoxelLodTerrain::get_lod_fade_duration() const {
 	return _lod_fade_duration;
 }
 
+void VoxelLodTerrain::set_lod_sdf_filter(VoxelBuffer::DownscaleFilter filter) {
+	ERR_FAIL_INDEX(filter, VoxelBuffer::DOWNSCALE_FILTER_COUNT);
+	// Majority is meant for discrete values, it doesn't make sense for a distance field
+	ERR_FAIL_COND(filter == VoxelBuffer::DOWNSCALE_MAJORITY);
+	_lod_sdf_filter = filter;
+}
+
+VoxelBuffer::DownscaleFilter VoxelLodTerrain::get_lod_sdf_filter() const {
+	return _lod_sdf_filter;
+}
+
+void VoxelLodTerrain::set_sparse_sdf_band(float band) {
+	_sparse_sdf_band = max(band, 0.f);
+}
+
+float VoxelLodTerrain::get_sparse_sdf_band() const {
+	return _sparse_sdf_band;
+}
+
+void VoxelLodTerrain::set_adaptive_8_bits_sdf(bool enabled) {
+	_adaptive_8_bits_sdf = enabled;
+}
+
+bool VoxelLodTerrain::get_adaptive_8_bits_sdf() const {
+	return _adaptive_8_bits_sdf;
+}
+
+void VoxelLodTerrain::set_implicit_uniform_blocks(bool enabled) {
+	_implicit_uniform_blocks = enabled;
+}
+
+bool VoxelLodTerrain::get_implicit_uniform_blocks() const {
+	return _implicit_uniform_blocks;
+}
+
+const VoxelDataBlock *VoxelLodTerrain::get_implicit_block_source(Vector3i block_pos, unsigned int lod_index) const {
+	if (!_implicit_uniform_blocks) {
+		return nullptr;
+	}
+	Vector3i parent_block_pos = block_pos;
+	for (unsigned int parent_lod_index = lod_index + 1; parent_lod_index < _lod_count; ++parent_lod_index) {
+		parent_block_pos = parent_block_pos >> 1;
+		const VoxelDataBlock *block = _lods[parent_lod_index].data_map.get_block(parent_block_pos);
+		if (block == nullptr) {
+			// The parent may be implied too
+			continue;
+		}
+		// Edits are propagated to lower LODs, so children of an ancestor edited since it was loaded may differ
+		if (block->was_edited()) {
+			return nullptr;
+		}
+		for (unsigned int channel_index = 0; channel_index < VoxelBuffer::MAX_CHANNELS; ++channel_index) {
+			if (block->voxels->get_channel_compression(channel_index) != VoxelBuffer::COMPRESSION_UNIFORM) {
+				return nullptr;
+			}
+		}
+		// Edits saved before the ancestor was loaded are only known by the stream.
+		// Blocks between the ancestor and the requested one are checked too, because they get created on edit.
+		if (_stream.is_valid()) {
+			const int data_block_size = get_data_block_size();
+			for (unsigned int child_lod_index = lod_index; child_lod_index < parent_lod_index; ++child_lod_index) {
+				const Vector3i child_block_pos = block_pos >> (child_lod_index - lod_index);
+				const Vector3i origin_in_voxels = (child_block_pos << child_lod_index) * data_block_size;
+				if (_stream->may_have_block(origin_in_voxels, child_lod_index)) {
+					return nullptr;
+				}
+			}
+		}
+		return block;
+	}
+	return nullptr;
+}
+
+void VoxelLodTerrain::materialize_implicit_blocks(Box3i voxel_box) {
+	if (!_implicit_uniform_blocks) {
+		return;
+	}
+	const Box3i block_box = voxel_box.downscaled(get_data_block_size());
+	block_box.for_each_cell([this](Vector3i block_pos_lod0) {
+		if (_lods[0].data_map.has_block(block_pos_lod0)) {
+			return;
+		}
+		const VoxelDataBlock *source = get_implicit_block_source(block_pos_lod0, 0);
+		if (source == nullptr) {
+			return;
+		}
+		// Blocks between LOD0 and the source are created as well, so edits can be propagated to them
+		for (int lod_index = static_cast<int>(source->lod_index) - 1; lod_index >= 0; --lod_index) {
+			Lod &lod = _lods[lod_index];
+			const Vector3i block_pos = block_pos_lod0 >> lod_index;
+			if (lod.data_map.has_block(block_pos)) {
+				continue;
+			}
+			// Not expected, but a late response must not overwrite the block
+			lod.loading_blocks.erase(block_pos);
+			// Voxels are not copied until they get modified
+			lod.data_map.set_block_buffer(block_pos, source->voxels->duplicate(false));
+		}
+	});
+}
+
 String VoxelLodTerrain::get_configuration_warning() const {
 	String w = VoxelNode::get_configuration_warning();
 	if (!w.empty()) {
@@ -2559,9 +2724,26 @@ void VoxelLodTerrain::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_collision_update_delay", "delay_msec"),
 			&VoxelLodTerrain::set_collision_update_delay);
 
+	ClassDB::bind_method(D_METHOD("get_block_unload_margin"), &VoxelLodTerrain::get_block_unload_margin);
+	ClassDB::bind_method(D_METHOD("set_block_unload_margin", "margin_in_blocks"),
+			&VoxelLodTerrain::set_block_unload_margin);
+
 	ClassDB::bind_method(D_METHOD("get_lod_fade_duration"), &VoxelLodTerrain::get_lod_fade_duration);
 	ClassDB::bind_method(D_METHOD("set_lod_fade_duration", "seconds"), &VoxelLodTerrain::set_lod_fade_duration);
 
+	ClassDB::bind_method(D_METHOD("get_lod_sdf_filter"), &VoxelLodTerrain::get_lod_sdf_filter);
+	ClassDB::bind_method(D_METHOD("set_lod_sdf_filter", "filter"), &VoxelLodTerrain::set_lod_sdf_filter);
+
+	ClassDB::bind_method(D_METHOD("get_sparse_sdf_band"), &VoxelLodTerrain::get_sparse_sdf_band);
+	ClassDB::bind_method(D_METHOD("set_sparse_sdf_band", "band"), &VoxelLodTerrain::set_sparse_sdf_band);
+
+	ClassDB::bind_method(D_METHOD("get_adaptive_8_bits_sdf"), &VoxelLodTerrain::get_adaptive_8_bits_sdf);
+	ClassDB::bind_method(D_METHOD("set_adaptive_8_bits_sdf", "enabled"), &VoxelLodTerrain::set_adaptive_8_bits_sdf);
+
+	ClassDB::bind_method(D_METHOD("get_implicit_uniform_blocks"), &VoxelLodTerrain::get_implicit_uniform_blocks);
+	ClassDB::bind_method(D_METHOD("set_implicit_uniform_blocks", "enabled"),
+			&VoxelLodTerrain::set_implicit_uniform_blocks);
+
 	ClassDB::bind_method(D_METHOD("set_lod_count", "lod_count"), &VoxelLodTerrain::set_lod_count);
 	ClassDB::bind_method(D_METHOD("get_lod_count"), &VoxelLodTerrain::get_lod_count);
 
@@ -2622,6 +2804,13 @@ void VoxelLodTerrain::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "lod_count"), "set_lod_count", "get_lod_count");
 	ADD_PROPERTY(PropertyInfo(Variant::REAL, "lod_distance"), "set_lod_distance", "get_lod_distance");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "lod_fade_duration"), "set_lod_fade_duration", "get_lod_fade_duration");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "lod_sdf_filter", PROPERTY_HINT_ENUM, "Nearest,Min,Average"),
+			"set_lod_sdf_filter", "get_lod_sdf_filter");
+	ADD_PROPERTY(PropertyInfo(Variant::REAL, "sparse_sdf_band"), "set_sparse_sdf_band", "get_sparse_sdf_band");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "adaptive_8_bits_sdf"),
+			"set_adaptive_8_bits_sdf", "get_adaptive_8_bits_sdf");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "implicit_uniform_blocks"),
+			"set_implicit_uniform_blocks", "get_implicit_uniform_blocks");
 
 	ADD_GROUP("Material", "");
 
@@ -2648,6 +2837,8 @@ void VoxelLodTerrain::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "run_stream_in_editor"),
 			"set_run_stream_in_editor", "is_stream_running_in_editor");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "mesh_block_size"), "set_mesh_block_size", "get_mesh_block_size");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "block_unload_margin", PROPERTY_HINT_RANGE, "0, 16, 1"),
+			"set_block_unload_margin", "get_block_unload_margin");
 	// TODO Add back access to block, but with an API securing multithreaded access
 	ADD_SIGNAL(MethodInfo(VoxelStringNames::get_singleton()->block_loaded,
 			PropertyInfo(Variant::VECTOR3, "position")));
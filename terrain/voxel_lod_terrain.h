@@ -82,6 +82,8 @@ public:
 	// These must be called after an edit
 	void post_edit_area(Box3i p_box);
 	void post_edit_block_lod0(Vector3i bpos);
+	// Same as above, where only part of the block was edited. The box is in voxels relative to the block.
+	void post_edit_block_lod0(Vector3i bpos, Box3i box_in_block);
 
 	void set_voxel_bounds(Box3i p_box);
 	inline Box3i get_voxel_bounds() const { return _bounds_in_voxels; }
@@ -89,9 +91,38 @@ public:
 	void set_collision_update_delay(int delay_msec);
 	int get_collision_update_delay() const;
 
+	// Blocks leaving the view remain loaded until they are this many data blocks further away
+	void set_block_unload_margin(int margin_in_blocks);
+	int get_block_unload_margin() const;
+
 	void set_lod_fade_duration(float seconds);
 	float get_lod_fade_duration() const;
 
+	// Filter used on SDF when edits are propagated to lower LODs
+	void set_lod_sdf_filter(VoxelBuffer::DownscaleFilter filter);
+	VoxelBuffer::DownscaleFilter get_lod_sdf_filter() const;
+
+	// Distance from the surface (in voxels) beyond which loaded SDF is clamped and stored as sparse bricks.
+	// Zero disables it.
+	void set_sparse_sdf_band(float band);
+	float get_sparse_sdf_band() const;
+
+	// When enabled, loaded SDF that is not stored as sparse bricks is quantized to 8 bits, with a range fitted to
+	// each block. Blocks are decompressed to their original depth when edited.
+	void set_adaptive_8_bits_sdf(bool enabled);
+	bool get_adaptive_8_bits_sdf() const;
+
+	// When enabled, blocks are not loaded if their closest loaded ancestor in lower LODs is uniform and was not
+	// edited. Their voxels are implied by that ancestor until they get edited.
+	// With a stream, this only applies to blocks the stream knows it doesn't have (see VoxelStream::may_have_block).
+	void set_implicit_uniform_blocks(bool enabled);
+	bool get_implicit_uniform_blocks() const;
+
+	// Gets the block from which voxels of a block that was not loaded can be inferred, if any
+	const VoxelDataBlock *get_implicit_block_source(Vector3i block_pos, unsigned int lod_index) const;
+	// Creates blocks implied by lower LODs intersecting an area of LOD0, so they can be edited
+	void materialize_implicit_blocks(Box3i voxel_box);
+
 	String get_configuration_warning() const override;
 
 	enum ProcessMode {
@@ -160,7 +191,7 @@ public:
 	Array get_mesh_block_surface(Vector3i block_pos, int lod_index) const;
 	Vector<Vector3i> get_meshed_block_positions_at_lod(int lod_index) const;
 
-	VoxelDataMap get_data_map(int lod_index);
+	VoxelDataMap &get_data_map(int lod_index);
 
 protected:
 	static void _bind_methods();
@@ -265,6 +296,7 @@ private:
 	unsigned int _collision_mask = 1;
 	float _collision_margin = VoxelConstants::DEFAULT_COLLISION_MARGIN;
 	int _collision_update_delay = 0;
+	int _block_unload_margin = 0;
 
 	VoxelInstancer *_instancer = nullptr;
 
@@ -294,6 +326,10 @@ private:
 	// Distance between a viewer and the end of LOD0
 	float _lod_distance = 0.f;
 	float _lod_fade_duration = 0.f;
+	VoxelBuffer::DownscaleFilter _lod_sdf_filter = VoxelBuffer::DOWNSCALE_NEAREST;
+	float _sparse_sdf_band = 0.f;
+	bool _adaptive_8_bits_sdf = false;
+	bool _implicit_uniform_blocks = false;
 	unsigned int _view_distance_voxels = 512;
 
 	bool _run_stream_in_editor = true;
@@ -8,10 +8,13 @@
 #include "../util/macros.h"
 #include "../util/profiling.h"
 #include "../util/profiling_clock.h"
+#include "pending_unloads.h"
 
 #include <core/core_string_names.h>
 #include <core/engine.h>
+#include <core/os/os.h>
 #include <scene/3d/mesh_instance.h>
+#include <algorithm>
 
 VoxelTerrain::VoxelTerrain() {
 	// Note: don't do anything heavy in the constructor.
@@ -175,6 +178,7 @@ void VoxelTerrain::set_mesh_block_size(unsigned int mesh_block_size) {
 
 	// Unload all mesh blocks regardless of refcount
 	_mesh_map.create(po2, 0);
+	_mesh_blocks_pending_unload.clear();
 
 	// Make paired viewers re-view the new meshable area
 	for (unsigned int i = 0; i < _paired_viewers.size(); ++i) {
@@ -295,6 +299,28 @@ void VoxelTerrain::set_max_view_distance(unsigned int distance_in_voxels) {
 	_max_view_distance_voxels = distance_in_voxels;
 }
 
+void VoxelTerrain::set_block_unload_margin(int margin_in_blocks) {
+	ERR_FAIL_COND(margin_in_blocks < 0);
+	_block_unload_margin = margin_in_blocks;
+}
+
+int VoxelTerrain::get_block_unload_margin() const {
+	return _block_unload_margin;
+}
+
+void VoxelTerrain::set_block_unload_delay(float seconds) {
+	ERR_FAIL_COND(seconds < 0.f);
+	_block_unload_delay = seconds;
+}
+
+float VoxelTerrain::get_block_unload_delay() const {
+	return _block_unload_delay;
+}
+
+bool VoxelTerrain::is_unload_delayed() const {
+	return _block_unload_margin > 0 || _block_unload_delay > 0.f;
+}
+
 void VoxelTerrain::set_material(unsigned int id, Ref<Material> material) {
 	// TODO Update existing block surfaces
 	ERR_FAIL_COND(id < 0 || id >= VoxelMesherBlocky::MAX_MATERIALS);
@@ -315,6 +341,11 @@ void VoxelTerrain::try_schedule_mesh_update(VoxelMeshBlock *mesh_block) {
 	}
 	if (mesh_block->mesh_viewers.get() == 0 && mesh_block->collision_viewers.get() == 0) {
 		// No viewers want mesh on this block (why even call this function then?)
+		auto it = _mesh_blocks_pending_unload.find(mesh_block->position);
+		if (it != _mesh_blocks_pending_unload.end()) {
+			// The block is hidden, remesh it only if it gets viewed again
+			it->second.needs_update = true;
+		}
 		return;
 	}
 
@@ -341,7 +372,7 @@ void VoxelTerrain::try_schedule_mesh_update(VoxelMeshBlock *mesh_block) {
 	}
 }
 
-void VoxelTerrain::view_data_block(Vector3i bpos) {
+void VoxelTerrain::view_data_block(Vector3i bpos, bool prefetch) {
 	VoxelDataBlock *block = _data_map.get_block(bpos);
 
 	if (block == nullptr) {
@@ -352,23 +383,51 @@ void VoxelTerrain::view_data_block(Vector3i bpos) {
 			// First viewer to request it
 			LoadingBlock new_loading_block;
 			new_loading_block.viewers.add();
+			new_loading_block.prefetch = prefetch;
 
 			// Schedule a loading request
 			_loading_blocks.set(bpos, new_loading_block);
 			_blocks_pending_load.push_back(bpos);
 
+			if (prefetch) {
+				_prefetched_blocks.insert(bpos);
+				++_stats.prefetch_requested_blocks;
+			}
+
 		} else {
 			// More viewers
 			loading_block->viewers.add();
+
+			if (loading_block->prefetch && !prefetch) {
+				// It is needed now, so request it again without the lower priority of prefetching.
+				// The first response to come back will be used.
+				loading_block->prefetch = false;
+				loading_block->requested = true;
+				_blocks_pending_load.push_back(bpos);
+
+			} else if (!loading_block->requested) {
+				// The previous prefetch request was cancelled
+				loading_block->requested = true;
+				_blocks_pending_load.push_back(bpos);
+			}
 		}
 
 	} else {
 		// The block is loaded
 		block->viewers.add();
 
+		if (_data_blocks_pending_unload.erase(bpos) != 0) {
+			// It was left recently, no need to load it again
+			++_stats.revived_data_blocks;
+		}
+
 		// TODO viewers with varying flags during the game is not supported at the moment.
 		// They have to be re-created, which may cause world re-load...
 	}
+
+	if (!prefetch && _prefetched_blocks.erase(bpos) != 0) {
+		++_stats.prefetch_hit_blocks;
+	}
 }
 
 void VoxelTerrain::view_mesh_block(Vector3i bpos, bool mesh_flag, bool collision_flag) {
@@ -393,6 +452,29 @@ void VoxelTerrain::view_mesh_block(Vector3i bpos, bool mesh_flag, bool collision
 		block->collision_viewers.add();
 	}
 
+	auto pending_it = _mesh_blocks_pending_unload.find(bpos);
+	if (pending_it != _mesh_blocks_pending_unload.end()) {
+		// The block was left recently and is still loaded, show it again
+		const MeshBlockPendingUnload pending = pending_it->second;
+		_mesh_blocks_pending_unload.erase(pending_it);
+		++_stats.revived_mesh_blocks;
+
+		if (block->mesh_viewers.get() == 0) {
+			block->drop_mesh();
+		}
+		if (block->collision_viewers.get() == 0) {
+			block->drop_collision();
+		}
+		block->set_visible(true);
+
+		if (!pending.needs_update &&
+				(block->mesh_viewers.get() == 0 || pending.had_mesh) &&
+				(block->collision_viewers.get() == 0 || pending.had_collision)) {
+			// What it had is still valid
+			return;
+		}
+	}
+
 	// This is needed in case a viewer wants to view meshes in places data blocks are already present.
 	// Before that, meshes were updated only when a data block was loaded or modified,
 	// so changing block size or viewer flags did not make meshes appear.
@@ -420,6 +502,10 @@ void VoxelTerrain::unview_data_block(Vector3i bpos) {
 			// No longer want to load it
 			_loading_blocks.erase(bpos);
 
+			if (_prefetched_blocks.erase(bpos) != 0) {
+				++_stats.prefetch_wasted_blocks;
+			}
+
 			// TODO Do we really need that vector after all?
 			for (size_t i = 0; i < _blocks_pending_load.size(); ++i) {
 				if (_blocks_pending_load[i] == bpos) {
@@ -435,7 +521,12 @@ void VoxelTerrain::unview_data_block(Vector3i bpos) {
 		block->viewers.remove();
 		if (block->viewers.get() == 0) {
 			// The block itself is no longer wanted
-			unload_data_block(bpos);
+			if (is_unload_delayed()) {
+				// Viewers moving back and forth would load it again soon, so wait a bit
+				_data_blocks_pending_unload[bpos] = OS::get_singleton()->get_ticks_msec();
+			} else {
+				unload_data_block(bpos);
+			}
 		}
 	}
 }
@@ -446,24 +537,38 @@ void VoxelTerrain::unview_mesh_block(Vector3i bpos, bool mesh_flag, bool collisi
 	// so that would mean we unview one without viewing it in the first place
 	ERR_FAIL_COND(block == nullptr);
 
+	const bool had_mesh = block->mesh_viewers.get() > 0;
+	const bool had_collision = block->collision_viewers.get() > 0;
+
 	if (mesh_flag) {
 		block->mesh_viewers.remove();
-		if (block->mesh_viewers.get() == 0) {
-			// Mesh no longer required
-			block->drop_mesh();
-		}
 	}
-
 	if (collision_flag) {
 		block->collision_viewers.remove();
-		if (block->collision_viewers.get() == 0) {
-			// Collision no longer required
-			block->drop_collision();
+	}
+
+	if (block->mesh_viewers.get() == 0 && block->collision_viewers.get() == 0) {
+		if (is_unload_delayed()) {
+			// Viewers moving back and forth would mesh it again soon, so only hide it for now
+			block->set_visible(false);
+			MeshBlockPendingUnload pending;
+			pending.time_msec = OS::get_singleton()->get_ticks_msec();
+			pending.had_mesh = had_mesh;
+			pending.had_collision = had_collision;
+			_mesh_blocks_pending_unload[bpos] = pending;
+		} else {
+			unload_mesh_block(bpos);
 		}
+		return;
 	}
 
-	if (block->collision_viewers.get() == 0 && block->collision_viewers.get() == 0) {
-		unload_mesh_block(bpos);
+	if (mesh_flag && block->mesh_viewers.get() == 0) {
+		// Mesh no longer required
+		block->drop_mesh();
+	}
+	if (collision_flag && block->collision_viewers.get() == 0) {
+		// Collision no longer required
+		block->drop_collision();
 	}
 }
 
@@ -500,12 +605,66 @@ void VoxelTerrain::unload_data_block(Vector3i bpos) {
 
 	_loading_blocks.erase(bpos);
 
+	_data_blocks_pending_unload.erase(bpos);
+
+	if (_prefetched_blocks.erase(bpos) != 0) {
+		++_stats.prefetch_wasted_blocks;
+	}
+
 	// Blocks in the update queue will be cancelled in _process,
 	// because it's too expensive to linear-search all blocks for each block
 }
 
 void VoxelTerrain::unload_mesh_block(Vector3i bpos) {
 	_mesh_map.remove_block(bpos, VoxelMeshMap::NoAction());
+	_mesh_blocks_pending_unload.erase(bpos);
+}
+
+void VoxelTerrain::process_pending_unloads() {
+	VOXEL_PROFILE_SCOPE();
+
+	if (_data_blocks_pending_unload.size() == 0 && _mesh_blocks_pending_unload.size() == 0) {
+		return;
+	}
+
+	const uint64_t now_msec = OS::get_singleton()->get_ticks_msec();
+	const uint64_t delay_msec = static_cast<uint64_t>(_block_unload_delay * 1000.f);
+
+	std::vector<Box3i> viewed_boxes;
+
+	if (_data_blocks_pending_unload.size() > 0) {
+		for (size_t i = 0; i < _paired_viewers.size(); ++i) {
+			const PairedViewer::State &state = _paired_viewers[i].state;
+			if (!state.data_box.is_empty()) {
+				viewed_boxes.push_back(state.data_box);
+			}
+			if (!state.prefetch_box.is_empty()) {
+				viewed_boxes.push_back(state.prefetch_box);
+			}
+		}
+
+		unload_expired_blocks(_data_blocks_pending_unload, viewed_boxes, now_msec, delay_msec,
+				_block_unload_margin, MAX_BLOCKS_PENDING_UNLOAD,
+				[](uint64_t time_msec) { return time_msec; },
+				[this](Vector3i bpos) { unload_data_block(bpos); });
+	}
+
+	if (_mesh_blocks_pending_unload.size() > 0) {
+		viewed_boxes.clear();
+		for (size_t i = 0; i < _paired_viewers.size(); ++i) {
+			const PairedViewer::State &state = _paired_viewers[i].state;
+			if (!state.mesh_box.is_empty()) {
+				viewed_boxes.push_back(state.mesh_box);
+			}
+		}
+
+		const int mesh_margin = ceildiv(_block_unload_margin * get_data_block_size(), get_mesh_block_size());
+
+		unload_expired_blocks(_mesh_blocks_pending_unload, viewed_boxes, now_msec, delay_msec,
+				mesh_margin, MAX_BLOCKS_PENDING_UNLOAD,
+				[](const MeshBlockPendingUnload &pending) { return pending.time_msec; },
+				[this](Vector3i bpos) { unload_mesh_block(bpos); });
+	}
 }
 
 void VoxelTerrain::save_all_modified_blocks(bool with_copy) {
@@ -535,6 +694,15 @@ Dictionary VoxelTerrain::_b_get_statistics() const {
 	d["updated_blocks"] = _stats.updated_blocks;
 	d["remaining_main_thread_blocks"] = _stats.remaining_main_thread_blocks;
 
+	d["prefetch_requested_blocks"] = _stats.prefetch_requested_blocks;
+	d["prefetch_hit_blocks"] = _stats.prefetch_hit_blocks;
+	d["prefetch_wasted_blocks"] = _stats.prefetch_wasted_blocks;
+
+	d["data_blocks_pending_unload"] = (int)_data_blocks_pending_unload.size();
+	d["mesh_blocks_pending_unload"] = (int)_mesh_blocks_pending_unload.size();
+	d["revived_data_blocks"] = _stats.revived_data_blocks;
+	d["revived_mesh_blocks"] = _stats.revived_mesh_blocks;
+
 	return d;
 }
 
@@ -587,6 +755,7 @@ void VoxelTerrain::stop_streamer() {
 	VoxelServer::get_singleton()->set_volume_generator(_volume_id, Ref<VoxelGenerator>());
 	_loading_blocks.clear();
 	_blocks_pending_load.clear();
+	_prefetched_blocks.clear();
 	_reception_buffers.data_output.clear();
 }
 
@@ -604,6 +773,9 @@ void VoxelTerrain::reset_map() {
 	_blocks_pending_load.clear();
 	_blocks_pending_update.clear();
 	_blocks_to_save.clear();
+	_prefetched_blocks.clear();
+	_data_blocks_pending_unload.clear();
+	_mesh_blocks_pending_unload.clear();
 
 	// No need to care about refcounts, we drop everything anyways. Will pair it back on next process.
 	_paired_viewers.clear();
@@ -717,8 +889,10 @@ void VoxelTerrain::send_block_data_requests() {
 	// Blocks to load
 	for (size_t i = 0; i < _blocks_pending_load.size(); ++i) {
 		const Vector3i block_pos = _blocks_pending_load[i];
+		const LoadingBlock *loading_block = _loading_blocks.getptr(block_pos);
+		const bool prefetch = loading_block != nullptr && loading_block->prefetch;
 		// TODO Batch request
-		VoxelServer::get_singleton()->request_block_load(_volume_id, block_pos, 0, false);
+		VoxelServer::get_singleton()->request_block_load(_volume_id, block_pos, 0, false, prefetch);
 	}
 
 	// Blocks to save
@@ -875,6 +1049,23 @@ void VoxelTerrain::_process() {
 
 				state.data_box = Box3i::from_center_extents(data_block_pos, Vector3i(view_distance_data_blocks))
 										 .clipped(bounds_in_data_blocks);
+
+				// Load ahead of where the viewer will be after some time, if it keeps moving in the same direction
+				state.prefetch_box = Box3i();
+				if (viewer.prefetch_time > 0.f) {
+					Vector3 motion = world_to_local_transform.basis.xform(viewer.velocity * viewer.prefetch_time);
+					// A viewer moving further than its view distance in that time would see holes regardless
+					const float max_motion = state.view_distance_voxels;
+					if (motion.length_squared() > squared(max_motion)) {
+						motion = motion.normalized() * max_motion;
+					}
+					const Vector3i offset_data_blocks =
+							Vector3i::from_floored(motion / data_block_size + Vector3(0.5f, 0.5f, 0.5f));
+					if (offset_data_blocks != Vector3i()) {
+						state.prefetch_box = Box3i(state.data_box.pos + offset_data_blocks, state.data_box.size)
+													 .clipped(bounds_in_data_blocks);
+					}
+				}
 			}
 		};
 
@@ -917,7 +1108,30 @@ void VoxelTerrain::_process() {
 					new_data_box.difference(prev_data_box, [this, &viewer](Box3i box_to_load) {
 						box_to_load.for_each_cell([this, &viewer](Vector3i bpos) {
 							// Load or update block
-							view_data_block(bpos);
+							view_data_block(bpos, false);
+						});
+					});
+				}
+			}
+
+			{
+				const Box3i &new_prefetch_box = viewer.state.prefetch_box;
+				const Box3i &prev_prefetch_box = viewer.prev_state.prefetch_box;
+
+				if (prev_prefetch_box != new_prefetch_box) {
+					VOXEL_PROFILE_SCOPE();
+
+					// Viewed after the data box, so blocks both need are not loaded as prefetched.
+					// If the viewer changes direction, blocks left behind get unviewed and their loading cancelled.
+					prev_prefetch_box.difference(new_prefetch_box, [this](Box3i out_of_range_box) {
+						out_of_range_box.for_each_cell([this](Vector3i bpos) {
+							unview_data_block(bpos);
+						});
+					});
+
+					new_prefetch_box.difference(prev_prefetch_box, [this](Box3i box_to_load) {
+						box_to_load.for_each_cell([this](Vector3i bpos) {
+							view_data_block(bpos, true);
 						});
 					});
 				}
@@ -987,6 +1201,9 @@ void VoxelTerrain::_process() {
 		_prev_bounds_in_voxels = _bounds_in_voxels;
 	}
 
+	// After viewers moved, so blocks they just came back to are not unloaded
+	process_pending_unloads();
+
 	_stats.time_detect_required_blocks = profiling_clock.restart();
 
 	// We no longer need unpaired viewers.
@@ -1038,6 +1255,18 @@ void VoxelTerrain::_process() {
 				loading_block = *loading_block_ptr;
 			}
 
+			if (ob.dropped && ob.prefetch) {
+				// Prefetches get cancelled when viewers turn away, so requesting it again now would only get it
+				// cancelled again. Viewers still reference the block, so it stays loading, and the next viewer
+				// needing it will request it again. If it was needed meanwhile, a request without prefetching
+				// is already on its way.
+				if (loading_block.prefetch) {
+					_loading_blocks.getptr(block_pos)->requested = false;
+				}
+				++_stats.dropped_block_loads;
+				continue;
+			}
+
 			if (ob.dropped) {
 				// That block was cancelled by the server, but we are still expecting it.
 				// We'll have to request it again.
@@ -1129,13 +1358,15 @@ void VoxelTerrain::_process() {
 			//mesh_request.data_blocks_count = data_box.size.volume();
 
 			// This iteration order is specifically chosen to match VoxelServer and threaded access
-			data_box.for_each_cell_zxy([this, &mesh_request](Vector3i data_block_pos) {
-				VoxelDataBlock *data_block = _data_map.get_block(data_block_pos);
+			FixedArray<VoxelDataBlock *, VoxelConstants::MAX_BLOCK_COUNT_PER_REQUEST> data_blocks;
+			_data_map.get_blocks_in_box_zxy(data_box, to_span(data_blocks, data_box.size.volume()));
+			mesh_request.data_blocks_count = data_box.size.volume();
+			for (unsigned int i = 0; i < mesh_request.data_blocks_count; ++i) {
+				const VoxelDataBlock *data_block = data_blocks[i];
 				if (data_block != nullptr) {
-					mesh_request.data_blocks[mesh_request.data_blocks_count] = data_block->voxels;
+					mesh_request.data_blocks[i] = data_block->voxels;
 				}
-				++mesh_request.data_blocks_count;
-			});
+			}
 
 #ifdef DEBUG_ENABLED
 			{
@@ -1229,7 +1460,13 @@ void VoxelTerrain::_process() {
 				collidable_surfaces.clear();
 			}
 
-			const bool gen_collisions = _generate_collisions && block->collision_viewers.get() > 0;
+			// Meshes of blocks waiting to be unloaded are kept hidden, in case a viewer comes back
+			auto pending_it = _mesh_blocks_pending_unload.find(ob.position);
+			const bool pending_unload = pending_it != _mesh_blocks_pending_unload.end();
+
+			const bool gen_collisions = _generate_collisions &&
+										(block->collision_viewers.get() > 0 ||
+												(pending_unload && pending_it->second.had_collision));
 
 			block->set_mesh(mesh);
 			if (gen_collisions) {
@@ -1238,7 +1475,7 @@ void VoxelTerrain::_process() {
 				block->set_collision_layer(_collision_layer);
 				block->set_collision_mask(_collision_mask);
 			}
-			block->set_visible(true);
+			block->set_visible(!pending_unload);
 			block->set_parent_visible(is_visible());
 			block->set_parent_transform(local_to_world_transform);
 		}
@@ -1353,6 +1590,13 @@ void VoxelTerrain::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_max_view_distance", "distance_in_voxels"), &VoxelTerrain::set_max_view_distance);
 	ClassDB::bind_method(D_METHOD("get_max_view_distance"), &VoxelTerrain::get_max_view_distance);
 
+	ClassDB::bind_method(D_METHOD("set_block_unload_margin", "margin_in_blocks"),
+			&VoxelTerrain::set_block_unload_margin);
+	ClassDB::bind_method(D_METHOD("get_block_unload_margin"), &VoxelTerrain::get_block_unload_margin);
+
+	ClassDB::bind_method(D_METHOD("set_block_unload_delay", "seconds"), &VoxelTerrain::set_block_unload_delay);
+	ClassDB::bind_method(D_METHOD("get_block_unload_delay"), &VoxelTerrain::get_block_unload_delay);
+
 	ClassDB::bind_method(D_METHOD("get_generate_collisions"), &VoxelTerrain::get_generate_collisions);
 	ClassDB::bind_method(D_METHOD("set_generate_collisions", "enabled"), &VoxelTerrain::set_generate_collisions);
 
@@ -1409,6 +1653,10 @@ void VoxelTerrain::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "run_stream_in_editor"),
 			"set_run_stream_in_editor", "is_stream_running_in_editor");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "mesh_block_size"), "set_mesh_block_size", "get_mesh_block_size");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "block_unload_margin", PROPERTY_HINT_RANGE, "0, 16, 1"),
+			"set_block_unload_margin", "get_block_unload_margin");
+	ADD_PROPERTY(PropertyInfo(Variant::REAL, "block_unload_delay", PROPERTY_HINT_RANGE, "0.0, 60.0, 0.1"),
+			"set_block_unload_delay", "get_block_unload_delay");
 
 	// TODO Add back access to block, but with an API securing multithreaded access
 	ADD_SIGNAL(MethodInfo(VoxelStringNames::get_singleton()->block_loaded,
@@ -7,6 +7,8 @@
 #include "voxel_node.h"
 
 #include <scene/3d/spatial.h>
+#include <unordered_map>
+#include <unordered_set>
 
 class VoxelTool;
 class Node;
@@ -19,6 +21,8 @@ class VoxelTerrain : public VoxelNode {
 	GDCLASS(VoxelTerrain, VoxelNode)
 public:
 	static const unsigned int MAX_VIEW_DISTANCE_FOR_LARGE_VOLUME = 512;
+	// Beyond this amount, blocks waiting to be unloaded are evicted regardless of margin and delay, oldest first
+	static const unsigned int MAX_BLOCKS_PENDING_UNLOAD = 1024;
 
 	VoxelTerrain();
 	~VoxelTerrain();
@@ -58,6 +62,14 @@ public:
 	unsigned int get_max_view_distance() const;
 	void set_max_view_distance(unsigned int distance_in_voxels);
 
+	// Blocks leaving the view of all viewers remain loaded until they are this many data blocks further away
+	void set_block_unload_margin(int margin_in_blocks);
+	int get_block_unload_margin() const;
+
+	// Minimum time blocks leaving the view of all viewers remain loaded, in seconds
+	void set_block_unload_delay(float seconds);
+	float get_block_unload_delay() const;
+
 	// TODO Make this obsolete with multi-viewers
 	void set_viewer_path(NodePath path);
 	NodePath get_viewer_path() const;
@@ -92,6 +104,15 @@ public:
 		uint32_t time_process_load_responses = 0;
 		uint32_t time_request_blocks_to_update = 0;
 		uint32_t time_process_update_responses = 0;
+		// Totals since the terrain started, about blocks loaded in advance of moving viewers
+		uint32_t prefetch_requested_blocks = 0;
+		// Prefetched blocks which a viewer then needed
+		uint32_t prefetch_hit_blocks = 0;
+		// Prefetched blocks which were unloaded before any viewer needed them
+		uint32_t prefetch_wasted_blocks = 0;
+		// Totals since the terrain started, about blocks viewed again while they were waiting to be unloaded
+		uint32_t revived_data_blocks = 0;
+		uint32_t revived_mesh_blocks = 0;
 	};
 
 	const Stats &get_stats() const;
@@ -119,12 +140,14 @@ private:
 	void stop_streamer();
 	void reset_map();
 
-	void view_data_block(Vector3i bpos);
+	void view_data_block(Vector3i bpos, bool prefetch);
 	void view_mesh_block(Vector3i bpos, bool mesh_flag, bool collision_flag);
 	void unview_data_block(Vector3i bpos);
 	void unview_mesh_block(Vector3i bpos, bool mesh_flag, bool collision_flag);
 	void unload_data_block(Vector3i bpos);
 	void unload_mesh_block(Vector3i bpos);
+	void process_pending_unloads();
+	bool is_unload_delayed() const;
 	//void make_data_block_dirty(Vector3i bpos);
 	void try_schedule_mesh_update(VoxelMeshBlock *block);
 	void try_schedule_mesh_update_from_data(const Box3i &box_in_voxels);
@@ -157,6 +180,8 @@ private:
 		struct State {
 			Vector3i local_position_voxels;
 			Box3i data_box;
+			// Data blocks ahead of the viewer when it moves. Can overlap `data_box`.
+			Box3i prefetch_box;
 			Box3i mesh_box;
 			int view_distance_voxels = 0;
 			bool requires_collisions = false;
@@ -181,18 +206,39 @@ private:
 	Box3i _prev_bounds_in_voxels;
 
 	unsigned int _max_view_distance_voxels = 128;
+	int _block_unload_margin = 0;
+	float _block_unload_delay = 0.f;
 
 	// TODO Terrains only need to handle the visible portion of voxels, which reduces the bounds blocks to handle.
 	// Therefore, could a simple grid be better to use than a hashmap?
 
 	struct LoadingBlock {
 		VoxelRefCount viewers;
+		// Only requested by prefetch boxes so far
+		bool prefetch = false;
+		// False if the server cancelled the prefetch request, so the next viewer to need the block requests it again
+		bool requested = true;
 	};
 
 	HashMap<Vector3i, LoadingBlock, Vector3iHasher> _loading_blocks;
 	std::vector<Vector3i> _blocks_pending_load;
 	std::vector<Vector3i> _blocks_pending_update;
 	std::vector<BlockToSave> _blocks_to_save;
+	// Blocks loaded or loading because of prefetching, which no viewer needed yet
+	std::unordered_set<Vector3i> _prefetched_blocks;
+
+	// Blocks no viewer needs anymore, kept loaded in case viewers come back.
+	// Meshes are hidden meanwhile. Values are the time at which they were left, in milliseconds.
+	struct MeshBlockPendingUnload {
+		uint64_t time_msec = 0;
+		// What the block had when it got hidden
+		bool had_mesh = false;
+		bool had_collision = false;
+		// Data changed since the block got hidden, so it has to be remeshed if it gets viewed again
+		bool needs_update = false;
+	};
+	std::unordered_map<Vector3i, uint64_t> _data_blocks_pending_unload;
+	std::unordered_map<Vector3i, MeshBlockPendingUnload> _mesh_blocks_pending_unload;
 
 	Ref<VoxelStream> _stream;
 	Ref<VoxelMesher> _mesher;
@@ -1,7 +1,13 @@
 #include "voxel_viewer.h"
 #include "../server/voxel_server.h"
+#include "../util/math/funcs.h"
 #include <core/engine.h>
 
+namespace {
+// How fast the velocity follows actual motion, per second. Lower values react slower but filter out jitter.
+const float VELOCITY_SMOOTHING = 8.f;
+} // namespace
+
 VoxelViewer::VoxelViewer() {
 	set_notify_transform(!Engine::get_singleton()->is_editor_hint());
 }
@@ -39,6 +45,22 @@ bool VoxelViewer::is_requiring_collisions() const {
 	return _requires_collisions;
 }
 
+void VoxelViewer::set_prefetch_time(float seconds) {
+	ERR_FAIL_COND(seconds < 0.f);
+	_prefetch_time = seconds;
+	if (is_active()) {
+		VoxelServer::get_singleton()->set_viewer_prefetch_time(_viewer_id, seconds);
+	}
+}
+
+float VoxelViewer::get_prefetch_time() const {
+	return _prefetch_time;
+}
+
+Vector3 VoxelViewer::get_velocity() const {
+	return _velocity;
+}
+
 void VoxelViewer::_notification(int p_what) {
 	switch (p_what) {
 		case NOTIFICATION_ENTER_TREE: {
@@ -47,8 +69,13 @@ void VoxelViewer::_notification(int p_what) {
 				VoxelServer::get_singleton()->set_viewer_distance(_viewer_id, _view_distance);
 				VoxelServer::get_singleton()->set_viewer_requires_visuals(_viewer_id, _requires_visuals);
 				VoxelServer::get_singleton()->set_viewer_requires_collisions(_viewer_id, _requires_collisions);
+				VoxelServer::get_singleton()->set_viewer_prefetch_time(_viewer_id, _prefetch_time);
 				const Vector3 pos = get_global_transform().origin;
 				VoxelServer::get_singleton()->set_viewer_position(_viewer_id, pos);
+				_last_position = pos;
+				_velocity = Vector3();
+				// Velocity is measured every frame, because the transform doesn't change when the viewer stops
+				set_process(true);
 			}
 		} break;
 
@@ -65,11 +92,38 @@ void VoxelViewer::_notification(int p_what) {
 			}
 			break;
 
+		case NOTIFICATION_PROCESS:
+			if (is_active()) {
+				_process();
+			}
+			break;
+
 		default:
 			break;
 	}
 }
 
+void VoxelViewer::_process() {
+	const float delta = get_process_delta_time();
+	const Vector3 position = get_global_transform().origin;
+	const Vector3 motion = position - _last_position;
+	_last_position = position;
+
+	if (delta <= 0.f) {
+		return;
+	}
+
+	if (motion.length_squared() > squared(static_cast<float>(_view_distance))) {
+		// Teleported, this is not a motion to anticipate
+		_velocity = Vector3();
+	} else {
+		// Smoothed, so jitter doesn't make prefetching change direction all the time
+		_velocity = _velocity.linear_interpolate(motion / delta, min(delta * VELOCITY_SMOOTHING, 1.f));
+	}
+
+	VoxelServer::get_singleton()->set_viewer_velocity(_viewer_id, _velocity);
+}
+
 bool VoxelViewer::is_active() const {
 	return is_inside_tree() && !Engine::get_singleton()->is_editor_hint();
 }
@@ -84,8 +138,15 @@ void VoxelViewer::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_requires_collisions", "enabled"), &VoxelViewer::set_requires_collisions);
 	ClassDB::bind_method(D_METHOD("is_requiring_collisions"), &VoxelViewer::is_requiring_collisions);
 
+	ClassDB::bind_method(D_METHOD("set_prefetch_time", "seconds"), &VoxelViewer::set_prefetch_time);
+	ClassDB::bind_method(D_METHOD("get_prefetch_time"), &VoxelViewer::get_prefetch_time);
+
+	ClassDB::bind_method(D_METHOD("get_velocity"), &VoxelViewer::get_velocity);
+
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "view_distance"), "set_view_distance", "get_view_distance");
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "requires_visuals"), "set_requires_visuals", "is_requiring_visuals");
 	ADD_PROPERTY(
 			PropertyInfo(Variant::BOOL, "requires_collisions"), "set_requires_collisions", "is_requiring_collisions");
+	ADD_PROPERTY(PropertyInfo(Variant::REAL, "prefetch_time", PROPERTY_HINT_RANGE, "0.0, 10.0, 0.1"),
+			"set_prefetch_time", "get_prefetch_time");
 }
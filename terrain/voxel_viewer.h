@@ -21,6 +21,13 @@ public:
 	void set_requires_collisions(bool enabled);
 	bool is_requiring_collisions() const;
 
+	// How many seconds of motion ahead of the viewer should be loaded in advance. 0 disables it.
+	void set_prefetch_time(float seconds);
+	float get_prefetch_time() const;
+
+	// Smoothed velocity in world space units per second
+	Vector3 get_velocity() const;
+
 protected:
 	void _notification(int p_what);
 
@@ -34,6 +41,9 @@ private:
 	unsigned int _view_distance = 128;
 	bool _requires_visuals = true;
 	bool _requires_collisions = false;
+	float _prefetch_time = 0.f;
+	Vector3 _velocity;
+	Vector3 _last_position;
 };
 
 #endif // VOXEL_VIEWER_H
@@ -0,0 +1,437 @@
+#include "../storage/funcs.h"
+#include "../storage/voxel_buffer.h"
+#include "../storage/voxel_metadata_map.h"
+#include "../streams/compressed_data.h"
+#include "../util/funcs.h"
+#include "../util/macros.h"
+#include "../util/math/morton.h"
+#include "../util/profiling_clock.h"
+#include "../util/simd.h"
+#include "../util/vector3i_index_map.h"
+#include "tests.h"
+
+#include <core/hash_map.h>
+#include <core/map.h>
+#include <core/print_string.h>
+#include <vector>
+
+namespace Benchmarks {
+
+const int ITERATIONS = 1000;
+const Vector3i BLOCK_SIZE(34, 34, 34);
+
+// Volatile sink so the optimizer doesn't remove benchmarked code
+volatile uint64_t g_sink = 0;
+
+template <typename F>
+uint64_t measure(F f) {
+	ProfilingClock clock;
+	for (int i = 0; i < ITERATIONS; ++i) {
+		f();
+	}
+	return clock.restart();
+}
+
+void print_result(const char *name, uint64_t scalar_usec, uint64_t optimized_usec) {
+	print_line(String("{0}: scalar {1} us, optimized {2} us, x{3}")
+					   .format(varray(name, SIZE_T_TO_VARIANT(scalar_usec), SIZE_T_TO_VARIANT(optimized_usec),
+							   static_cast<double>(scalar_usec) / MAX(optimized_usec, 1))));
+}
+
+template <typename T>
+void bench_fill() {
+	std::vector<T> data;
+	data.resize(BLOCK_SIZE.volume());
+
+	const uint64_t scalar_time = measure([&data]() {
+		for (size_t i = 0; i < data.size(); ++i) {
+			data[i] = static_cast<T>(g_sink + 1);
+		}
+		g_sink = g_sink + data.back();
+	});
+
+	const uint64_t optimized_time = measure([&data]() {
+		simd::fill<T>(data.data(), data.size(), static_cast<T>(g_sink + 1));
+		g_sink = g_sink + data.back();
+	});
+
+	print_result(sizeof(T) == 1 ? "fill u8" : "fill u16", scalar_time, optimized_time);
+}
+
+void bench_fill_area() {
+	Ref<VoxelBuffer> buffer;
+	buffer.instance();
+	buffer->create(BLOCK_SIZE);
+	buffer->set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+	buffer->decompress_channel(VoxelBuffer::CHANNEL_SDF);
+
+	const Vector3i min(1, 1, 1);
+	const Vector3i max = BLOCK_SIZE - Vector3i(1);
+
+	const uint64_t scalar_time = measure([&buffer, min, max]() {
+		Vector3i pos;
+		for (pos.z = min.z; pos.z < max.z; ++pos.z) {
+			for (pos.x = min.x; pos.x < max.x; ++pos.x) {
+				for (pos.y = min.y; pos.y < max.y; ++pos.y) {
+					buffer->set_voxel(g_sink & 0xff, pos, VoxelBuffer::CHANNEL_SDF);
+				}
+			}
+		}
+		g_sink = g_sink + 1;
+	});
+
+	const uint64_t optimized_time = measure([&buffer, min, max]() {
+		buffer->fill_area(g_sink & 0xff, min, max, VoxelBuffer::CHANNEL_SDF);
+		g_sink = g_sink + 1;
+	});
+
+	print_result("fill_area u16", scalar_time, optimized_time);
+}
+
+template <typename T>
+void bench_is_uniform() {
+	std::vector<T> data;
+	data.resize(BLOCK_SIZE.volume(), 42);
+
+	const uint64_t scalar_time = measure([&data]() {
+		bool uniform = true;
+		for (size_t i = 1; i < data.size(); ++i) {
+			if (data[i] != data[0]) {
+				uniform = false;
+				break;
+			}
+		}
+		g_sink = g_sink + uniform;
+	});
+
+	const uint64_t optimized_time = measure([&data]() {
+		g_sink = g_sink + is_uniform(data.data(), data.size());
+	});
+
+	print_result(sizeof(T) == 1 ? "is_uniform u8" : "is_uniform u16", scalar_time, optimized_time);
+}
+
+void bench_copy_3d_region() {
+	std::vector<uint16_t> src;
+	std::vector<uint16_t> dst;
+	src.resize(BLOCK_SIZE.volume(), 1);
+	dst.resize(BLOCK_SIZE.volume(), 0);
+
+	// Typical neighbor padding copy, where rows span the whole height
+	const Vector3i src_min(0, 0, 0);
+	const Vector3i src_max(BLOCK_SIZE.x, BLOCK_SIZE.y, 16);
+
+	const uint64_t scalar_time = measure([&src, &dst, src_min, src_max]() {
+		Vector3i pos;
+		for (pos.z = src_min.z; pos.z < src_max.z; ++pos.z) {
+			for (pos.x = src_min.x; pos.x < src_max.x; ++pos.x) {
+				for (pos.y = src_min.y; pos.y < src_max.y; ++pos.y) {
+					const unsigned int i = pos.get_zxy_index(BLOCK_SIZE);
+					dst[i] = src[i];
+				}
+			}
+		}
+		g_sink = g_sink + dst[0];
+	});
+
+	const uint64_t optimized_time = measure([&src, &dst, src_min, src_max]() {
+		copy_3d_region_zxy(Span<uint16_t>(dst.data(), 0, dst.size()), BLOCK_SIZE, Vector3i(),
+				Span<const uint16_t>(src.data(), 0, src.size()), BLOCK_SIZE, src_min, src_max);
+		g_sink = g_sink + dst[0];
+	});
+
+	print_result("copy_3d_region_zxy u16", scalar_time, optimized_time);
+}
+
+template <typename T>
+void bench_downscale_row() {
+	const unsigned int count = 1024;
+	std::vector<T> src;
+	std::vector<T> dst;
+	src.resize(count * 2);
+	dst.resize(count);
+	for (size_t i = 0; i < src.size(); ++i) {
+		src[i] = static_cast<T>(i);
+	}
+
+	const uint64_t scalar_time = measure([&src, &dst]() {
+		for (size_t i = 0; i < dst.size(); ++i) {
+			dst[i] = src[i * 2];
+		}
+		g_sink = g_sink + dst.back();
+	});
+
+	const uint64_t optimized_time = measure([&src, &dst]() {
+		simd::copy_even_items(dst.data(), src.data(), dst.size());
+		g_sink = g_sink + dst.back();
+	});
+
+	print_result(sizeof(T) == 1 ? "downscale row u8" : "downscale row u16", scalar_time, optimized_time);
+}
+
+void bench_downscale_to() {
+	Ref<VoxelBuffer> src;
+	src.instance();
+	src->create(Vector3i(32, 32, 32));
+	src->set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+	src->set_voxel(1, Vector3i(3, 4, 5), VoxelBuffer::CHANNEL_SDF);
+
+	Ref<VoxelBuffer> dst;
+	dst.instance();
+	dst->create(Vector3i(32, 32, 32));
+	dst->set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+
+	const Vector3i src_size = src->get_size();
+
+	const uint64_t scalar_time = measure([&src, &dst, src_size]() {
+		Vector3i pos;
+		for (pos.z = 0; pos.z < src_size.z / 2; ++pos.z) {
+			for (pos.x = 0; pos.x < src_size.x / 2; ++pos.x) {
+				for (pos.y = 0; pos.y < src_size.y / 2; ++pos.y) {
+					const uint64_t v = src->get_voxel(pos << 1, VoxelBuffer::CHANNEL_SDF);
+					dst->set_voxel(v, pos, VoxelBuffer::CHANNEL_SDF);
+				}
+			}
+		}
+	});
+
+	const uint64_t optimized_time = measure([&src, &dst, src_size]() {
+		src->downscale_to(**dst, Vector3i(), src_size, Vector3i());
+	});
+
+	print_result("downscale_to u16", scalar_time, optimized_time);
+}
+
+// Compares block index lookups in 3x3x3 neighborhoods, like meshing requests do
+void bench_block_index() {
+	// Same configuration VoxelDataMap used before
+	HashMap<Vector3i, unsigned int, Vector3iHasher, HashMapComparatorDefault<Vector3i>, 3, 2> hash_map;
+	Vector3iIndexMap index_map;
+
+	const Box3i box(-8, -4, -8, 16, 8, 16);
+	unsigned int value = 0;
+	box.for_each_cell([&hash_map, &index_map, &value](Vector3i pos) {
+		hash_map.set(pos, value);
+		index_map.set(pos, value);
+		++value;
+	});
+
+	const Box3i centers = box.padded(-1);
+
+	const uint64_t hash_map_time = measure([&hash_map, centers]() {
+		uint64_t sum = 0;
+		centers.for_each_cell([&hash_map, &sum](Vector3i center) {
+			Box3i(center - Vector3i(1), Vector3i(3)).for_each_cell_zxy([&hash_map, &sum](Vector3i pos) {
+				const unsigned int *v = hash_map.getptr(pos);
+				if (v != nullptr) {
+					sum += *v;
+				}
+			});
+		});
+		g_sink = g_sink + sum;
+	});
+
+	const uint64_t index_map_time = measure([&index_map, centers]() {
+		uint64_t sum = 0;
+		centers.for_each_cell([&index_map, &sum](Vector3i center) {
+			Box3i(center - Vector3i(1), Vector3i(3)).for_each_cell_zxy([&index_map, &sum](Vector3i pos) {
+				const uint32_t *v = index_map.getptr(pos);
+				if (v != nullptr) {
+					sum += *v;
+				}
+			});
+		});
+		g_sink = g_sink + sum;
+	});
+
+	print_result("block index 3x3x3 lookups", hash_map_time, index_map_time);
+}
+
+// Compares reading the 6 neighbors of every voxel, like gradient and normal computations do,
+// from a channel copied in ZXY and in Morton order
+void bench_neighbor_reads_layout() {
+	const Vector3i size(32, 32, 32);
+
+	Ref<VoxelBuffer> buffer;
+	buffer.instance();
+	buffer->create(size);
+	buffer->set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+	Box3i(Vector3i(), size).for_each_cell_zxy([&buffer](Vector3i pos) {
+		buffer->set_voxel(pos.x ^ pos.y ^ pos.z, pos, VoxelBuffer::CHANNEL_SDF);
+	});
+
+	std::vector<uint16_t> zxy_values;
+	zxy_values.resize(size.volume());
+	buffer->copy_channel_area_to_raw(VoxelBuffer::CHANNEL_SDF, Box3i(Vector3i(), size),
+			Span<uint16_t>(zxy_values.data(), zxy_values.size()).reinterpret_cast_to<uint8_t>());
+
+	std::vector<uint16_t> morton_values;
+	morton_values.resize(size.volume());
+	buffer->copy_channel_to_morton(VoxelBuffer::CHANNEL_SDF,
+			Span<uint16_t>(morton_values.data(), morton_values.size()).reinterpret_cast_to<uint8_t>());
+
+	const uint64_t zxy_time = measure([&zxy_values, size]() {
+		uint64_t sum = 0;
+		Vector3i pos;
+		for (pos.z = 1; pos.z < size.z - 1; ++pos.z) {
+			for (pos.x = 1; pos.x < size.x - 1; ++pos.x) {
+				for (pos.y = 1; pos.y < size.y - 1; ++pos.y) {
+					sum += zxy_values[Vector3i(pos.x - 1, pos.y, pos.z).get_zxy_index(size)];
+					sum += zxy_values[Vector3i(pos.x + 1, pos.y, pos.z).get_zxy_index(size)];
+					sum += zxy_values[Vector3i(pos.x, pos.y - 1, pos.z).get_zxy_index(size)];
+					sum += zxy_values[Vector3i(pos.x, pos.y + 1, pos.z).get_zxy_index(size)];
+					sum += zxy_values[Vector3i(pos.x, pos.y, pos.z - 1).get_zxy_index(size)];
+					sum += zxy_values[Vector3i(pos.x, pos.y, pos.z + 1).get_zxy_index(size)];
+				}
+			}
+		}
+		g_sink = g_sink + sum;
+	});
+
+	const uint64_t morton_time = measure([&morton_values, size]() {
+		uint64_t sum = 0;
+		Vector3i pos;
+		for (pos.z = 1; pos.z < size.z - 1; ++pos.z) {
+			for (pos.x = 1; pos.x < size.x - 1; ++pos.x) {
+				for (pos.y = 1; pos.y < size.y - 1; ++pos.y) {
+					sum += morton_values[morton3d_encode(pos.x - 1, pos.y, pos.z)];
+					sum += morton_values[morton3d_encode(pos.x + 1, pos.y, pos.z)];
+					sum += morton_values[morton3d_encode(pos.x, pos.y - 1, pos.z)];
+					sum += morton_values[morton3d_encode(pos.x, pos.y + 1, pos.z)];
+					sum += morton_values[morton3d_encode(pos.x, pos.y, pos.z - 1)];
+					sum += morton_values[morton3d_encode(pos.x, pos.y, pos.z + 1)];
+				}
+			}
+		}
+		g_sink = g_sink + sum;
+	});
+
+	print_result("6-neighbor reads, ZXY vs Morton", zxy_time, morton_time);
+}
+
+// Compares area queries of voxel metadata, like VoxelTool.for_each_voxel_metadata_in_area does
+void bench_voxel_metadata_area() {
+	Map<Vector3i, Variant> tree;
+	VoxelMetadataMap flat;
+
+	// Sparse metadata, like chests and machines placed in a block
+	const Box3i box(Vector3i(), Vector3i(32, 32, 32));
+	box.for_each_cell([&tree, &flat](Vector3i pos) {
+		if ((pos.x * 7 + pos.y * 13 + pos.z * 29) % 17 == 0) {
+			tree[pos] = pos.x;
+			flat.set(pos, pos.x);
+		}
+	});
+
+	const Box3i query_box(Vector3i(8, 8, 8), Vector3i(8, 8, 8));
+
+	const uint64_t tree_time = measure([&tree, query_box]() {
+		uint64_t sum = 0;
+		const Map<Vector3i, Variant>::Element *elem = tree.front();
+		while (elem != nullptr) {
+			if (query_box.contains(elem->key())) {
+				sum += static_cast<int>(elem->value());
+			}
+			elem = elem->next();
+		}
+		g_sink = g_sink + sum;
+	});
+
+	const uint64_t flat_time = measure([&flat, query_box]() {
+		uint64_t sum = 0;
+		flat.for_each_in_area(query_box, [&sum](Vector3i pos, const Variant &value) {
+			sum += static_cast<int>(value);
+		});
+		g_sink = g_sink + sum;
+	});
+
+	print_result("voxel metadata area query, tree vs flat", tree_time, flat_time);
+}
+
+// Compares compressing a 16-bit SDF channel of terrain as-is, and after delta and byte shuffle filters
+void bench_sdf_compression_filters() {
+	const Vector3i size(32, 32, 32);
+
+	Ref<VoxelBuffer> buffer;
+	buffer.instance();
+	buffer->create(size);
+	buffer->set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+	// Rolling hills crossing the block
+	Box3i(Vector3i(), size).for_each_cell_zxy([&buffer](Vector3i pos) {
+		const float height = 16.f + 6.f * Math::sin(pos.x * 0.21f) + 4.f * Math::cos(pos.z * 0.13f + pos.x * 0.05f);
+		buffer->set_voxel_f(0.1f * (pos.y - height), pos.x, pos.y, pos.z, VoxelBuffer::CHANNEL_SDF);
+	});
+
+	Span<uint8_t> raw;
+	CRASH_COND(!buffer->get_channel_raw(VoxelBuffer::CHANNEL_SDF, raw));
+	const Span<const uint8_t> raw_const(raw.data(), raw.size());
+	const uint8_t filters = VoxelCompressedData::FILTER_DELTA_Y | VoxelCompressedData::FILTER_BYTE_SHUFFLE;
+
+	std::vector<uint8_t> filtered;
+	filtered.resize(raw.size());
+	std::vector<uint8_t> compressed;
+	std::vector<uint8_t> decompressed;
+	std::vector<uint8_t> reverted;
+	reverted.resize(raw.size());
+
+	const uint64_t raw_compress_time = measure([&raw_const, &compressed]() {
+		VoxelCompressedData::compress(raw_const, compressed, VoxelCompressedData::COMPRESSION_LZ4);
+		g_sink = g_sink + compressed.size();
+	});
+	const size_t raw_compressed_size = compressed.size();
+	const uint64_t raw_decompress_time = measure([&compressed, &decompressed]() {
+		VoxelCompressedData::decompress(to_span_const(compressed), decompressed);
+		g_sink = g_sink + decompressed.size();
+	});
+
+	const uint64_t filtered_compress_time = measure([&raw_const, &filtered, &compressed, filters]() {
+		VoxelCompressedData::apply_filters(raw_const, to_span(filtered), filters, 2, 32);
+		VoxelCompressedData::compress(to_span_const(filtered), compressed, VoxelCompressedData::COMPRESSION_LZ4);
+		g_sink = g_sink + compressed.size();
+	});
+	const size_t filtered_compressed_size = compressed.size();
+	const uint64_t filtered_decompress_time = measure([&compressed, &decompressed, &reverted, filters]() {
+		VoxelCompressedData::decompress(to_span_const(compressed), decompressed);
+		VoxelCompressedData::revert_filters(to_span_const(decompressed), to_span(reverted), filters, 2, 32);
+		g_sink = g_sink + reverted.size();
+	});
+
+	print_line(String("16-bit SDF LZ4 compression: {0} bytes, raw {1} bytes, filtered {2} bytes")
+					   .format(varray(SIZE_T_TO_VARIANT(raw.size()), SIZE_T_TO_VARIANT(raw_compressed_size),
+							   SIZE_T_TO_VARIANT(filtered_compressed_size))));
+	print_result("16-bit SDF compression, raw vs filtered", raw_compress_time, filtered_compress_time);
+	print_result("16-bit SDF decompression, raw vs filtered", raw_decompress_time, filtered_decompress_time);
+
+	// Acceleration trades ratio for speed
+	const uint64_t default_compress_time = measure([&filtered, &compressed]() {
+		VoxelCompressedData::compress(to_span_const(filtered), compressed, VoxelCompressedData::COMPRESSION_LZ4);
+		g_sink = g_sink + compressed.size();
+	});
+	const uint64_t accelerated_compress_time = measure([&filtered, &compressed]() {
+		VoxelCompressedData::compress(
+				to_span_const(filtered), compressed, VoxelCompressedData::COMPRESSION_LZ4, 8);
+		g_sink = g_sink + compressed.size();
+	});
+	print_line(String("Filtered 16-bit SDF with LZ4 acceleration 8: {0} bytes")
+					   .format(varray(SIZE_T_TO_VARIANT(compressed.size()))));
+	print_result("LZ4 acceleration 1 vs 8", default_compress_time, accelerated_compress_time);
+}
+
+} // namespace Benchmarks
+
+// Only run when VOXEL_RUN_BENCHMARKS is defined, because they take time and only print results
+void run_voxel_benchmarks() {
+	Benchmarks::bench_fill<uint8_t>();
+	Benchmarks::bench_fill<uint16_t>();
+	Benchmarks::bench_fill_area();
+	Benchmarks::bench_is_uniform<uint8_t>();
+	Benchmarks::bench_is_uniform<uint16_t>();
+	Benchmarks::bench_copy_3d_region();
+	Benchmarks::bench_downscale_row<uint8_t>();
+	Benchmarks::bench_downscale_row<uint16_t>();
+	Benchmarks::bench_downscale_to();
+	Benchmarks::bench_block_index();
+	Benchmarks::bench_neighbor_reads_layout();
+	Benchmarks::bench_voxel_metadata_area();
+	Benchmarks::bench_sdf_compression_filters();
+}
@@ -1,11 +1,88 @@
 #include "tests.h"
+#include "../edition/voxel_tool.h"
+#include "../edition/voxel_tool_lod_terrain.h"
 #include "../generators/graph/voxel_generator_graph.h"
+#include "../generators/simple/voxel_generator_flat.h"
+#include "../server/voxel_server.h"
 #include "../storage/voxel_data_map.h"
+#include "../streams/file_utils.h"
+#include "../streams/log/log_segment.h"
+#include "../streams/log/voxel_stream_log.h"
+#include "../streams/voxel_block_presence_index.h"
+#include "../streams/region/region_file.h"
+#include "../streams/region/voxel_stream_region_files.h"
+#include "../streams/voxel_block_serializer.h"
+#include "../streams/voxel_stream_cache.h"
+#include "../terrain/pending_unloads.h"
+#include "../terrain/voxel_lod_terrain.h"
 #include "../util/island_finder.h"
 #include "../util/math/box3i.h"
+#include "../util/math/morton.h"
+#include "../util/vector3i_index_map.h"
 
 #include <core/hash_map.h>
+#include <core/os/dir_access.h>
+#include <core/os/file_access.h>
+#include <core/os/os.h>
+#include <core/os/semaphore.h>
 #include <core/print_string.h>
+#include <algorithm>
+
+void remove_test_directory(const String &dir_path) {
+	DirAccessRef da = DirAccess::open(dir_path);
+	if (!da) {
+		return;
+	}
+	// Not removing while listing
+	std::vector<String> file_names;
+	std::vector<String> dir_names;
+	da->list_dir_begin();
+	while (true) {
+		const String name = da->get_next();
+		if (name == "") {
+			break;
+		}
+		if (name == "." || name == "..") {
+			continue;
+		}
+		if (da->current_is_dir()) {
+			dir_names.push_back(name);
+		} else {
+			file_names.push_back(name);
+		}
+	}
+	da->list_dir_end();
+	for (unsigned int i = 0; i < dir_names.size(); ++i) {
+		remove_test_directory(dir_path.plus_file(dir_names[i]));
+	}
+	for (unsigned int i = 0; i < file_names.size(); ++i) {
+		da->remove(dir_path.plus_file(file_names[i]));
+	}
+	da->remove(dir_path);
+}
+
+// Gets an empty directory tests can write files into
+String create_test_directory(const String &name) {
+	const String dir_path = OS::get_singleton()->get_user_data_dir().plus_file("voxel_tests").plus_file(name);
+	remove_test_directory(dir_path);
+	ERR_FAIL_COND_V(check_directory_created(dir_path) != OK, String());
+	return dir_path;
+}
+
+// Fills a block with values LZ4 can't compress much, so it takes more sectors than uniform blocks
+void fill_block_with_noise(VoxelBuffer &voxels, uint32_t seed) {
+	uint32_t x = seed;
+	const Vector3i size = voxels.get_size();
+	Vector3i pos;
+	for (pos.z = 0; pos.z < size.z; ++pos.z) {
+		for (pos.x = 0; pos.x < size.x; ++pos.x) {
+			for (pos.y = 0; pos.y < size.y; ++pos.y) {
+				x = x * 1664525u + 1013904223u;
+				voxels.set_voxel(x >> 24, pos, VoxelBuffer::CHANNEL_TYPE);
+			}
+		}
+	}
+}
 
 void test_box3i_for_inner_outline() {
 	const Box3i box(-1, 2, 3, 8, 6, 5);
@@ -197,6 +274,1277 @@ void test_voxel_data_map_copy() {
 	ERR_FAIL_COND(!buffer->equals(**buffer2));
 }
 
+void test_voxel_buffer_copy_on_write() {
+	static const int channel = VoxelBuffer::CHANNEL_TYPE;
+
+	Ref<VoxelBuffer> buffer;
+	buffer.instance();
+	buffer->create(Vector3i(16, 16, 16));
+	buffer->set_voxel(1, Vector3i(4, 5, 6), channel);
+
+	Ref<VoxelBuffer> copy = buffer->duplicate(false);
+
+	// The copy must share memory with the original
+	Span<uint8_t> raw0;
+	Span<uint8_t> raw1;
+	ERR_FAIL_COND(!buffer->get_channel_raw(channel, raw0));
+	ERR_FAIL_COND(!copy->get_channel_raw(channel, raw1));
+	ERR_FAIL_COND(raw0.data() != raw1.data());
+
+	// Modifying the original must not affect the copy
+	buffer->set_voxel(2, Vector3i(4, 5, 6), channel);
+	ERR_FAIL_COND(buffer->get_voxel(Vector3i(4, 5, 6), channel) != 2);
+	ERR_FAIL_COND(copy->get_voxel(Vector3i(4, 5, 6), channel) != 1);
+	ERR_FAIL_COND(!buffer->get_channel_raw(channel, raw0));
+	ERR_FAIL_COND(raw0.data() == raw1.data());
+
+	// Releasing the original must leave the copy intact
+	buffer.unref();
+	ERR_FAIL_COND(copy->get_voxel(Vector3i(4, 5, 6), channel) != 1);
+}
+
+void test_voxel_buffer_downscale() {
+	static const int sdf_channel = VoxelBuffer::CHANNEL_SDF;
+	static const int type_channel = VoxelBuffer::CHANNEL_TYPE;
+
+	Ref<VoxelBuffer> src;
+	src.instance();
+	src->create(Vector3i(4, 4, 4));
+	src->set_channel_depth(sdf_channel, VoxelBuffer::DEPTH_8_BIT);
+	src->fill(100, sdf_channel);
+	src->fill(1, type_channel);
+
+	// Make the first cell non-uniform
+	src->set_voxel(20, Vector3i(1, 1, 1), sdf_channel);
+	src->set_voxel(60, Vector3i(0, 1, 0), sdf_channel);
+	src->set_voxel(2, Vector3i(1, 0, 0), type_channel);
+	src->set_voxel(2, Vector3i(0, 1, 0), type_channel);
+	src->set_voxel(3, Vector3i(0, 0, 1), type_channel);
+
+	Ref<VoxelBuffer> dst;
+	dst.instance();
+	dst->create(Vector3i(2, 2, 2));
+	dst->set_channel_depth(sdf_channel, VoxelBuffer::DEPTH_8_BIT);
+
+	src->downscale_to(**dst, Vector3i(), src->get_size(), Vector3i(), VoxelBuffer::DOWNSCALE_NEAREST);
+	ERR_FAIL_COND(dst->get_voxel(Vector3i(0, 0, 0), sdf_channel) != 100);
+	ERR_FAIL_COND(dst->get_voxel(Vector3i(1, 1, 1), sdf_channel) != 100);
+	// Types use majority regardless of the SDF filter
+	ERR_FAIL_COND(dst->get_voxel(Vector3i(0, 0, 0), type_channel) != 1);
+
+	src->downscale_to(**dst, Vector3i(), src->get_size(), Vector3i(), VoxelBuffer::DOWNSCALE_MIN);
+	ERR_FAIL_COND(dst->get_voxel(Vector3i(0, 0, 0), sdf_channel) != 20);
+	ERR_FAIL_COND(dst->get_voxel(Vector3i(1, 0, 0), sdf_channel) != 100);
+
+	src->downscale_to(**dst, Vector3i(), src->get_size(), Vector3i(), VoxelBuffer::DOWNSCALE_AVERAGE);
+	// (6 * 100 + 20 + 60) / 8 = 85
+	ERR_FAIL_COND(dst->get_voxel(Vector3i(0, 0, 0), sdf_channel) != 85);
+
+	// Downscaling into an offset region must not go out of bounds
+	src->downscale_to(**dst, Vector3i(), src->get_size(), Vector3i(1, 1, 1), VoxelBuffer::DOWNSCALE_MIN);
+	ERR_FAIL_COND(dst->get_voxel(Vector3i(1, 1, 1), sdf_channel) != 20);
+}
+
+void test_voxel_buffer_morton_copy() {
+	static const int channel = VoxelBuffer::CHANNEL_SDF;
+	const Vector3i size(16, 16, 16);
+
+	Ref<VoxelBuffer> buffer;
+	buffer.instance();
+	buffer->create(size);
+	buffer->set_channel_depth(channel, VoxelBuffer::DEPTH_16_BIT);
+	Box3i(Vector3i(), size).for_each_cell_zxy([&buffer](Vector3i pos) {
+		buffer->set_voxel(pos.x + 3 * pos.y + 7 * pos.z, pos, channel);
+	});
+
+	std::vector<uint16_t> values;
+	values.resize(size.volume());
+	Span<uint8_t> bytes = Span<uint16_t>(values.data(), values.size()).reinterpret_cast_to<uint8_t>();
+	buffer->copy_channel_to_morton(channel, bytes);
+	ERR_FAIL_COND(values[morton3d_encode(5, 6, 7)] != 5 + 3 * 6 + 7 * 7);
+	ERR_FAIL_COND(values[morton3d_encode(15, 0, 9)] != 15 + 7 * 9);
+
+	// Reading back gives the same voxels
+	Ref<VoxelBuffer> buffer2;
+	buffer2.instance();
+	buffer2->create(size);
+	buffer2->set_channel_depth(channel, VoxelBuffer::DEPTH_16_BIT);
+	buffer2->copy_channel_from_morton(channel, Span<const uint8_t>(bytes.data(), bytes.size()));
+	ERR_FAIL_COND(!buffer2->equals(**buffer));
+
+	// Uniform channels are expanded
+	buffer->clear_channel(channel, 42);
+	buffer->copy_channel_to_morton(channel, bytes);
+	ERR_FAIL_COND(values[morton3d_encode(1, 2, 3)] != 42);
+
+	ERR_FAIL_COND(VoxelBuffer::is_morton_size_supported(Vector3i(18, 18, 18)));
+	ERR_FAIL_COND(VoxelBuffer::is_morton_size_supported(Vector3i(16, 16, 32)));
+}
+
+void test_voxel_buffer_metadata() {
+	Ref<VoxelBuffer> buffer;
+	buffer.instance();
+	buffer->create(Vector3i(16, 16, 16));
+
+	// Insert out of order, the map must stay sorted
+	buffer->set_voxel_metadata(Vector3i(5, 5, 5), 1);
+	buffer->set_voxel_metadata(Vector3i(1, 2, 3), 2);
+	buffer->set_voxel_metadata(Vector3i(10, 0, 0), 3);
+	buffer->set_voxel_metadata(Vector3i(6, 5, 5), 4);
+	buffer->set_voxel_metadata(Vector3i(1, 2, 3), 5);
+	buffer->set_block_metadata("block");
+
+	ERR_FAIL_COND(buffer->get_voxel_metadata().size() != 4);
+	ERR_FAIL_COND(buffer->get_voxel_metadata(Vector3i(1, 2, 3)) != Variant(5));
+	ERR_FAIL_COND(buffer->get_voxel_metadata(Vector3i(2, 2, 3)) != Variant());
+
+	int count = 0;
+	buffer->for_each_voxel_metadata_in_area(Box3i(Vector3i(4, 4, 4), Vector3i(3, 3, 3)),
+			[&count](Vector3i pos, const Variant &meta) {
+				ERR_FAIL_COND(pos != Vector3i(5, 5, 5) && pos != Vector3i(6, 5, 5));
+				++count;
+			});
+	ERR_FAIL_COND(count != 2);
+
+	// Boxes going outside of the buffer must not break range queries
+	count = 0;
+	buffer->for_each_voxel_metadata_in_area(Box3i(Vector3i(-4, -4, -4), Vector3i(8, 8, 8)),
+			[&count](Vector3i pos, const Variant &meta) { ++count; });
+	ERR_FAIL_COND(count != 1);
+
+	// Serialization round-trip
+	VoxelBlockSerializerInternal serializer;
+	VoxelBlockSerializerInternal::SerializeResult result = serializer.serialize(**buffer);
+	ERR_FAIL_COND(!result.success);
+	const std::vector<uint8_t> data = result.data;
+	Ref<VoxelBuffer> buffer2;
+	buffer2.instance();
+	ERR_FAIL_COND(!serializer.deserialize(data, **buffer2));
+	ERR_FAIL_COND(buffer2->get_voxel_metadata().size() != 4);
+	ERR_FAIL_COND(buffer2->get_voxel_metadata(Vector3i(1, 2, 3)) != Variant(5));
+	ERR_FAIL_COND(buffer2->get_voxel_metadata(Vector3i(10, 0, 0)) != Variant(3));
+	ERR_FAIL_COND(buffer2->get_block_metadata() != Variant("block"));
+
+	buffer->clear_voxel_metadata_in_area(Box3i(Vector3i(0, 0, 0), Vector3i(6, 6, 6)));
+	ERR_FAIL_COND(buffer->get_voxel_metadata().size() != 2);
+	ERR_FAIL_COND(buffer->get_voxel_metadata(Vector3i(6, 5, 5)) != Variant(4));
+
+	// Copying within the same buffer, with overlapping source and destination
+	buffer->set_voxel_metadata(Vector3i(8, 5, 5), 6);
+	buffer->copy_voxel_metadata_in_area(buffer, Box3i(Vector3i(6, 5, 5), Vector3i(4, 1, 1)), Vector3i(7, 5, 5));
+	ERR_FAIL_COND(buffer->get_voxel_metadata().size() != 5);
+	ERR_FAIL_COND(buffer->get_voxel_metadata(Vector3i(6, 5, 5)) != Variant(4));
+	ERR_FAIL_COND(buffer->get_voxel_metadata(Vector3i(7, 5, 5)) != Variant(4));
+	ERR_FAIL_COND(buffer->get_voxel_metadata(Vector3i(8, 5, 5)) != Variant(6));
+	ERR_FAIL_COND(buffer->get_voxel_metadata(Vector3i(9, 5, 5)) != Variant(6));
+}
+
+void test_voxel_buffer_sparse() {
+	// Not a multiple of the brick size, so edge bricks are partially outside
+	const Vector3i size(20, 32, 16);
+	Ref<VoxelBuffer> buffer;
+	buffer.instance();
+	buffer->set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_32_BIT);
+	buffer->create(size);
+
+	buffer->set_voxel(3, Vector3i(1, 2, 3), VoxelBuffer::CHANNEL_TYPE);
+	buffer->set_voxel(4, Vector3i(19, 31, 15), VoxelBuffer::CHANNEL_TYPE);
+	// Flat ground at y=8.5
+	Box3i(Vector3i(), size).for_each_cell_zxy([&buffer](Vector3i pos) {
+		buffer->set_voxel_f(pos.y - 8.5f, pos.x, pos.y, pos.z, VoxelBuffer::CHANNEL_SDF);
+	});
+
+	Ref<VoxelBuffer> reference = buffer->duplicate(false);
+
+	// Lossless
+	buffer->compress_sparse_channel(VoxelBuffer::CHANNEL_TYPE);
+	ERR_FAIL_COND(buffer->get_channel_compression(VoxelBuffer::CHANNEL_TYPE) != VoxelBuffer::COMPRESSION_SPARSE);
+	ERR_FAIL_COND(buffer->get_channel_sparse(VoxelBuffer::CHANNEL_TYPE)->get_dense_brick_count() != 2);
+	ERR_FAIL_COND(buffer->get_voxel(Vector3i(1, 2, 3), VoxelBuffer::CHANNEL_TYPE) != 3);
+	ERR_FAIL_COND(buffer->get_voxel(Vector3i(19, 31, 15), VoxelBuffer::CHANNEL_TYPE) != 4);
+	ERR_FAIL_COND(buffer->get_voxel(Vector3i(10, 10, 10), VoxelBuffer::CHANNEL_TYPE) != 0);
+	ERR_FAIL_COND(!buffer->equals(**reference));
+
+	// Copying a region overlapping several bricks, and clipped by the source
+	Ref<VoxelBuffer> dst;
+	dst.instance();
+	dst->create(Vector3i(8, 8, 8));
+	dst->copy_from(**buffer, Vector3i(14, 26, 10), Vector3i(22, 34, 18), Vector3i(), VoxelBuffer::CHANNEL_TYPE);
+	ERR_FAIL_COND(dst->get_voxel(Vector3i(5, 5, 5), VoxelBuffer::CHANNEL_TYPE) != 4);
+	ERR_FAIL_COND(dst->get_voxel(Vector3i(4, 5, 5), VoxelBuffer::CHANNEL_TYPE) != 0);
+
+	// Serialization round-trip keeps sparse storage
+	VoxelBlockSerializerInternal serializer;
+	VoxelBlockSerializerInternal::SerializeResult result = serializer.serialize(**buffer);
+	ERR_FAIL_COND(!result.success);
+	const std::vector<uint8_t> data = result.data;
+	Ref<VoxelBuffer> buffer2;
+	buffer2.instance();
+	ERR_FAIL_COND(!serializer.deserialize(data, **buffer2));
+	ERR_FAIL_COND(buffer2->get_channel_compression(VoxelBuffer::CHANNEL_TYPE) != VoxelBuffer::COMPRESSION_SPARSE);
+	ERR_FAIL_COND(!buffer2->equals(**reference));
+
+	// Writing decompresses
+	buffer->set_voxel(5, Vector3i(0, 0, 0), VoxelBuffer::CHANNEL_TYPE);
+	ERR_FAIL_COND(buffer->get_channel_compression(VoxelBuffer::CHANNEL_TYPE) != VoxelBuffer::COMPRESSION_NONE);
+	ERR_FAIL_COND(buffer->get_voxel(Vector3i(0, 0, 0), VoxelBuffer::CHANNEL_TYPE) != 5);
+	ERR_FAIL_COND(buffer->get_voxel(Vector3i(1, 2, 3), VoxelBuffer::CHANNEL_TYPE) != 3);
+
+	// Narrow band: only the layer of bricks crossing the surface remains dense
+	buffer->compress_sparse_channel(VoxelBuffer::CHANNEL_SDF, 1.f);
+	ERR_FAIL_COND(buffer->get_channel_compression(VoxelBuffer::CHANNEL_SDF) != VoxelBuffer::COMPRESSION_SPARSE);
+	ERR_FAIL_COND(buffer->get_channel_sparse(VoxelBuffer::CHANNEL_SDF)->get_dense_brick_count() != 6);
+	ERR_FAIL_COND(buffer->get_voxel_f(0, 0, 0, VoxelBuffer::CHANNEL_SDF) != -1.f);
+	ERR_FAIL_COND(buffer->get_voxel_f(0, 12, 0, VoxelBuffer::CHANNEL_SDF) != 3.5f);
+	ERR_FAIL_COND(buffer->get_voxel_f(19, 31, 15, VoxelBuffer::CHANNEL_SDF) != 1.f);
+}
+
+void test_voxel_buffer_sdf_8_bits() {
+	const Vector3i size(16, 16, 16);
+	Ref<VoxelBuffer> buffer;
+	buffer.instance();
+	buffer->create(size);
+	ERR_FAIL_COND(buffer->get_channel_depth(VoxelBuffer::CHANNEL_SDF) != VoxelBuffer::DEPTH_16_BIT);
+	const float sdf_scale = VoxelBuffer::get_sdf_quantization_scale(VoxelBuffer::DEPTH_16_BIT);
+
+	// Slope crossing the block
+	Box3i(Vector3i(), size).for_each_cell_zxy([&buffer, sdf_scale](Vector3i pos) {
+		buffer->set_voxel_f((pos.y - 8.5f + 0.2f * pos.x) * sdf_scale, pos.x, pos.y, pos.z, VoxelBuffer::CHANNEL_SDF);
+	});
+	Ref<VoxelBuffer> reference = buffer->duplicate(false);
+
+	buffer->compress_sdf_to_8_bits();
+	ERR_FAIL_COND(buffer->get_channel_compression(VoxelBuffer::CHANNEL_SDF) != VoxelBuffer::COMPRESSION_SDF_8_BITS);
+	ERR_FAIL_COND(buffer->get_channel_depth(VoxelBuffer::CHANNEL_SDF) != VoxelBuffer::DEPTH_16_BIT);
+
+	// Values span 18 voxels, so codes are closer than the 0.08 voxels of fixed 8-bit SDF
+	Box3i(Vector3i(), size).for_each_cell_zxy([&buffer, &reference, sdf_scale](Vector3i pos) {
+		const float expected = reference->get_voxel_f(pos.x, pos.y, pos.z, VoxelBuffer::CHANNEL_SDF) / sdf_scale;
+		const float actual = buffer->get_voxel_f(pos.x, pos.y, pos.z, VoxelBuffer::CHANNEL_SDF) / sdf_scale;
+		ERR_FAIL_COND(Math::abs(actual - expected) > 0.06f);
+		ERR_FAIL_COND((actual < 0.f) != (expected < 0.f));
+	});
+
+	// Serialization round-trip keeps quantized storage
+	VoxelBlockSerializerInternal serializer;
+	VoxelBlockSerializerInternal::SerializeResult result = serializer.serialize(**buffer);
+	ERR_FAIL_COND(!result.success);
+	const std::vector<uint8_t> data = result.data;
+	Ref<VoxelBuffer> buffer2;
+	buffer2.instance();
+	ERR_FAIL_COND(!serializer.deserialize(data, **buffer2));
+	ERR_FAIL_COND(buffer2->get_channel_compression(VoxelBuffer::CHANNEL_SDF) != VoxelBuffer::COMPRESSION_SDF_8_BITS);
+	ERR_FAIL_COND(!buffer2->equals(**buffer));
+
+	// Copying a region decodes values
+	Ref<VoxelBuffer> dst;
+	dst.instance();
+	dst->create(Vector3i(8, 8, 8));
+	dst->copy_from(**buffer, Vector3i(4, 4, 4), Vector3i(12, 12, 12), Vector3i(), VoxelBuffer::CHANNEL_SDF);
+	ERR_FAIL_COND(dst->get_voxel(Vector3i(1, 2, 3), VoxelBuffer::CHANNEL_SDF) !=
+				  buffer->get_voxel(Vector3i(5, 6, 7), VoxelBuffer::CHANNEL_SDF));
+
+	// Writing decompresses
+	const uint64_t v = buffer->get_voxel(Vector3i(3, 3, 3), VoxelBuffer::CHANNEL_SDF);
+	buffer->set_voxel(0, Vector3i(0, 0, 0), VoxelBuffer::CHANNEL_SDF);
+	ERR_FAIL_COND(buffer->get_channel_compression(VoxelBuffer::CHANNEL_SDF) != VoxelBuffer::COMPRESSION_NONE);
+	ERR_FAIL_COND(buffer->get_voxel(Vector3i(0, 0, 0), VoxelBuffer::CHANNEL_SDF) != 0);
+	ERR_FAIL_COND(buffer->get_voxel(Vector3i(3, 3, 3), VoxelBuffer::CHANNEL_SDF) != v);
+
+	// Distances beyond what 8-bit SDF can represent saturate, leaving a uniform channel
+	buffer->fill_f(100.f * sdf_scale, VoxelBuffer::CHANNEL_SDF);
+	buffer->set_voxel_f(50.f * sdf_scale, 0, 0, 0, VoxelBuffer::CHANNEL_SDF);
+	buffer->compress_sdf_to_8_bits();
+	ERR_FAIL_COND(buffer->get_channel_compression(VoxelBuffer::CHANNEL_SDF) != VoxelBuffer::COMPRESSION_UNIFORM);
+}
+
+void test_voxel_buffer_channel_raw_area() {
+	Ref<VoxelBuffer> buffer;
+	buffer.instance();
+	buffer->create(Vector3i(8, 8, 8));
+	Box3i(Vector3i(), buffer->get_size()).for_each_cell_zxy([&buffer](Vector3i pos) {
+		buffer->set_voxel(pos.x + 10 * pos.y + 100 * pos.z, pos, VoxelBuffer::CHANNEL_TYPE);
+	});
+
+	const Box3i box(Vector3i(1, 2, 3), Vector3i(3, 4, 5));
+	std::vector<uint16_t> values;
+	values.resize(box.size.volume());
+	buffer->copy_channel_area_to_raw(VoxelBuffer::CHANNEL_TYPE, box,
+			Span<uint16_t>(values.data(), values.size()).reinterpret_cast_to<uint8_t>());
+	box.for_each_cell_zxy([&values, &box](Vector3i pos) {
+		const uint16_t v = values[(pos - box.pos).get_zxy_index(box.size)];
+		ERR_FAIL_COND(v != pos.x + 10 * pos.y + 100 * pos.z);
+	});
+
+	// Writing back into another buffer puts values at the same place
+	Ref<VoxelBuffer> buffer2;
+	buffer2.instance();
+	buffer2->create(buffer->get_size());
+	buffer2->copy_channel_area_from_raw(VoxelBuffer::CHANNEL_TYPE, box,
+			Span<uint16_t>(values.data(), values.size()).reinterpret_cast_to<const uint8_t>());
+	ERR_FAIL_COND(buffer2->get_voxel(Vector3i(2, 3, 4), VoxelBuffer::CHANNEL_TYPE) != 432);
+	ERR_FAIL_COND(buffer2->get_voxel(Vector3i(0, 0, 0), VoxelBuffer::CHANNEL_TYPE) != 0);
+
+	// Whole channels of uniform buffers are filled with their value
+	buffer2->clear_channel(VoxelBuffer::CHANNEL_TYPE, 7);
+	const Box3i whole(Vector3i(), buffer2->get_size());
+	values.resize(whole.size.volume());
+	buffer2->copy_channel_area_to_raw(VoxelBuffer::CHANNEL_TYPE, whole,
+			Span<uint16_t>(values.data(), values.size()).reinterpret_cast_to<uint8_t>());
+	for (size_t i = 0; i < values.size(); ++i) {
+		ERR_FAIL_COND(values[i] != 7);
+	}
+}
+
+void test_block_serializer_filters() {
+	// Not a multiple of anything in particular, so columns don't align with other sizes
+	const Vector3i size(6, 13, 5);
+
+	Ref<VoxelBuffer> buffer;
+	buffer.instance();
+	buffer->create(size);
+	buffer->set_channel_depth(VoxelBuffer::CHANNEL_SDF, VoxelBuffer::DEPTH_16_BIT);
+	buffer->set_channel_depth(VoxelBuffer::CHANNEL_WEIGHTS, VoxelBuffer::DEPTH_16_BIT);
+	buffer->set_channel_depth(VoxelBuffer::CHANNEL_DATA5, VoxelBuffer::DEPTH_64_BIT);
+	Box3i(Vector3i(), size).for_each_cell_zxy([&buffer](Vector3i pos) {
+		// Negative values wrap around with deltas
+		buffer->set_voxel_f(0.05f * (pos.y - 6) + 0.01f * pos.x, pos.x, pos.y, pos.z, VoxelBuffer::CHANNEL_SDF);
+		buffer->set_voxel(0x1234 + pos.x * 7 + pos.z, pos, VoxelBuffer::CHANNEL_WEIGHTS);
+		buffer->set_voxel((uint64_t(pos.z) << 40) | (pos.y * 3), pos.x, pos.y, pos.z, VoxelBuffer::CHANNEL_DATA5);
+	});
+
+	VoxelBlockSerializerInternal serializer;
+	VoxelBlockSerializerInternal::SerializeResult result = serializer.serialize_and_compress(**buffer);
+	ERR_FAIL_COND(!result.success);
+	const std::vector<uint8_t> data = result.data;
+
+	Ref<VoxelBuffer> buffer2;
+	buffer2.instance();
+	ERR_FAIL_COND(!serializer.decompress_and_deserialize(data, **buffer2));
+	ERR_FAIL_COND(buffer2->get_size() != size);
+	ERR_FAIL_COND(buffer2->get_channel_compression(VoxelBuffer::CHANNEL_SDF) != VoxelBuffer::COMPRESSION_NONE);
+	ERR_FAIL_COND(!buffer->equals(**buffer2));
+
+	// Unknown filters are rejected, rather than only reverting known ones
+	Ref<VoxelBuffer> type_buffer;
+	type_buffer.instance();
+	type_buffer->create(size);
+	type_buffer->set_channel_depth(VoxelBuffer::CHANNEL_TYPE, VoxelBuffer::DEPTH_16_BIT);
+	type_buffer->set_voxel(1234, 1, 2, 3, VoxelBuffer::CHANNEL_TYPE);
+	VoxelBlockSerializerInternal::SerializeResult raw_result = serializer.serialize(**type_buffer);
+	ERR_FAIL_COND(!raw_result.success);
+	std::vector<uint8_t> raw_data = raw_result.data;
+	// Version and size come first, then the format of the type channel, followed by its filters
+	const unsigned int filters_offset = 1 + 3 * sizeof(uint16_t) + 1;
+	ERR_FAIL_COND((raw_data[filters_offset - 1] & 0xf) != 0xf);
+	ERR_FAIL_COND(!serializer.deserialize(raw_data, **buffer2));
+	raw_data[filters_offset] |= 0x80;
+	ERR_FAIL_COND(serializer.deserialize(raw_data, **buffer2));
+}
+
+void test_voxel_data_block_dirty_box() {
+	Ref<VoxelBuffer> buffer;
+	buffer.instance();
+	buffer->create(Vector3i(16, 16, 16));
+	VoxelDataBlock *block = VoxelDataBlock::create(Vector3i(), buffer, 16, 0);
+	ERR_FAIL_COND(block == nullptr);
+
+	ERR_FAIL_COND(block->is_dirty());
+
+	// Rounded to regions of 4 voxels
+	block->mark_dirty_box(Box3i(Vector3i(5, 6, 7), Vector3i(2, 2, 2)));
+	ERR_FAIL_COND(block->get_dirty_box() != Box3i(Vector3i(4, 4, 4), Vector3i(4, 4, 4)));
+
+	block->mark_dirty_box(Box3i(Vector3i(9, 1, 14), Vector3i(1, 1, 1)));
+	ERR_FAIL_COND(block->get_dirty_box() != Box3i::from_min_max(Vector3i(4, 0, 4), Vector3i(12, 8, 16)));
+
+	// Clipped to the block
+	block->clear_dirty();
+	block->mark_dirty_box(Box3i(Vector3i(-3, -3, -3), Vector3i(4, 4, 4)));
+	ERR_FAIL_COND(block->get_dirty_box() != Box3i(Vector3i(), Vector3i(4, 4, 4)));
+
+	block->mark_dirty();
+	ERR_FAIL_COND(block->get_dirty_box() != Box3i(Vector3i(), Vector3i(16, 16, 16)));
+
+	memdelete(block);
+}
+
+void test_lod_terrain_implicit_uniform_blocks() {
+	VoxelLodTerrain *terrain = memnew(VoxelLodTerrain);
+	terrain->set_implicit_uniform_blocks(true);
+	const int bs = terrain->get_data_block_size();
+
+	// Uniform block at LOD2, covering LOD0 blocks from (0,0,0) to (3,3,3)
+	Ref<VoxelBuffer> ancestor_voxels;
+	ancestor_voxels.instance();
+	ancestor_voxels->create(Vector3i(bs));
+	ancestor_voxels->fill_f(0.5f, VoxelBuffer::CHANNEL_SDF);
+	const float ancestor_sdf = ancestor_voxels->get_voxel_f(0, 0, 0, VoxelBuffer::CHANNEL_SDF);
+	VoxelDataBlock *ancestor = terrain->get_data_map(2).set_block_buffer(Vector3i(), ancestor_voxels);
+	ERR_FAIL_COND(ancestor == nullptr);
+
+	// Solid uniform block next to it, covering LOD0 blocks from (4,0,0) to (7,3,3)
+	Ref<VoxelBuffer> solid_voxels;
+	solid_voxels.instance();
+	solid_voxels->create(Vector3i(bs));
+	solid_voxels->fill_f(-0.5f, VoxelBuffer::CHANNEL_SDF);
+	ERR_FAIL_COND(terrain->get_data_map(2).set_block_buffer(Vector3i(1, 0, 0), solid_voxels) == nullptr);
+
+	Ref<VoxelTool> vt = terrain->get_voxel_tool();
+	vt->set_channel(VoxelBuffer::CHANNEL_SDF);
+
+	// Read without the block being loaded
+	const Vector3i edit_pos(bs, bs, bs);
+	ERR_FAIL_COND(terrain->get_data_map(0).has_block(Vector3i(1, 1, 1)));
+	ERR_FAIL_COND(terrain->get_implicit_block_source(Vector3i(1, 1, 1), 0) != ancestor);
+	ERR_FAIL_COND(vt->get_voxel_f(edit_pos) != ancestor_sdf);
+	ERR_FAIL_COND(!vt->is_area_editable(Box3i(edit_pos, Vector3i(1))));
+	// Checking editability must not create blocks
+	ERR_FAIL_COND(terrain->get_data_map(0).has_block(Vector3i(1, 1, 1)));
+
+	// Other ways of reading see implicit blocks too
+	const VoxelToolLodTerrain *lod_vt = Object::cast_to<VoxelToolLodTerrain>(*vt);
+	ERR_FAIL_COND(lod_vt == nullptr);
+	ERR_FAIL_COND(!Math::is_equal_approx(
+			lod_vt->get_voxel_f_interpolated(edit_pos.to_vec3() + Vector3(0.5, 0.5, 0.5)), ancestor_sdf));
+	Ref<VoxelBuffer> copied;
+	copied.instance();
+	copied->create(Vector3i(bs));
+	// Spans the two uniform blocks
+	const Vector3i copy_pos(4 * bs - bs / 2, 0, 0);
+	vt->copy(copy_pos, copied, 1 << VoxelBuffer::CHANNEL_SDF);
+	ERR_FAIL_COND(copied->get_voxel_f(0, 0, 0, VoxelBuffer::CHANNEL_SDF) != ancestor_sdf);
+	ERR_FAIL_COND(copied->get_voxel_f(bs - 1, bs - 1, bs - 1, VoxelBuffer::CHANNEL_SDF) >= 0.f);
+	Ref<VoxelRaycastResult> hit = vt->raycast(edit_pos.to_vec3(), Vector3(1, 0, 0), 4 * bs, 0);
+	ERR_FAIL_COND(hit.is_null());
+	ERR_FAIL_COND(hit->position != Vector3i(4 * bs, bs, bs));
+	ERR_FAIL_COND(terrain->get_data_map(0).get_block_count() != 0);
+
+	// Edit on a block border, so the neighbor remeshed after the edit must be created too
+	vt->set_voxel_f(edit_pos, -0.5f);
+	ERR_FAIL_COND(!terrain->get_data_map(0).has_block(Vector3i(1, 1, 1)));
+	ERR_FAIL_COND(!terrain->get_data_map(0).has_block(Vector3i(0, 0, 0)));
+	ERR_FAIL_COND(!terrain->get_data_map(1).has_block(Vector3i(0, 0, 0)));
+	const VoxelDataBlock *edited_block = terrain->get_data_map(0).get_block(Vector3i(1, 1, 1));
+	ERR_FAIL_COND(!edited_block->is_modified());
+	ERR_FAIL_COND(vt->get_voxel_f(edit_pos) >= 0.f);
+	ERR_FAIL_COND(vt->get_voxel_f(edit_pos + Vector3i(1, 0, 0)) != ancestor_sdf);
+	// Created blocks share voxels with the ancestor until they get modified
+	ERR_FAIL_COND(ancestor_voxels->get_voxel_f(0, 0, 0, VoxelBuffer::CHANNEL_SDF) != ancestor_sdf);
+
+	// Saving clears the modified flag, but children of an edited ancestor must still not be implied
+	ERR_FAIL_COND(terrain->get_implicit_block_source(Vector3i(3, 3, 3), 0) != ancestor);
+	ancestor->set_modified(true);
+	ancestor->set_modified(false);
+	ERR_FAIL_COND(terrain->get_implicit_block_source(Vector3i(3, 3, 3), 0) != nullptr);
+
+	vt.unref();
+	memdelete(terrain);
+}
+
+bool check_region_block(const VoxelRegionFile &region, Vector3i pos, const VoxelBuffer &expected,
+		VoxelBlockSerializerInternal &serializer) {
+	Ref<VoxelBuffer> loaded;
+	loaded.instance();
+	loaded->create(expected.get_size());
+	return region.load_block(pos, loaded, serializer) == OK && loaded->equals(expected);
+}
+
+void test_region_file_sector_reuse_and_compaction() {
+	const String dir_path = create_test_directory("region_file");
+	ERR_FAIL_COND(dir_path.empty());
+	const String fpath = dir_path.plus_file("test.vxr");
+
+	Ref<VoxelBuffer> uniform_block;
+	uniform_block.instance();
+	uniform_block->create(Vector3i(16));
+	uniform_block->clear_channel(VoxelBuffer::CHANNEL_TYPE, 1);
+
+	FixedArray<Ref<VoxelBuffer>, 3> noisy_blocks;
+	for (unsigned int i = 0; i < noisy_blocks.size(); ++i) {
+		noisy_blocks[i].instance();
+		noisy_blocks[i]->create(Vector3i(16));
+		fill_block_with_noise(**noisy_blocks[i], i + 1);
+	}
+
+	VoxelRegionFormat format;
+	format.block_size_po2 = 4;
+	format.region_size = Vector3i(4);
+	for (unsigned int i = 0; i < format.channel_depths.size(); ++i) {
+		format.channel_depths[i] = uniform_block->get_channel_depth(i);
+	}
+	format.sector_size = 512;
+
+	VoxelBlockSerializerInternal serializer;
+	const Vector3i a(0, 0, 0);
+	const Vector3i b(1, 0, 0);
+	const Vector3i c(2, 0, 0);
+	const Vector3i d(3, 0, 0);
+
+	{
+		VoxelRegionFile region;
+		ERR_FAIL_COND(!region.set_format(format));
+		ERR_FAIL_COND(region.open(fpath, true) != OK);
+
+		ERR_FAIL_COND(region.save_block(a, uniform_block, serializer) != OK);
+		ERR_FAIL_COND(region.save_block(b, uniform_block, serializer) != OK);
+		ERR_FAIL_COND(region.save_block(c, uniform_block, serializer) != OK);
+		ERR_FAIL_COND(region.get_sector_count() != 3);
+
+		// Growing moves the block at the end, its previous sector becomes free
+		ERR_FAIL_COND(region.save_block(a, noisy_blocks[0], serializer) != OK);
+		ERR_FAIL_COND(region.get_free_sector_count() != 1);
+		const unsigned int noisy_sector_count = region.get_sector_count() - 3;
+		ERR_FAIL_COND(noisy_sector_count < 3);
+
+		// A new block fits in the free sector
+		ERR_FAIL_COND(region.save_block(d, uniform_block, serializer) != OK);
+		ERR_FAIL_COND(region.get_free_sector_count() != 0);
+		ERR_FAIL_COND(region.get_sector_count() != 3 + noisy_sector_count);
+
+		// The header was saved before the free sector got reused, so the file still points to intact blocks
+		// if the process stops now
+		{
+			VoxelRegionFile saved_region;
+			ERR_FAIL_COND(!saved_region.set_format(format));
+			ERR_FAIL_COND(saved_region.open(fpath, false) != OK);
+			ERR_FAIL_COND(!check_region_block(saved_region, a, **noisy_blocks[0], serializer));
+			ERR_FAIL_COND(!check_region_block(saved_region, b, **uniform_block, serializer));
+			ERR_FAIL_COND(!check_region_block(saved_region, c, **uniform_block, serializer));
+			ERR_FAIL_COND(saved_region.has_block(d));
+		}
+
+		// Leave holes before the last blocks
+		ERR_FAIL_COND(region.save_block(b, noisy_blocks[1], serializer) != OK);
+		ERR_FAIL_COND(region.save_block(c, noisy_blocks[2], serializer) != OK);
+		ERR_FAIL_COND(region.save_block(a, uniform_block, serializer) != OK);
+		const unsigned int sector_count_before = region.get_sector_count();
+		ERR_FAIL_COND(region.get_free_sector_count() == 0);
+
+		ERR_FAIL_COND(region.compact() != OK);
+		ERR_FAIL_COND(region.get_sector_count() >= sector_count_before);
+		ERR_FAIL_COND(region.get_free_sector_count() >= noisy_sector_count);
+
+		ERR_FAIL_COND(!check_region_block(region, a, **uniform_block, serializer));
+		ERR_FAIL_COND(!check_region_block(region, b, **noisy_blocks[1], serializer));
+		ERR_FAIL_COND(!check_region_block(region, c, **noisy_blocks[2], serializer));
+		ERR_FAIL_COND(!check_region_block(region, d, **uniform_block, serializer));
+		ERR_FAIL_COND(region.close() != OK);
+	}
+
+	// The header saved by compaction must match where blocks are
+	{
+		VoxelRegionFile region;
+		ERR_FAIL_COND(!region.set_format(format));
+		ERR_FAIL_COND(region.open(fpath, false) != OK);
+		ERR_FAIL_COND(!check_region_block(region, a, **uniform_block, serializer));
+		ERR_FAIL_COND(!check_region_block(region, b, **noisy_blocks[1], serializer));
+		ERR_FAIL_COND(!check_region_block(region, c, **noisy_blocks[2], serializer));
+		ERR_FAIL_COND(!check_region_block(region, d, **uniform_block, serializer));
+		ERR_FAIL_COND(region.close() != OK);
+	}
+
+	remove_test_directory(dir_path);
+}
+
+void test_region_files_batched_load_order() {
+	const String dir_path = create_test_directory("region_files_batch");
+	ERR_FAIL_COND(dir_path.empty());
+
+	Ref<VoxelStreamRegionFiles> stream;
+	stream.instance();
+	stream->set_directory(dir_path);
+	const int bs = 1 << stream->get_block_size_po2();
+	const int region_size = stream->get_region_size().x;
+
+	// Two regions with two blocks each, saved in a different order than they will be requested
+	const Vector3i block_positions[] = {
+		Vector3i(1, 0, 0),
+		Vector3i(0, 0, 0),
+		Vector3i(region_size + 1, 0, 0),
+		Vector3i(region_size, 0, 0),
+	};
+	const unsigned int block_count = sizeof(block_positions) / sizeof(block_positions[0]);
+	std::vector<Ref<VoxelBuffer>> saved_blocks;
+	for (unsigned int i = 0; i < block_count; ++i) {
+		Ref<VoxelBuffer> voxels;
+		voxels.instance();
+		voxels->create(Vector3i(bs));
+		fill_block_with_noise(**voxels, i + 1);
+		stream->immerge_block(voxels, block_positions[i] * bs, 0);
+		saved_blocks.push_back(voxels);
+	}
+
+	// Interleaving regions, in reverse storage order within each region, with a missing block in between
+	const int request_order[] = { 3, 1, -1, 2, 0 };
+	const unsigned int request_count = sizeof(request_order) / sizeof(request_order[0]);
+	Vector<VoxelBlockRequest> requests;
+	for (unsigned int i = 0; i < request_count; ++i) {
+		VoxelBlockRequest r;
+		r.voxel_buffer.instance();
+		r.voxel_buffer->create(Vector3i(bs));
+		r.origin_in_voxels = request_order[i] == -1 ? Vector3i(2, 0, 0) * bs : block_positions[request_order[i]] * bs;
+		r.lod = 0;
+		requests.push_back(r);
+	}
+
+	Vector<VoxelStream::Result> results;
+	stream->emerge_blocks(requests, results);
+	ERR_FAIL_COND(results.size() != static_cast<int>(request_count));
+
+	for (unsigned int i = 0; i < request_count; ++i) {
+		const int block_index = request_order[i];
+		if (block_index == -1) {
+			ERR_FAIL_COND(results[i] != VoxelStream::RESULT_BLOCK_NOT_FOUND);
+		} else {
+			ERR_FAIL_COND(results[i] != VoxelStream::RESULT_BLOCK_FOUND);
+			ERR_FAIL_COND(!requests[i].voxel_buffer->equals(**saved_blocks[block_index]));
+		}
+	}
+
+	// Files are closed when the stream is destroyed
+	stream.unref();
+	remove_test_directory(dir_path);
+}
+
+void test_stream_cache_load_during_flush() {
+	VoxelStreamCache cache;
+
+	Ref<VoxelBuffer> saved_block;
+	saved_block.instance();
+	saved_block->create(Vector3i(8));
+	fill_block_with_noise(**saved_block, 1);
+
+	const Vector3i saved_pos(1, 2, 3);
+	const Vector3i erased_pos(4, 5, 6);
+	const Vector3i resaved_pos(-1, 0, 0);
+
+	cache.save_voxel_block(saved_pos, 0, saved_block);
+	cache.save_voxel_block(resaved_pos, 0, saved_block);
+	// Erased blocks are cached as null
+	cache.save_voxel_block(erased_pos, 0, Ref<VoxelBuffer>());
+	cache.save_instance_block(erased_pos, 0, nullptr);
+
+	Ref<VoxelBuffer> newer_block;
+	newer_block.instance();
+	newer_block->create(Vector3i(8));
+	fill_block_with_noise(**newer_block, 2);
+
+	bool flushed = false;
+	cache.flush([&cache, &flushed, saved_block, newer_block, saved_pos, erased_pos, resaved_pos](
+						Span<VoxelStreamCache::Block *> blocks) {
+		ERR_FAIL_COND(blocks.size() != 3);
+		ERR_FAIL_COND(cache.get_indicative_block_count() != 0);
+
+		// Blocks being flushed can still be loaded
+		Ref<VoxelBuffer> loaded;
+		loaded.instance();
+		ERR_FAIL_COND(cache.load_voxel_block(saved_pos, 0, loaded) != VoxelStreamCache::FOUND);
+		ERR_FAIL_COND(!loaded->equals(**saved_block));
+
+		// Erased blocks must not be read from the stream while they are being flushed
+		Ref<VoxelBuffer> erased;
+		erased.instance();
+		ERR_FAIL_COND(cache.load_voxel_block(erased_pos, 0, erased) != VoxelStreamCache::ERASED);
+		std::unique_ptr<VoxelInstanceBlockData> instances;
+		ERR_FAIL_COND(cache.load_instance_block(erased_pos, 0, instances) != VoxelStreamCache::ERASED);
+		ERR_FAIL_COND(instances != nullptr);
+
+		// Saves made during the flush take precedence, and are kept for the next one
+		cache.save_voxel_block(resaved_pos, 0, newer_block);
+		ERR_FAIL_COND(cache.load_voxel_block(resaved_pos, 0, loaded) != VoxelStreamCache::FOUND);
+		ERR_FAIL_COND(!loaded->equals(**newer_block));
+		ERR_FAIL_COND(cache.get_indicative_block_count() != 1);
+
+		flushed = true;
+	});
+	ERR_FAIL_COND(!flushed);
+
+	Ref<VoxelBuffer> loaded;
+	loaded.instance();
+	ERR_FAIL_COND(cache.load_voxel_block(saved_pos, 0, loaded) != VoxelStreamCache::NOT_CACHED);
+	ERR_FAIL_COND(cache.load_voxel_block(erased_pos, 0, loaded) != VoxelStreamCache::NOT_CACHED);
+	ERR_FAIL_COND(cache.load_voxel_block(resaved_pos, 0, loaded) != VoxelStreamCache::FOUND);
+	ERR_FAIL_COND(!loaded->equals(**newer_block));
+}
+
+// Stream still having an old version of blocks until it gets told they were erased.
+// Loading the gate block keeps the streaming thread busy until the gate is opened, so requests can be queued meanwhile.
+class TestStaleStream : public VoxelStream {
+public:
+	Ref<VoxelBuffer> stale_block;
+	Vector3i gate_origin;
+	Semaphore gate_entered;
+	Semaphore gate;
+	bool erased = false;
+
+	Result emerge_block(Ref<VoxelBuffer> out_buffer, Vector3i origin_in_voxels, int lod) override {
+		if (origin_in_voxels == gate_origin) {
+			gate_entered.post();
+			gate.wait();
+			return RESULT_BLOCK_NOT_FOUND;
+		}
+		if (erased) {
+			return RESULT_BLOCK_NOT_FOUND;
+		}
+		out_buffer->copy_from(**stale_block);
+		return RESULT_BLOCK_FOUND;
+	}
+
+	void immerge_block(Ref<VoxelBuffer> buffer, Vector3i origin_in_voxels, int lod) override {
+		if (buffer.is_null()) {
+			erased = true;
+		}
+	}
+};
+
+void test_server_load_erased_block_while_save_queued() {
+	VoxelServer *server = VoxelServer::get_singleton();
+	ERR_FAIL_COND(server == nullptr);
+
+	const int block_size = 16;
+	const Vector3i gate_pos(-1, -1, -1);
+	const Vector3i erased_pos(0, 0, 0);
+
+	Ref<TestStaleStream> stream;
+	stream.instance();
+	stream->stale_block.instance();
+	stream->stale_block->create(Vector3i(block_size));
+	fill_block_with_noise(**stream->stale_block, 1);
+	stream->gate_origin = gate_pos * block_size;
+
+	Ref<VoxelGeneratorFlat> generator;
+	generator.instance();
+
+	VoxelServer::ReceptionBuffers buffers;
+	const uint32_t volume_id = server->add_volume(&buffers, VoxelServer::VOLUME_SPARSE_GRID);
+	server->set_volume_data_block_size(volume_id, block_size);
+	server->set_volume_generator(volume_id, generator);
+	server->set_volume_stream(volume_id, stream);
+
+	// While the streaming thread is busy, the erase stays in the save queue, and loads go before it
+	server->request_block_load(volume_id, gate_pos, 0, false, false);
+	stream->gate_entered.wait();
+	server->request_voxel_block_save(volume_id, Ref<VoxelBuffer>(), erased_pos, 0);
+	server->request_block_load(volume_id, erased_pos, 0, false, false);
+	stream->gate.post();
+
+	Ref<VoxelBuffer> loaded;
+	for (unsigned int i = 0; i < 1000 && loaded.is_null(); ++i) {
+		OS::get_singleton()->delay_usec(5000);
+		server->process();
+		for (unsigned int j = 0; j < buffers.data_output.size(); ++j) {
+			const VoxelServer::BlockDataOutput &o = buffers.data_output[j];
+			if (o.position == erased_pos && !o.dropped) {
+				loaded = o.voxels;
+			}
+		}
+		buffers.data_output.clear();
+	}
+	server->remove_volume(volume_id);
+	ERR_FAIL_COND(loaded.is_null());
+
+	// The block must come from the generator, not from the old version the stream still has
+	Ref<VoxelBuffer> expected;
+	expected.instance();
+	expected->create(Vector3i(block_size));
+	VoxelBlockRequest request{ expected, erased_pos * block_size, 0 };
+	generator->generate_block(request);
+	ERR_FAIL_COND(loaded->equals(**stream->stale_block));
+	ERR_FAIL_COND(!loaded->equals(**expected));
+}
+
+void test_unload_expired_blocks_hysteresis() {
+	struct L {
+		static uint64_t get_time(uint64_t time_msec) {
+			return time_msec;
+		}
+	};
+
+	const uint64_t delay_msec = 1000;
+	const int margin = 1;
+	// Viewer standing at the origin, viewing blocks -2..1 on each axis
+	std::vector<Box3i> viewed_boxes;
+	viewed_boxes.push_back(Box3i(Vector3i(-2), Vector3i(4)));
+
+	std::unordered_map<Vector3i, uint64_t> pending;
+	// Just outside of the view, within the margin
+	const Vector3i near_pos(2, 0, 0);
+	// Beyond the margin
+	const Vector3i far_pos(4, 0, 0);
+	pending[near_pos] = 10000;
+	pending[far_pos] = 10000;
+
+	std::vector<Vector3i> unloaded;
+	auto unload_func = [&pending, &unloaded](Vector3i bpos) {
+		pending.erase(bpos);
+		unloaded.push_back(bpos);
+	};
+
+	// Nothing gets unloaded before the delay, even far away
+	unload_expired_blocks(pending, viewed_boxes, 10999, delay_msec, margin, 1024, L::get_time, unload_func);
+	ERR_FAIL_COND(unloaded.size() != 0);
+	ERR_FAIL_COND(pending.size() != 2);
+
+	// After the delay, only blocks beyond the margin get unloaded
+	unload_expired_blocks(pending, viewed_boxes, 11000, delay_msec, margin, 1024, L::get_time, unload_func);
+	ERR_FAIL_COND(unloaded.size() != 1);
+	ERR_FAIL_COND(unloaded[0] != far_pos);
+	ERR_FAIL_COND(pending.size() != 1);
+
+	// Blocks within the margin stay as long as the viewer doesn't move away
+	unloaded.clear();
+	unload_expired_blocks(pending, viewed_boxes, 60000, delay_msec, margin, 1024, L::get_time, unload_func);
+	ERR_FAIL_COND(unloaded.size() != 0);
+
+	// Once the viewer moved away, they get unloaded
+	viewed_boxes[0] = Box3i(Vector3i(-6, -2, -2), Vector3i(4));
+	unload_expired_blocks(pending, viewed_boxes, 60000, delay_msec, margin, 1024, L::get_time, unload_func);
+	ERR_FAIL_COND(unloaded.size() != 1);
+	ERR_FAIL_COND(unloaded[0] != near_pos);
+	ERR_FAIL_COND(pending.size() != 0);
+
+	// Without margin nor delay, blocks leaving the view are unloaded right away
+	unloaded.clear();
+	pending[near_pos] = 70000;
+	unload_expired_blocks(pending, viewed_boxes, 70000, 0, 0, 1024, L::get_time, unload_func);
+	ERR_FAIL_COND(unloaded.size() != 1);
+
+	// When too many blocks are pending, the ones left the longest ago are unloaded first, even if not expired
+	unloaded.clear();
+	for (int i = 0; i < 5; ++i) {
+		pending[Vector3i(10 + i, 0, 0)] = 80000 + i;
+	}
+	unload_expired_blocks(pending, viewed_boxes, 80010, delay_msec, margin, 3, L::get_time, unload_func);
+	ERR_FAIL_COND(unloaded.size() != 2);
+	ERR_FAIL_COND(pending.size() != 3);
+	ERR_FAIL_COND(pending.find(Vector3i(10, 0, 0)) != pending.end());
+	ERR_FAIL_COND(pending.find(Vector3i(11, 0, 0)) != pending.end());
+}
+
+void test_vector3i_index_map() {
+	Vector3iIndexMap map;
+	HashMap<Vector3i, unsigned int, Vector3iHasher> expected;
+
+	// Insert a dense region, like blocks around a viewer, then remove part of it
+	const Box3i box(-10, -5, -10, 20, 10, 20);
+	unsigned int value = 0;
+	box.for_each_cell([&map, &expected, &value](Vector3i pos) {
+		map.set(pos, value);
+		expected.set(pos, value);
+		++value;
+	});
+	const Box3i removed_box(-3, -3, -3, 8, 8, 8);
+	removed_box.for_each_cell([&map, &expected](Vector3i pos) {
+		ERR_FAIL_COND(!map.erase(pos));
+		expected.erase(pos);
+	});
+	ERR_FAIL_COND(map.erase(Vector3i(1000, 0, 0)));
+	ERR_FAIL_COND(map.size() != static_cast<uint32_t>(expected.size()));
+
+	// Check every position, including some outside of the inserted region
+	box.padded(2).for_each_cell([&map, &expected](Vector3i pos) {
+		const unsigned int *expected_value = expected.getptr(pos);
+		const uint32_t *value = map.getptr(pos);
+		ERR_FAIL_COND((expected_value == nullptr) != (value == nullptr));
+		if (value != nullptr) {
+			ERR_FAIL_COND(*value != *expected_value);
+		}
+	});
+}
+
+void test_morton_64() {
+	const uint32_t coords[] = { 0, 1, 2, 1023, 1024, 65535, 65536, 1234567, 0x1fffff };
+	for (uint32_t x : coords) {
+		for (uint32_t y : coords) {
+			for (uint32_t z : coords) {
+				const uint64_t m = morton3d_encode_64(x, y, z);
+				uint32_t dx, dy, dz;
+				morton3d_decode_64(m, dx, dy, dz);
+				ERR_FAIL_COND(dx != x || dy != y || dz != z);
+				// Must match the 32-bit version where it applies
+				if (x < 1024 && y < 1024 && z < 1024) {
+					ERR_FAIL_COND(m != morton3d_encode(x, y, z));
+				}
+			}
+		}
+	}
+	ERR_FAIL_COND(morton3d_encode_64(0x1fffff, 0x1fffff, 0x1fffff) != (uint64_t(1) << 63) - 1);
+}
+
+void test_block_presence_index() {
+	VoxelBlockPresenceIndex index;
+	const Vector3i positions[] = {
+		Vector3i(0, 0, 0),
+		Vector3i(15, 15, 15),
+		Vector3i(16, 0, 0),
+		Vector3i(-1, -1, -1),
+		Vector3i(-17, 5, 300),
+		Vector3i(32767, -32768, 7)
+	};
+	const unsigned int position_count = sizeof(positions) / sizeof(positions[0]);
+
+	for (unsigned int i = 0; i < position_count; ++i) {
+		ERR_FAIL_COND(index.is_present(positions[i], 0));
+		index.set_present(positions[i], 0);
+		// Setting twice is allowed
+		index.set_present(positions[i], 0);
+	}
+
+	for (unsigned int i = 0; i < position_count; ++i) {
+		ERR_FAIL_COND(!index.is_present(positions[i], 0));
+		// LODs are separate
+		ERR_FAIL_COND(index.is_present(positions[i], 1));
+		// Neighbors were not set
+		ERR_FAIL_COND(index.is_present(positions[i] + Vector3i(0, 1, 0), 0));
+	}
+
+	// (0,0,0) and (15,15,15) share a region, (-1,-1,-1) does not
+	ERR_FAIL_COND(index.get_region_count() != position_count - 1);
+
+	index.clear();
+	ERR_FAIL_COND(index.get_region_count() != 0);
+	for (unsigned int i = 0; i < position_count; ++i) {
+		ERR_FAIL_COND(index.is_present(positions[i], 0));
+	}
+}
+
+void test_log_segment_file_name() {
+	const uint32_t ids[] = { 1, 42, 99999999, 0xffffffff };
+	for (unsigned int i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+		const String fname = VoxelLogSegment::get_file_name(ids[i]);
+		uint32_t id = 0;
+		ERR_FAIL_COND(!VoxelLogSegment::parse_file_name(fname, id));
+		ERR_FAIL_COND(id != ids[i]);
+	}
+
+	// Names are padded so segments list in order
+	ERR_FAIL_COND(!(VoxelLogSegment::get_file_name(7) < VoxelLogSegment::get_file_name(12)));
+
+	uint32_t id = 0;
+	ERR_FAIL_COND(VoxelLogSegment::parse_file_name("seg_00000000.vxlog", id));
+	ERR_FAIL_COND(VoxelLogSegment::parse_file_name("seg_4294967296.vxlog", id));
+	ERR_FAIL_COND(VoxelLogSegment::parse_file_name("seg_abc.vxlog", id));
+	ERR_FAIL_COND(VoxelLogSegment::parse_file_name("seg_00000001.vxlog.tmp", id));
+	ERR_FAIL_COND(VoxelLogSegment::parse_file_name("index.vxcheckpoint", id));
+}
+
+Ref<VoxelBuffer> create_noise_block(uint32_t seed) {
+	Ref<VoxelBuffer> voxels;
+	voxels.instance();
+	voxels->create(Vector3i(1 << VoxelConstants::DEFAULT_BLOCK_SIZE_PO2));
+	fill_block_with_noise(**voxels, seed);
+	return voxels;
+}
+
+Ref<VoxelStreamLog> open_test_log_stream(const String &dir_path) {
+	Ref<VoxelStreamLog> stream;
+	stream.instance();
+	stream->set_directory(dir_path);
+	return stream;
+}
+
+void save_log_block(VoxelStreamLog &stream, Vector3i block_pos, Ref<VoxelBuffer> voxels) {
+	stream.immerge_block(voxels, block_pos << stream.get_block_size_po2(), 0);
+}
+
+// Checks the block has the expected voxels, or is not found if `expected` is null
+bool check_log_block(VoxelStreamLog &stream, Vector3i block_pos, Ref<VoxelBuffer> expected) {
+	Ref<VoxelBuffer> loaded;
+	loaded.instance();
+	loaded->create(Vector3i(1 << stream.get_block_size_po2()));
+	const VoxelStream::Result res = stream.emerge_block(loaded, block_pos << stream.get_block_size_po2(), 0);
+	if (expected.is_null()) {
+		return res == VoxelStream::RESULT_BLOCK_NOT_FOUND;
+	}
+	return res == VoxelStream::RESULT_BLOCK_FOUND && loaded->equals(**expected);
+}
+
+std::vector<uint32_t> get_log_segment_ids(const String &dir_path) {
+	std::vector<uint32_t> ids;
+	DirAccessRef da = DirAccess::open(dir_path);
+	ERR_FAIL_COND_V(!da, ids);
+	da->list_dir_begin();
+	String fname = da->get_next();
+	while (fname != "") {
+		uint32_t id;
+		if (!da->current_is_dir() && VoxelLogSegment::parse_file_name(fname, id)) {
+			ids.push_back(id);
+		}
+		fname = da->get_next();
+	}
+	da->list_dir_end();
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+void test_log_stream_save_and_reopen() {
+	const String dir_path = create_test_directory("log_stream_reopen");
+	ERR_FAIL_COND(dir_path.empty());
+
+	const Vector3i kept_pos(1, 2, 3);
+	const Vector3i overwritten_pos(-4, 0, 7);
+	const Vector3i deleted_pos(0, -1, 0);
+	Ref<VoxelBuffer> kept_block = create_noise_block(1);
+	Ref<VoxelBuffer> overwritten_block = create_noise_block(3);
+
+	{
+		Ref<VoxelStreamLog> stream = open_test_log_stream(dir_path);
+		save_log_block(**stream, kept_pos, kept_block);
+		save_log_block(**stream, overwritten_pos, create_noise_block(2));
+		save_log_block(**stream, deleted_pos, create_noise_block(4));
+		save_log_block(**stream, overwritten_pos, overwritten_block);
+		// Deleting saves an empty record
+		save_log_block(**stream, deleted_pos, Ref<VoxelBuffer>());
+
+		ERR_FAIL_COND(!check_log_block(**stream, kept_pos, kept_block));
+		ERR_FAIL_COND(!check_log_block(**stream, overwritten_pos, overwritten_block));
+		ERR_FAIL_COND(!check_log_block(**stream, deleted_pos, Ref<VoxelBuffer>()));
+		ERR_FAIL_COND(stream->may_have_block(deleted_pos << stream->get_block_size_po2(), 0));
+	}
+
+	// Closing wrote a checkpoint
+	ERR_FAIL_COND(!FileAccess::exists(dir_path.plus_file(VoxelStreamLog::CHECKPOINT_FILE_NAME)));
+	{
+		Ref<VoxelStreamLog> stream = open_test_log_stream(dir_path);
+		ERR_FAIL_COND(!check_log_block(**stream, kept_pos, kept_block));
+		ERR_FAIL_COND(!check_log_block(**stream, overwritten_pos, overwritten_block));
+		ERR_FAIL_COND(!check_log_block(**stream, deleted_pos, Ref<VoxelBuffer>()));
+	}
+
+	// Without the checkpoint, the whole log is read, and the deletion still applies
+	DirAccessRef da = DirAccess::open(dir_path);
+	ERR_FAIL_COND(!da);
+	ERR_FAIL_COND(da->remove(dir_path.plus_file(VoxelStreamLog::CHECKPOINT_FILE_NAME)) != OK);
+	{
+		Ref<VoxelStreamLog> stream = open_test_log_stream(dir_path);
+		ERR_FAIL_COND(!check_log_block(**stream, kept_pos, kept_block));
+		ERR_FAIL_COND(!check_log_block(**stream, overwritten_pos, overwritten_block));
+		ERR_FAIL_COND(!check_log_block(**stream, deleted_pos, Ref<VoxelBuffer>()));
+	}
+
+	remove_test_directory(dir_path);
+}
+
+void test_log_stream_replay_after_checkpoint() {
+	const String dir_path = create_test_directory("log_stream_replay");
+	ERR_FAIL_COND(dir_path.empty());
+	const String copy_path = create_test_directory("log_stream_replay_copy");
+	ERR_FAIL_COND(copy_path.empty());
+
+	const Vector3i a(0, 0, 0);
+	const Vector3i b(1, 0, 0);
+	const Vector3i c(2, 0, 0);
+	const Vector3i d(3, 0, 0);
+	Ref<VoxelBuffer> a_block = create_noise_block(1);
+	Ref<VoxelBuffer> b_block = create_noise_block(3);
+	Ref<VoxelBuffer> d_block = create_noise_block(5);
+
+	Ref<VoxelStreamLog> stream = open_test_log_stream(dir_path);
+	save_log_block(**stream, a, a_block);
+	save_log_block(**stream, b, create_noise_block(2));
+	save_log_block(**stream, c, create_noise_block(4));
+	stream->save_checkpoint();
+
+	// Records after the checkpoint
+	save_log_block(**stream, b, b_block);
+	save_log_block(**stream, c, Ref<VoxelBuffer>());
+	save_log_block(**stream, d, d_block);
+
+	// Copy files while the stream is still open, as if it crashed before writing another checkpoint
+	{
+		DirAccessRef da = DirAccess::open(dir_path);
+		ERR_FAIL_COND(!da);
+		ERR_FAIL_COND(da->copy(dir_path.plus_file(VoxelStreamLog::CHECKPOINT_FILE_NAME),
+							  copy_path.plus_file(VoxelStreamLog::CHECKPOINT_FILE_NAME)) != OK);
+		const std::vector<uint32_t> ids = get_log_segment_ids(dir_path);
+		ERR_FAIL_COND(ids.size() != 1);
+		const String segment_name = VoxelLogSegment::get_file_name(ids[0]);
+		ERR_FAIL_COND(da->copy(dir_path.plus_file(segment_name), copy_path.plus_file(segment_name)) != OK);
+	}
+	stream.unref();
+
+	{
+		Ref<VoxelStreamLog> copy_stream = open_test_log_stream(copy_path);
+		ERR_FAIL_COND(!check_log_block(**copy_stream, a, a_block));
+		ERR_FAIL_COND(!check_log_block(**copy_stream, b, b_block));
+		ERR_FAIL_COND(!check_log_block(**copy_stream, c, Ref<VoxelBuffer>()));
+		ERR_FAIL_COND(!check_log_block(**copy_stream, d, d_block));
+	}
+
+	remove_test_directory(copy_path);
+	remove_test_directory(dir_path);
+}
+
+void test_log_stream_torn_tail() {
+	const String dir_path = create_test_directory("log_stream_torn_tail");
+	ERR_FAIL_COND(dir_path.empty());
+
+	const Vector3i a(0, 0, 0);
+	const Vector3i b(0, 1, 0);
+	const Vector3i c(0, 2, 0);
+	Ref<VoxelBuffer> a_block = create_noise_block(1);
+	Ref<VoxelBuffer> b_block = create_noise_block(2);
+	Ref<VoxelBuffer> c_block = create_noise_block(3);
+
+	{
+		Ref<VoxelStreamLog> stream = open_test_log_stream(dir_path);
+		save_log_block(**stream, a, a_block);
+		save_log_block(**stream, b, b_block);
+	}
+
+	// Simulate a crash while writing a record, before a checkpoint was written
+	const std::vector<uint32_t> ids = get_log_segment_ids(dir_path);
+	ERR_FAIL_COND(ids.size() != 1);
+	{
+		DirAccessRef da = DirAccess::open(dir_path);
+		ERR_FAIL_COND(!da);
+		ERR_FAIL_COND(da->remove(dir_path.plus_file(VoxelStreamLog::CHECKPOINT_FILE_NAME)) != OK);
+
+		const String segment_path = dir_path.plus_file(VoxelLogSegment::get_file_name(ids[0]));
+		FileAccessRef f = FileAccess::open(segment_path, FileAccess::READ_WRITE);
+		ERR_FAIL_COND(!f);
+		f->seek_end();
+		for (unsigned int i = 0; i < VoxelLogSegment::RECORD_HEADER_SIZE + 10; ++i) {
+			f->store_8(0xab);
+		}
+	}
+
+	{
+		Ref<VoxelStreamLog> stream = open_test_log_stream(dir_path);
+		ERR_FAIL_COND(!check_log_block(**stream, a, a_block));
+		ERR_FAIL_COND(!check_log_block(**stream, b, b_block));
+
+		// New records can't follow the invalid data, so they go to a new segment
+		save_log_block(**stream, c, c_block);
+		const std::vector<uint32_t> new_ids = get_log_segment_ids(dir_path);
+		ERR_FAIL_COND(new_ids.size() != 2);
+		ERR_FAIL_COND(new_ids[0] != ids[0]);
+		ERR_FAIL_COND(new_ids[1] <= ids[0]);
+		ERR_FAIL_COND(!check_log_block(**stream, c, c_block));
+	}
+
+	{
+		Ref<VoxelStreamLog> stream = open_test_log_stream(dir_path);
+		ERR_FAIL_COND(!check_log_block(**stream, a, a_block));
+		ERR_FAIL_COND(!check_log_block(**stream, b, b_block));
+		ERR_FAIL_COND(!check_log_block(**stream, c, c_block));
+	}
+
+	remove_test_directory(dir_path);
+}
+
+void test_log_stream_compaction() {
+	const String dir_path = create_test_directory("log_stream_compaction");
+	ERR_FAIL_COND(dir_path.empty());
+
+	Ref<VoxelStreamLog> stream = open_test_log_stream(dir_path);
+	stream->set_segment_size(VoxelStreamLog::MIN_SEGMENT_SIZE);
+	// Only segments without live blocks get compacted, so the test decides which ones
+	stream->set_compaction_threshold(1.f);
+
+	const Vector3i deleted_pos(-1, -1, -1);
+	save_log_block(**stream, deleted_pos, create_noise_block(1));
+
+	// Fill the first segment with blocks which stay live
+	std::vector<Vector3i> first_positions;
+	while (get_log_segment_ids(dir_path).size() < 2) {
+		ERR_FAIL_COND(first_positions.size() > 10000);
+		const Vector3i pos(static_cast<int>(first_positions.size()), 0, 0);
+		save_log_block(**stream, pos, create_noise_block(100 + first_positions.size()));
+		first_positions.push_back(pos);
+	}
+	// The last block started the second segment
+	std::vector<Vector3i> second_positions;
+	second_positions.push_back(first_positions.back());
+	first_positions.pop_back();
+
+	// The deletion goes in the second segment, while the deleted block is in the first
+	save_log_block(**stream, deleted_pos, Ref<VoxelBuffer>());
+
+	// Fill the second segment with blocks which will be saved again
+	while (get_log_segment_ids(dir_path).size() < 3) {
+		ERR_FAIL_COND(second_positions.size() > 10000);
+		const Vector3i pos(static_cast<int>(second_positions.size()), 1, 0);
+		save_log_block(**stream, pos, create_noise_block(10000 + second_positions.size()));
+		second_positions.push_back(pos);
+	}
+	const std::vector<uint32_t> ids = get_log_segment_ids(dir_path);
+
+	// Only the deletion is left in the second segment
+	std::vector<Ref<VoxelBuffer>> latest_blocks;
+	for (size_t i = 0; i < second_positions.size(); ++i) {
+		latest_blocks.push_back(create_noise_block(20000 + i));
+		save_log_block(**stream, second_positions[i], latest_blocks[i]);
+	}
+
+	stream->compact();
+
+	// Saving again may have started more segments, but only the second one could be compacted
+	const std::vector<uint32_t> compacted_ids = get_log_segment_ids(dir_path);
+	ERR_FAIL_COND(compacted_ids.size() < 2);
+	ERR_FAIL_COND(compacted_ids[0] != ids[0]);
+	ERR_FAIL_COND(compacted_ids[1] != ids[2]);
+
+	for (size_t i = 0; i < second_positions.size(); ++i) {
+		ERR_FAIL_COND(!check_log_block(**stream, second_positions[i], latest_blocks[i]));
+	}
+	ERR_FAIL_COND(!check_log_block(**stream, deleted_pos, Ref<VoxelBuffer>()));
+	stream.unref();
+
+	// If the checkpoint is lost, the log is replayed from the start, and the deletion must still be there
+	{
+		DirAccessRef da = DirAccess::open(dir_path);
+		ERR_FAIL_COND(!da);
+		ERR_FAIL_COND(da->remove(dir_path.plus_file(VoxelStreamLog::CHECKPOINT_FILE_NAME)) != OK);
+	}
+	stream = open_test_log_stream(dir_path);
+	ERR_FAIL_COND(!check_log_block(**stream, deleted_pos, Ref<VoxelBuffer>()));
+	ERR_FAIL_COND(!check_log_block(**stream, first_positions[0], create_noise_block(100)));
+	for (size_t i = 0; i < second_positions.size(); ++i) {
+		ERR_FAIL_COND(!check_log_block(**stream, second_positions[i], latest_blocks[i]));
+	}
+	stream.unref();
+
+	remove_test_directory(dir_path);
+}
+
+void test_log_stream_unreadable_segment() {
+	const String dir_path = create_test_directory("log_stream_unreadable");
+	ERR_FAIL_COND(dir_path.empty());
+
+	const uint32_t unreadable_id = 7;
+	const String unreadable_path = dir_path.plus_file(VoxelLogSegment::get_file_name(unreadable_id));
+	const String unreadable_contents = "Not a segment";
+	{
+		FileAccessRef f = FileAccess::open(unreadable_path, FileAccess::WRITE);
+		ERR_FAIL_COND(!f);
+		f->store_string(unreadable_contents);
+	}
+
+	const Vector3i saved_pos(1, 0, 0);
+	const Vector3i absent_pos(0, 5, 0);
+	Ref<VoxelBuffer> saved_block = create_noise_block(1);
+	{
+		Ref<VoxelStreamLog> stream = open_test_log_stream(dir_path);
+		// Not loaded yet, so it can't tell
+		ERR_FAIL_COND(!stream->may_have_block(absent_pos << stream->get_block_size_po2(), 0));
+
+		save_log_block(**stream, saved_pos, saved_block);
+		ERR_FAIL_COND(!check_log_block(**stream, saved_pos, saved_block));
+		ERR_FAIL_COND(stream->may_have_block(absent_pos << stream->get_block_size_po2(), 0));
+	}
+
+	// The new segment didn't reuse the ID of the one which couldn't be read
+	const std::vector<uint32_t> ids = get_log_segment_ids(dir_path);
+	ERR_FAIL_COND(ids.size() != 2);
+	ERR_FAIL_COND(ids[0] != unreadable_id);
+	ERR_FAIL_COND(ids[1] <= unreadable_id);
+	ERR_FAIL_COND(FileAccess::get_file_as_string(unreadable_path) != unreadable_contents);
+
+	remove_test_directory(dir_path);
+}
+
 void test_encode_weights_packed_u16() {
 	FixedArray<uint8_t, 4> weights;
 	// There is data loss of the 4 smaller bits in this encoding,
@@ -671,6 +2019,30 @@ void run_voxel_tests() {
 	VOXEL_TEST(test_voxel_data_map_paste_fill);
 	VOXEL_TEST(test_voxel_data_map_paste_mask);
 	VOXEL_TEST(test_voxel_data_map_copy);
+	VOXEL_TEST(test_lod_terrain_implicit_uniform_blocks);
+	VOXEL_TEST(test_region_file_sector_reuse_and_compaction);
+	VOXEL_TEST(test_region_files_batched_load_order);
+	VOXEL_TEST(test_stream_cache_load_during_flush);
+	VOXEL_TEST(test_server_load_erased_block_while_save_queued);
+	VOXEL_TEST(test_unload_expired_blocks_hysteresis);
+	VOXEL_TEST(test_vector3i_index_map);
+	VOXEL_TEST(test_morton_64);
+	VOXEL_TEST(test_block_presence_index);
+	VOXEL_TEST(test_log_segment_file_name);
+	VOXEL_TEST(test_log_stream_save_and_reopen);
+	VOXEL_TEST(test_log_stream_replay_after_checkpoint);
+	VOXEL_TEST(test_log_stream_torn_tail);
+	VOXEL_TEST(test_log_stream_compaction);
+	VOXEL_TEST(test_log_stream_unreadable_segment);
+	VOXEL_TEST(test_voxel_buffer_copy_on_write);
+	VOXEL_TEST(test_voxel_buffer_downscale);
+	VOXEL_TEST(test_voxel_buffer_morton_copy);
+	VOXEL_TEST(test_voxel_buffer_metadata);
+	VOXEL_TEST(test_voxel_buffer_sparse);
+	VOXEL_TEST(test_voxel_buffer_sdf_8_bits);
+	VOXEL_TEST(test_voxel_buffer_channel_raw_area);
+	VOXEL_TEST(test_block_serializer_filters);
+	VOXEL_TEST(test_voxel_data_block_dirty_box);
 	VOXEL_TEST(test_encode_weights_packed_u16);
 	VOXEL_TEST(test_copy_3d_region_zxy);
 	VOXEL_TEST(test_voxel_graph_generator_default_graph_compilation);
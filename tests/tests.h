@@ -3,5 +3,6 @@
 
 void run_voxel_tests();
 void run_noise_tests();
+void run_voxel_benchmarks();
 
 #endif // VOXEL_TESTS_H
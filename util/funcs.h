@@ -1,6 +1,7 @@
 #ifndef HEADER_VOXEL_UTILITY_H
 #define HEADER_VOXEL_UTILITY_H
 
+#include "simd.h"
 #include <core/pool_vector.h>
 #include <core/vector.h>
 #include <utility>
@@ -138,6 +139,10 @@ template <typename Item_T>
 inline bool is_uniform(const Item_T *p_data, uint32_t item_count) {
 	const Item_T v0 = p_data[0];
 
+#ifdef VOXEL_SIMD_SSE2
+	return simd::all_equal(p_data, item_count, v0);
+#else
+
 	//typedef size_t Bucket_T;
 	struct Bucket_T {
 		size_t a;
@@ -185,6 +190,7 @@ inline bool is_uniform(const Item_T *p_data, uint32_t item_count) {
 	}
 
 	return true;
+#endif
 }
 
 #endif // HEADER_VOXEL_UTILITY_H
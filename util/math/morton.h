@@ -0,0 +1,73 @@
+#ifndef VOXEL_MORTON_H
+#define VOXEL_MORTON_H
+
+#include <stdint.h>
+
+// Morton code (Z-order curve) in 3D, interleaving bits of coordinates.
+// Voxels close to each other on any axis tend to be close in memory, unlike with row-major orders.
+// Y is placed in the lowest bit, so short vertical runs are still contiguous.
+// Supports coordinates up to 1023.
+
+// Spreads the 10 lowest bits of `v` so there are two zero bits between each of them
+inline uint32_t morton3d_spread_bits(uint32_t v) {
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// Inverse of `morton3d_spread_bits`
+inline uint32_t morton3d_compact_bits(uint32_t v) {
+	v &= 0x09249249;
+	v = (v ^ (v >> 2)) & 0x030c30c3;
+	v = (v ^ (v >> 4)) & 0x0300f00f;
+	v = (v ^ (v >> 8)) & 0x030000ff;
+	v = (v ^ (v >> 16)) & 0x3ff;
+	return v;
+}
+
+inline uint32_t morton3d_encode(uint32_t x, uint32_t y, uint32_t z) {
+	return morton3d_spread_bits(y) | (morton3d_spread_bits(x) << 1) | (morton3d_spread_bits(z) << 2);
+}
+
+inline void morton3d_decode(uint32_t m, uint32_t &x, uint32_t &y, uint32_t &z) {
+	y = morton3d_compact_bits(m);
+	x = morton3d_compact_bits(m >> 1);
+	z = morton3d_compact_bits(m >> 2);
+}
+
+// 64-bit variants, supporting coordinates up to 2097151 (21 bits)
+
+inline uint64_t morton3d_spread_bits_64(uint64_t v) {
+	v &= 0x1fffff;
+	v = (v | (v << 32)) & 0x001f00000000ffff;
+	v = (v | (v << 16)) & 0x001f0000ff0000ff;
+	v = (v | (v << 8)) & 0x100f00f00f00f00f;
+	v = (v | (v << 4)) & 0x10c30c30c30c30c3;
+	v = (v | (v << 2)) & 0x1249249249249249;
+	return v;
+}
+
+inline uint64_t morton3d_compact_bits_64(uint64_t v) {
+	v &= 0x1249249249249249;
+	v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3;
+	v = (v ^ (v >> 4)) & 0x100f00f00f00f00f;
+	v = (v ^ (v >> 8)) & 0x001f0000ff0000ff;
+	v = (v ^ (v >> 16)) & 0x001f00000000ffff;
+	v = (v ^ (v >> 32)) & 0x1fffff;
+	return v;
+}
+
+inline uint64_t morton3d_encode_64(uint32_t x, uint32_t y, uint32_t z) {
+	return morton3d_spread_bits_64(y) | (morton3d_spread_bits_64(x) << 1) | (morton3d_spread_bits_64(z) << 2);
+}
+
+inline void morton3d_decode_64(uint64_t m, uint32_t &x, uint32_t &y, uint32_t &z) {
+	y = morton3d_compact_bits_64(m);
+	x = morton3d_compact_bits_64(m >> 1);
+	z = morton3d_compact_bits_64(m >> 2);
+}
+
+#endif // VOXEL_MORTON_H
@@ -186,6 +186,10 @@ struct Vector3i {
 	static inline Vector3i min(const Vector3i a, const Vector3i b) {
 		return Vector3i(::min(a.x, b.x), ::min(a.y, b.y), ::min(a.z, b.z));
 	}
+
+	static inline Vector3i max(const Vector3i a, const Vector3i b) {
+		return Vector3i(::max(a.x, b.x), ::max(a.y, b.y), ::max(a.z, b.z));
+	}
 };
 
 _FORCE_INLINE_ Vector3i operator+(const Vector3i &a, const Vector3i &b) {
@@ -0,0 +1,135 @@
+#ifndef VOXEL_UTIL_SIMD_H
+#define VOXEL_UTIL_SIMD_H
+
+#include <stdint.h>
+#include <string.h>
+
+// SSE2 is part of the baseline of every x86_64 target Godot builds for, so it doesn't need runtime detection.
+// Wider instruction sets (AVX2) would need per-function target attributes or separate translation units compiled
+// with different flags, which Godot's build system doesn't do for modules. Other architectures use scalar code,
+// which compilers may still auto-vectorize.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VOXEL_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace simd {
+
+#ifdef VOXEL_SIMD_SSE2
+
+// Makes a 16-byte vector where every item is the given value
+template <typename T>
+inline __m128i broadcast(T value) {
+	static_assert(16 % sizeof(T) == 0, "Item size must divide vector size");
+	union {
+		__m128i v;
+		T items[16 / sizeof(T)];
+	} u;
+	for (unsigned int i = 0; i < 16 / sizeof(T); ++i) {
+		u.items[i] = value;
+	}
+	return u.v;
+}
+
+#endif
+
+// Sets `count` items to `value`. Pointers don't need to be aligned.
+template <typename T>
+inline void fill(T *dst, uint32_t count, T value) {
+#ifdef VOXEL_SIMD_SSE2
+	const uint32_t items_per_vector = 16 / sizeof(T);
+	const __m128i v = broadcast(value);
+	uint32_t i = 0;
+	for (; i + items_per_vector <= count; i += items_per_vector) {
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+	}
+	for (; i < count; ++i) {
+		dst[i] = value;
+	}
+#else
+	for (uint32_t i = 0; i < count; ++i) {
+		dst[i] = value;
+	}
+#endif
+}
+
+template <>
+inline void fill<uint8_t>(uint8_t *dst, uint32_t count, uint8_t value) {
+	memset(dst, value, count);
+}
+
+// Tests if all `count` items are equal to `value`
+template <typename T>
+inline bool all_equal(const T *src, uint32_t count, T value) {
+	uint32_t i = 0;
+#ifdef VOXEL_SIMD_SSE2
+	const uint32_t items_per_vector = 16 / sizeof(T);
+	const __m128i ref = broadcast(value);
+	// Test 4 vectors at once and branch only once for them, data is usually uniform or differs early
+	for (; i + 4 * items_per_vector <= count; i += 4 * items_per_vector) {
+		const __m128i *p = reinterpret_cast<const __m128i *>(src + i);
+		const __m128i d0 = _mm_xor_si128(_mm_loadu_si128(p), ref);
+		const __m128i d1 = _mm_xor_si128(_mm_loadu_si128(p + 1), ref);
+		const __m128i d2 = _mm_xor_si128(_mm_loadu_si128(p + 2), ref);
+		const __m128i d3 = _mm_xor_si128(_mm_loadu_si128(p + 3), ref);
+		const __m128i d = _mm_or_si128(_mm_or_si128(d0, d1), _mm_or_si128(d2, d3));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(d, _mm_setzero_si128())) != 0xffff) {
+			return false;
+		}
+	}
+#endif
+	for (; i < count; ++i) {
+		if (src[i] != value) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Copies every other item of `src` into `dst`: dst[i] = src[2 * i].
+// `src` must contain at least `2 * count - 1` items.
+template <typename T>
+inline void copy_even_items(T *dst, const T *src, uint32_t count) {
+	for (uint32_t i = 0; i < count; ++i) {
+		dst[i] = src[i << 1];
+	}
+}
+
+#ifdef VOXEL_SIMD_SSE2
+
+template <>
+inline void copy_even_items<uint8_t>(uint8_t *dst, const uint8_t *src, uint32_t count) {
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+	uint32_t i = 0;
+	// Reads 32 bytes at a time, so the last item must be handled by the scalar loop
+	for (; i + 16 < count; i += 16) {
+		const __m128i a = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i)), mask);
+		const __m128i b = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 16)), mask);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(a, b));
+	}
+	for (; i < count; ++i) {
+		dst[i] = src[i << 1];
+	}
+}
+
+template <>
+inline void copy_even_items<uint16_t>(uint16_t *dst, const uint16_t *src, uint32_t count) {
+	uint32_t i = 0;
+	for (; i + 8 < count; i += 8) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 8));
+		// Sign-extend low halves so the signed saturating pack leaves them unchanged
+		a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+		b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(a, b));
+	}
+	for (; i < count; ++i) {
+		dst[i] = src[i << 1];
+	}
+}
+
+#endif
+
+} // namespace simd
+
+#endif // VOXEL_UTIL_SIMD_H
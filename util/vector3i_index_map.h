@@ -0,0 +1,155 @@
+#ifndef VOXEL_VECTOR3I_INDEX_MAP_H
+#define VOXEL_VECTOR3I_INDEX_MAP_H
+
+#include "math/vector3i.h"
+#include <core/error_macros.h>
+#include <vector>
+
+// Maps Vector3i keys to unsigned integer indices, using open addressing with linear probing.
+// Keys and values are stored inline in a single flat array, so a lookup usually touches one cache line,
+// unlike Godot's HashMap which allocates an element per key and chains them.
+// Meant for spatial indexes of blocks, where lookups are much more frequent than insertions and removals.
+class Vector3iIndexMap {
+public:
+	static const uint32_t NO_VALUE = 0xffffffff;
+
+	Vector3iIndexMap() {}
+
+	// Returns a pointer to the value associated with the key, or null if the key is not in the map.
+	// The pointer becomes invalid after any insertion or removal.
+	inline uint32_t *getptr(const Vector3i &key) {
+		if (_count == 0) {
+			return nullptr;
+		}
+		uint32_t i = hash(key) & _mask;
+		while (true) {
+			Slot &slot = _slots[i];
+			if (slot.value == NO_VALUE) {
+				return nullptr;
+			}
+			if (slot.key == key) {
+				return &slot.value;
+			}
+			i = (i + 1) & _mask;
+		}
+	}
+
+	inline const uint32_t *getptr(const Vector3i &key) const {
+		return const_cast<Vector3iIndexMap *>(this)->getptr(key);
+	}
+
+	inline bool has(const Vector3i &key) const {
+		return getptr(key) != nullptr;
+	}
+
+	void set(const Vector3i &key, uint32_t value) {
+		ERR_FAIL_COND(value == NO_VALUE);
+		// Keep the load factor under 1/2, so probe sequences stay short
+		if ((_count + 1) * 2 > _slots.size()) {
+			grow();
+		}
+		uint32_t i = hash(key) & _mask;
+		while (true) {
+			Slot &slot = _slots[i];
+			if (slot.value == NO_VALUE) {
+				slot.key = key;
+				slot.value = value;
+				++_count;
+				return;
+			}
+			if (slot.key == key) {
+				slot.value = value;
+				return;
+			}
+			i = (i + 1) & _mask;
+		}
+	}
+
+	bool erase(const Vector3i &key) {
+		if (_count == 0) {
+			return false;
+		}
+		uint32_t i = hash(key) & _mask;
+		while (true) {
+			const Slot &slot = _slots[i];
+			if (slot.value == NO_VALUE) {
+				return false;
+			}
+			if (slot.key == key) {
+				break;
+			}
+			i = (i + 1) & _mask;
+		}
+		// Backward-shift deletion: move following entries of the cluster back if that brings them closer to
+		// their ideal slot, so no tombstones are needed and lookups stay fast.
+		uint32_t j = i;
+		while (true) {
+			j = (j + 1) & _mask;
+			Slot &next = _slots[j];
+			if (next.value == NO_VALUE) {
+				break;
+			}
+			const uint32_t ideal = hash(next.key) & _mask;
+			// Check if `ideal` is cyclically outside of ]i, j]
+			const bool can_move = i <= j ? (ideal <= i || ideal > j) : (ideal <= i && ideal > j);
+			if (can_move) {
+				_slots[i] = next;
+				i = j;
+			}
+		}
+		_slots[i].value = NO_VALUE;
+		--_count;
+		return true;
+	}
+
+	void clear() {
+		_slots.clear();
+		_mask = 0;
+		_count = 0;
+	}
+
+	inline uint32_t size() const {
+		return _count;
+	}
+
+	// Mixes coordinates so that neighbor positions don't land in neighbor slots, which would create long
+	// clusters with linear probing.
+	static inline uint32_t hash(const Vector3i &v) {
+		uint32_t h = static_cast<uint32_t>(v.x) * 73856093u;
+		h ^= static_cast<uint32_t>(v.y) * 19349663u;
+		h ^= static_cast<uint32_t>(v.z) * 83492791u;
+		// Finalizer from MurmurHash3
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+private:
+	struct Slot {
+		Vector3i key;
+		uint32_t value = NO_VALUE;
+	};
+
+	void grow() {
+		std::vector<Slot> old_slots;
+		old_slots.swap(_slots);
+		const uint32_t new_capacity = old_slots.size() == 0 ? 64 : old_slots.size() * 2;
+		_slots.resize(new_capacity);
+		_mask = new_capacity - 1;
+		_count = 0;
+		for (auto it = old_slots.begin(); it != old_slots.end(); ++it) {
+			if (it->value != NO_VALUE) {
+				set(it->key, it->value);
+			}
+		}
+	}
+
+	std::vector<Slot> _slots;
+	uint32_t _mask = 0;
+	uint32_t _count = 0;
+};
+
+#endif // VOXEL_VECTOR3I_INDEX_MAP_H